@@ -0,0 +1,40 @@
+#include "FieldIngest.h"
+
+#include <string.h>
+#include <BatchCodec.h>
+
+FieldIngest::FieldIngest(IngestDatabase& db, const std::string& topicRoot)
+    : db(db), sensorTopic(topicRoot + "/sensors"), messageCount(0), readingCount(0), rejectedCount(0),
+      failedCount(0) {
+  batch.reserve(256);
+}
+
+void FieldIngest::handle(const char* topic, size_t topicLen, const char* payload, size_t len, int64_t arrival) {
+  messageCount++;
+
+  if (topicLen == sensorTopic.size() && memcmp(topic, sensorTopic.data(), topicLen) == 0) {
+    batch.clear();
+    uint32_t now = 0;
+    if (decodeBatch(payload, len, now, collect, this) >= 0) {
+      for (const StoredRecord& record : batch) {
+        // Gateway uptime to wall-clock time; a record from before the last reset lands at the gateway's boot
+        int64_t time = arrival - ((int64_t)now - record.timestamp);
+        if (db.addReading(time, record.timestamp, record.reading)) {
+          readingCount++;
+        } else {
+          failedCount++;
+        }
+      }
+      return;
+    }
+    rejectedCount++;
+  }
+
+  if (!db.addMessage(arrival, topic, topicLen, payload, len)) {
+    failedCount++;
+  }
+}
+
+void FieldIngest::collect(const StoredRecord& record, void* context) {
+  ((FieldIngest*)context)->batch.push_back(record);
+}
@@ -0,0 +1,41 @@
+#ifndef FIELD_INGEST_H
+#define FIELD_INGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <RecordStore.h>
+#include "IngestDatabase.h"
+
+/* Routes the gateway's MQTT messages into the database.
+ * Batches on <root>/sensors (text "B1,..." or binary "b1:..." from
+ * BatchCodec) are decoded with the firmware's own decodeBatch() and stored
+ * one row per reading; a batch that does not decode, and every message on
+ * another topic, is kept as it came in field_messages.
+ */
+class FieldIngest {
+public:
+  FieldIngest(IngestDatabase& db, const std::string& topicRoot);
+
+  // A message that arrived at arrival (Unix seconds)
+  void handle(const char* topic, size_t topicLen, const char* payload, size_t len, int64_t arrival);
+
+  uint64_t messages() const { return messageCount; }
+  uint64_t readings() const { return readingCount; }
+  uint64_t rejected() const { return rejectedCount; }  // Batches that did not decode
+  uint64_t failed() const { return failedCount; }      // Rows the database refused; see IngestDatabase::error()
+
+private:
+  static void collect(const StoredRecord& record, void* context);
+
+  IngestDatabase& db;
+  std::string sensorTopic;
+  std::vector<StoredRecord> batch;  // Records of the batch being decoded, reused for every batch
+  uint64_t messageCount;
+  uint64_t readingCount;
+  uint64_t rejectedCount;
+  uint64_t failedCount;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "IngestDatabase.h"
+
+#define NOT_PENDING UINT64_MAX // firstPendingAt before flush() first sees the open transaction
+
+static const char SCHEMA[] =
+  "CREATE TABLE IF NOT EXISTS field_readings ("
+  " time INTEGER NOT NULL, node INTEGER NOT NULL, uptime INTEGER NOT NULL,"
+  " temperature INTEGER, humidity INTEGER, pressure INTEGER, flags INTEGER NOT NULL);"
+  "CREATE INDEX IF NOT EXISTS field_readings_time ON field_readings(time);"
+  "CREATE INDEX IF NOT EXISTS field_readings_node_time ON field_readings(node, time);"
+  "CREATE TABLE IF NOT EXISTS field_messages ("
+  " time INTEGER NOT NULL, topic TEXT NOT NULL, payload TEXT NOT NULL);"
+  "CREATE INDEX IF NOT EXISTS field_messages_topic_time ON field_messages(topic, time);";
+
+IngestDatabase::IngestDatabase()
+    : db(nullptr), insertReading(nullptr), insertMessage(nullptr), pendingRows(0), firstPendingAt(NOT_PENDING) {}
+
+IngestDatabase::~IngestDatabase() {
+  close();
+}
+
+bool IngestDatabase::open(const std::string& path) {
+  close();
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    return fail("open");
+  }
+  sqlite3_busy_timeout(db, 5000);  // A notebook holding a write lock on the lab tables delays a commit, no more
+
+  // WAL lets readers run alongside the writer; NORMAL syncs at checkpoints only, which WAL keeps consistent
+  if (!execute("PRAGMA journal_mode=WAL") || !execute("PRAGMA synchronous=NORMAL") || !execute(SCHEMA)) {
+    return false;
+  }
+  if (sqlite3_prepare_v2(db, "INSERT INTO field_readings VALUES (?, ?, ?, ?, ?, ?, ?)", -1, &insertReading,
+                         nullptr) != SQLITE_OK ||
+      sqlite3_prepare_v2(db, "INSERT INTO field_messages VALUES (?, ?, ?)", -1, &insertMessage, nullptr) !=
+        SQLITE_OK) {
+    return fail("prepare");
+  }
+  return true;
+}
+
+void IngestDatabase::close() {
+  if (db == nullptr) {
+    return;
+  }
+  flush(0, true);
+  sqlite3_finalize(insertReading);
+  sqlite3_finalize(insertMessage);
+  insertReading = nullptr;
+  insertMessage = nullptr;
+  sqlite3_close(db);
+  db = nullptr;
+}
+
+bool IngestDatabase::addReading(int64_t time, uint32_t uptime, const SensorReading& reading) {
+  if (!begin()) {
+    return false;
+  }
+  bool climate = (reading.flags & SENSOR_FLAG_TH_INVALID) == 0;
+  bool pressure = (reading.flags & SENSOR_FLAG_PRESSURE_INVALID) == 0;
+
+  sqlite3_bind_int64(insertReading, 1, time);
+  sqlite3_bind_int(insertReading, 2, reading.nodeId);
+  sqlite3_bind_int64(insertReading, 3, uptime);
+  climate ? sqlite3_bind_int(insertReading, 4, reading.temperature) : sqlite3_bind_null(insertReading, 4);
+  climate ? sqlite3_bind_int(insertReading, 5, reading.humidity) : sqlite3_bind_null(insertReading, 5);
+  pressure ? sqlite3_bind_int64(insertReading, 6, reading.pressure) : sqlite3_bind_null(insertReading, 6);
+  sqlite3_bind_int(insertReading, 7, reading.flags);
+
+  int result = sqlite3_step(insertReading);
+  sqlite3_reset(insertReading);
+  if (result != SQLITE_DONE) {
+    return fail("insert reading");
+  }
+  pendingRows++;
+  return true;
+}
+
+bool IngestDatabase::addMessage(int64_t time, const char* topic, size_t topicLen, const char* payload, size_t len) {
+  if (!begin()) {
+    return false;
+  }
+  sqlite3_bind_int64(insertMessage, 1, time);
+  sqlite3_bind_text(insertMessage, 2, topic, (int)topicLen, SQLITE_TRANSIENT);
+  sqlite3_bind_text(insertMessage, 3, payload, (int)len, SQLITE_TRANSIENT);
+
+  int result = sqlite3_step(insertMessage);
+  sqlite3_reset(insertMessage);
+  if (result != SQLITE_DONE) {
+    return fail("insert message");
+  }
+  pendingRows++;
+  return true;
+}
+
+bool IngestDatabase::flush(uint64_t nowMs, bool force) {
+  if (db == nullptr || sqlite3_get_autocommit(db)) {
+    return true;  // No transaction open
+  }
+  if (firstPendingAt == NOT_PENDING) {
+    firstPendingAt = nowMs;
+  }
+  if (!force && pendingRows < INGEST_COMMIT_ROWS && nowMs - firstPendingAt < INGEST_COMMIT_INTERVAL) {
+    return true;
+  }
+
+  bool committed = execute("COMMIT");
+  if (!committed) {
+    execute("ROLLBACK");  // The batch is lost rather than retried forever; error() tells why
+  }
+  pendingRows = 0;
+  firstPendingAt = NOT_PENDING;
+  return committed;
+}
+
+bool IngestDatabase::execute(const char* sql) {
+  char* message = nullptr;
+  if (sqlite3_exec(db, sql, nullptr, nullptr, &message) != SQLITE_OK) {
+    lastError = std::string(sql).substr(0, 32) + ": " + (message ? message : sqlite3_errmsg(db));
+    sqlite3_free(message);
+    return false;
+  }
+  return true;
+}
+
+bool IngestDatabase::begin() {
+  if (db == nullptr) {
+    lastError = "database not open";
+    return false;
+  }
+  return !sqlite3_get_autocommit(db) || execute("BEGIN");
+}
+
+bool IngestDatabase::fail(const char* what) {
+  lastError = std::string(what) + ": " + (db ? sqlite3_errmsg(db) : "out of memory");
+  return false;
+}
@@ -0,0 +1,66 @@
+#ifndef INGEST_DATABASE_H
+#define INGEST_DATABASE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sqlite3.h>
+#include <string>
+#include <SensorPacket.h>
+
+// Rows written in one transaction at most; at thousands of readings a second a commit lands every few hundred ms
+#define INGEST_COMMIT_ROWS 5000
+
+// Longest a row waits for its commit, so a quiet gateway's readings are still queryable within a second
+#define INGEST_COMMIT_INTERVAL 1000 // milliseconds
+
+/* Field Tables, next to the lab tables of the analysis side in the same database:
+ * field_readings | One row per gateway reading
+ *   time         | Unix seconds the gateway received it (arrival - (now - uptime), as the Python logger did)
+ *   node         | Node id
+ *   uptime       | Gateway uptime seconds it was stored at; 0 for readings stored before the last reset
+ *   temperature  | centi-degrees Celsius, NULL when SENSOR_FLAG_TH_INVALID is set
+ *   humidity     | centi-%RH, NULL likewise
+ *   pressure     | deci-Pascal, NULL when SENSOR_FLAG_PRESSURE_INVALID is set
+ *   flags        | SENSOR_FLAG_* bits as sent
+ * field_messages | Every other gateway message: location, links, stats, results, decisions, status
+ *   time, topic, payload
+ */
+
+/* SQLite writer for the ingest, in WAL mode so the query server and the
+ * notebooks read while it writes. Rows go into an open transaction through
+ * prepared statements and are committed in batches by flush(), which turns
+ * one fsync per message into one per INGEST_COMMIT_ROWS rows or
+ * INGEST_COMMIT_INTERVAL.
+ */
+class IngestDatabase {
+public:
+  IngestDatabase();
+  ~IngestDatabase();
+
+  // Open or create path with the field tables; false with error() set
+  bool open(const std::string& path);
+  void close();
+
+  bool addReading(int64_t time, uint32_t uptime, const SensorReading& reading);
+  bool addMessage(int64_t time, const char* topic, size_t topicLen, const char* payload, size_t len);
+
+  // Commit the open transaction once it is due at nowMs (monotonic), or now when force is set
+  bool flush(uint64_t nowMs, bool force = false);
+
+  size_t pending() const { return pendingRows; }
+  const std::string& error() const { return lastError; }
+
+private:
+  bool execute(const char* sql);
+  bool begin();
+  bool fail(const char* what);
+
+  sqlite3* db;
+  sqlite3_stmt* insertReading;
+  sqlite3_stmt* insertMessage;
+  size_t pendingRows;
+  uint64_t firstPendingAt;  // Monotonic ms flush() first saw the open transaction at
+  std::string lastError;
+};
+
+#endif
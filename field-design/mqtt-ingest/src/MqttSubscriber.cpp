@@ -0,0 +1,331 @@
+#include "MqttSubscriber.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t monotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void putRemainingLength(size_t len, std::vector<uint8_t>& out) {
+  do {
+    uint8_t byte = len & 0x7F;
+    len >>= 7;
+    out.push_back(len > 0 ? byte | 0x80 : byte);
+  } while (len > 0);
+}
+
+static void putString(const std::string& text, std::vector<uint8_t>& out) {
+  out.push_back((text.size() >> 8) & 0xFF);
+  out.push_back(text.size() & 0xFF);
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+bool MqttPacketReader::feed(const uint8_t* data, size_t len, PacketCallback onPacket, void* context) {
+  pending.insert(pending.end(), data, data + len);
+
+  size_t pos = 0;
+  while (pos + 2 <= pending.size()) {
+    // Remaining length: up to 4 bytes of 7 bits after the first byte
+    size_t remaining = 0;
+    size_t lengthBytes = 0;
+    bool complete = false;
+    while (lengthBytes < 4 && pos + 1 + lengthBytes < pending.size()) {
+      uint8_t byte = pending[pos + 1 + lengthBytes];
+      remaining |= (size_t)(byte & 0x7F) << (7 * lengthBytes);
+      lengthBytes++;
+      if (!(byte & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (lengthBytes == 4) {
+        return false;
+      }
+      break;  // The length itself is still incomplete
+    }
+    if (remaining > MQTT_PACKET_MAX) {
+      return false;
+    }
+
+    size_t bodyStart = pos + 1 + lengthBytes;
+    if (bodyStart + remaining > pending.size()) {
+      break;
+    }
+    onPacket(pending[pos], pending.data() + bodyStart, remaining, context);
+    pos = bodyStart + remaining;
+  }
+
+  pending.erase(pending.begin(), pending.begin() + pos);
+  return true;
+}
+
+void mqttEncodeConnect(const std::string& clientId, uint16_t keepalive, std::vector<uint8_t>& out) {
+  std::vector<uint8_t> body;
+  putString("MQTT", body);
+  body.push_back(4);     // Protocol level 3.1.1
+  body.push_back(0x02);  // Clean session, no will, no credentials
+  body.push_back(keepalive >> 8);
+  body.push_back(keepalive & 0xFF);
+  putString(clientId, body);
+
+  out.push_back(MQTT_CONNECT << 4);
+  putRemainingLength(body.size(), out);
+  out.insert(out.end(), body.begin(), body.end());
+}
+
+void mqttEncodeSubscribe(uint16_t packetId, const std::string& filter, std::vector<uint8_t>& out) {
+  std::vector<uint8_t> body;
+  body.push_back(packetId >> 8);
+  body.push_back(packetId & 0xFF);
+  putString(filter, body);
+  body.push_back(0);  // QoS 0: a message lost in transit is carried again by the gateway's next batch
+
+  out.push_back((MQTT_SUBSCRIBE << 4) | 0x02);
+  putRemainingLength(body.size(), out);
+  out.insert(out.end(), body.begin(), body.end());
+}
+
+void mqttEncodePingreq(std::vector<uint8_t>& out) {
+  out.push_back(MQTT_PINGREQ << 4);
+  out.push_back(0);
+}
+
+void mqttEncodePuback(uint16_t packetId, std::vector<uint8_t>& out) {
+  out.push_back(MQTT_PUBACK << 4);
+  out.push_back(2);
+  out.push_back(packetId >> 8);
+  out.push_back(packetId & 0xFF);
+}
+
+bool mqttDecodePublish(uint8_t header, const uint8_t* body, size_t len, const char*& topic, size_t& topicLen,
+                       const char*& payload, size_t& payloadLen, std::vector<uint8_t>& ack) {
+  if (len < 2) {
+    return false;
+  }
+  topicLen = ((size_t)body[0] << 8) | body[1];
+  size_t pos = 2 + topicLen;
+  uint8_t qos = (header >> 1) & 0x03;
+  if (qos > 0) {
+    if (pos + 2 > len) {
+      return false;
+    }
+    if (qos == 1) {
+      mqttEncodePuback(((uint16_t)body[pos] << 8) | body[pos + 1], ack);
+    }
+    pos += 2;
+  }
+  if (pos > len) {
+    return false;
+  }
+  topic = (const char*)body + 2;
+  payload = (const char*)body + pos;
+  payloadLen = len - pos;
+  return true;
+}
+
+MqttSubscriber::MqttSubscriber(const std::string& host, uint16_t port, const std::string& clientId,
+                               uint16_t keepalive, MqttMessageCallback onMessage, void* context)
+    : host(host), port(port), clientId(clientId), keepalive(keepalive), onMessage(onMessage), context(context),
+      fd(-1), awaited(0), arrived(false), failed(false), lastSentAt(0), pingSentAt(0) {}
+
+MqttSubscriber::~MqttSubscriber() {
+  close();
+}
+
+bool MqttSubscriber::connect(const std::string& filter, uint32_t timeoutMs) {
+  close();
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+    return false;
+  }
+
+  for (struct addrinfo* address = addresses; address != nullptr && fd < 0; address = address->ai_next) {
+    fd = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd >= 0 && ::connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  std::vector<uint8_t> packet;
+  mqttEncodeConnect(clientId, keepalive, packet);
+  if (!sendAll(packet) || !waitFor(MQTT_CONNACK, timeoutMs)) {
+    close();
+    return false;
+  }
+
+  packet.clear();
+  mqttEncodeSubscribe(1, filter, packet);
+  if (!sendAll(packet) || !waitFor(MQTT_SUBACK, timeoutMs)) {
+    close();
+    return false;
+  }
+  pingSentAt = 0;
+  return true;
+}
+
+void MqttSubscriber::close() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+  reader.reset();
+}
+
+bool MqttSubscriber::poll() {
+  if (fd < 0) {
+    return false;
+  }
+
+  uint8_t buffer[16384];
+  for (;;) {
+    ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      if (!feed(buffer, (size_t)n)) {
+        close();
+        return false;
+      }
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return true;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    close();  // Closed by the broker, or a socket error
+    return false;
+  }
+}
+
+bool MqttSubscriber::keepAlive(uint64_t nowMs) {
+  if (fd < 0) {
+    return false;
+  }
+  if (pingSentAt != 0 && nowMs - pingSentAt > (uint64_t)keepalive * 1000) {
+    close();
+    return false;
+  }
+  if (pingSentAt == 0 && nowMs - lastSentAt >= (uint64_t)keepalive * 500) {
+    std::vector<uint8_t> packet;
+    mqttEncodePingreq(packet);
+    if (!sendAll(packet)) {
+      close();
+      return false;
+    }
+    pingSentAt = nowMs;
+  }
+  return true;
+}
+
+bool MqttSubscriber::feed(const uint8_t* data, size_t len) {
+  failed = false;
+  return reader.feed(data, len, onPacket, this) && !failed;
+}
+
+void MqttSubscriber::onPacket(uint8_t header, const uint8_t* body, size_t len, void* context) {
+  MqttSubscriber* self = (MqttSubscriber*)context;
+  uint8_t type = header >> 4;
+  self->arrived |= type == self->awaited;
+
+  switch (type) {
+    case MQTT_PUBLISH: {
+      const char* topic;
+      const char* payload;
+      size_t topicLen, payloadLen;
+      std::vector<uint8_t> ack;
+      if (!mqttDecodePublish(header, body, len, topic, topicLen, payload, payloadLen, ack)) {
+        self->failed = true;
+        return;
+      }
+      self->onMessage(topic, topicLen, payload, payloadLen, self->context);
+      if (!ack.empty() && !self->sendAll(ack)) {
+        self->failed = true;
+      }
+      break;
+    }
+
+    case MQTT_CONNACK:
+      self->failed |= len < 2 || body[1] != 0;  // Any return code but 0 refuses the connection
+      break;
+
+    case MQTT_SUBACK:
+      self->failed |= len < 3 || body[2] == 0x80;
+      break;
+
+    case MQTT_PINGRESP:
+      self->pingSentAt = 0;
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool MqttSubscriber::sendAll(const std::vector<uint8_t>& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += (size_t)n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      struct pollfd writable = {fd, POLLOUT, 0};
+      ::poll(&writable, 1, 1000);
+      continue;
+    }
+    return false;
+  }
+  lastSentAt = monotonicMs();
+  return true;
+}
+
+// Read until a packet of type arrives; messages arriving meanwhile are delivered as usual
+bool MqttSubscriber::waitFor(uint8_t type, uint32_t timeoutMs) {
+  uint64_t deadline = monotonicMs() + timeoutMs;
+  uint8_t buffer[1024];
+  awaited = type;
+  arrived = false;
+
+  while (!arrived) {
+    uint64_t now = monotonicMs();
+    if (now >= deadline) {
+      return false;
+    }
+    struct pollfd readable = {fd, POLLIN, 0};
+    if (::poll(&readable, 1, (int)(deadline - now)) <= 0) {
+      continue;
+    }
+    ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return false;
+    }
+    if (n > 0 && !feed(buffer, (size_t)n)) {
+      return false;
+    }
+  }
+  awaited = 0;
+  return true;
+}
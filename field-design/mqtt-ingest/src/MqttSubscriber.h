@@ -0,0 +1,104 @@
+#ifndef MQTT_SUBSCRIBER_H
+#define MQTT_SUBSCRIBER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Largest packet accepted from the broker; gateway batches are a few hundred bytes
+#define MQTT_PACKET_MAX 65536
+
+// Control packet types, the high nibble of the first byte
+#define MQTT_CONNECT 1
+#define MQTT_CONNACK 2
+#define MQTT_PUBLISH 3
+#define MQTT_PUBACK 4
+#define MQTT_SUBSCRIBE 8
+#define MQTT_SUBACK 9
+#define MQTT_PINGREQ 12
+#define MQTT_PINGRESP 13
+
+// A PUBLISH delivered to the subscriber; neither string is NUL-terminated
+typedef void (*MqttMessageCallback)(const char* topic, size_t topicLen, const char* payload, size_t len,
+                                    void* context);
+
+/* Splits the byte stream from the broker into control packets.
+ * feed() takes whatever read() returned, however the packets are split
+ * across reads, and hands each complete packet to onPacket with its first
+ * byte and body. Only the partial packet at the end is buffered.
+ */
+class MqttPacketReader {
+public:
+  typedef void (*PacketCallback)(uint8_t header, const uint8_t* body, size_t len, void* context);
+
+  // False once the stream is malformed (bad remaining length or a packet over MQTT_PACKET_MAX)
+  bool feed(const uint8_t* data, size_t len, PacketCallback onPacket, void* context);
+
+  void reset() { pending.clear(); }
+
+private:
+  std::vector<uint8_t> pending;
+};
+
+// Packets the subscriber sends, appended to out
+void mqttEncodeConnect(const std::string& clientId, uint16_t keepalive, std::vector<uint8_t>& out);
+void mqttEncodeSubscribe(uint16_t packetId, const std::string& filter, std::vector<uint8_t>& out);
+void mqttEncodePingreq(std::vector<uint8_t>& out);
+void mqttEncodePuback(uint16_t packetId, std::vector<uint8_t>& out);
+
+// Split a PUBLISH body into topic and payload, acking QoS 1 deliveries into ack; false when malformed
+bool mqttDecodePublish(uint8_t header, const uint8_t* body, size_t len, const char*& topic, size_t& topicLen,
+                       const char*& payload, size_t& payloadLen, std::vector<uint8_t>& ack);
+
+/* Minimal MQTT 3.1.1 subscriber over a plain TCP socket: CONNECT with a clean
+ * session, one SUBSCRIBE at QoS 0, PUBLISH delivery and PINGREQ keepalive.
+ * That is all the ingest needs of the protocol, so no client library is
+ * pulled in. The socket is non-blocking once connected; call poll() when it
+ * is readable and keepAlive() at least every second.
+ */
+class MqttSubscriber {
+public:
+  // onMessage gets every PUBLISH, including retained ones that arrive while connect() waits for its SUBACK
+  MqttSubscriber(const std::string& host, uint16_t port, const std::string& clientId, uint16_t keepalive,
+                 MqttMessageCallback onMessage, void* context);
+  ~MqttSubscriber();
+
+  // Connect and subscribe to filter, waiting at most timeoutMs each for CONNACK and SUBACK; false on any failure
+  bool connect(const std::string& filter, uint32_t timeoutMs);
+  void close();
+
+  bool connected() const { return fd >= 0; }
+  int socket() const { return fd; }
+
+  // Read what the socket has and deliver every complete PUBLISH; false when the connection is lost
+  bool poll();
+
+  // Ping the broker when the link has been quiet for half the keepalive; false when a ping went unanswered
+  bool keepAlive(uint64_t nowMs);
+
+private:
+  static void onPacket(uint8_t header, const uint8_t* body, size_t len, void* context);
+  bool sendAll(const std::vector<uint8_t>& data);
+  bool waitFor(uint8_t type, uint32_t timeoutMs);
+  bool feed(const uint8_t* data, size_t len);
+
+  std::string host;
+  uint16_t port;
+  std::string clientId;
+  uint16_t keepalive;
+  MqttMessageCallback onMessage;
+  void* context;
+  int fd;
+  MqttPacketReader reader;
+  uint8_t awaited;           // Packet type waitFor() is waiting for, 0 when none
+  bool arrived;              // The awaited packet came in
+  bool failed;               // The broker refused the connection or sent a malformed packet
+  uint64_t lastSentAt;       // Milliseconds on the monotonic clock
+  uint64_t pingSentAt;       // 0 when no ping is outstanding
+};
+
+// Milliseconds on the monotonic clock
+uint64_t monotonicMs();
+
+#endif
@@ -0,0 +1,285 @@
+#include "QueryServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <map>
+
+#define REQUEST_MAX 8192     // Request line and headers
+#define REQUEST_TIMEOUT 5000 // Milliseconds a client gets to send its request
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Percent-decode a query string component, '+' meaning space
+static std::string urlDecode(const std::string& text) {
+  std::string out;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '%' && i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+      out.push_back((char)(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+      i += 2;
+    } else {
+      out.push_back(text[i] == '+' ? ' ' : text[i]);
+    }
+  }
+  return out;
+}
+
+static std::map<std::string, std::string> parseQuery(const std::string& query) {
+  std::map<std::string, std::string> params;
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos) {
+      end = query.size();
+    }
+    std::string pair = query.substr(pos, end - pos);
+    size_t equals = pair.find('=');
+    if (equals != std::string::npos) {
+      params[urlDecode(pair.substr(0, equals))] = urlDecode(pair.substr(equals + 1));
+    }
+    pos = end + 1;
+  }
+  return params;
+}
+
+// Integer parameter name of params into value, keeping value when it is absent; false when it is not a number
+static bool integerParam(const std::map<std::string, std::string>& params, const char* name, int64_t& value) {
+  auto it = params.find(name);
+  if (it == params.end()) {
+    return true;
+  }
+  char* end;
+  long long parsed = strtoll(it->second.c_str(), &end, 10);
+  if (it->second.empty() || *end != '\0') {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+// Append one CSV field, quoted when it holds a separator, quote or line break
+static void appendCsv(std::string& out, const char* text) {
+  if (text == nullptr) {
+    return;
+  }
+  if (strpbrk(text, ",\"\r\n") == nullptr) {
+    out += text;
+    return;
+  }
+  out.push_back('"');
+  for (const char* p = text; *p; p++) {
+    if (*p == '"') {
+      out.push_back('"');
+    }
+    out.push_back(*p);
+  }
+  out.push_back('"');
+}
+
+static void appendRows(sqlite3_stmt* statement, std::string& body) {
+  int columns = sqlite3_column_count(statement);
+  while (sqlite3_step(statement) == SQLITE_ROW) {
+    for (int i = 0; i < columns; i++) {
+      if (i > 0) {
+        body.push_back(',');
+      }
+      appendCsv(body, (const char*)sqlite3_column_text(statement, i));
+    }
+    body.push_back('\n');
+  }
+}
+
+QueryServer::QueryServer(const std::string& dbPath) : dbPath(dbPath), db(nullptr), listener(-1), running(false) {}
+
+QueryServer::~QueryServer() {
+  stop();
+  if (db != nullptr) {
+    sqlite3_close(db);
+  }
+}
+
+bool QueryServer::start(const std::string& address, uint16_t port) {
+  if (!openDatabase()) {
+    return false;
+  }
+
+  struct sockaddr_in bound;
+  memset(&bound, 0, sizeof(bound));
+  bound.sin_family = AF_INET;
+  bound.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &bound.sin_addr) != 1) {
+    return false;
+  }
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(listener, (struct sockaddr*)&bound, sizeof(bound)) != 0 || listen(listener, 16) != 0) {
+    if (listener >= 0) {
+      close(listener);
+      listener = -1;
+    }
+    return false;
+  }
+
+  running = true;
+  thread = std::thread(&QueryServer::serve, this);
+  return true;
+}
+
+void QueryServer::stop() {
+  if (!running) {
+    return;
+  }
+  running = false;
+  thread.join();
+  close(listener);
+  listener = -1;
+}
+
+int QueryServer::respond(const std::string& target, std::string& body) {
+  body.clear();
+  if (!openDatabase()) {
+    body = "database unavailable\n";
+    return 503;
+  }
+
+  size_t question = target.find('?');
+  std::string path = target.substr(0, question);
+  std::map<std::string, std::string> params =
+    parseQuery(question == std::string::npos ? std::string() : target.substr(question + 1));
+
+  int64_t from = 0;
+  int64_t to = INT64_MAX;
+  int64_t node = -1;
+  int64_t limit = QUERY_DEFAULT_LIMIT;
+  if (!integerParam(params, "from", from) || !integerParam(params, "to", to) ||
+      !integerParam(params, "node", node) || !integerParam(params, "limit", limit) || limit < 0 ||
+      limit > QUERY_MAX_LIMIT) {
+    body = "from, to, node and limit must be integers, limit at most 1000000\n";
+    return 400;
+  }
+
+  sqlite3_stmt* statement = nullptr;
+  if (path == "/readings") {
+    body = "time,node,uptime,temperature,humidity,pressure,flags\n";
+    sqlite3_prepare_v2(db,
+                       "SELECT time, node, uptime, temperature / 100.0, humidity / 100.0, pressure / 1000.0, flags"
+                       " FROM field_readings WHERE time >= ?1 AND time < ?2 AND (?3 < 0 OR node = ?3)"
+                       " ORDER BY time LIMIT ?4",
+                       -1, &statement, nullptr);
+    if (statement != nullptr) {
+      sqlite3_bind_int64(statement, 3, node);
+    }
+  } else if (path == "/messages") {
+    body = "time,topic,payload\n";
+    sqlite3_prepare_v2(db,
+                       "SELECT time, topic, payload FROM field_messages"
+                       " WHERE time >= ?1 AND time < ?2 AND (?3 IS NULL OR topic = ?3) ORDER BY time LIMIT ?4",
+                       -1, &statement, nullptr);
+    auto topic = params.find("topic");
+    if (statement != nullptr && topic != params.end()) {
+      sqlite3_bind_text(statement, 3, topic->second.c_str(), -1, SQLITE_TRANSIENT);
+    }
+  } else {
+    body = "unknown path, use /readings or /messages\n";
+    return 404;
+  }
+
+  if (statement == nullptr) {
+    body = std::string(sqlite3_errmsg(db)) + "\n";
+    return 500;
+  }
+  sqlite3_bind_int64(statement, 1, from);
+  sqlite3_bind_int64(statement, 2, to);
+  sqlite3_bind_int64(statement, 4, limit);
+  appendRows(statement, body);
+  sqlite3_finalize(statement);
+  return 200;
+}
+
+bool QueryServer::openDatabase() {
+  if (db != nullptr) {
+    return true;
+  }
+  if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    sqlite3_close(db);
+    db = nullptr;
+    return false;
+  }
+  sqlite3_busy_timeout(db, 5000);
+  return true;
+}
+
+void QueryServer::serve() {
+  while (running) {
+    struct pollfd readable = {listener, POLLIN, 0};
+    if (poll(&readable, 1, 500) <= 0) {
+      continue;  // Wake up now and then to notice stop()
+    }
+    int client = accept(listener, nullptr, nullptr);
+    if (client >= 0) {
+      handleConnection(client);
+      close(client);
+    }
+  }
+}
+
+void QueryServer::handleConnection(int client) {
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < REQUEST_MAX) {
+    struct pollfd readable = {client, POLLIN, 0};
+    if (poll(&readable, 1, REQUEST_TIMEOUT) <= 0) {
+      return;
+    }
+    ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return;
+    }
+    request.append(buffer, (size_t)n);
+  }
+
+  // "GET <target> HTTP/1.1"
+  std::string body;
+  int status = 405;
+  size_t space = request.find(' ');
+  size_t end = space == std::string::npos ? std::string::npos : request.find(' ', space + 1);
+  if (request.compare(0, 4, "GET ") == 0 && end != std::string::npos) {
+    status = respond(request.substr(space + 1, end - space - 1), body);
+  } else {
+    body = "only GET is supported\n";
+  }
+
+  const char* reason = status == 200 ? "OK" : status == 400 ? "Bad Request" : status == 404 ? "Not Found"
+                     : status == 405 ? "Method Not Allowed" : status == 503 ? "Service Unavailable"
+                     : "Internal Server Error";
+  std::string header = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" +
+                       "Content-Type: " + (status == 200 ? "text/csv" : "text/plain") + "; charset=utf-8\r\n" +
+                       "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+  header += body;
+
+  size_t sent = 0;
+  while (sent < header.size()) {
+    ssize_t n = send(client, header.data() + sent, header.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    sent += (size_t)n;
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <sqlite3.h>
+
+// Rows one query returns unless it asks for fewer with limit=
+#define QUERY_DEFAULT_LIMIT 100000
+#define QUERY_MAX_LIMIT 1000000
+
+/* Query Endpoints, HTTP GET answered as CSV with a header row:
+ * Path      | Parameters                                  | Columns
+ * ----------|---------------------------------------------|-----------------------------------------------
+ * /readings | from, to (Unix seconds, to exclusive), node | time,node,uptime,temperature,humidity,pressure,flags
+ *           | and limit, all optional                     | in degrees Celsius, %RH and hPa, empty when invalid
+ * /messages | from, to, topic (exact), limit              | time,topic,payload
+ * Rows are ordered by time; a bad parameter answers 400 and an unknown path 404.
+ */
+
+/* Time-range queries over the ingest database for the analysis notebooks,
+ * e.g. pandas.read_csv("http://host:8086/readings?from=1727568000&node=1").
+ * Runs on its own thread with its own read-only connection, so with the
+ * database in WAL mode a long query never holds up the ingest. One request
+ * per connection, answered in order.
+ */
+class QueryServer {
+public:
+  explicit QueryServer(const std::string& dbPath);
+  ~QueryServer();
+
+  // Listen on address:port and start serving; false when the socket or the database cannot be opened
+  bool start(const std::string& address, uint16_t port);
+  void stop();
+
+  // Answer a request target such as "/readings?from=0&to=100" into body; returns the HTTP status code
+  int respond(const std::string& target, std::string& body);
+
+private:
+  bool openDatabase();
+  void serve();
+  void handleConnection(int client);
+
+  std::string dbPath;
+  sqlite3* db;
+  int listener;
+  std::atomic<bool> running;
+  std::thread thread;
+};
+
+#endif
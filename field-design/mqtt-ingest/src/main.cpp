@@ -0,0 +1,143 @@
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "MqttSubscriber.h"
+#include "IngestDatabase.h"
+#include "FieldIngest.h"
+#include "QueryServer.h"
+
+// Defaults match the gateway's (see stm32_cc1101_receiver_a9g/src/main.cpp)
+#define DEFAULT_BROKER "test.mosquitto.org"
+#define DEFAULT_PORT 1883
+#define DEFAULT_TOPIC_ROOT "/test/stm32"
+#define DEFAULT_CLIENT_ID "STM32Ingest"
+#define DEFAULT_DATABASE "irrigation_data.db" // Shared with the analysis side, next to its lab tables
+#define DEFAULT_QUERY_ADDRESS "127.0.0.1"
+#define DEFAULT_QUERY_PORT 8086
+
+#define MQTT_KEEPALIVE 60 // Seconds
+#define MQTT_ANSWER_TIMEOUT 10000 // Milliseconds to wait for CONNACK and SUBACK
+#define RECONNECT_MIN 1000 // Reconnect backoff in milliseconds, doubling up to RECONNECT_MAX
+#define RECONNECT_MAX 60000
+#define POLL_INTERVAL 100 // Longest the loop sleeps, bounding commit latency and shutdown time
+#define REPORT_INTERVAL 60000 // Throughput line on stderr
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+static void onMessage(const char* topic, size_t topicLen, const char* payload, size_t len, void* context) {
+  ((FieldIngest*)context)->handle(topic, topicLen, payload, len, (int64_t)time(nullptr));
+}
+
+static void usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [-b broker] [-p port] [-t topic root] [-i client id] [-d database] [-a query address]\n"
+          "       [-q query port, 0 for none]\n"
+          "Subscribes to <topic root>/#, stores the gateway batches in field_readings and every other message\n"
+          "in field_messages, and answers /readings and /messages time-range queries over HTTP as CSV.\n",
+          name);
+}
+
+int main(int argc, char** argv) {
+  std::string broker = DEFAULT_BROKER;
+  int port = DEFAULT_PORT;
+  std::string topicRoot = DEFAULT_TOPIC_ROOT;
+  std::string clientId = DEFAULT_CLIENT_ID;
+  std::string database = DEFAULT_DATABASE;
+  std::string queryAddress = DEFAULT_QUERY_ADDRESS;
+  int queryPort = DEFAULT_QUERY_PORT;
+
+  int option;
+  while ((option = getopt(argc, argv, "b:p:t:i:d:a:q:h")) != -1) {
+    switch (option) {
+      case 'b': broker = optarg; break;
+      case 'p': port = atoi(optarg); break;
+      case 't': topicRoot = optarg; break;
+      case 'i': clientId = optarg; break;
+      case 'd': database = optarg; break;
+      case 'a': queryAddress = optarg; break;
+      case 'q': queryPort = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return option == 'h' ? 0 : 2;
+    }
+  }
+  if (port <= 0 || port > 65535 || queryPort < 0 || queryPort > 65535) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  IngestDatabase db;
+  if (!db.open(database)) {
+    fprintf(stderr, "ingest: %s: %s\n", database.c_str(), db.error().c_str());
+    return 1;
+  }
+
+  QueryServer queries(database);
+  if (queryPort != 0 && !queries.start(queryAddress, (uint16_t)queryPort)) {
+    fprintf(stderr, "ingest: cannot serve queries on %s:%d\n", queryAddress.c_str(), queryPort);
+    return 1;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  FieldIngest ingest(db, topicRoot);
+  MqttSubscriber mqtt(broker, (uint16_t)port, clientId, MQTT_KEEPALIVE, onMessage, &ingest);
+  std::string filter = topicRoot + "/#";
+  uint64_t reconnectAt = 0;
+  uint32_t backoff = RECONNECT_MIN;
+  uint64_t reportAt = monotonicMs() + REPORT_INTERVAL;
+  uint64_t reportedMessages = 0;
+
+  while (!stopping) {
+    uint64_t now = monotonicMs();
+    if (!mqtt.connected() && now >= reconnectAt) {
+      if (mqtt.connect(filter, MQTT_ANSWER_TIMEOUT)) {
+        fprintf(stderr, "ingest: subscribed to %s on %s:%d\n", filter.c_str(), broker.c_str(), port);
+        backoff = RECONNECT_MIN;
+      } else {
+        fprintf(stderr, "ingest: cannot connect to %s:%d, retrying in %u s\n", broker.c_str(), port,
+                backoff / 1000);
+        reconnectAt = now + backoff;
+        backoff = backoff * 2 > RECONNECT_MAX ? RECONNECT_MAX : backoff * 2;
+      }
+    }
+
+    struct pollfd readable = {mqtt.socket(), POLLIN, 0};
+    if (mqtt.connected() && poll(&readable, 1, POLL_INTERVAL) > 0 && !mqtt.poll()) {
+      fprintf(stderr, "ingest: connection to the broker lost\n");
+    } else if (!mqtt.connected()) {
+      poll(nullptr, 0, POLL_INTERVAL);
+    }
+
+    now = monotonicMs();
+    if (mqtt.connected() && !mqtt.keepAlive(now)) {
+      fprintf(stderr, "ingest: broker stopped answering\n");
+    }
+    if (!db.flush(now)) {
+      fprintf(stderr, "ingest: commit failed: %s\n", db.error().c_str());
+    }
+
+    if (now >= reportAt) {
+      fprintf(stderr, "ingest: %.1f msg/s, %llu messages, %llu readings, %llu rejected, %llu failed\n",
+              (ingest.messages() - reportedMessages) * 1000.0 / REPORT_INTERVAL,
+              (unsigned long long)ingest.messages(), (unsigned long long)ingest.readings(),
+              (unsigned long long)ingest.rejected(), (unsigned long long)ingest.failed());
+      reportedMessages = ingest.messages();
+      reportAt = now + REPORT_INTERVAL;
+    }
+  }
+
+  queries.stop();
+  db.flush(monotonicMs(), true);
+  db.close();
+  return 0;
+}
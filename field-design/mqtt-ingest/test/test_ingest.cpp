@@ -0,0 +1,271 @@
+// Ingest pipeline checks: MQTT framing, a loopback broker session, batch rows in SQLite and the query answers
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <BatchCodec.h>
+#include "MqttSubscriber.h"
+#include "IngestDatabase.h"
+#include "FieldIngest.h"
+#include "QueryServer.h"
+
+static int failures = 0;
+
+#define CHECK(condition)                                                  \
+  do {                                                                    \
+    if (!(condition)) {                                                   \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+      failures++;                                                         \
+    }                                                                     \
+  } while (0)
+
+// PUBLISH of payload on topic at QoS 0 or 1
+static std::vector<uint8_t> publishPacket(const std::string& topic, const std::string& payload, uint8_t qos = 0) {
+  std::vector<uint8_t> body;
+  body.push_back(topic.size() >> 8);
+  body.push_back(topic.size() & 0xFF);
+  body.insert(body.end(), topic.begin(), topic.end());
+  if (qos > 0) {
+    body.push_back(0x12);
+    body.push_back(0x34);
+  }
+  body.insert(body.end(), payload.begin(), payload.end());
+
+  std::vector<uint8_t> packet = {(uint8_t)((MQTT_PUBLISH << 4) | (qos << 1))};
+  size_t len = body.size();
+  do {
+    uint8_t byte = len & 0x7F;
+    len >>= 7;
+    packet.push_back(len > 0 ? byte | 0x80 : byte);
+  } while (len > 0);
+  packet.insert(packet.end(), body.begin(), body.end());
+  return packet;
+}
+
+struct Collected {
+  std::vector<std::string> topics;
+  std::vector<std::string> payloads;
+};
+
+static void collectPacket(uint8_t header, const uint8_t* body, size_t len, void* context) {
+  Collected* collected = (Collected*)context;
+  const char* topic;
+  const char* payload;
+  size_t topicLen, payloadLen;
+  std::vector<uint8_t> ack;
+  if ((header >> 4) == MQTT_PUBLISH && mqttDecodePublish(header, body, len, topic, topicLen, payload, payloadLen,
+                                                         ack)) {
+    collected->topics.push_back(std::string(topic, topicLen));
+    collected->payloads.push_back(std::string(payload, payloadLen));
+  }
+}
+
+static void collectMessage(const char* topic, size_t topicLen, const char* payload, size_t len, void* context) {
+  Collected* collected = (Collected*)context;
+  collected->topics.push_back(std::string(topic, topicLen));
+  collected->payloads.push_back(std::string(payload, len));
+}
+
+static void testFramingAcrossReads() {
+  std::string big(300, 'x');  // Two-byte remaining length
+  std::vector<uint8_t> stream = publishPacket("/a", "one");
+  std::vector<uint8_t> second = publishPacket("/b", big);
+  stream.insert(stream.end(), second.begin(), second.end());
+
+  MqttPacketReader reader;
+  Collected collected;
+  for (uint8_t byte : stream) {
+    CHECK(reader.feed(&byte, 1, collectPacket, &collected));
+  }
+  CHECK(collected.payloads.size() == 2);
+  CHECK(collected.topics.size() == 2 && collected.topics[1] == "/b");
+  CHECK(collected.payloads.size() == 2 && collected.payloads[1] == big);
+
+  const uint8_t oversized[] = {MQTT_PUBLISH << 4, 0xFF, 0xFF, 0xFF, 0x7F};
+  CHECK(!reader.feed(oversized, sizeof(oversized), collectPacket, &collected));
+}
+
+static void testQos1Acknowledged() {
+  std::vector<uint8_t> packet = publishPacket("/t", "p", 1);
+  const char* topic;
+  const char* payload;
+  size_t topicLen, payloadLen;
+  std::vector<uint8_t> ack;
+  CHECK(mqttDecodePublish(packet[0], packet.data() + 2, packet.size() - 2, topic, topicLen, payload, payloadLen,
+                          ack));
+  CHECK(std::string(payload, payloadLen) == "p");
+  std::vector<uint8_t> expected = {MQTT_PUBACK << 4, 2, 0x12, 0x34};
+  CHECK(ack == expected);
+}
+
+// One broker session on a loopback port: CONNACK, SUBACK with a retained message right behind it, two more
+// messages and a close
+static void runBroker(int listener) {
+  int client = accept(listener, nullptr, nullptr);
+  if (client < 0) {
+    return;
+  }
+  uint8_t buffer[256];
+  recv(client, buffer, sizeof(buffer), 0);  // CONNECT
+  const uint8_t connack[] = {MQTT_CONNACK << 4, 2, 0, 0};
+  send(client, connack, sizeof(connack), 0);
+  recv(client, buffer, sizeof(buffer), 0);  // SUBSCRIBE
+
+  std::vector<uint8_t> out = {MQTT_SUBACK << 4, 3, 0, 1, 0};
+  std::vector<uint8_t> retained = publishPacket("/test/stm32/location", "L:0.4,36.9");
+  out.insert(out.end(), retained.begin(), retained.end());
+  send(client, out.data(), out.size(), 0);
+
+  usleep(50000);
+  out = publishPacket("/test/stm32/sensors", "B1,100,90;7,0,2000,5000,1012000,0");
+  std::vector<uint8_t> stats = publishPacket("/test/stm32/stats", "U:100");
+  out.insert(out.end(), stats.begin(), stats.end());
+  send(client, out.data(), out.size(), 0);
+  usleep(50000);
+  close(client);
+}
+
+static void testLoopbackSession() {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(address);
+  CHECK(bind(listener, (struct sockaddr*)&address, sizeof(address)) == 0 && listen(listener, 1) == 0);
+  getsockname(listener, (struct sockaddr*)&address, &len);
+  std::thread broker(runBroker, listener);
+
+  Collected collected;
+  MqttSubscriber mqtt("127.0.0.1", ntohs(address.sin_port), "test", 60, collectMessage, &collected);
+  CHECK(mqtt.connect("/test/stm32/#", 2000));
+  uint64_t deadline = monotonicMs() + 2000;
+  while (mqtt.connected() && monotonicMs() < deadline) {
+    mqtt.poll();
+    usleep(5000);
+  }
+  broker.join();
+  close(listener);
+
+  CHECK(!mqtt.connected());  // The broker closed the session
+  CHECK(collected.topics.size() == 3);
+  CHECK(collected.topics.size() == 3 && collected.topics[0] == "/test/stm32/location");
+  CHECK(collected.payloads.size() == 3 && collected.payloads[1].compare(0, 3, "B1,") == 0);
+}
+
+static void testIngestAndQuery() {
+  char path[] = "/tmp/test_ingest_XXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  IngestDatabase db;
+  CHECK(db.open(path));
+  FieldIngest ingest(db, "/test/stm32");
+
+  // Binary batch from the gateway's encoder: node 1 every 30 s, one with a failed humidity sensor
+  RecordStore store;
+  for (uint32_t i = 0; i < 10; i++) {
+    StoredRecord record = {1000 + i * 30, {1, (uint8_t)i, (int16_t)(2124 + i), 6937, 814870, 0}};
+    record.reading.flags = i == 4 ? SENSOR_FLAG_TH_INVALID : 0;
+    store.append(record);
+  }
+  char batch[512];
+  size_t written = 0;
+  CHECK(encodeBatch(store, BATCH_BINARY, 1270, batch, sizeof(batch), written) == 10);
+
+  const char* sensors = "/test/stm32/sensors";
+  ingest.handle(sensors, strlen(sensors), batch, written, 1700000000);
+  const char* text = "B1,50,40;2,0,-150,9000,1013000,2";
+  ingest.handle(sensors, strlen(sensors), text, strlen(text), 1700000100);
+  const char* broken = "B1,50,40;2,0";
+  ingest.handle(sensors, strlen(sensors), broken, strlen(broken), 1700000100);
+  const char* links = "/test/stm32/links";
+  const char* stats = "N:1,R:120,L:3,D:1,S:-78,P:1,T:5";
+  ingest.handle(links, strlen(links), stats, strlen(stats), 1700000200);
+  CHECK(db.pending() == 13);
+  CHECK(db.flush(0));  // Not due yet
+  CHECK(db.pending() == 13);
+  CHECK(db.flush(INGEST_COMMIT_INTERVAL));
+  CHECK(db.pending() == 0);
+
+  CHECK(ingest.messages() == 4);
+  CHECK(ingest.readings() == 11);
+  CHECK(ingest.rejected() == 1);
+  CHECK(ingest.failed() == 0);
+
+  QueryServer queries(path);
+  std::string body;
+  CHECK(queries.respond("/readings?node=1&from=1699999730&to=1699999791", body) == 200);
+  CHECK(body == "time,node,uptime,temperature,humidity,pressure,flags\n"
+                "1699999730,1,1000,21.24,69.37,814.87,0\n"
+                "1699999760,1,1030,21.25,69.37,814.87,0\n"
+                "1699999790,1,1060,21.26,69.37,814.87,0\n");
+
+  CHECK(queries.respond("/readings?node=1&from=1699999850&limit=1", body) == 200);
+  CHECK(body == "time,node,uptime,temperature,humidity,pressure,flags\n1699999850,1,1120,,,814.87,1\n");
+
+  CHECK(queries.respond("/readings?node=2", body) == 200);
+  CHECK(body == "time,node,uptime,temperature,humidity,pressure,flags\n1700000090,2,40,-1.5,90.0,,2\n");
+
+  CHECK(queries.respond("/messages?topic=%2Ftest%2Fstm32%2Flinks", body) == 200);
+  CHECK(body == "time,topic,payload\n1700000200,/test/stm32/links,\"N:1,R:120,L:3,D:1,S:-78,P:1,T:5\"\n");
+  CHECK(queries.respond("/messages?topic=/test/stm32/sensors", body) == 200);
+  CHECK(body.find(broken) != std::string::npos);
+
+  CHECK(queries.respond("/readings?from=yesterday", body) == 400);
+  CHECK(queries.respond("/readings?limit=2000000", body) == 400);
+  CHECK(queries.respond("/nodes", body) == 404);
+
+  db.close();
+  unlink(path);
+  unlink((std::string(path) + "-wal").c_str());
+  unlink((std::string(path) + "-shm").c_str());
+}
+
+// Rough ingest rate of single-reading text batches, the worst case per message; printed, not checked
+static void benchmarkIngest() {
+  char path[] = "/tmp/test_ingest_XXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+  IngestDatabase db;
+  CHECK(db.open(path));
+  FieldIngest ingest(db, "/r");
+
+  const int count = 50000;
+  char payload[64];
+  uint64_t start = monotonicMs();
+  for (int i = 0; i < count; i++) {
+    int len = snprintf(payload, sizeof(payload), "B1,%d,%d;%d,0,2124,6937,814870,0", i, i, i % 50);
+    ingest.handle("/r/sensors", 10, payload, (size_t)len, 1700000000 + i);
+    db.flush(monotonicMs());
+  }
+  db.flush(0, true);
+  uint64_t elapsed = monotonicMs() - start;
+  CHECK(ingest.readings() == (uint64_t)count);
+  printf("ingest: %d messages in %llu ms (%.0f msg/s)\n", count, (unsigned long long)elapsed,
+         elapsed > 0 ? count * 1000.0 / elapsed : 0.0);
+
+  db.close();
+  unlink(path);
+  unlink((std::string(path) + "-wal").c_str());
+  unlink((std::string(path) + "-shm").c_str());
+}
+
+int main() {
+  testFramingAcrossReads();
+  testQos1Acknowledged();
+  testLoopbackSession();
+  testIngestAndQuery();
+  benchmarkIngest();
+  if (failures > 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,216 @@
+#include "AtEngine.h"
+
+#include <string.h>
+
+static const char CRLF[] = "\r\n";
+static const char CTRL_Z[] = {AT_CTRL_Z, '\0'};
+
+AtEngine::AtEngine(Stream& port)
+    : port(port), head(0), count(0), urcCount(0), state(AT_IDLE), writing(nullptr), writeLeft(0), terminator(nullptr),
+      sentAt(0), idleSince(0), nextHoldOff(0), lastLineAt(0) {}
+
+AtEngine::Command* AtEngine::enqueue(uint32_t timeout, AtDoneCallback onDone, void* context, AtLineCallback onLine) {
+  if (count >= AT_QUEUE_DEPTH) {
+    return nullptr;
+  }
+
+  Command* command = &queue[(head + count) % AT_QUEUE_DEPTH];
+  command->payload = nullptr;
+  command->external = nullptr;
+  command->holdOff = nextHoldOff;
+  command->timeout = timeout;
+  command->onDone = onDone;
+  command->onLine = onLine;
+  command->context = context;
+  nextHoldOff = 0;
+  return command;
+}
+
+bool AtEngine::send(const char* command, uint32_t timeout, AtDoneCallback onDone, void* context, AtLineCallback onLine) {
+  size_t len = strlen(command);
+  if (len >= AT_COMMAND_MAX) {
+    return false;
+  }
+
+  Command* slot = enqueue(timeout, onDone, context, onLine);
+  if (slot == nullptr) {
+    return false;
+  }
+  memcpy(slot->text, command, len + 1);
+  count++;
+  return true;
+}
+
+bool AtEngine::sendExternal(const char* command, uint32_t timeout, AtDoneCallback onDone, void* context, AtLineCallback onLine) {
+  Command* slot = enqueue(timeout, onDone, context, onLine);
+  if (slot == nullptr) {
+    return false;
+  }
+  slot->external = command;
+  count++;
+  return true;
+}
+
+bool AtEngine::sendWithPayload(const char* command, const char* payload, uint32_t timeout,
+                               AtDoneCallback onDone, void* context) {
+  size_t len = strlen(command);
+  size_t payloadLen = strlen(payload);
+  if (len + 1 + payloadLen >= AT_COMMAND_MAX) {
+    return false;
+  }
+
+  Command* slot = enqueue(timeout, onDone, context, nullptr);
+  if (slot == nullptr) {
+    return false;
+  }
+  memcpy(slot->text, command, len + 1);
+  memcpy(slot->text + len + 1, payload, payloadLen + 1);
+  slot->payload = slot->text + len + 1;
+  count++;
+  return true;
+}
+
+bool AtEngine::sendWithExternalPayload(const char* command, const char* payload, uint32_t timeout,
+                                       AtDoneCallback onDone, void* context) {
+  size_t len = strlen(command);
+  if (len >= AT_COMMAND_MAX) {
+    return false;
+  }
+
+  Command* slot = enqueue(timeout, onDone, context, nullptr);
+  if (slot == nullptr) {
+    return false;
+  }
+  memcpy(slot->text, command, len + 1);
+  slot->payload = payload;
+  count++;
+  return true;
+}
+
+bool AtEngine::onUrc(const char* prefix, AtLineCallback handler, void* context) {
+  if (urcCount >= AT_URC_MAX) {
+    return false;
+  }
+  urcs[urcCount].prefix = prefix;
+  urcs[urcCount].handler = handler;
+  urcs[urcCount].context = context;
+  urcCount++;
+  return true;
+}
+
+void AtEngine::clearQueue() {
+  // The in-flight command stays at the head until its result arrives
+  count = state == AT_IDLE ? 0 : 1;
+}
+
+void AtEngine::poll() {
+  for (uint8_t i = 0; i < AT_POLL_BUDGET && port.available() > 0; i++) {
+    AtLineType type = parser.feed((char)port.read());
+    if (type != AT_LINE_NONE) {
+      lastLineAt = millis();
+      handleLine(type);
+    }
+  }
+
+  if (state == AT_IDLE && count > 0 && millis() - idleSince >= queue[head].holdOff) {
+    startNext();
+  }
+
+  // The timeout starts once the command, or the payload of a prompted one, has gone out
+  if ((state == AT_SEND_COMMAND || state == AT_SEND_PAYLOAD) && writePending()) {
+    state = state == AT_SEND_PAYLOAD || queue[head].payload == nullptr ? AT_WAIT_RESULT : AT_WAIT_PROMPT;
+    sentAt = millis();
+  }
+
+  if ((state == AT_WAIT_PROMPT || state == AT_WAIT_RESULT) && millis() - sentAt >= queue[head].timeout) {
+    finish(AT_RESULT_TIMEOUT);
+  }
+}
+
+void AtEngine::handleLine(AtLineType type) {
+  if (type == AT_LINE_TEXT) {
+    for (uint8_t i = 0; i < urcCount; i++) {
+      if (AtParser::startsWith(parser.line(), urcs[i].prefix)) {
+        urcs[i].handler(parser.line(), urcs[i].context);
+        return;
+      }
+    }
+    if (state != AT_IDLE && queue[head].onLine != nullptr) {
+      queue[head].onLine(parser.line(), queue[head].context);
+    }
+    return;
+  }
+
+  if (state == AT_IDLE) {
+    return;  // Stray result code, e.g. the tail of a command that already timed out
+  }
+
+  switch (type) {
+    case AT_LINE_PROMPT:
+      if (state == AT_WAIT_PROMPT) {
+        startWrite(queue[head].payload, CTRL_Z);
+        state = AT_SEND_PAYLOAD;
+      }
+      break;
+    case AT_LINE_OK:
+      finish(AT_RESULT_OK);
+      break;
+    case AT_LINE_ERROR:
+      finish(AT_RESULT_ERROR);
+      break;
+    case AT_LINE_CME_ERROR:
+      finish(AT_RESULT_CME_ERROR);
+      break;
+    default:
+      break;
+  }
+}
+
+void AtEngine::startNext() {
+  Command& command = queue[head];
+  startWrite(command.external ? command.external : command.text, CRLF);
+  state = AT_SEND_COMMAND;
+}
+
+void AtEngine::startWrite(const char* text, const char* next) {
+  writing = text;
+  writeLeft = strlen(text);
+  terminator = next;
+}
+
+// Write what the TX buffer has room for; true once the text and its terminator are all out
+bool AtEngine::writePending() {
+  for (;;) {
+    if (writeLeft == 0) {
+      if (terminator == nullptr) {
+        return true;
+      }
+      startWrite(terminator, nullptr);
+    }
+    int room = port.availableForWrite();
+    if (room <= 0) {
+      return false;
+    }
+    size_t chunk = writeLeft < (size_t)room ? writeLeft : (size_t)room;
+    port.write((const uint8_t*)writing, chunk);
+    writing += chunk;
+    writeLeft -= chunk;
+  }
+}
+
+void AtEngine::finish(AtResult result) {
+  // Pop before the callback so it can queue follow-up commands
+  AtDoneCallback onDone = queue[head].onDone;
+  void* context = queue[head].context;
+
+  head = (head + 1) % AT_QUEUE_DEPTH;
+  count--;
+  state = AT_IDLE;
+  writeLeft = 0;  // An early ERROR cuts a payload short; the rest is not sent
+  terminator = nullptr;
+  idleSince = millis();
+
+  if (onDone != nullptr) {
+    onDone(result, context);
+  }
+}
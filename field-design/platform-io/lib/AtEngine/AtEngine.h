@@ -0,0 +1,141 @@
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+#include <Arduino.h>
+#include <AtParser.h>
+
+// Commands that can wait in the queue, including the one in flight
+#ifndef AT_QUEUE_DEPTH
+#define AT_QUEUE_DEPTH 8
+#endif
+
+// Longest command plus payload (e.g. AT+CMGS="<number>" followed by a 160 character SMS)
+#ifndef AT_COMMAND_MAX
+#define AT_COMMAND_MAX 192
+#endif
+
+// Unsolicited result code prefixes that can be registered
+#ifndef AT_URC_MAX
+#define AT_URC_MAX 6
+#endif
+
+// Bytes read from the modem per call to poll(), keeps loop() latency bounded during long responses
+#define AT_POLL_BUDGET 64
+
+#define AT_CTRL_Z 26 // Terminates the payload of AT+CMGS and similar prompted commands
+
+enum AtResult {
+  AT_RESULT_OK,
+  AT_RESULT_ERROR,
+  AT_RESULT_CME_ERROR, // +CME ERROR or +CMS ERROR, code in AtEngine::lastErrorCode()
+  AT_RESULT_TIMEOUT
+};
+
+// Called once when a command completes
+typedef void (*AtDoneCallback)(AtResult result, void* context);
+
+// Called for each intermediate response line of a command, or for a matching unsolicited line
+typedef void (*AtLineCallback)(const char* line, void* context);
+
+/* Non-blocking AT command engine shared by the A9G firmwares.
+ * Commands are queued and sent one at a time; poll() from loop() feeds modem
+ * output through AtParser, routes lines to the command or to URC handlers,
+ * completes commands on their final result code and enforces timeouts.
+ * Commands and payloads go out through a write cursor, only as many bytes per
+ * poll() as the port's TX buffer takes (availableForWrite()), so a 512 byte
+ * MQTT payload at 9600 baud never stalls loop(); a command's timeout runs
+ * from its last byte. Nothing allocates: commands are copied into fixed queue slots.
+ */
+class AtEngine {
+public:
+  explicit AtEngine(Stream& port);
+
+  // Queue a command; onLine receives its intermediate lines. Returns false when the queue is full
+  bool send(const char* command, uint32_t timeout, AtDoneCallback onDone = nullptr,
+            void* context = nullptr, AtLineCallback onLine = nullptr);
+
+  // Queue a command kept in the caller's buffer instead of a slot, for payloads larger than AT_COMMAND_MAX;
+  // command must stay valid and unchanged until onDone runs
+  bool sendExternal(const char* command, uint32_t timeout, AtDoneCallback onDone = nullptr,
+                    void* context = nullptr, AtLineCallback onLine = nullptr);
+
+  // Queue a command that answers with the "> " prompt; payload and Ctrl+Z are sent at the prompt
+  bool sendWithPayload(const char* command, const char* payload, uint32_t timeout,
+                       AtDoneCallback onDone = nullptr, void* context = nullptr);
+
+  // As sendWithPayload(), with the payload kept in the caller's buffer for payloads larger than AT_COMMAND_MAX
+  // (e.g. an SMS PDU in hex); payload must stay valid and unchanged until onDone runs
+  bool sendWithExternalPayload(const char* command, const char* payload, uint32_t timeout,
+                               AtDoneCallback onDone = nullptr, void* context = nullptr);
+
+  // Wait ms after the previous command completes before sending the next command queued
+  void holdOff(uint16_t ms) { nextHoldOff = ms; }
+
+  // Route unsolicited lines starting with prefix (e.g. "+CMTI:") to handler
+  bool onUrc(const char* prefix, AtLineCallback handler, void* context = nullptr);
+
+  // Service the modem; call on every pass through loop()
+  void poll();
+
+  // Drop every queued command that has not been sent yet, without calling their callbacks
+  void clearQueue();
+
+  bool busy() const { return state != AT_IDLE || count > 0; }
+  uint8_t queued() const { return count; }
+  uint8_t freeSlots() const { return AT_QUEUE_DEPTH - count; }
+  int lastErrorCode() const { return parser.errorCode(); }
+
+  // millis() when the modem last sent a complete line, 0 if it never has; shows it is still alive
+  uint32_t lastResponseAt() const { return lastLineAt; }
+
+private:
+  enum State {
+    AT_IDLE,
+    AT_SEND_COMMAND, // Command and CR LF going out
+    AT_WAIT_PROMPT,  // Prompted command sent, waiting for "> "
+    AT_SEND_PAYLOAD, // Payload and Ctrl+Z going out
+    AT_WAIT_RESULT   // Command sent, waiting for its final result code
+  };
+
+  struct Command {
+    char text[AT_COMMAND_MAX]; // Command, then an optional NUL-separated payload
+    const char* external;      // Caller-owned command sent instead of text, or nullptr
+    const char* payload;       // Sent at the prompt, in text or the caller's buffer; nullptr when there is none
+    uint16_t holdOff;
+    uint32_t timeout;
+    AtDoneCallback onDone;
+    AtLineCallback onLine;
+    void* context;
+  };
+
+  struct Urc {
+    const char* prefix;
+    AtLineCallback handler;
+    void* context;
+  };
+
+  Command* enqueue(uint32_t timeout, AtDoneCallback onDone, void* context, AtLineCallback onLine);
+  void handleLine(AtLineType type);
+  void startNext();
+  void startWrite(const char* text, const char* next);
+  bool writePending();
+  void finish(AtResult result);
+
+  Stream& port;
+  AtParser parser;
+  Command queue[AT_QUEUE_DEPTH];
+  uint8_t head;
+  uint8_t count;
+  Urc urcs[AT_URC_MAX];
+  uint8_t urcCount;
+  State state;
+  const char* writing;    // Next byte of the command or payload going out
+  size_t writeLeft;       // Bytes of it still to write
+  const char* terminator; // CR LF or Ctrl+Z written after it, nullptr once under way
+  uint32_t sentAt;        // millis() when the last byte went out
+  uint32_t idleSince;
+  uint16_t nextHoldOff;
+  uint32_t lastLineAt;
+};
+
+#endif
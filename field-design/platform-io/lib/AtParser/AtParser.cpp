@@ -0,0 +1,95 @@
+#include "AtParser.h"
+
+#include <string.h>
+
+AtParser::AtParser() {
+  reset();
+}
+
+void AtParser::reset() {
+  buffer[0] = '\0';
+  length = 0;
+  overflow = false;
+  complete = false;
+  lastErrorCode = -1;
+}
+
+bool AtParser::startsWith(const char* line, const char* prefix) {
+  while (*prefix) {
+    if (*line++ != *prefix++) {
+      return false;
+    }
+  }
+  return true;
+}
+
+AtLineType AtParser::feed(char c) {
+  if (complete) {
+    length = 0;
+    overflow = false;
+    complete = false;
+    buffer[0] = '\0';
+  }
+
+  if (c == '\r' || c == '\n') {
+    if (length == 0) {
+      return AT_LINE_NONE;  // Blank line or the second half of "\r\n"
+    }
+    buffer[length] = '\0';
+    complete = true;
+    return classify();
+  }
+
+  // Responses never start with a space; this also swallows the one after the prompt
+  if (c == ' ' && length == 0) {
+    return AT_LINE_NONE;
+  }
+
+  // The data prompt is "> " with no line terminator, so recognise it at the start of a line
+  if (c == '>' && length == 0) {
+    buffer[0] = '>';
+    buffer[1] = '\0';
+    length = 1;
+    complete = true;
+    return AT_LINE_PROMPT;
+  }
+
+  if (length < AT_LINE_MAX - 1) {
+    buffer[length++] = c;
+  } else {
+    overflow = true;
+  }
+  return AT_LINE_NONE;
+}
+
+AtLineType AtParser::classify() {
+  switch (buffer[0]) {
+    case 'O':
+      if (length == 2 && buffer[1] == 'K') {
+        return AT_LINE_OK;
+      }
+      break;
+    case 'E':
+      if (length == 5 && strcmp(buffer, "ERROR") == 0) {
+        return AT_LINE_ERROR;
+      }
+      break;
+    case '+':
+      if (startsWith(buffer, "+CME ERROR:") || startsWith(buffer, "+CMS ERROR:")) {
+        const char* p = buffer + 11;
+        while (*p == ' ') {
+          p++;
+        }
+        lastErrorCode = -1;
+        if (*p >= '0' && *p <= '9') {
+          lastErrorCode = 0;
+          while (*p >= '0' && *p <= '9') {
+            lastErrorCode = lastErrorCode * 10 + (*p++ - '0');
+          }
+        }
+        return AT_LINE_CME_ERROR;
+      }
+      break;
+  }
+  return AT_LINE_TEXT;
+}
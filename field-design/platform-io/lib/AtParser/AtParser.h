@@ -0,0 +1,59 @@
+#ifndef AT_PARSER_H
+#define AT_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Longest response line kept; longer lines are truncated and flagged
+#ifndef AT_LINE_MAX
+#define AT_LINE_MAX 128
+#endif
+
+// What a byte fed to AtParser completed
+enum AtLineType {
+  AT_LINE_NONE,      // Line still in progress (or an empty line was skipped)
+  AT_LINE_TEXT,      // Intermediate or unsolicited line, available through line()
+  AT_LINE_OK,        // Final result code "OK"
+  AT_LINE_ERROR,     // Final result code "ERROR"
+  AT_LINE_CME_ERROR, // Final result code "+CME ERROR: <n>" or "+CMS ERROR: <n>", see errorCode()
+  AT_LINE_PROMPT     // "> " data prompt after AT+CMGS and similar commands
+};
+
+/* Zero-allocation, incremental AT response parser.
+ * Bytes are fed one at a time into a fixed line buffer; a line is classified
+ * once, when its terminator arrives, so a response costs O(length) in total.
+ */
+class AtParser {
+public:
+  AtParser();
+
+  // Feed one received byte; returns the kind of line it completed
+  AtLineType feed(char c);
+
+  // Text of the line completed by the last AT_LINE_TEXT/final result, NUL-terminated
+  const char* line() const { return buffer; }
+  size_t lineLength() const { return length; }
+
+  // True if the last completed line was longer than AT_LINE_MAX - 1 and was cut short
+  bool truncated() const { return overflow; }
+
+  // Numeric code of the last +CME/+CMS ERROR, -1 if it had none
+  int errorCode() const { return lastErrorCode; }
+
+  // Drop any partially received line
+  void reset();
+
+  // True when line starts with prefix
+  static bool startsWith(const char* line, const char* prefix);
+
+private:
+  AtLineType classify();
+
+  char buffer[AT_LINE_MAX];
+  size_t length;
+  bool overflow;
+  bool complete; // Last byte finished a line; the next byte starts a new one
+  int lastErrorCode;
+};
+
+#endif
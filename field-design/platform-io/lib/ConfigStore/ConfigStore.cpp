@@ -0,0 +1,247 @@
+#include "ConfigStore.h"
+
+#include <string.h>
+
+static uint16_t readU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+// Record size in flash for a value of len bytes
+static uint16_t recordLength(uint8_t len) {
+  return CONFIG_RECORD_HEADER_LEN + ((len + 1) & ~1);
+}
+
+// Fletcher-16 never yields 0xFFFF, so a record whose check is still erased never passes
+static uint16_t recordCheck(uint8_t key, uint8_t len, const uint8_t* value) {
+  uint16_t sum1 = (key + len) % 255;
+  uint16_t sum2 = (key + sum1) % 255;
+  for (uint8_t i = 0; i < len; i++) {
+    sum1 = (sum1 + value[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+ConfigStore::ConfigStore(SpillStorage& storage)
+    : storage(storage), current(0), end(CONFIG_PAGE_HEADER_LEN), currentGeneration(0) {
+  memset(offsets, 0, sizeof(offsets));
+}
+
+void ConfigStore::begin() {
+  memset(offsets, 0, sizeof(offsets));
+  current = 0;
+  end = CONFIG_PAGE_HEADER_LEN;
+  currentGeneration = 0;
+  if (!usable()) {
+    return;
+  }
+
+  uint16_t size = storage.pageSize();
+  bool valid[2];
+  uint32_t generation[2];
+  for (uint8_t i = 0; i < 2; i++) {
+    valid[i] = readU16(storage.page(i)) == CONFIG_PAGE_MAGIC;
+    generation[i] = readU32(storage.page(i) + 4);
+  }
+
+  if (valid[0] && valid[1]) {
+    // Reset after a compaction wrote its header but before it erased the old page: the newer copy is complete
+    current = (int32_t)(generation[1] - generation[0]) > 0 ? 1 : 0;
+  } else if (valid[0] || valid[1]) {
+    current = valid[1] ? 1 : 0;
+  } else {
+    // Never formatted, or the first format was cut short
+    if (!blank(0, 0, size)) {
+      storage.erase(0);
+    }
+    format(0, 0);
+  }
+
+  // The other page is the older copy or a compaction torn before its header
+  uint8_t other = current ^ 1;
+  if (!blank(other, 0, size)) {
+    storage.erase(other);
+  }
+  currentGeneration = readU32(storage.page(current) + 4);
+  scan();
+}
+
+bool ConfigStore::set(uint8_t key, const void* value, uint8_t len) {
+  if (len == 0 || len > CONFIG_VALUE_MAX) {
+    return false;
+  }
+  uint8_t storedLen;
+  const uint8_t* stored = this->value(key, storedLen);
+  if (stored != nullptr && storedLen == len && memcmp(stored, value, len) == 0) {
+    return true;  // Unchanged values cost no flash
+  }
+  return append(key, (const uint8_t*)value, len);
+}
+
+bool ConfigStore::setNumber(uint8_t key, int32_t value) {
+  uint8_t bytes[4];
+  writeU32(bytes, (uint32_t)value);
+  return set(key, bytes, sizeof(bytes));
+}
+
+bool ConfigStore::setText(uint8_t key, const char* text) {
+  size_t len = strlen(text) + 1;
+  return len <= CONFIG_VALUE_MAX && set(key, text, (uint8_t)len);
+}
+
+bool ConfigStore::remove(uint8_t key) {
+  return !has(key) || append(key, nullptr, 0);
+}
+
+const uint8_t* ConfigStore::value(uint8_t key, uint8_t& len) const {
+  if (!has(key)) {
+    len = 0;
+    return nullptr;
+  }
+  const uint8_t* record = storage.page(current) + offsets[key];
+  len = record[1];
+  return record + CONFIG_RECORD_HEADER_LEN;
+}
+
+int32_t ConfigStore::number(uint8_t key, int32_t fallback) const {
+  uint8_t len;
+  const uint8_t* stored = value(key, len);
+  return stored != nullptr && len == 4 ? (int32_t)readU32(stored) : fallback;
+}
+
+const char* ConfigStore::text(uint8_t key, const char* fallback) const {
+  uint8_t len;
+  const uint8_t* stored = value(key, len);
+  return stored != nullptr && stored[len - 1] == '\0' ? (const char*)stored : fallback;
+}
+
+uint16_t ConfigStore::freeBytes() const {
+  return usable() ? storage.pageSize() - end : 0;
+}
+
+bool ConfigStore::append(uint8_t key, const uint8_t* value, uint8_t len) {
+  if (!usable() || key >= CONFIG_KEYS) {
+    return false;
+  }
+  uint16_t length = recordLength(len);
+  uint16_t size = storage.pageSize();
+  if (end + length > size || !blank(current, end, length)) {
+    if (!compact() || end + length > size) {
+      return false;
+    }
+  }
+
+  bool written = writeRecord(current, end, key, value, len);
+  if (written) {
+    offsets[key] = len == 0 ? 0 : end;
+  }
+  end += length;  // A failed write may have programmed part of the record; its check fails on the next scan
+  return written;
+}
+
+bool ConfigStore::writeRecord(uint8_t page, uint16_t offset, uint8_t key, const uint8_t* value, uint8_t len) {
+  uint8_t record[CONFIG_RECORD_HEADER_LEN + CONFIG_VALUE_MAX];
+  uint16_t length = recordLength(len);
+  memset(record, 0xFF, length);
+  uint16_t check = recordCheck(key, len, value);
+  record[0] = key;
+  record[1] = len;
+  record[2] = check & 0xFF;
+  record[3] = check >> 8;
+  if (len > 0) {
+    memcpy(record + CONFIG_RECORD_HEADER_LEN, value, len);
+  }
+  return storage.program(page, offset, record, length);
+}
+
+bool ConfigStore::compact() {
+  uint8_t target = current ^ 1;
+  uint16_t size = storage.pageSize();
+  if (!blank(target, 0, size) && !storage.erase(target)) {
+    return false;
+  }
+
+  // Copy the latest record of every key that is set; the header goes last, making the copy current
+  uint16_t offset = CONFIG_PAGE_HEADER_LEN;
+  for (uint8_t key = 0; key < CONFIG_KEYS; key++) {
+    if (offsets[key] == 0) {
+      continue;
+    }
+    const uint8_t* record = storage.page(current) + offsets[key];
+    uint16_t length = recordLength(record[1]);
+    if (offset + length > size ||
+        !writeRecord(target, offset, key, record + CONFIG_RECORD_HEADER_LEN, record[1])) {
+      return false;  // The headerless copy is erased by the next compaction or begin()
+    }
+    offset += length;
+  }
+  if (!format(target, currentGeneration + 1)) {
+    return false;
+  }
+
+  uint8_t old = current;
+  current = target;
+  currentGeneration++;
+  scan();
+  storage.erase(old);  // Should this fail, begin() still picks the newer page
+  return true;
+}
+
+bool ConfigStore::format(uint8_t page, uint32_t generation) {
+  uint8_t header[CONFIG_PAGE_HEADER_LEN];
+  header[0] = CONFIG_PAGE_MAGIC & 0xFF;
+  header[1] = CONFIG_PAGE_MAGIC >> 8;
+  header[2] = 0xFF;
+  header[3] = 0xFF;
+  writeU32(header + 4, generation);
+  return storage.program(page, 2, header + 2, CONFIG_PAGE_HEADER_LEN - 2) && storage.program(page, 0, header, 2);
+}
+
+// Rebuild the offset cache from the current page, the latest valid record of each key winning
+void ConfigStore::scan() {
+  memset(offsets, 0, sizeof(offsets));
+  const uint8_t* data = storage.page(current);
+  uint16_t size = storage.pageSize();
+  uint16_t offset = CONFIG_PAGE_HEADER_LEN;
+
+  while (offset + CONFIG_RECORD_HEADER_LEN <= size) {
+    const uint8_t* record = data + offset;
+    if (record[0] == 0xFF && record[1] == 0xFF) {
+      break;  // First blank record: the end of the log
+    }
+    uint16_t length = recordLength(record[1]);
+    if (offset + length > size) {
+      offset = size;  // Torn length; the page counts as full and the next update compacts it
+      break;
+    }
+    uint8_t key = record[0];
+    uint8_t len = record[1];
+    if (key < CONFIG_KEYS && len <= CONFIG_VALUE_MAX &&
+        readU16(record + 2) == recordCheck(key, len, record + CONFIG_RECORD_HEADER_LEN)) {
+      offsets[key] = len == 0 ? 0 : offset;
+    }
+    offset += length;
+  }
+  end = offset;
+}
+
+bool ConfigStore::blank(uint8_t page, uint16_t offset, uint16_t len) const {
+  const uint8_t* data = storage.page(page) + offset;
+  for (uint16_t i = 0; i < len; i++) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <RecordStore.h>
+
+/* Settings Page Layout (little-endian), two pages used in turn:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 2    | Magic CONFIG_PAGE_MAGIC, written last so a torn compaction leaves the page invalid
+ * 2      | 2    | Reserved, 0xFFFF
+ * 4      | 4    | Generation, one more than the page compacted into this one; the higher valid page is current
+ * 8      | ...  | Records, oldest first, up to the first blank byte
+ *
+ * Record Layout:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Key, below CONFIG_KEYS
+ * 1      | 1    | Value length; 0 removes the key, which then reads as its default again
+ * 2      | 2    | Fletcher-16 over key, length and value; a record torn by a reset fails it and is skipped
+ * 4      | n    | Value, padded with 0xFF to an even length (flash is written in half-words)
+ */
+
+#define CONFIG_PAGE_MAGIC 0x4346
+#define CONFIG_PAGE_HEADER_LEN 8
+#define CONFIG_RECORD_HEADER_LEN 4
+
+// Keys a store can hold, each costing two bytes of RAM for its cached offset
+#ifndef CONFIG_KEYS
+#define CONFIG_KEYS 16
+#endif
+
+// Longest value, e.g. a broker host name with its NUL
+#define CONFIG_VALUE_MAX 64
+
+/* Key-value settings kept in two flash pages of a SpillStorage.
+ * An update appends a record to the current page instead of erasing it,
+ * so a 1 KB page takes dozens of updates per erase; only when it is full
+ * are the live values compacted into the other page, which then becomes
+ * current, and the pages take the erases in turn. The offset of every
+ * key's latest record is cached in RAM, so a read is a table look-up
+ * and a pointer into memory-mapped flash, with no scan and no copy.
+ * Without flash (fewer than two pages) every key reads as its default
+ * and set() fails.
+ */
+class ConfigStore {
+public:
+  // Uses pages 0 and 1 of storage
+  explicit ConfigStore(SpillStorage& storage);
+
+  // Find the current page, finish or undo a compaction cut short by a reset and cache the offsets;
+  // call once from setup() before the first read
+  void begin();
+
+  // Store len bytes under key; false when the key or length is out of range or the flash write failed.
+  // Setting the value a key already has writes nothing
+  bool set(uint8_t key, const void* value, uint8_t len);
+  bool setNumber(uint8_t key, int32_t value);
+
+  // Stored with its NUL, so text() reads it straight from flash
+  bool setText(uint8_t key, const char* text);
+
+  // Back to the default; false when the flash write failed
+  bool remove(uint8_t key);
+
+  bool has(uint8_t key) const { return key < CONFIG_KEYS && offsets[key] != 0; }
+
+  // Latest value of key in flash and its length, or nullptr when it is not set
+  const uint8_t* value(uint8_t key, uint8_t& len) const;
+
+  // The stored number or text, or fallback when the key is not set or its value is not 4 bytes or not
+  // NUL-terminated; keys are untyped, so each one is read the way it is written
+  int32_t number(uint8_t key, int32_t fallback) const;
+  const char* text(uint8_t key, const char* fallback) const;
+
+  // Compactions since the store was first formatted; each one erased a page
+  uint32_t generation() const { return currentGeneration; }
+
+  // Bytes left in the current page for records
+  uint16_t freeBytes() const;
+
+private:
+  bool usable() const { return storage.pageCount() >= 2; }
+  bool append(uint8_t key, const uint8_t* value, uint8_t len);
+  bool writeRecord(uint8_t page, uint16_t offset, uint8_t key, const uint8_t* value, uint8_t len);
+  bool compact();
+  bool format(uint8_t page, uint32_t generation);
+  void scan();
+  bool blank(uint8_t page, uint16_t offset, uint16_t len) const;
+
+  SpillStorage& storage;
+  uint8_t current;            // Page holding the live records
+  uint16_t end;               // Offset the next record goes to
+  uint32_t currentGeneration;
+  uint16_t offsets[CONFIG_KEYS];  // Record of each key in the current page, 0 when the key is not set
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "DownlinkQueue.h"
+
+DownlinkQueue::DownlinkQueue() : nextSequence(0) {
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    entries[i].used = false;
+  }
+}
+
+bool DownlinkQueue::push(SensorCommand& command, uint32_t now) {
+  Entry* slot = nullptr;
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    Entry& entry = entries[i];
+    if (entry.used && entry.command.nodeId == command.nodeId && entry.command.code == command.code) {
+      slot = &entry;  // Superseded before the node picked it up
+      break;
+    }
+    if (!entry.used && slot == nullptr) {
+      slot = &entry;
+    }
+  }
+  if (slot == nullptr) {
+    return false;
+  }
+
+  // A fresh sequence number, so a node that applied the replaced command applies this one too
+  command.sequence = nextSequence++;
+  slot->command = command;
+  slot->queuedAt = now;
+  slot->attempts = 0;
+  slot->used = true;
+  return true;
+}
+
+bool DownlinkQueue::next(uint8_t nodeId, SensorCommand& command) {
+  Entry* oldest = nullptr;
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    Entry& entry = entries[i];
+    if (entry.used && entry.command.nodeId == nodeId && entry.attempts < DOWNLINK_ATTEMPTS &&
+        (oldest == nullptr || (int32_t)(entry.queuedAt - oldest->queuedAt) < 0)) {
+      oldest = &entry;
+    }
+  }
+  if (oldest == nullptr) {
+    return false;
+  }
+
+  oldest->attempts++;
+  command = oldest->command;
+  return true;
+}
+
+bool DownlinkQueue::complete(const SensorCommandResult& result) {
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    Entry& entry = entries[i];
+    if (entry.used && entry.command.nodeId == result.nodeId && entry.command.sequence == result.sequence) {
+      entry.used = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DownlinkQueue::expire(uint32_t now, SensorCommand& expired) {
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    Entry& entry = entries[i];
+    if (entry.used && now - entry.queuedAt >= DOWNLINK_EXPIRY) {
+      entry.used = false;
+      expired = entry.command;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t DownlinkQueue::size() const {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < DOWNLINK_QUEUE_CAPACITY; i++) {
+    if (entries[i].used) {
+      count++;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,56 @@
+#ifndef DOWNLINK_QUEUE_H
+#define DOWNLINK_QUEUE_H
+
+#include <stdint.h>
+#include <SensorPacket.h>
+
+// Commands waiting for their nodes at once
+#ifndef DOWNLINK_QUEUE_CAPACITY
+#define DOWNLINK_QUEUE_CAPACITY 8
+#endif
+
+// ACKs a command is carried in before the gateway stops offering it
+#define DOWNLINK_ATTEMPTS 8
+
+// A command still without a result this long after it was queued is given up
+#define DOWNLINK_EXPIRY 3600000UL // 1 hour in milliseconds
+
+/* Commands queued for nodes until they answer.
+ * A node only listens while it waits for an ACK, so the gateway carries a
+ * node's oldest queued command as the payload of every ACK it sends that
+ * node, until the node's command result arrives or the attempts run out.
+ * A newer command with the same code for the same node replaces the queued
+ * one. next() runs in the radio interrupt; push(), complete() and expire()
+ * run in loop() and must be called with interrupts held off.
+ */
+class DownlinkQueue {
+public:
+  DownlinkQueue();
+
+  // Queue command, assigning its sequence number; false when the queue is full
+  bool push(SensorCommand& command, uint32_t now);
+
+  // Command to carry in the next ACK to nodeId, counting the attempt; false when there is none
+  bool next(uint8_t nodeId, SensorCommand& command);
+
+  // Remove the command result answers; false when it is not queued (already answered or expired)
+  bool complete(const SensorCommandResult& result);
+
+  // Remove one command older than DOWNLINK_EXPIRY into expired; false when there is none
+  bool expire(uint32_t now, SensorCommand& expired);
+
+  uint8_t size() const;
+
+private:
+  struct Entry {
+    SensorCommand command;
+    uint32_t queuedAt;
+    uint8_t attempts;
+    bool used;
+  };
+
+  Entry entries[DOWNLINK_QUEUE_CAPACITY];
+  uint8_t nextSequence;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stdint.h>
+
+// Compiler barrier; producer and consumer share one core, so ordering against the ISR is all we need
+#define FRAME_RING_BARRIER() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
+/* Lock-free single-producer/single-consumer ring of fixed-size slots.
+ * The producer (an ISR) fills writeSlot() in place and calls commit();
+ * the consumer (loop()) processes readSlot() in place and calls release().
+ * Capacity must be a power of two no larger than 128.
+ */
+template <typename T, uint8_t Capacity>
+class FrameRing {
+  static_assert(Capacity > 0 && Capacity <= 128 && (Capacity & (Capacity - 1)) == 0,
+                "FrameRing capacity must be a power of two no larger than 128");
+
+public:
+  FrameRing() : head(0), tail(0), overflows(0) {}
+
+  // Producer side: free slot to fill, or nullptr when the ring is full
+  T* writeSlot() {
+    if ((uint8_t)(head - tail) == Capacity) {
+      overflows++;
+      return nullptr;
+    }
+    return &slots[head & (Capacity - 1)];
+  }
+
+  // Producer side: publish the slot returned by writeSlot()
+  void commit() {
+    FRAME_RING_BARRIER();
+    head = head + 1;
+  }
+
+  // Consumer side: oldest filled slot, or nullptr when the ring is empty
+  T* readSlot() {
+    if (head == tail) {
+      return nullptr;
+    }
+    FRAME_RING_BARRIER();
+    return &slots[tail & (Capacity - 1)];
+  }
+
+  // Consumer side: hand the slot returned by readSlot() back to the producer
+  void release() {
+    FRAME_RING_BARRIER();
+    tail = tail + 1;
+  }
+
+  uint8_t size() const { return (uint8_t)(head - tail); }
+  static uint8_t capacity() { return Capacity; }
+
+  // Frames the producer had to drop because the consumer fell behind
+  uint16_t overflowCount() const { return overflows; }
+
+private:
+  T slots[Capacity];
+  volatile uint8_t head; // Written only by the producer
+  volatile uint8_t tail; // Written only by the consumer
+  volatile uint16_t overflows;
+};
+
+#endif
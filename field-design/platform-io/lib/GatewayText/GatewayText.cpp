@@ -0,0 +1,46 @@
+#include "GatewayText.h"
+
+#include <string.h>
+#include <AtParser.h>
+
+bool parseSensorData(const uint8_t* buf, uint8_t len, SensorReading& data) {
+  return decodeSensorReading(buf, len, data);
+}
+
+// Append "<label><value>" with two decimals, or "<label>9999.00" when the value is not valid
+static void appendSensorField(StringBuilder& text, const char* label, int32_t centiValue, bool valid) {
+  text.append(label).appendFixed(valid ? centiValue : GATEWAY_INVALID_VALUE, 2);
+}
+
+void formatSensorData(const SensorReading& data, StringBuilder& text) {
+  bool thValid = !(data.flags & SENSOR_FLAG_TH_INVALID);
+  bool pressureValid = !(data.flags & SENSOR_FLAG_PRESSURE_INVALID);
+  text.append("N:").appendUnsigned(data.nodeId).append(',');
+
+  // Pressure goes from deci-Pa to hPa with two decimals (i.e. whole Pa)
+  appendSensorField(text, "T:", data.temperature, thValid);
+  appendSensorField(text, ",H:", data.humidity, thValid);
+  appendSensorField(text, ",P:", (int32_t)((data.pressure + 5) / 10), pressureValid);
+}
+
+const char* parseGpsInfo(const char* line, size_t& len) {
+  if (!AtParser::startsWith(line, "+CGPSINFO:")) {
+    return nullptr;
+  }
+
+  const char* gpsData = line + 10;
+  while (*gpsData == ' ') {
+    gpsData++;
+  }
+
+  len = strlen(gpsData);
+  while (len > 0 && gpsData[len - 1] == ' ') {
+    len--;
+  }
+
+  // Without a fix the receiver answers with empty fields; latitude comes first
+  if (len == 0 || gpsData[0] == ',') {
+    return nullptr;
+  }
+  return gpsData;
+}
@@ -0,0 +1,26 @@
+#ifndef GATEWAY_TEXT_H
+#define GATEWAY_TEXT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SensorPacket.h>
+#include <StringBuilder.h>
+
+// Value reported in place of a reading whose sensor failed
+#define GATEWAY_INVALID_VALUE 999900 // "9999.00"
+
+/* Text the gateways exchange with the modem, kept free of Arduino types so the
+ * same code runs in the native tests.
+ */
+
+// Decode a reading or window summary frame (see SensorPacket.h); a summary is stored as its means
+bool parseSensorData(const uint8_t* buf, uint8_t len, SensorReading& data);
+
+// Append "N:<id>,T:<temp>,H:<hum>,P:<hPa>" to text, with 9999.00 for values that are not valid
+void formatSensorData(const SensorReading& data, StringBuilder& text);
+
+// Position data of a "+CGPSINFO: <data>" line with the spaces around it trimmed, length in len;
+// nullptr for any other line or a receiver without a fix (empty fields)
+const char* parseGpsInfo(const char* line, size_t& len);
+
+#endif
@@ -0,0 +1,112 @@
+#include "GpsCache.h"
+
+#include <string.h>
+#include <GatewayText.h>
+
+GpsCache::GpsCache(AtEngine& modem)
+    : modem(modem), fixValid(false), running(false), candidateValid(false), attempts(0), misses(0),
+      fixedAt(0), nextRefreshAt(0), onDone(nullptr), context(nullptr) {
+  strcpy(text, GPS_NO_FIX);
+}
+
+bool GpsCache::due() const {
+  return !running && (int32_t)(millis() - nextRefreshAt) >= 0;
+}
+
+uint32_t GpsCache::fixAge() const {
+  return fixValid ? millis() - fixedAt : 0xFFFFFFFFUL;
+}
+
+bool GpsCache::refresh(AtDoneCallback onDone, void* context) {
+  if (running || modem.freeSlots() < 2) {
+    return false;
+  }
+
+  this->onDone = onDone;
+  this->context = context;
+  attempts = 0;
+  candidateValid = false;
+  running = true;
+
+  // Warm-up is the hold-off of the first AT+CGPSINFO, queued once power-up answers
+  if (!modem.send("AT+CGPSPWR=1", 2000, onPoweredUp, this)) {
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+void GpsCache::cancel() {
+  // Bring-up powers the receiver on again, so the next refresh also turns it back off
+  running = false;
+  nextRefreshAt = millis();
+}
+
+bool GpsCache::requestInfo() {
+  modem.holdOff(attempts == 0 ? GPS_WARMUP : GPS_ATTEMPT_DELAY);
+  attempts++;
+  return modem.send("AT+CGPSINFO", GPS_INFO_TIMEOUT, onInfoDone, this, onInfoLine);
+}
+
+void GpsCache::powerDown() {
+  if (!modem.send("AT+CGPSPWR=0", 2000, onPoweredDown, this)) {
+    finish(candidateValid);
+  }
+}
+
+void GpsCache::finish(bool gotFix) {
+  running = false;
+  if (gotFix) {
+    misses = 0;
+  } else if (misses < 255) {
+    misses++;
+  }
+  nextRefreshAt = millis() + (gotFix ? GPS_REFRESH_INTERVAL : GPS_RETRY_INTERVAL);
+
+  if (onDone != nullptr) {
+    onDone(gotFix ? AT_RESULT_OK : AT_RESULT_ERROR, context);
+  }
+}
+
+void GpsCache::onPoweredUp(AtResult result, void* context) {
+  GpsCache* gps = static_cast<GpsCache*>(context);
+  if (!gps->running) {
+    return;
+  }
+  if (result != AT_RESULT_OK || !gps->requestInfo()) {
+    gps->powerDown();
+  }
+}
+
+// Store the +CGPSINFO: data as "L:<data>" when it carries a position
+void GpsCache::onInfoLine(const char* line, void* context) {
+  GpsCache* gps = static_cast<GpsCache*>(context);
+  size_t len;
+  const char* gpsData = parseGpsInfo(line, len);
+  if (gpsData == nullptr) {
+    return;
+  }
+
+  snprintf(gps->text, sizeof(gps->text), "L:%.*s", (int)len, gpsData);
+  gps->fixValid = true;
+  gps->fixedAt = millis();
+  gps->candidateValid = true;
+}
+
+void GpsCache::onInfoDone(AtResult result, void* context) {
+  GpsCache* gps = static_cast<GpsCache*>(context);
+  if (!gps->running) {
+    return;
+  }
+  if (!gps->candidateValid && gps->attempts < GPS_FIX_ATTEMPTS && gps->requestInfo()) {
+    return;
+  }
+  gps->powerDown();
+}
+
+void GpsCache::onPoweredDown(AtResult result, void* context) {
+  GpsCache* gps = static_cast<GpsCache*>(context);
+  if (gps->running) {
+    gps->finish(gps->candidateValid);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef GPS_CACHE_H
+#define GPS_CACHE_H
+
+#include <Arduino.h>
+#include <AtEngine.h>
+
+// A field gateway does not move, so a good fix is only refreshed every few hours
+#ifndef GPS_REFRESH_INTERVAL
+#define GPS_REFRESH_INTERVAL 21600000UL // 6 hours in milliseconds
+#endif
+
+#define GPS_RETRY_INTERVAL 600000UL // 10 minutes after a refresh that found no fix
+#define GPS_WARMUP 5000             // Milliseconds after power-up before the first AT+CGPSINFO
+#define GPS_ATTEMPT_DELAY 5000      // Milliseconds between AT+CGPSINFO attempts
+#define GPS_FIX_ATTEMPTS 12         // AT+CGPSINFO attempts per refresh, about a minute with the delays
+#define GPS_INFO_TIMEOUT 10000
+
+#define GPS_NO_FIX "L:9999.0" // Location reported before the first fix
+#define GPS_LOCATION_MAX 64
+
+/* Cached A9G GPS location, refreshed in the background on a slow schedule.
+ * refresh() queues one modem job: power the receiver up, ask AT+CGPSINFO
+ * until it reports a fix or the attempts run out, then power it down again.
+ * Reports read location() in constant time; a fix is kept after a refresh
+ * that failed, with its age available through fixAge().
+ */
+class GpsCache {
+public:
+  explicit GpsCache(AtEngine& modem);
+
+  // True when no refresh is running and the next one is due
+  bool due() const;
+
+  // Queue a refresh; onDone gets AT_RESULT_OK when a new fix was stored. False if the queue is full
+  bool refresh(AtDoneCallback onDone = nullptr, void* context = nullptr);
+
+  // The modem was reset and its queue dropped: forget any refresh in flight and refresh once it is back
+  void cancel();
+
+  // "L:<+CGPSINFO data>" of the last fix, or GPS_NO_FIX
+  const char* location() const { return text; }
+  bool hasFix() const { return fixValid; }
+  bool refreshing() const { return running; }
+  uint8_t missedRefreshes() const { return misses; }
+
+  // Milliseconds since the cached fix was taken, 0xFFFFFFFF without one
+  uint32_t fixAge() const;
+
+private:
+  static void onPoweredUp(AtResult result, void* context);
+  static void onInfoLine(const char* line, void* context);
+  static void onInfoDone(AtResult result, void* context);
+  static void onPoweredDown(AtResult result, void* context);
+
+  bool requestInfo();
+  void powerDown();
+  void finish(bool gotFix);
+
+  AtEngine& modem;
+  char text[GPS_LOCATION_MAX];
+  bool fixValid;
+  bool running;
+  bool candidateValid; // The attempt in flight reported a fix
+  uint8_t attempts;
+  uint8_t misses;      // Consecutive refreshes without a fix
+  uint32_t fixedAt;
+  uint32_t nextRefreshAt;
+  AtDoneCallback onDone;
+  void* context;
+};
+
+#endif
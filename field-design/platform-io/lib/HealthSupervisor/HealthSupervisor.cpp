@@ -0,0 +1,129 @@
+#include "HealthSupervisor.h"
+
+#if defined(ARDUINO_ARCH_STM32)
+#include <IWatchdog.h>
+#include <backup.h>
+#endif
+
+HealthSupervisor::HealthSupervisor()
+    : subsystemCount(0), cause(RESET_CAUSE_UNKNOWN), failedId(-1), boots(0), resetCallback(nullptr),
+      resetContext(nullptr) {}
+
+void HealthSupervisor::begin(uint32_t watchdogTimeout) {
+  readResetCause();
+#if defined(ARDUINO_ARCH_STM32)
+  IWatchdog.begin(watchdogTimeout * 1000UL);
+#endif
+}
+
+#if defined(ARDUINO_ARCH_STM32)
+void HealthSupervisor::readResetCause() {
+  // Several flags can be set at once (NRST is driven low on every reset), so the most specific wins
+  if (__HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST) || __HAL_RCC_GET_FLAG(RCC_FLAG_WWDGRST)) {
+    cause = RESET_CAUSE_WATCHDOG;
+  } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_LPWRRST)) {
+    cause = RESET_CAUSE_LOW_POWER;
+  } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_SFTRST)) {
+    cause = RESET_CAUSE_SOFTWARE;
+  } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_PORRST)) {
+    cause = RESET_CAUSE_POWER_ON;
+  } else if (__HAL_RCC_GET_FLAG(RCC_FLAG_PINRST)) {
+    cause = RESET_CAUSE_PIN;
+  }
+  __HAL_RCC_CLEAR_RESET_FLAGS();
+
+  enableBackupDomain();
+  uint32_t record = getBackupRegister(HEALTH_BKP_CAUSE);
+  if (cause == RESET_CAUSE_SOFTWARE && (record & 0xFF00) == HEALTH_CAUSE_MAGIC && (record & 0xFF) != 0) {
+    cause = RESET_CAUSE_SUPERVISOR;
+    failedId = (record & 0xFF) - 1;
+  }
+  setBackupRegister(HEALTH_BKP_CAUSE, 0);
+
+  boots = cause == RESET_CAUSE_POWER_ON ? 1 : getBackupRegister(HEALTH_BKP_BOOTS) + 1;
+  setBackupRegister(HEALTH_BKP_BOOTS, boots);
+}
+#else
+void HealthSupervisor::readResetCause() {
+  cause = RESET_CAUSE_POWER_ON;
+  boots = 1;
+}
+#endif
+
+int8_t HealthSupervisor::addSubsystem(const char* name, uint32_t timeout) {
+  if (subsystemCount >= HEALTH_MAX_SUBSYSTEMS) {
+    return -1;
+  }
+  subsystems[subsystemCount].name = name;
+  subsystems[subsystemCount].timeout = timeout;
+  subsystems[subsystemCount].lastAlive = millis();
+  return subsystemCount++;
+}
+
+void HealthSupervisor::alive(int8_t id) {
+  alive(id, millis());
+}
+
+void HealthSupervisor::alive(int8_t id, uint32_t at) {
+  if (id < 0 || id >= subsystemCount) {
+    return;
+  }
+  // Ignore reports older than what is already known, e.g. a modem that has not answered since boot
+  if ((int32_t)(at - subsystems[id].lastAlive) > 0) {
+    subsystems[id].lastAlive = at;
+  }
+}
+
+void HealthSupervisor::fail(int8_t id) {
+  if (resetCallback != nullptr) {
+    resetCallback(resetContext);
+  }
+#if defined(ARDUINO_ARCH_STM32)
+  setBackupRegister(HEALTH_BKP_CAUSE, HEALTH_CAUSE_MAGIC | (uint8_t)(id + 1));
+  NVIC_SystemReset();
+#endif
+}
+
+void HealthSupervisor::poll() {
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < subsystemCount; i++) {
+    if (now - subsystems[i].lastAlive > subsystems[i].timeout) {
+      fail(i);
+      return;
+    }
+  }
+#if defined(ARDUINO_ARCH_STM32)
+  IWatchdog.reload();
+#endif
+}
+
+void HealthSupervisor::onReset(HealthResetCallback callback, void* context) {
+  resetCallback = callback;
+  resetContext = context;
+}
+
+const char* HealthSupervisor::failedSubsystem() const {
+  if (cause != RESET_CAUSE_SUPERVISOR || failedId < 0 || failedId >= subsystemCount) {
+    return "";
+  }
+  return subsystems[failedId].name;
+}
+
+const char* HealthSupervisor::causeName(ResetCause cause) {
+  switch (cause) {
+    case RESET_CAUSE_POWER_ON:
+      return "POWER";
+    case RESET_CAUSE_PIN:
+      return "PIN";
+    case RESET_CAUSE_SOFTWARE:
+      return "SOFTWARE";
+    case RESET_CAUSE_WATCHDOG:
+      return "WATCHDOG";
+    case RESET_CAUSE_SUPERVISOR:
+      return "SUPERVISOR";
+    case RESET_CAUSE_LOW_POWER:
+      return "LOWPOWER";
+    default:
+      return "UNKNOWN";
+  }
+}
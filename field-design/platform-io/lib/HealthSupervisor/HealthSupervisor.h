@@ -0,0 +1,86 @@
+#ifndef HEALTH_SUPERVISOR_H
+#define HEALTH_SUPERVISOR_H
+
+#include <Arduino.h>
+
+// Independent watchdog period in milliseconds; the F103 IWDG tops out at about 26 s
+#ifndef IWDG_TIMEOUT
+#define IWDG_TIMEOUT 20000
+#endif
+
+#define HEALTH_MAX_SUBSYSTEMS 4
+#define HEALTH_NO_TIMEOUT 0xFFFFFFFFUL // For subsystems that only ever report through fail()
+
+// Backup registers that survive a reset (not a power loss without VBAT), above those STM32RTC uses
+#define HEALTH_BKP_CAUSE 9     // HEALTH_CAUSE_MAGIC | (failed subsystem + 1), written just before a supervised reset
+#define HEALTH_BKP_BOOTS 10    // Resets since power-on
+#define HEALTH_CAUSE_MAGIC 0xA500
+
+enum ResetCause {
+  RESET_CAUSE_UNKNOWN,
+  RESET_CAUSE_POWER_ON,   // Power-on or brown-out
+  RESET_CAUSE_PIN,        // NRST pin, e.g. the reset button or the programmer
+  RESET_CAUSE_SOFTWARE,   // NVIC_SystemReset() outside the supervisor
+  RESET_CAUSE_WATCHDOG,   // IWDG expired: loop() stopped running
+  RESET_CAUSE_SUPERVISOR, // A subsystem missed its deadline or reported a failure, see failedSubsystem()
+  RESET_CAUSE_LOW_POWER   // Illegal entry into standby or stop
+};
+
+// Called just before a supervised reset, e.g. to persist data still in RAM
+typedef void (*HealthResetCallback)(void* context);
+
+/* Watchdog-fed health supervisor.
+ * Subsystems report progress with alive(); poll() reloads the IWDG only
+ * while every subsystem has reported within its timeout, so a hung
+ * subsystem resets the MCU just like a hung loop(). A supervised reset
+ * records which subsystem failed in a backup register, and the reset flags
+ * plus that record tell the next boot why it restarted.
+ */
+class HealthSupervisor {
+public:
+  HealthSupervisor();
+
+  // Read and clear the reset cause, then start the watchdog; call first thing in setup()
+  void begin(uint32_t watchdogTimeout = IWDG_TIMEOUT);
+
+  // Register a subsystem that must report alive() at least every timeout ms; returns its id, -1 if full
+  int8_t addSubsystem(const char* name, uint32_t timeout);
+
+  // The subsystem made progress now, or at millis() value at when it reports after the fact
+  void alive(int8_t id);
+  void alive(int8_t id, uint32_t at);
+
+  // The subsystem cannot recover: record it and reset now
+  void fail(int8_t id);
+
+  // Feed the watchdog if every subsystem is on time, reset otherwise; call on every pass through loop()
+  void poll();
+
+  void onReset(HealthResetCallback callback, void* context = nullptr);
+
+  ResetCause resetCause() const { return cause; }
+  // Name of the subsystem behind a RESET_CAUSE_SUPERVISOR, once it has been registered again
+  const char* failedSubsystem() const;
+  uint16_t bootCount() const { return boots; }
+
+  static const char* causeName(ResetCause cause);
+
+private:
+  struct Subsystem {
+    const char* name;
+    uint32_t timeout;
+    uint32_t lastAlive;
+  };
+
+  void readResetCause();
+
+  Subsystem subsystems[HEALTH_MAX_SUBSYSTEMS];
+  uint8_t subsystemCount;
+  ResetCause cause;
+  int8_t failedId;
+  uint16_t boots;
+  HealthResetCallback resetCallback;
+  void* resetContext;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "HeapMonitor.h"
+
+static volatile uint32_t operations = 0;
+static uint32_t markedOperations = 0;
+static size_t markedInUse = 0;
+
+#if defined(ARDUINO_ARCH_STM32)
+#include <malloc.h>
+#include <reent.h>
+#include <unistd.h>
+
+// Replace newlib's no-op malloc lock with a counter; the firmware is single-threaded, so nothing else to lock
+extern "C" void __malloc_lock(struct _reent* reent) {
+  operations = operations + 1;
+}
+
+extern "C" void __malloc_unlock(struct _reent* reent) {}
+
+size_t heapInUse() {
+  // mallinfo() takes the lock itself, which is not an allocation
+  uint32_t before = operations;
+  struct mallinfo info = mallinfo();
+  operations = before;
+  return info.uordblks;
+}
+
+size_t heapFree() {
+  uint32_t before = operations;
+  struct mallinfo info = mallinfo();
+  operations = before;
+  char stackTop;  // Its address stands in for the stack pointer
+  return (size_t)(&stackTop - (char*)sbrk(0)) + info.fordblks;
+}
+
+#elif defined(HEAP_MONITOR_WRAP)
+#include <stdlib.h>
+#include <malloc.h>
+#include <new>
+
+// Native test builds link with -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc, so every
+// allocation made by the code under test comes through here
+static size_t inUse = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  void* ptr = __real_malloc(size);
+  operations = operations + 1;
+  inUse += ptr ? malloc_usable_size(ptr) : 0;
+  return ptr;
+}
+
+void __wrap_free(void* ptr) {
+  if (ptr) {
+    operations = operations + 1;
+    inUse -= malloc_usable_size(ptr);
+  }
+  __real_free(ptr);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  void* ptr = __real_calloc(count, size);
+  operations = operations + 1;
+  inUse += ptr ? malloc_usable_size(ptr) : 0;
+  return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  size_t before = ptr ? malloc_usable_size(ptr) : 0;
+  void* moved = __real_realloc(ptr, size);
+  operations = operations + 1;
+  if (moved || size == 0) {
+    inUse = inUse - before + (moved ? malloc_usable_size(moved) : 0);
+  }
+  return moved;
+}
+}
+
+// libstdc++ allocates inside the shared library, out of reach of --wrap, so new and delete are routed here too
+void* operator new(size_t size) {
+  void* ptr = __wrap_malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  __wrap_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  __wrap_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  __wrap_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  __wrap_free(ptr);
+}
+
+size_t heapInUse() {
+  return inUse;
+}
+
+size_t heapFree() {
+  return 0;
+}
+
+#else
+
+size_t heapInUse() {
+  return 0;
+}
+
+size_t heapFree() {
+  return 0;
+}
+
+#endif
+
+uint32_t heapOperations() {
+  return operations;
+}
+
+void heapMonitorMark() {
+  markedInUse = heapInUse();
+  markedOperations = operations;
+}
+
+uint32_t heapOperationsSinceMark() {
+  return operations - markedOperations;
+}
+
+int32_t heapGrowthSinceMark() {
+  return (int32_t)heapInUse() - (int32_t)markedInUse;
+}
@@ -0,0 +1,33 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Heap activity counters for proving the firmware does not allocate in steady state.
+ * Every newlib malloc/free/realloc takes the malloc lock, so the lock hook
+ * counts heap operations whatever called them (including library code).
+ * Native test builds defining HEAP_MONITOR_WRAP count through linker-wrapped
+ * malloc/free instead; elsewhere the counters stay at zero.
+ */
+
+// Heap operations since boot
+uint32_t heapOperations();
+
+// Bytes currently allocated from the heap
+size_t heapInUse();
+
+// Bytes still free for the heap and the stack: the gap between the program break and the stack pointer plus
+// free heap blocks; 0 where it is not known
+size_t heapFree();
+
+// Start of steady state, call at the end of setup(); operations before it are start-up allocations
+void heapMonitorMark();
+
+// Heap operations since heapMonitorMark(), 0 when nothing allocated in steady state
+uint32_t heapOperationsSinceMark();
+
+// Bytes allocated since heapMonitorMark() and not freed; a leak shows up as steady growth
+int32_t heapGrowthSinceMark();
+
+#endif
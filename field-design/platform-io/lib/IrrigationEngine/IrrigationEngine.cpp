@@ -0,0 +1,168 @@
+#include "IrrigationEngine.h"
+
+#include <string.h>
+
+// Names of the IRRIGATION_REASON_* bits, lowest bit first
+static const char* const REASON_NAMES[] = {"HOT", "DRY", "OK", "TIME", "STALE"};
+#define REASON_NAME_COUNT (sizeof(REASON_NAMES) / sizeof(REASON_NAMES[0]))
+
+// Milliseconds from since to now; 0 when since was stamped a little after now, e.g. by a frame received
+// after the caller read millis()
+static uint32_t elapsed(uint32_t now, uint32_t since) {
+  int32_t delta = (int32_t)(now - since);
+  return delta > 0 ? (uint32_t)delta : 0;
+}
+
+IrrigationEngine::IrrigationEngine(const IrrigationZone* zones, uint8_t count)
+    : zones(zones), count(count > IRRIGATION_MAX_ZONES ? IRRIGATION_MAX_ZONES : count) {
+  memset(states, 0, sizeof(states));
+}
+
+void IrrigationEngine::update(const SensorReading& reading, uint32_t now) {
+  if (reading.flags & SENSOR_FLAG_TH_INVALID) {
+    return;  // Neither mean moves on a failed read, and the zone goes stale if the sensor stays down
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (zones[i].sensorNode != reading.nodeId) {
+      continue;
+    }
+    ZoneState& state = states[i];
+    if (state.samples == 0) {
+      state.temperature = (int32_t)reading.temperature << IRRIGATION_EWMA_SHIFT;
+      state.humidity = (int32_t)reading.humidity << IRRIGATION_EWMA_SHIFT;
+    } else {
+      state.temperature += reading.temperature - (state.temperature >> IRRIGATION_EWMA_SHIFT);
+      state.humidity += reading.humidity - (state.humidity >> IRRIGATION_EWMA_SHIFT);
+    }
+    if (state.samples < IRRIGATION_MIN_SAMPLES) {
+      state.samples++;
+    }
+    state.lastReadingAt = now;
+  }
+}
+
+bool IrrigationEngine::poll(uint32_t now, IrrigationDecision& decision) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (step(i, now, decision)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IrrigationEngine::commandResult(const SensorCommandResult& result, uint32_t now) {
+  if (result.code != SENSOR_COMMAND_VALVE || result.result == SENSOR_RESULT_OK) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    ZoneState& state = states[i];
+    if (zones[i].valveNode != result.nodeId || state.mode == IRRIGATION_DISABLED) {
+      continue;
+    }
+    state.mode = result.result == SENSOR_RESULT_UNSUPPORTED ? IRRIGATION_DISABLED : IRRIGATION_SOAKING;
+    state.since = now;
+  }
+}
+
+void IrrigationEngine::formatDecision(const IrrigationDecision& decision, StringBuilder& text) const {
+  text.append("Z:").append(zones[decision.zone].name);
+  text.append(",N:").appendUnsigned(decision.valveNode);
+  text.append(",A:").append(decision.action == IRRIGATION_OPEN ? "OPEN" : "CLOSE");
+  text.append(",S:").appendUnsigned(decision.seconds);
+  text.append(",R:");
+  bool first = true;
+  for (uint8_t i = 0; i < REASON_NAME_COUNT; i++) {
+    if (decision.reasons & (1 << i)) {
+      if (!first) {
+        text.append('+');
+      }
+      text.append(REASON_NAMES[i]);
+      first = false;
+    }
+  }
+  text.append(",T:").appendFixed(decision.temperature, 2);
+  text.append(",H:").appendFixed(decision.humidity, 2);
+}
+
+bool IrrigationEngine::step(uint8_t index, uint32_t now, IrrigationDecision& decision) {
+  const IrrigationZone& zone = zones[index];
+  ZoneState& state = states[index];
+  bool fresh = state.samples >= IRRIGATION_MIN_SAMPLES && elapsed(now, state.lastReadingAt) < IRRIGATION_STALE_TIME;
+
+  switch (state.mode) {
+    case IRRIGATION_SOAKING:
+      if (elapsed(now, state.since) < zone.soakTime) {
+        return false;
+      }
+      // A zone still past its limits after the soak opens again straight away
+      state.mode = IRRIGATION_IDLE;
+      state.since = now;
+      // fall through
+
+    case IRRIGATION_IDLE: {
+      uint8_t reasons = fresh ? startReasons(index) : 0;
+      if (reasons != 0) {
+        decide(index, IRRIGATION_WATERING, IRRIGATION_OPEN, reasons, now, decision);
+        return true;
+      }
+      return false;
+    }
+
+    case IRRIGATION_WATERING:
+      if (!fresh) {
+        decide(index, IRRIGATION_IDLE, IRRIGATION_CLOSE, IRRIGATION_REASON_STALE, now, decision);
+        return true;
+      }
+      if (recovered(index)) {
+        decide(index, IRRIGATION_IDLE, IRRIGATION_CLOSE, IRRIGATION_REASON_RECOVERED, now, decision);
+        return true;
+      }
+      if (elapsed(now, state.since) >= (uint32_t)zone.wateringTime * 1000) {
+        // The valve has closed itself by now; the command makes sure, in case it missed the open time
+        decide(index, IRRIGATION_SOAKING, IRRIGATION_CLOSE, IRRIGATION_REASON_TIMEOUT | startReasons(index), now,
+               decision);
+        return true;
+      }
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+uint8_t IrrigationEngine::startReasons(uint8_t index) const {
+  const IrrigationZone& zone = zones[index];
+  uint8_t reasons = 0;
+  if (zone.temperatureMax != IRRIGATION_NO_TEMPERATURE_LIMIT && temperature(index) > zone.temperatureMax) {
+    reasons |= IRRIGATION_REASON_HOT;
+  }
+  if (zone.humidityMin != IRRIGATION_NO_HUMIDITY_LIMIT && humidity(index) < zone.humidityMin) {
+    reasons |= IRRIGATION_REASON_DRY;
+  }
+  return reasons;
+}
+
+bool IrrigationEngine::recovered(uint8_t index) const {
+  const IrrigationZone& zone = zones[index];
+  bool cool = zone.temperatureMax == IRRIGATION_NO_TEMPERATURE_LIMIT ||
+              temperature(index) <= (int32_t)zone.temperatureMax - zone.temperatureHysteresis;
+  bool humid = zone.humidityMin == IRRIGATION_NO_HUMIDITY_LIMIT ||
+               humidity(index) >= (int32_t)zone.humidityMin + zone.humidityHysteresis;
+  return cool && humid;
+}
+
+void IrrigationEngine::decide(uint8_t index, IrrigationMode mode, uint8_t action, uint8_t reasons, uint32_t now,
+                              IrrigationDecision& decision) {
+  states[index].mode = mode;
+  states[index].since = now;
+
+  decision.zone = index;
+  decision.valveNode = zones[index].valveNode;
+  decision.action = action;
+  decision.seconds = action == IRRIGATION_OPEN ? zones[index].wateringTime : 0;
+  decision.reasons = reasons;
+  decision.temperature = temperature(index);
+  decision.humidity = humidity(index);
+}
@@ -0,0 +1,126 @@
+#ifndef IRRIGATION_ENGINE_H
+#define IRRIGATION_ENGINE_H
+
+#include <stdint.h>
+#include <SensorPacket.h>
+#include <StringBuilder.h>
+
+// Zones one gateway decides for
+#ifndef IRRIGATION_MAX_ZONES
+#define IRRIGATION_MAX_ZONES 8
+#endif
+
+// Rolling means follow each reading with weight 1 / 2^IRRIGATION_EWMA_SHIFT, about the last 4 readings
+#define IRRIGATION_EWMA_SHIFT 2
+
+// Readings a zone needs before it is decided on, so one odd reading after boot does not open a valve
+#define IRRIGATION_MIN_SAMPLES 3
+
+// A zone whose sensor node has been silent this long is not started, and a watering zone is closed
+#ifndef IRRIGATION_STALE_TIME
+#define IRRIGATION_STALE_TIME 1800000UL // 30 minutes in milliseconds
+#endif
+
+// Limit of a zone that does not use it
+#define IRRIGATION_NO_TEMPERATURE_LIMIT INT16_MAX
+#define IRRIGATION_NO_HUMIDITY_LIMIT 0
+
+// Why a decision was taken, as bits
+#define IRRIGATION_REASON_HOT 0x01       // "HOT", rolling temperature above temperatureMax
+#define IRRIGATION_REASON_DRY 0x02       // "DRY", rolling humidity below humidityMin
+#define IRRIGATION_REASON_RECOVERED 0x04 // "OK", back inside both limits by their hysteresis
+#define IRRIGATION_REASON_TIMEOUT 0x08   // "TIME", wateringTime is over and the zone soaks
+#define IRRIGATION_REASON_STALE 0x10     // "STALE", no recent reading from the sensor node
+
+// Limits and valve of one zone, in frame units (see SensorPacket.h)
+struct IrrigationZone {
+  const char* name;
+  uint8_t sensorNode;            // Node whose readings drive the zone
+  uint8_t valveNode;             // Node driving the zone's valve through SENSOR_COMMAND_VALVE
+  int16_t temperatureMax;        // centi-degrees Celsius; watering starts when the rolling mean rises above it
+  uint16_t humidityMin;          // centi-%RH; watering starts when the rolling mean falls below it
+  int16_t temperatureHysteresis; // Watering stops once both means are back inside by their hysteresis
+  uint16_t humidityHysteresis;
+  uint16_t wateringTime;         // Seconds the valve opens for; the valve node closes it by itself after
+  uint32_t soakTime;             // Milliseconds after a full wateringTime before the zone is checked again
+};
+
+enum IrrigationMode {
+  IRRIGATION_IDLE,     // Valve closed, checked on every poll()
+  IRRIGATION_WATERING, // Valve opened
+  IRRIGATION_SOAKING,  // Valve closed after wateringTime or a failed command, not checked until soakTime
+  IRRIGATION_DISABLED  // The valve node answered that it has no valve; the zone stays off until reboot
+};
+
+enum IrrigationAction {
+  IRRIGATION_OPEN,
+  IRRIGATION_CLOSE
+};
+
+// A valve change the gateway has to send as SENSOR_COMMAND_VALVE and report upstream
+struct IrrigationDecision {
+  uint8_t zone;
+  uint8_t valveNode;
+  uint8_t action;       // IrrigationAction
+  uint16_t seconds;     // Command value: open time, 0 to close
+  uint8_t reasons;      // IRRIGATION_REASON_* bits
+  int16_t temperature;  // Rolling means the decision was taken on
+  uint16_t humidity;
+};
+
+/* Threshold irrigation of the lab controller, run at the gateway over the
+ * readings of its field nodes, so a valve reacts without a round trip over
+ * GPRS. Each zone keeps an incremental rolling mean (EWMA) of its sensor
+ * node's temperature and humidity; a mean past a limit opens the zone's
+ * valve, and it closes again once both means are back inside by their
+ * hysteresis, when the readings stop, or after wateringTime, followed by a
+ * soak. Nothing allocates; zones come from a static table.
+ */
+class IrrigationEngine {
+public:
+  IrrigationEngine(const IrrigationZone* zones, uint8_t count);
+
+  // Fold an accepted reading into every zone it drives; now is millis() at reception
+  void update(const SensorReading& reading, uint32_t now);
+
+  // Step the zones; fills decision and returns true for the next valve that has to change, so call until false
+  bool poll(uint32_t now, IrrigationDecision& decision);
+
+  // A node's answer to a valve command: a zone whose valve is missing is disabled, and one whose command
+  // failed any other way (including COMMAND_RESULT_* codes of the gateway) soaks before trying again
+  void commandResult(const SensorCommandResult& result, uint32_t now);
+
+  uint8_t size() const { return count; }
+  const IrrigationZone& zone(uint8_t index) const { return zones[index]; }
+  IrrigationMode mode(uint8_t index) const { return (IrrigationMode)states[index].mode; }
+  uint8_t samples(uint8_t index) const { return states[index].samples; }
+
+  // Rolling means of zone, in frame units
+  int16_t temperature(uint8_t index) const { return (int16_t)(states[index].temperature >> IRRIGATION_EWMA_SHIFT); }
+  uint16_t humidity(uint8_t index) const { return (uint16_t)(states[index].humidity >> IRRIGATION_EWMA_SHIFT); }
+
+  // Append "Z:<name>,N:<valve node>,A:<OPEN|CLOSE>,S:<seconds>,R:<reasons>,T:<mean>,H:<mean>"
+  void formatDecision(const IrrigationDecision& decision, StringBuilder& text) const;
+
+private:
+  struct ZoneState {
+    int32_t temperature;  // Rolling means scaled by 2^IRRIGATION_EWMA_SHIFT
+    int32_t humidity;
+    uint8_t samples;      // Readings folded in, saturating at IRRIGATION_MIN_SAMPLES
+    uint8_t mode;         // IrrigationMode
+    uint32_t lastReadingAt;
+    uint32_t since;       // millis() the zone entered its mode
+  };
+
+  bool step(uint8_t index, uint32_t now, IrrigationDecision& decision);
+  uint8_t startReasons(uint8_t index) const;
+  bool recovered(uint8_t index) const;
+  void decide(uint8_t index, IrrigationMode mode, uint8_t action, uint8_t reasons, uint32_t now,
+              IrrigationDecision& decision);
+
+  const IrrigationZone* zones;
+  uint8_t count;
+  ZoneState states[IRRIGATION_MAX_ZONES];
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "LinkAdvisor.h"
+
+#include <string.h>
+#include <RH_CC110.h>
+
+const LinkProfile LINK_PROFILES[LINK_PROFILE_COUNT] = {
+  {RH_CC110::GFSK_Rb1_2Fd5_2, 1200, -112},
+  {RH_CC110::GFSK_Rb38_4Fd20, 38400, -104},
+  {RH_CC110::GFSK_Rb250Fd127, 250000, -95},
+};
+
+const int8_t LINK_POWER_DBM[LINK_POWER_STEPS] = {0, 5, 7, 10};
+
+uint8_t encodeLinkFlags(const LinkAdvice& advice) {
+  return (uint8_t)(((advice.profile & 0x03) << 2) | (advice.powerStep & 0x03));
+}
+
+LinkAdvice decodeLinkFlags(uint8_t flags) {
+  LinkAdvice advice;
+  advice.profile = (flags >> 2) & 0x03;
+  advice.powerStep = flags & 0x03;
+  if (advice.profile >= LINK_PROFILE_COUNT) {
+    advice.profile = LINK_PROFILE_ROBUST;
+  }
+  return advice;
+}
+
+LinkAdvisor::LinkAdvisor() : profileLimit(LINK_PROFILE_COUNT - 1) {
+  memset(loss, 0, sizeof(loss));
+  memset(advised, 0, sizeof(advised));
+}
+
+LinkAdvice LinkAdvisor::update(uint8_t nodeId, int16_t rssi, uint8_t flags, bool inSlot) {
+  LinkAdvice sentAt = decodeLinkFlags(flags);
+  int32_t measured = ((int32_t)LINK_POWER_DBM[sentAt.powerStep] - rssi) * 16;
+  if (measured < 16) {
+    measured = 16;  // Keeps 0 free for "not heard"
+  }
+
+  int32_t smoothed = loss[nodeId] ? loss[nodeId] + ((measured - loss[nodeId]) >> LINK_LOSS_SHIFT) : measured;
+  loss[nodeId] = (uint16_t)(smoothed > 0xFFFF ? 0xFFFF : smoothed);
+  int16_t pathLoss = (int16_t)((loss[nodeId] + 8) >> 4);
+
+  LinkAdvice current = advice(nodeId);
+  LinkAdvice next = {LINK_PROFILE_ROBUST, LINK_POWER_STEPS - 1};
+
+  // Fastest profile first, then the lowest power step it closes the link with
+  for (int8_t profile = inSlot ? profileLimit : LINK_PROFILE_ROBUST; profile >= 0; profile--) {
+    for (uint8_t step = 0; step < LINK_POWER_STEPS; step++) {
+      bool bolder = profile > current.profile || (profile == current.profile && step < current.powerStep);
+      int16_t needed = LINK_PROFILES[profile].sensitivity + LINK_FADE_MARGIN + (bolder ? LINK_HYSTERESIS : 0);
+      if (LINK_POWER_DBM[step] - pathLoss >= needed) {
+        next.profile = profile;
+        next.powerStep = step;
+        advised[nodeId] = encodeLinkFlags(next);
+        return next;
+      }
+    }
+  }
+
+  // Not even the robust profile at full power has the margin: stay on it at full power
+  advised[nodeId] = encodeLinkFlags(next);
+  return next;
+}
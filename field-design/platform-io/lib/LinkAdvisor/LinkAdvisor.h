@@ -0,0 +1,95 @@
+#ifndef LINK_ADVISOR_H
+#define LINK_ADVISOR_H
+
+#include <stdint.h>
+#include <SlotSchedule.h>
+
+/* Link Profiles, most robust first (CC1101 typical sensitivity at 433 MHz):
+ * Id | RadioHead modem config | Rate      | Sensitivity | 26-byte summary on air
+ * ---|------------------------|-----------|-------------|-----------------------
+ * 0  | GFSK_Rb1_2Fd5_2        | 1.2 kbps  | -112 dBm    | ~274 ms
+ * 1  | GFSK_Rb38_4Fd20        | 38.4 kbps | -104 dBm    | ~9 ms
+ * 2  | GFSK_Rb250Fd127        | 250 kbps  | -95 dBm     | ~2 ms
+ * Beacons, listen-before-talk traffic and retransmissions always use profile 0;
+ * a faster profile is only used inside the node's own TDMA slot, where the
+ * gateway retunes to it.
+ */
+#define LINK_PROFILE_ROBUST 0
+#define LINK_PROFILE_COUNT 3
+
+// Node transmit power steps the gateway can advise: 0, 5, 7 and 10 dBm (RH_CC110::TransmitPower0dBm and up)
+#define LINK_POWER_STEPS 4
+
+// Margin in dB kept above the sensitivity for fading
+#ifndef LINK_FADE_MARGIN
+#define LINK_FADE_MARGIN 10
+#endif
+
+// Extra margin in dB before a faster profile or a lower power step is advised, so the advice does not flap
+#define LINK_HYSTERESIS 3
+
+// Weight of a new path loss measurement, 1 / 2^LINK_LOSS_SHIFT
+#define LINK_LOSS_SHIFT 2
+
+struct LinkProfile {
+  uint8_t modemConfig; // RH_CC110::ModemConfigChoice
+  uint32_t bitrate;    // Bits per second on air
+  int8_t sensitivity;  // dBm
+};
+
+extern const LinkProfile LINK_PROFILES[LINK_PROFILE_COUNT];
+extern const int8_t LINK_POWER_DBM[LINK_POWER_STEPS];
+
+// Rate profile and transmit power step of one node
+struct LinkAdvice {
+  uint8_t profile;
+  uint8_t powerStep;
+};
+
+/* Link Bits in the RadioHead Header Flags (RH_FLAGS_APPLICATION_SPECIFIC):
+ * Bits | Node frame                   | Gateway ACK
+ * -----|------------------------------|-------------------------------------
+ * 0-1  | Power step the frame went at | Power step for the node's next frames
+ * 2-3  | Profile the frame went at    | Profile for the node's next slot
+ */
+uint8_t encodeLinkFlags(const LinkAdvice& advice);
+
+// Out-of-range profiles decode as LINK_PROFILE_ROBUST
+LinkAdvice decodeLinkFlags(uint8_t flags);
+
+// Milliseconds on air for a frame with payloadLen bytes at profile
+inline uint32_t linkAirtime(uint8_t payloadLen, uint8_t profile) {
+  return SlotSchedule::airtime(payloadLen, LINK_PROFILES[profile].bitrate);
+}
+
+/* Gateway side of the link adaptation.
+ * Each frame's RSSI and the power step it was sent at give the path loss
+ * to its node, smoothed per node. The advice is the fastest profile and the
+ * lowest power step that still leave LINK_FADE_MARGIN above the profile's
+ * sensitivity, so near nodes speed up and turn down while far nodes keep
+ * the robust profile at full power. Called from the radio interrupt.
+ */
+class LinkAdvisor {
+public:
+  LinkAdvisor();
+
+  // Fold in a frame from nodeId heard at rssi with the header flags it carried; inSlot is true when it
+  // arrived in the node's own TDMA slot, the only place a faster profile can be used. Returns the new advice
+  LinkAdvice update(uint8_t nodeId, int16_t rssi, uint8_t flags, bool inSlot);
+
+  // Fastest profile advised to any node from now on; LINK_PROFILE_ROBUST turns rate adaptation off
+  void setProfileLimit(uint8_t profile) { profileLimit = profile < LINK_PROFILE_COUNT ? profile : LINK_PROFILE_COUNT - 1; }
+
+  // Advice last given to nodeId
+  LinkAdvice advice(uint8_t nodeId) const { return decodeLinkFlags(advised[nodeId]); }
+
+  // Smoothed path loss to nodeId in dB, 0 when it has not been heard
+  uint8_t pathLoss(uint8_t nodeId) const { return (loss[nodeId] + 8) >> 4; }
+
+private:
+  uint16_t loss[256];    // Path loss in 1/16 dB, 0 when the node has not been heard
+  uint8_t advised[256];  // Encoded LinkAdvice
+  uint8_t profileLimit;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "ModemBoot.h"
+
+#include <string.h>
+
+ModemBoot::ModemBoot(AtEngine& modem)
+    : modem(modem), state(BOOT_IDLE), steps(nullptr), stepCount(0), stepIndex(0), registered(false), run(0),
+      nextTicket(0), startedAt(0), phaseStartedAt(0), bootTime(0), onDone(nullptr), context(nullptr) {
+  for (uint8_t i = 0; i < 2; i++) {
+    tickets[i].boot = this;
+    tickets[i].run = 0;
+  }
+}
+
+bool ModemBoot::start(const ModemStep* steps, uint8_t count, uint16_t grace, AtDoneCallback onDone, void* context) {
+  run++;
+  this->steps = steps;
+  stepCount = count;
+  stepIndex = 0;
+  this->onDone = onDone;
+  this->context = context;
+  startedAt = millis();
+  phaseStartedAt = startedAt;
+  state = BOOT_PROBE;
+
+  modem.holdOff(grace);
+  if (!send("AT", MODEM_PROBE_TIMEOUT, onProbeDone)) {
+    state = BOOT_IDLE;
+    return false;
+  }
+  return true;
+}
+
+void ModemBoot::cancel() {
+  run++;
+  state = BOOT_IDLE;
+}
+
+bool ModemBoot::send(const char* command, uint32_t timeout, AtDoneCallback done, AtLineCallback onLine) {
+  Ticket* ticket = &tickets[nextTicket];
+  nextTicket ^= 1;
+  ticket->run = run;
+  return modem.send(command, timeout, done, ticket, onLine);
+}
+
+// The boot a callback belongs to, or nullptr when its run was cancelled
+ModemBoot* ModemBoot::current(void* context) {
+  Ticket* ticket = static_cast<Ticket*>(context);
+  ModemBoot* boot = ticket->boot;
+  return ticket->run == boot->run && boot->state != BOOT_IDLE ? boot : nullptr;
+}
+
+void ModemBoot::finish(AtResult result) {
+  state = BOOT_IDLE;
+  if (result == AT_RESULT_OK) {
+    bootTime = millis() - startedAt;
+  }
+  if (onDone != nullptr) {
+    onDone(result, context);
+  }
+}
+
+void ModemBoot::nextStep() {
+  if (stepIndex < stepCount) {
+    const ModemStep& step = steps[stepIndex++];
+    if (!send(step.command, step.timeout, onStepDone)) {
+      finish(AT_RESULT_ERROR);
+    }
+    return;
+  }
+
+  state = BOOT_REGISTER;
+  registered = false;
+  phaseStartedAt = millis();
+  if (!send("AT+CREG?", 2000, onRegisterDone, onRegisterLine)) {
+    finish(AT_RESULT_ERROR);
+  }
+}
+
+void ModemBoot::onProbeDone(AtResult result, void* context) {
+  ModemBoot* boot = current(context);
+  if (boot == nullptr || boot->state != BOOT_PROBE) {
+    return;
+  }
+
+  if (result == AT_RESULT_OK) {
+    boot->state = BOOT_CONFIG;
+    boot->nextStep();
+    return;
+  }
+
+  if (millis() - boot->phaseStartedAt >= MODEM_BOOT_TIMEOUT) {
+    boot->finish(AT_RESULT_TIMEOUT);
+    return;
+  }
+  boot->modem.holdOff(MODEM_PROBE_INTERVAL);
+  if (!boot->send("AT", MODEM_PROBE_TIMEOUT, onProbeDone)) {
+    boot->finish(AT_RESULT_ERROR);
+  }
+}
+
+void ModemBoot::onStepDone(AtResult result, void* context) {
+  // A failed step does not stop the bring-up, as before; the reports find out if the modem is unusable
+  ModemBoot* boot = current(context);
+  if (boot != nullptr && boot->state == BOOT_CONFIG) {
+    boot->nextStep();
+  }
+}
+
+// "+CREG: <n>,<stat>": stat 1 is registered on the home network, 5 is roaming
+void ModemBoot::onRegisterLine(const char* line, void* context) {
+  ModemBoot* boot = current(context);
+  if (boot == nullptr || !AtParser::startsWith(line, "+CREG:")) {
+    return;
+  }
+
+  const char* stat = strchr(line, ',');
+  stat = stat != nullptr ? stat + 1 : line + 6;
+  while (*stat == ' ') {
+    stat++;
+  }
+  boot->registered = *stat == '1' || *stat == '5';
+}
+
+void ModemBoot::onRegisterDone(AtResult result, void* context) {
+  ModemBoot* boot = current(context);
+  if (boot == nullptr || boot->state != BOOT_REGISTER) {
+    return;
+  }
+
+  if (result == AT_RESULT_OK && boot->registered) {
+    boot->finish(AT_RESULT_OK);
+    return;
+  }
+
+  if (millis() - boot->phaseStartedAt >= MODEM_REGISTER_TIMEOUT) {
+    boot->finish(AT_RESULT_TIMEOUT);
+    return;
+  }
+  boot->modem.holdOff(MODEM_REGISTER_INTERVAL);
+  if (!boot->send("AT+CREG?", 2000, onRegisterDone, onRegisterLine)) {
+    boot->finish(AT_RESULT_ERROR);
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef MODEM_BOOT_H
+#define MODEM_BOOT_H
+
+#include <Arduino.h>
+#include <AtEngine.h>
+
+#define MODEM_PROBE_INTERVAL 500        // Milliseconds between AT probes while the modem boots
+#define MODEM_PROBE_TIMEOUT 300         // A booted A9G answers AT well within this
+#define MODEM_BOOT_TIMEOUT 30000        // Give up when AT has not answered for this long
+#define MODEM_REGISTER_INTERVAL 1000    // Milliseconds between AT+CREG? polls
+#define MODEM_REGISTER_TIMEOUT 90000    // Give up waiting for the network after this long
+#define MODEM_RESET_GRACE 2000          // After AT+CRESET the old firmware may still answer for a moment
+
+// One configuration command of the bring-up sequence
+struct ModemStep {
+  const char* command;
+  uint32_t timeout;
+};
+
+/* Readiness-driven A9G bring-up on the AT engine, replacing fixed start-up delays.
+ * start() probes AT until the modem answers, sends each configuration step
+ * as soon as the previous one completes, then polls AT+CREG? until the modem
+ * is registered (home or roaming) and calls onDone. Callbacks of commands
+ * from a run that was cancelled are recognised and ignored.
+ */
+class ModemBoot {
+public:
+  explicit ModemBoot(AtEngine& modem);
+
+  // Run the bring-up; grace delays the first probe (MODEM_RESET_GRACE after AT+CRESET, 0 after power-on).
+  // onDone gets AT_RESULT_OK once registered, AT_RESULT_TIMEOUT if the modem or network never came up
+  bool start(const ModemStep* steps, uint8_t count, uint16_t grace, AtDoneCallback onDone, void* context = nullptr);
+
+  // Abandon the run in progress, e.g. before the queue is cleared for a reset
+  void cancel();
+
+  bool running() const { return state != BOOT_IDLE; }
+
+  // Milliseconds the last completed run took from start() to registration
+  uint32_t lastBootTime() const { return bootTime; }
+
+private:
+  enum State {
+    BOOT_IDLE,
+    BOOT_PROBE,    // Waiting for the modem to answer AT
+    BOOT_CONFIG,   // Sending the configuration steps
+    BOOT_REGISTER  // Waiting for network registration
+  };
+
+  // Commands carry the run they belong to, so a cancelled run's late callbacks can be told apart
+  struct Ticket {
+    ModemBoot* boot;
+    uint8_t run;
+  };
+
+  static void onProbeDone(AtResult result, void* context);
+  static void onStepDone(AtResult result, void* context);
+  static void onRegisterLine(const char* line, void* context);
+  static void onRegisterDone(AtResult result, void* context);
+  static ModemBoot* current(void* context);
+
+  bool send(const char* command, uint32_t timeout, AtDoneCallback onDone, AtLineCallback onLine = nullptr);
+  void nextStep();
+  void finish(AtResult result);
+
+  AtEngine& modem;
+  State state;
+  const ModemStep* steps;
+  uint8_t stepCount;
+  uint8_t stepIndex;
+  bool registered;
+  uint8_t run;
+  Ticket tickets[2];
+  uint8_t nextTicket;
+  uint32_t startedAt;
+  uint32_t phaseStartedAt;
+  uint32_t bootTime;
+  AtDoneCallback onDone;
+  void* context;
+};
+
+#endif
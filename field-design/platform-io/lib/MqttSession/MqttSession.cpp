@@ -0,0 +1,241 @@
+#include "MqttSession.h"
+
+MqttSession::MqttSession(AtEngine& modem, const char* broker, uint16_t port, const char* clientId, uint16_t keepAlive)
+    : modem(modem), broker(broker), port(port), clientId(clientId), keepAlive(keepAlive),
+      sessionState(MQTT_DOWN), failures(0), staleSession(false), nextAttemptAt(0), inflightCount(0),
+      subscriptionCount(0) {
+  for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    publishes[i].session = this;
+    publishes[i].used = false;
+  }
+}
+
+void MqttSession::begin() {
+  modem.onUrc("+MQTTDISCONNECTED", onDisconnectedUrc, this);
+  modem.onUrc("+MQTTPUBLISH:", onMessageUrc, this);
+}
+
+void MqttSession::poll() {
+  if (sessionState != MQTT_DOWN || (int32_t)(millis() - nextAttemptAt) < 0 || modem.freeSlots() < 2) {
+    return;
+  }
+
+  // A session the modem still thinks is open makes AT+MQTTCONN fail, so close it first
+  if (staleSession) {
+    modem.send("AT+MQTTDISCONN", 5000);
+    staleSession = false;
+  }
+
+  char command[AT_COMMAND_MAX];
+  snprintf(command, sizeof(command), "AT+MQTTCONN=\"%s\",%u,\"%s\",%u,0", broker, port, clientId, keepAlive);
+  if (modem.send(command, MQTT_CONNECT_TIMEOUT, onConnectDone, this)) {
+    sessionState = MQTT_CONNECTING;
+  }
+}
+
+MqttSession::Publish* MqttSession::acquire(AtDoneCallback onDone, void* context) {
+  if (sessionState != MQTT_UP || inflightCount >= MQTT_MAX_INFLIGHT) {
+    return nullptr;
+  }
+
+  for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    if (!publishes[i].used) {
+      publishes[i].onDone = onDone;
+      publishes[i].context = context;
+      return &publishes[i];
+    }
+  }
+  return nullptr;
+}
+
+bool MqttSession::subscribe(const char* topic, MqttMessageCallback onMessage, void* context) {
+  if (subscriptionCount >= MQTT_MAX_SUBSCRIPTIONS) {
+    return false;
+  }
+  subscriptions[subscriptionCount].topic = topic;
+  subscriptions[subscriptionCount].onMessage = onMessage;
+  subscriptions[subscriptionCount].context = context;
+  subscriptionCount++;
+
+  // Otherwise it goes out with the others once the session opens
+  if (sessionState == MQTT_UP) {
+    sendSubscribe(topic);
+  }
+  return true;
+}
+
+bool MqttSession::sendSubscribe(const char* topic) {
+  char command[AT_COMMAND_MAX];
+  int len = snprintf(command, sizeof(command), "AT+MQTTSUB=\"%s\",1,0", topic);
+  return len > 0 && len < (int)sizeof(command) && modem.send(command, MQTT_SUBSCRIBE_TIMEOUT, onSubscribeDone, this);
+}
+
+bool MqttSession::publish(const char* topic, const char* payload, AtDoneCallback onDone, void* context, bool retain) {
+  char command[AT_COMMAND_MAX];
+  int len = snprintf(command, sizeof(command), "AT+MQTTPUB=\"%s\",\"%s\",0,0,%d", topic, payload, retain ? 1 : 0);
+  if (len < 0 || len >= (int)sizeof(command)) {
+    return false;
+  }
+
+  Publish* slot = acquire(onDone, context);
+  if (slot == nullptr || !modem.send(command, MQTT_PUBLISH_TIMEOUT, onPublishDone, slot)) {
+    return false;
+  }
+  slot->used = true;
+  inflightCount++;
+  return true;
+}
+
+bool MqttSession::publishExternal(const char* command, AtDoneCallback onDone, void* context) {
+  Publish* slot = acquire(onDone, context);
+  if (slot == nullptr || !modem.sendExternal(command, MQTT_PUBLISH_TIMEOUT, onPublishDone, slot)) {
+    return false;
+  }
+  slot->used = true;
+  inflightCount++;
+  return true;
+}
+
+size_t MqttSession::openPublish(char* command, size_t len, const char* topic) {
+  int written = snprintf(command, len, "AT+MQTTPUB=\"%s\",\"", topic);
+  if (written < 0 || (size_t)written >= len) {
+    return 0;
+  }
+  return written;
+}
+
+bool MqttSession::closePublish(char* command, size_t len, size_t pos, bool retain) {
+  if (pos >= len) {
+    return false;
+  }
+  int written = snprintf(command + pos, len - pos, "\",0,0,%d", retain ? 1 : 0);
+  return written >= 0 && (size_t)written < len - pos;
+}
+
+void MqttSession::linkLost() {
+  // Callbacks of publishes dropped with the modem queue will never run
+  for (uint8_t i = 0; i < MQTT_MAX_INFLIGHT; i++) {
+    publishes[i].used = false;
+  }
+  inflightCount = 0;
+  sessionState = MQTT_DOWN;
+  staleSession = false;
+  failures = 0;
+  nextAttemptAt = millis();
+}
+
+bool MqttSession::setBroker(const char* broker, uint16_t port) {
+  if (sessionState == MQTT_CONNECTING || inflightCount > 0) {
+    return false;
+  }
+  this->broker = broker;
+  this->port = port;
+  if (sessionState == MQTT_UP) {
+    staleSession = true;
+  }
+  sessionState = MQTT_DOWN;
+  failures = 0;
+  nextAttemptAt = millis();
+  return true;
+}
+
+void MqttSession::scheduleReconnect() {
+  uint32_t delayMs = MQTT_BACKOFF_MIN;
+  for (uint8_t i = 1; i < failures && delayMs < MQTT_BACKOFF_MAX; i++) {
+    delayMs *= 2;
+  }
+  if (delayMs > MQTT_BACKOFF_MAX) {
+    delayMs = MQTT_BACKOFF_MAX;
+  }
+
+  // Up to 25% jitter so gateways that lost the same cell do not reconnect in lockstep
+  delayMs += random(delayMs / 4 + 1);
+
+  sessionState = MQTT_DOWN;
+  staleSession = true;
+  nextAttemptAt = millis() + delayMs;
+}
+
+void MqttSession::onConnectDone(AtResult result, void* context) {
+  MqttSession* session = static_cast<MqttSession*>(context);
+  if (session->sessionState != MQTT_CONNECTING) {
+    return;  // linkLost() ran while the connect was in flight
+  }
+
+  if (result == AT_RESULT_OK) {
+    session->sessionState = MQTT_UP;
+    session->failures = 0;
+    for (uint8_t i = 0; i < session->subscriptionCount; i++) {
+      session->sendSubscribe(session->subscriptions[i].topic);
+    }
+  } else {
+    if (session->failures < 255) {
+      session->failures++;
+    }
+    session->scheduleReconnect();
+  }
+}
+
+void MqttSession::onPublishDone(AtResult result, void* context) {
+  Publish* slot = static_cast<Publish*>(context);
+  MqttSession* session = slot->session;
+  if (!slot->used) {
+    return;  // Dropped by linkLost()
+  }
+
+  slot->used = false;
+  session->inflightCount--;
+
+  // A failed publish means the session is gone; reconnect after the shortest backoff
+  if (result != AT_RESULT_OK && session->sessionState == MQTT_UP) {
+    session->failures = 1;
+    session->scheduleReconnect();
+  }
+
+  if (slot->onDone != nullptr) {
+    slot->onDone(result, slot->context);
+  }
+}
+
+void MqttSession::onDisconnectedUrc(const char* line, void* context) {
+  MqttSession* session = static_cast<MqttSession*>(context);
+  if (session->sessionState == MQTT_UP) {
+    session->failures = 1;
+    session->scheduleReconnect();
+  }
+}
+
+void MqttSession::onSubscribeDone(AtResult result, void* context) {
+  MqttSession* session = static_cast<MqttSession*>(context);
+
+  // A session without its subscriptions would silently miss messages, so start over
+  if (result != AT_RESULT_OK && session->sessionState == MQTT_UP) {
+    session->failures = 1;
+    session->scheduleReconnect();
+  }
+}
+
+// +MQTTPUBLISH: <packet id>,<topic>,<length>,<payload>; the payload runs to the end of the line
+void MqttSession::onMessageUrc(const char* line, void* context) {
+  MqttSession* session = static_cast<MqttSession*>(context);
+
+  const char* topic = strchr(line, ',');
+  const char* topicEnd = topic ? strchr(topic + 1, ',') : nullptr;
+  const char* payload = topicEnd ? strchr(topicEnd + 1, ',') : nullptr;
+  if (payload == nullptr) {
+    return;
+  }
+  for (topic++; *topic == ' '; topic++) {
+  }
+  for (payload++; *payload == ' '; payload++) {
+  }
+
+  size_t topicLen = topicEnd - topic;
+  for (uint8_t i = 0; i < session->subscriptionCount; i++) {
+    const Subscription& subscription = session->subscriptions[i];
+    if (strlen(subscription.topic) == topicLen && strncmp(subscription.topic, topic, topicLen) == 0) {
+      subscription.onMessage(payload, subscription.context);
+      return;
+    }
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <Arduino.h>
+#include <AtEngine.h>
+
+// Publishes that may be queued on the AT engine at once
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 4
+#endif
+
+// Reconnect delay after the first failure, doubled per consecutive failure up to the maximum
+#define MQTT_BACKOFF_MIN 2000UL    // 2 seconds in milliseconds
+#define MQTT_BACKOFF_MAX 300000UL  // 5 minutes in milliseconds
+
+// Topics that can be subscribed at once
+#ifndef MQTT_MAX_SUBSCRIPTIONS
+#define MQTT_MAX_SUBSCRIPTIONS 2
+#endif
+
+#define MQTT_PUBLISH_SUFFIX_MAX 8 // Room closePublish() needs after the payload, including the NUL
+
+#define MQTT_CONNECT_TIMEOUT 15000
+#define MQTT_PUBLISH_TIMEOUT 10000
+#define MQTT_SUBSCRIBE_TIMEOUT 10000
+
+// Called for a message on a subscribed topic; payload is NUL-terminated and only valid during the call
+typedef void (*MqttMessageCallback)(const char* payload, void* context);
+
+enum MqttState {
+  MQTT_DOWN,       // No session; a connect is attempted once the backoff delay has passed
+  MQTT_CONNECTING, // AT+MQTTCONN in flight
+  MQTT_UP          // Session open, publishes go straight onto it
+};
+
+/* Long-lived MQTT session on the A9G built on AtEngine.
+ * The session is opened once and kept; the A9G sends the keepalive pings
+ * for the interval given to AT+MQTTCONN. A failed publish, a connect error
+ * or the +MQTTDISCONNECTED URC marks the link down, and poll() reconnects
+ * with exponential backoff instead of assuming the link is still there.
+ * Subscriptions are renewed on every connect, and messages arriving in
+ * the +MQTTPUBLISH URC are handed to the callback of their topic.
+ */
+class MqttSession {
+public:
+  MqttSession(AtEngine& modem, const char* broker, uint16_t port, const char* clientId, uint16_t keepAlive);
+
+  // Register URC handlers; call once after the engine is set up
+  void begin();
+
+  // Start connecting or reconnecting when due; call from loop() while the modem is usable
+  void poll();
+
+  // Queue a publish on the open session; false when down or MQTT_MAX_INFLIGHT publishes are queued
+  bool publish(const char* topic, const char* payload, AtDoneCallback onDone = nullptr, void* context = nullptr,
+               bool retain = false);
+
+  // Queue an AT+MQTTPUB built in the caller's buffer with openPublish()/closePublish(), for payloads
+  // larger than an AT engine slot; command must stay untouched until onDone runs
+  bool publishExternal(const char* command, AtDoneCallback onDone = nullptr, void* context = nullptr);
+
+  // Write the command prefix up to the opening quote of the payload; returns its length, 0 if it does not fit
+  static size_t openPublish(char* command, size_t len, const char* topic);
+
+  // Terminate a payload written at command + pos; false if the suffix does not fit
+  static bool closePublish(char* command, size_t len, size_t pos, bool retain = false);
+
+  // Subscribe to topic for the lifetime of the session, including after reconnects; topic must stay valid.
+  // Returns false when MQTT_MAX_SUBSCRIPTIONS topics are already subscribed
+  bool subscribe(const char* topic, MqttMessageCallback onMessage, void* context = nullptr);
+
+  // The modem was reset or lost its bearer: forget the session and reconnect from scratch
+  void linkLost();
+
+  // Move to another broker; broker must stay valid. An open session is closed and the next poll() connects
+  // there. False while a connect or publish is in flight, so no callback of the old session is cut off
+  bool setBroker(const char* broker, uint16_t port);
+
+  MqttState state() const { return sessionState; }
+  bool connected() const { return sessionState == MQTT_UP; }
+  uint8_t inflight() const { return inflightCount; }
+  uint8_t consecutiveFailures() const { return failures; }
+
+private:
+  struct Subscription {
+    const char* topic;
+    MqttMessageCallback onMessage;
+    void* context;
+  };
+
+  struct Publish {
+    MqttSession* session;
+    AtDoneCallback onDone;
+    void* context;
+    bool used;
+  };
+
+  static void onConnectDone(AtResult result, void* context);
+  static void onPublishDone(AtResult result, void* context);
+  static void onDisconnectedUrc(const char* line, void* context);
+  static void onSubscribeDone(AtResult result, void* context);
+  static void onMessageUrc(const char* line, void* context);
+
+  Publish* acquire(AtDoneCallback onDone, void* context);
+  void scheduleReconnect();
+  bool sendSubscribe(const char* topic);
+
+  AtEngine& modem;
+  const char* broker;
+  uint16_t port;
+  const char* clientId;
+  uint16_t keepAlive;
+
+  MqttState sessionState;
+  uint8_t failures;
+  bool staleSession; // The modem may still hold an old session that must be closed first
+  uint32_t nextAttemptAt;
+  Publish publishes[MQTT_MAX_INFLIGHT];
+  uint8_t inflightCount;
+  Subscription subscriptions[MQTT_MAX_SUBSCRIPTIONS];
+  uint8_t subscriptionCount;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "NodeTable.h"
+
+#include <string.h>
+
+NodeTable::NodeTable() {
+  clear();
+}
+
+void NodeTable::clear() {
+  memset(entries, 0, sizeof(entries));
+  memset(slotById, 0, sizeof(slotById));
+  count = 0;
+}
+
+NodeEntry* NodeTable::find(uint8_t nodeId) {
+  uint8_t slot = slotById[nodeId];
+  return slot ? &entries[slot - 1] : nullptr;
+}
+
+uint8_t NodeTable::pendingCount(uint8_t sink) const {
+  uint8_t pending = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (isPending(entries[i], sink)) {
+      pending++;
+    }
+  }
+  return pending;
+}
+
+NodeUpdateResult NodeTable::update(const SensorReading& reading, int16_t rssi, uint32_t now) {
+  NodeEntry* node = find(reading.nodeId);
+
+  if (node == nullptr) {
+    if (count >= NODE_TABLE_CAPACITY) {
+      return NODE_UPDATE_TABLE_FULL;
+    }
+    node = &entries[count++];
+    slotById[reading.nodeId] = count;
+    memset(node, 0, sizeof(*node));
+    node->nodeId = reading.nodeId;
+    node->lastSequence = reading.sequence;
+    node->sequenceWindow = 1;
+  } else {
+    NodeUpdateResult result = acceptSequence(*node, reading, now);
+    if (result == NODE_UPDATE_DUPLICATE) {
+      node->duplicates++;
+      return result;
+    }
+    if (result == NODE_UPDATE_LATE) {
+      node->received++;
+      return result;
+    }
+  }
+
+  node->reading = reading;
+  node->lastSeen = now;
+  node->rssi = rssi;
+  node->pendingSinks = NODE_SINK_ALL;
+  node->received++;
+
+  return NODE_UPDATE_ACCEPTED;
+}
+
+// True when a frame repeats the stored reading field for field, as a retransmit after a lost ACK does
+static bool sameReading(const SensorReading& a, const SensorReading& b) {
+  return a.sequence == b.sequence && a.temperature == b.temperature && a.humidity == b.humidity &&
+         a.pressure == b.pressure && a.flags == b.flags;
+}
+
+NodeUpdateResult NodeTable::acceptSequence(NodeEntry& node, const SensorReading& reading, uint32_t now) {
+  uint8_t sequence = reading.sequence;
+
+  // The node flags its frames after a reset (watchdog, brown-out) until one is acknowledged, so its counter
+  // starting again at 0 does not replay bits of the old window; only a retransmit of the stored frame is
+  // a duplicate. A long silence means the node most likely rebooted too, flag or not
+  bool restarted = (reading.flags & SENSOR_FLAG_RESTARTED) != 0 && !sameReading(reading, node.reading);
+  if (restarted || now - node.lastSeen > NODE_RESTART_TIMEOUT) {
+    node.lastSequence = sequence;
+    node.sequenceWindow = 1;
+    return NODE_UPDATE_ACCEPTED;
+  }
+
+  uint8_t ahead = sequence - node.lastSequence;
+
+  if (ahead == 0) {
+    return NODE_UPDATE_DUPLICATE;
+  }
+
+  // Newer sequence number (modulo 256): slide the window forward, counting the gap as lost
+  if (ahead < 128) {
+    node.lost += ahead - 1;
+    node.sequenceWindow = ahead < NODE_SEQUENCE_WINDOW ? (node.sequenceWindow << ahead) | 1 : 1;
+    node.lastSequence = sequence;
+    return NODE_UPDATE_ACCEPTED;
+  }
+
+  // Older sequence number: count it once if it is still inside the window
+  uint8_t behind = node.lastSequence - sequence;
+  if (behind < NODE_SEQUENCE_WINDOW) {
+    uint32_t bit = 1UL << behind;
+    if (node.sequenceWindow & bit) {
+      return NODE_UPDATE_DUPLICATE;
+    }
+    node.sequenceWindow |= bit;
+    if (node.lost > 0) {
+      node.lost--;  // Counted as lost when the gap opened
+    }
+    return NODE_UPDATE_LATE;
+  }
+
+  // Far outside the window: the node restarted its counter, start a new window
+  node.lastSequence = sequence;
+  node.sequenceWindow = 1;
+  return NODE_UPDATE_ACCEPTED;
+}
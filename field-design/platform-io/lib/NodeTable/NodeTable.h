@@ -0,0 +1,91 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdint.h>
+#include <SensorPacket.h>
+
+// Maximum number of transmitter nodes tracked by one gateway; override with -D NODE_TABLE_CAPACITY=<n>
+#ifndef NODE_TABLE_CAPACITY
+#define NODE_TABLE_CAPACITY 48
+#endif
+
+// Number of past sequence numbers remembered per node for duplicate detection
+#define NODE_SEQUENCE_WINDOW 32
+
+// A node silent for longer than this is assumed to have rebooted, so its sequence restarts; a node that
+// restarts sooner says so with SENSOR_FLAG_RESTARTED
+#define NODE_RESTART_TIMEOUT 600000UL // 10 minutes in milliseconds
+
+// Output sinks that consume node updates independently
+#define NODE_SINK_MQTT 0x01
+#define NODE_SINK_SMS 0x02
+#define NODE_SINK_ALL 0xFF
+
+// Per-node state kept by the gateway
+struct NodeEntry {
+  uint8_t nodeId;
+  uint8_t pendingSinks;    // NODE_SINK_* bits that have not yet sent the latest reading
+  SensorReading reading;   // Latest accepted reading
+  uint32_t lastSeen;       // millis() of the latest accepted reading
+  int16_t rssi;            // RSSI of the latest accepted reading in dBm
+  uint8_t lastSequence;    // Highest sequence number accepted
+  uint32_t sequenceWindow; // Bit n set when lastSequence - n has been received
+  uint16_t received;       // Accepted readings since the node was added
+  uint16_t duplicates;     // Retransmits dropped since the node was added
+  uint16_t lost;           // Sequence numbers never received, net of late arrivals
+};
+
+enum NodeUpdateResult {
+  NODE_UPDATE_ACCEPTED,  // Reading stored and marked pending for every sink
+  NODE_UPDATE_LATE,      // Out-of-order reading older than the stored one, counted but not stored
+  NODE_UPDATE_DUPLICATE, // Sequence number already seen, reading dropped
+  NODE_UPDATE_TABLE_FULL // Unknown node and no free slot, reading dropped
+};
+
+// Fixed-capacity, statically allocated table of transmitter nodes keyed by node id
+class NodeTable {
+public:
+  NodeTable();
+
+  // Store a decoded reading; now is millis() at reception
+  NodeUpdateResult update(const SensorReading& reading, int16_t rssi, uint32_t now);
+
+  // Entry for nodeId, or nullptr when the node has not been heard
+  NodeEntry* find(uint8_t nodeId);
+
+  // Entries are stored densely in the order nodes were first heard
+  uint8_t size() const { return count; }
+  NodeEntry& entry(uint8_t index) { return entries[index]; }
+  const NodeEntry& entry(uint8_t index) const { return entries[index]; }
+
+  // True when the entry holds a reading that sink has not sent yet
+  static bool isPending(const NodeEntry& node, uint8_t sink) { return (node.pendingSinks & sink) != 0; }
+  static void markFlushed(NodeEntry& node, uint8_t sink) { node.pendingSinks &= ~sink; }
+
+  // Clear the pending bit only if no newer reading replaced sequence while the sink was sending
+  static void markFlushed(NodeEntry& node, uint8_t sink, uint8_t sequence) {
+    if (node.reading.sequence == sequence) {
+      markFlushed(node, sink);
+    }
+  }
+
+  // Share of the node's frames that never arrived, in percent
+  static uint8_t lossPercent(const NodeEntry& node) {
+    uint32_t sent = (uint32_t)node.received + node.lost;
+    return sent ? (uint8_t)(node.lost * 100UL / sent) : 0;
+  }
+
+  // Number of entries with a reading pending for sink
+  uint8_t pendingCount(uint8_t sink) const;
+
+  void clear();
+
+private:
+  NodeUpdateResult acceptSequence(NodeEntry& node, const SensorReading& reading, uint32_t now);
+
+  NodeEntry entries[NODE_TABLE_CAPACITY];
+  uint8_t slotById[256]; // Slot + 1 for each node id, 0 when unused
+  uint8_t count;
+};
+
+#endif
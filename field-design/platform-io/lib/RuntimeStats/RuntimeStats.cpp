@@ -0,0 +1,99 @@
+#include "RuntimeStats.h"
+
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_STM32)
+#define DEMCR (*(volatile uint32_t*)0xE000EDFC)      // Debug Exception and Monitor Control
+#define DEMCR_TRCENA (1UL << 24)                      // Powers the DWT unit
+#define DWT_CTRL (*(volatile uint32_t*)0xE0001000)
+#define DWT_CTRL_CYCCNTENA 1UL
+#define DWT_CYCCNT (*(volatile uint32_t*)0xE0001004)
+
+void RuntimeStats::begin() {
+  DEMCR |= DEMCR_TRCENA;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+#else
+#include <chrono>
+
+uint32_t cycleCount() {
+  auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() *
+                    RUNTIME_STATS_CYCLES_PER_US);
+}
+
+void RuntimeStats::begin() {}
+
+#endif
+
+// Two-letter span names in the order of StatsSpan
+static const char* const SPAN_NAMES[SPAN_COUNT] = {"RA", "PA", "AT", "PU"};
+
+RuntimeStats::RuntimeStats() : lastPassAt(0), passSeen(false), lowWater(SIZE_MAX) {
+  for (uint8_t i = 0; i < STAT_COUNT; i++) {
+    counters[i] = 0;
+  }
+  resetWindow();
+}
+
+void RuntimeStats::record(StatsSpan span, uint32_t cycles) {
+  SpanStats& stats = spans[span];
+  stats.count++;
+  stats.total += cycles;
+  if (cycles > stats.max) {
+    stats.max = cycles;
+  }
+}
+
+void RuntimeStats::loopPass(uint32_t now) {
+  if (passSeen) {
+    uint32_t micros = cyclesToMicros(now - lastPassAt);
+    uint32_t limit = RUNTIME_STATS_BUCKET_BASE;
+    uint8_t index = 0;
+    while (index < RUNTIME_STATS_BUCKETS - 1 && micros >= limit) {
+      limit <<= 2;
+      index++;
+    }
+    buckets[index]++;
+  }
+  lastPassAt = now;
+  passSeen = true;
+}
+
+void RuntimeStats::sampleHeap(size_t freeBytes) {
+  if (freeBytes < lowWater) {
+    lowWater = freeBytes;
+  }
+}
+
+void RuntimeStats::resetWindow() {
+  memset(spans, 0, sizeof(spans));
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void RuntimeStats::format(StringBuilder& text) const {
+  text.append("RX:").appendUnsigned(counters[STAT_RECEIVED]);
+  text.append(",DR:").appendUnsigned(counters[STAT_DROPPED]);
+  text.append(",CRC:").appendUnsigned(counters[STAT_CRC_FAILED]);
+  text.append(",DU:").appendUnsigned(counters[STAT_DUPLICATE]);
+  text.append(",HL:").appendUnsigned(lowWater == SIZE_MAX ? 0 : (uint32_t)lowWater);
+  text.append(",HO:").appendUnsigned(counters[STAT_HEAP_OPERATIONS]);
+
+  for (uint8_t i = 0; i < SPAN_COUNT; i++) {
+    const SpanStats& stats = spans[i];
+    uint32_t mean = stats.count ? (uint32_t)(stats.total / stats.count) : 0;
+    text.append(',').append(SPAN_NAMES[i]).append(':').appendUnsigned(stats.count);
+    text.append('/').appendUnsigned(cyclesToMicros(mean));
+    text.append('/').appendUnsigned(cyclesToMicros(stats.max));
+  }
+
+  text.append(",LH:");
+  for (uint8_t i = 0; i < RUNTIME_STATS_BUCKETS; i++) {
+    if (i > 0) {
+      text.append('/');
+    }
+    text.appendUnsigned(buckets[i]);
+  }
+}
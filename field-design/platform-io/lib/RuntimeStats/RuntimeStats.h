@@ -0,0 +1,99 @@
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <StringBuilder.h>
+
+// Core clock in cycles per microsecond, 72 on the BluePill; spans are reported in microseconds
+#ifndef RUNTIME_STATS_CYCLES_PER_US
+#define RUNTIME_STATS_CYCLES_PER_US 72
+#endif
+
+// Loop latency histogram: bucket n counts passes shorter than RUNTIME_STATS_BUCKET_BASE << (2 * n) microseconds,
+// the last bucket everything longer (16 us, 64 us, 256 us, ~1 ms, ~4 ms, ~16 ms, ~65 ms, more)
+#define RUNTIME_STATS_BUCKETS 8
+#define RUNTIME_STATS_BUCKET_BASE 16
+
+// Code paths timed with the cycle counter
+enum StatsSpan {
+  SPAN_RADIO_RX, // GDO0 interrupt: FIFO read, ring commit and ACK
+  SPAN_PARSE,    // Decoding one queued frame into the node table
+  SPAN_AT,       // One AtEngine::poll(), including the callbacks it runs
+  SPAN_PUBLISH,  // Building and queuing one report message
+  SPAN_COUNT
+};
+
+// Event counters, kept since boot
+enum StatsCounter {
+  STAT_RECEIVED,   // Frames queued in rxRing
+  STAT_DROPPED,    // Frames read from the radio but dropped because rxRing was full
+  STAT_CRC_FAILED, // Frames RadioHead rejected (rxBad()); the CC1101 flushes failed CRCs before they interrupt
+  STAT_DUPLICATE,  // Retransmissions dropped by the node table
+  STAT_HEAP_OPERATIONS, // Heap operations since the steady-state mark (heapOperationsSinceMark()), set by the owner
+  STAT_COUNT
+};
+
+// Calls of one span over the current window, in cycles
+struct SpanStats {
+  uint32_t count;
+  uint64_t total;
+  uint32_t max;
+};
+
+#if defined(ARDUINO_ARCH_STM32)
+// Cortex-M3 DWT cycle counter; it wraps every ~60 s at 72 MHz, far longer than any span
+inline uint32_t cycleCount() { return *(volatile uint32_t*)0xE0001004; }
+#else
+// Host builds count RUNTIME_STATS_CYCLES_PER_US cycles per microsecond of the steady clock
+uint32_t cycleCount();
+#endif
+
+/* Runtime metrics of a gateway, cheap enough to collect in the radio interrupt.
+ * Spans and the loop latency histogram cover a window cleared by
+ * resetWindow() each time the stats are reported; the counters and the heap
+ * low-water mark run since boot. Nothing here allocates or blocks.
+ */
+class RuntimeStats {
+public:
+  RuntimeStats();
+
+  // Start the DWT cycle counter; call once at boot
+  static void begin();
+
+  // Add one call of span that took cycles, counted from cycleCount() at its start
+  void record(StatsSpan span, uint32_t cycles);
+
+  void count(StatsCounter counter) { counters[counter]++; }
+  void set(StatsCounter counter, uint32_t value) { counters[counter] = value; }
+  uint32_t counter(StatsCounter counter) const { return counters[counter]; }
+
+  const SpanStats& span(StatsSpan span) const { return spans[span]; }
+
+  // Call at the top of every loop() pass; the time since the previous pass goes into the histogram
+  void loopPass(uint32_t now);
+  uint32_t bucket(uint8_t index) const { return buckets[index]; }
+
+  // Fold in the free memory now; the smallest value seen since boot is the low-water mark
+  void sampleHeap(size_t freeBytes);
+  size_t heapLowWater() const { return lowWater; }
+
+  // Clear the spans and the histogram for the next window
+  void resetWindow();
+
+  // Append "RX:<n>,DR:<n>,CRC:<n>,DU:<n>,HL:<bytes>,HO:<n>,RA:<calls>/<mean>/<max>,PA:..,AT:..,PU:..,LH:<b0>/../<b7>",
+  // span times in microseconds
+  void format(StringBuilder& text) const;
+
+  static uint32_t cyclesToMicros(uint32_t cycles) { return cycles / RUNTIME_STATS_CYCLES_PER_US; }
+
+private:
+  SpanStats spans[SPAN_COUNT];
+  volatile uint32_t counters[STAT_COUNT];
+  uint32_t buckets[RUNTIME_STATS_BUCKETS];
+  uint32_t lastPassAt;
+  bool passSeen;
+  size_t lowWater;
+};
+
+#endif
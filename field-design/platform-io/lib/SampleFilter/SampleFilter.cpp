@@ -0,0 +1,80 @@
+#include "SampleFilter.h"
+
+ChannelFilter::ChannelFilter() {
+  reset();
+}
+
+void ChannelFilter::reset() {
+  historyCount = 0;
+  historyNext = 0;
+  ema = 0;
+  startWindow();
+}
+
+void ChannelFilter::startWindow() {
+  windowMin = 0;
+  windowMax = 0;
+  windowSum = 0;
+  windowCount = 0;
+}
+
+int32_t ChannelFilter::median() const {
+  // Insertion sort of at most FILTER_MEDIAN_TAPS values
+  int32_t sorted[FILTER_MEDIAN_TAPS];
+  for (uint8_t i = 0; i < historyCount; i++) {
+    int32_t value = history[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+
+  // With an even count there is no majority yet, so trust the newest sample
+  if ((historyCount & 1) == 0) {
+    return history[(historyNext + FILTER_MEDIAN_TAPS - 1) % FILTER_MEDIAN_TAPS];
+  }
+  return sorted[historyCount / 2];
+}
+
+void ChannelFilter::add(int32_t sample) {
+  bool primed = historyCount > 0;
+
+  history[historyNext] = sample;
+  historyNext = (historyNext + 1) % FILTER_MEDIAN_TAPS;
+  if (historyCount < FILTER_MEDIAN_TAPS) {
+    historyCount++;
+  }
+
+  int64_t scaled = (int64_t)median() * (1 << FILTER_EMA_FRACTION_BITS);
+  if (primed) {
+    ema += (scaled - ema) / (1 << FILTER_EMA_SHIFT);
+  } else {
+    ema = scaled;
+  }
+
+  // Round half away from zero back to frame units
+  int64_t half = 1 << (FILTER_EMA_FRACTION_BITS - 1);
+  int32_t output = (int32_t)((ema >= 0 ? ema + half : ema - half) / (1 << FILTER_EMA_FRACTION_BITS));
+
+  if (windowCount == UINT8_MAX) {
+    return;  // Window full; the filter keeps tracking but the summary is closed
+  }
+  if (windowCount == 0 || output < windowMin) {
+    windowMin = output;
+  }
+  if (windowCount == 0 || output > windowMax) {
+    windowMax = output;
+  }
+  windowSum += output;
+  windowCount++;
+}
+
+int32_t ChannelFilter::mean() const {
+  if (windowCount == 0) {
+    return 0;
+  }
+  int64_t half = windowCount / 2;
+  return (int32_t)((windowSum >= 0 ? windowSum + half : windowSum - half) / windowCount);
+}
@@ -0,0 +1,55 @@
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <stdint.h>
+
+// Samples in the sliding median; a single spike among them never reaches the output
+#define FILTER_MEDIAN_TAPS 3
+
+// EMA weight of a new sample is 1 / 2^FILTER_EMA_SHIFT; override with -D FILTER_EMA_SHIFT=<n>
+#ifndef FILTER_EMA_SHIFT
+#define FILTER_EMA_SHIFT 1
+#endif
+
+// Extra fractional bits kept in the EMA state so small steps are not lost to truncation
+#define FILTER_EMA_FRACTION_BITS 8
+
+/* Fixed-point filter for one sensor channel, in the channel's frame units.
+ * Each valid sample goes through a median of the last FILTER_MEDIAN_TAPS
+ * samples (outlier rejection) and then an exponential moving average; the
+ * filtered values are summarised as min/mean/max over the current window.
+ * The median history and the EMA carry over from one window to the next.
+ */
+class ChannelFilter {
+public:
+  ChannelFilter();
+
+  // Feed one valid sample; failed reads are simply not added
+  void add(int32_t sample);
+
+  // Start a new summary window, keeping the filter state
+  void startWindow();
+
+  // Forget the filter state, e.g. after the sensor failed and recovered
+  void reset();
+
+  // Number of samples in the current window; the statistics are only valid when non-zero
+  uint8_t count() const { return windowCount; }
+  int32_t minimum() const { return windowMin; }
+  int32_t maximum() const { return windowMax; }
+  int32_t mean() const;
+
+private:
+  int32_t median() const;
+
+  int32_t history[FILTER_MEDIAN_TAPS];
+  uint8_t historyCount;
+  uint8_t historyNext;
+  int64_t ema;          // Filter output scaled by 2^FILTER_EMA_FRACTION_BITS, wide enough for 24-bit pressure
+  int32_t windowMin;
+  int32_t windowMax;
+  int64_t windowSum;
+  uint8_t windowCount;
+};
+
+#endif
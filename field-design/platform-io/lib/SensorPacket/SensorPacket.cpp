@@ -0,0 +1,249 @@
+#include "SensorPacket.h"
+
+#define SENSOR_HEADER_BYTE ((SENSOR_PACKET_VERSION << 4) | SENSOR_FRAME_READING)
+#define SENSOR_SUMMARY_HEADER_BYTE ((SENSOR_PACKET_VERSION << 4) | SENSOR_FRAME_SUMMARY)
+#define SENSOR_BEACON_HEADER_BYTE ((SENSOR_PACKET_VERSION << 4) | SENSOR_FRAME_BEACON)
+#define SENSOR_COMMAND_HEADER_BYTE ((SENSOR_PACKET_VERSION << 4) | SENSOR_FRAME_COMMAND)
+#define SENSOR_RESULT_HEADER_BYTE ((SENSOR_PACKET_VERSION << 4) | SENSOR_FRAME_RESULT)
+
+static void writeU16(uint8_t* p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = value >> 8;
+}
+
+static void writeU24(uint8_t* p, uint32_t value) {
+  if (value > SENSOR_PRESSURE_MAX) {
+    value = SENSOR_PRESSURE_MAX;
+  }
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static uint16_t readU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readU24(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return readU24(p) | ((uint32_t)p[3] << 24);
+}
+
+size_t encodeSensorReading(const SensorReading& reading, uint8_t* buf, size_t len) {
+  if (len < SENSOR_READING_FRAME_LEN) {
+    return 0;
+  }
+
+  uint16_t temperature = (uint16_t)reading.temperature;
+  uint32_t pressure = reading.pressure > SENSOR_PRESSURE_MAX ? SENSOR_PRESSURE_MAX : reading.pressure;
+
+  buf[0] = SENSOR_HEADER_BYTE;
+  buf[1] = reading.nodeId;
+  buf[2] = reading.sequence;
+  buf[3] = temperature & 0xFF;
+  buf[4] = temperature >> 8;
+  buf[5] = reading.humidity & 0xFF;
+  buf[6] = reading.humidity >> 8;
+  buf[7] = pressure & 0xFF;
+  buf[8] = (pressure >> 8) & 0xFF;
+  buf[9] = (pressure >> 16) & 0xFF;
+  buf[10] = reading.flags;
+
+  return SENSOR_READING_FRAME_LEN;
+}
+
+bool decodeSensorReading(const uint8_t* buf, size_t len, SensorReading& reading) {
+  SensorSummary summary;
+  if (decodeSensorSummary(buf, len, summary)) {
+    reading = summary.reading;
+    return true;
+  }
+
+  if (len < SENSOR_READING_FRAME_LEN || buf[0] != SENSOR_HEADER_BYTE) {
+    return false;
+  }
+
+  reading.nodeId = buf[1];
+  reading.sequence = buf[2];
+  reading.temperature = (int16_t)(buf[3] | (buf[4] << 8));
+  reading.humidity = (uint16_t)(buf[5] | (buf[6] << 8));
+  reading.pressure = (uint32_t)buf[7] | ((uint32_t)buf[8] << 8) | ((uint32_t)buf[9] << 16);
+  reading.flags = buf[10];
+
+  return true;
+}
+
+size_t encodeSensorSummary(const SensorSummary& summary, uint8_t* buf, size_t len) {
+  if (len < SENSOR_SUMMARY_FRAME_LEN) {
+    return 0;
+  }
+
+  const SensorReading& mean = summary.reading;
+  buf[0] = SENSOR_SUMMARY_HEADER_BYTE;
+  buf[1] = mean.nodeId;
+  buf[2] = mean.sequence;
+  buf[3] = mean.flags;
+  buf[4] = summary.samples;
+  writeU16(buf + 5, (uint16_t)summary.temperatureMin);
+  writeU16(buf + 7, (uint16_t)mean.temperature);
+  writeU16(buf + 9, (uint16_t)summary.temperatureMax);
+  writeU16(buf + 11, summary.humidityMin);
+  writeU16(buf + 13, mean.humidity);
+  writeU16(buf + 15, summary.humidityMax);
+  writeU24(buf + 17, summary.pressureMin);
+  writeU24(buf + 20, mean.pressure);
+  writeU24(buf + 23, summary.pressureMax);
+
+  return SENSOR_SUMMARY_FRAME_LEN;
+}
+
+bool decodeSensorSummary(const uint8_t* buf, size_t len, SensorSummary& summary) {
+  if (len < SENSOR_SUMMARY_FRAME_LEN || buf[0] != SENSOR_SUMMARY_HEADER_BYTE) {
+    return false;
+  }
+
+  SensorReading& mean = summary.reading;
+  mean.nodeId = buf[1];
+  mean.sequence = buf[2];
+  mean.flags = buf[3];
+  summary.samples = buf[4];
+  summary.temperatureMin = (int16_t)readU16(buf + 5);
+  mean.temperature = (int16_t)readU16(buf + 7);
+  summary.temperatureMax = (int16_t)readU16(buf + 9);
+  summary.humidityMin = readU16(buf + 11);
+  mean.humidity = readU16(buf + 13);
+  summary.humidityMax = readU16(buf + 15);
+  summary.pressureMin = readU24(buf + 17);
+  mean.pressure = readU24(buf + 20);
+  summary.pressureMax = readU24(buf + 23);
+
+  return true;
+}
+
+size_t encodeSensorBeacon(const SensorBeacon& beacon, uint8_t* buf, size_t len) {
+  if (len < SENSOR_BEACON_FRAME_LEN) {
+    return 0;
+  }
+
+  buf[0] = SENSOR_BEACON_HEADER_BYTE;
+  writeU32(buf + 1, beacon.superframe);
+  buf[5] = beacon.slotCount;
+  writeU16(buf + 6, beacon.slotLength);
+  writeU32(buf + 8, beacon.interval);
+
+  return SENSOR_BEACON_FRAME_LEN;
+}
+
+bool decodeSensorBeacon(const uint8_t* buf, size_t len, SensorBeacon& beacon) {
+  if (len < SENSOR_BEACON_FRAME_LEN || buf[0] != SENSOR_BEACON_HEADER_BYTE) {
+    return false;
+  }
+
+  beacon.superframe = readU32(buf + 1);
+  beacon.slotCount = buf[5];
+  beacon.slotLength = readU16(buf + 6);
+  beacon.interval = readU32(buf + 8);
+
+  return true;
+}
+
+size_t formatFixedPoint(char* buf, size_t len, int32_t value, uint8_t decimals) {
+  char digits[12];
+  size_t count = 0;
+  size_t pos = 0;
+
+  if (decimals > 9) {
+    decimals = 9;
+  }
+
+  // Work on the magnitude so values between -1 and 0 keep their sign
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0 || count <= decimals);
+
+  if (len == 0) {
+    return 0;
+  }
+
+  if (value < 0 && pos + 1 < len) {
+    buf[pos++] = '-';
+  }
+  while (count > 0 && pos + 1 < len) {
+    if (count == decimals) {
+      buf[pos++] = '.';
+      if (pos + 1 >= len) {
+        break;
+      }
+    }
+    buf[pos++] = digits[--count];
+  }
+  buf[pos] = '\0';
+
+  return pos;
+}
+
+size_t encodeSensorCommand(const SensorCommand& command, uint8_t* buf, size_t len) {
+  if (len < SENSOR_COMMAND_FRAME_LEN) {
+    return 0;
+  }
+
+  buf[0] = SENSOR_COMMAND_HEADER_BYTE;
+  buf[1] = command.nodeId;
+  buf[2] = command.sequence;
+  buf[3] = command.code;
+  writeU32(buf + 4, (uint32_t)command.value);
+
+  return SENSOR_COMMAND_FRAME_LEN;
+}
+
+bool decodeSensorCommand(const uint8_t* buf, size_t len, SensorCommand& command) {
+  if (len < SENSOR_COMMAND_FRAME_LEN || buf[0] != SENSOR_COMMAND_HEADER_BYTE) {
+    return false;
+  }
+
+  command.nodeId = buf[1];
+  command.sequence = buf[2];
+  command.code = buf[3];
+  command.value = (int32_t)readU32(buf + 4);
+
+  return true;
+}
+
+size_t encodeSensorCommandResult(const SensorCommandResult& result, uint8_t* buf, size_t len) {
+  if (len < SENSOR_RESULT_FRAME_LEN) {
+    return 0;
+  }
+
+  buf[0] = SENSOR_RESULT_HEADER_BYTE;
+  buf[1] = result.nodeId;
+  buf[2] = result.sequence;
+  buf[3] = result.code;
+  buf[4] = result.result;
+
+  return SENSOR_RESULT_FRAME_LEN;
+}
+
+bool decodeSensorCommandResult(const uint8_t* buf, size_t len, SensorCommandResult& result) {
+  if (len < SENSOR_RESULT_FRAME_LEN || buf[0] != SENSOR_RESULT_HEADER_BYTE) {
+    return false;
+  }
+
+  result.nodeId = buf[1];
+  result.sequence = buf[2];
+  result.code = buf[3];
+  result.result = buf[4];
+
+  return true;
+}
@@ -0,0 +1,188 @@
+#ifndef SENSOR_PACKET_H
+#define SENSOR_PACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CC1101 Sensor Frame Layout (little-endian):
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Version (high nibble) and frame type (low nibble)
+ * 1      | 1    | Node id
+ * 2      | 1    | Sequence number (wraps at 255)
+ * 3      | 2    | Temperature, int16 centi-degrees Celsius
+ * 5      | 2    | Humidity, uint16 centi-%RH
+ * 7      | 3    | Pressure, uint24 deci-Pascal
+ * 10     | 1    | Flags (SENSOR_FLAG_*)
+ */
+
+/* CC1101 Summary Frame Layout (little-endian), one filtered window of samples:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Version (high nibble) and frame type (low nibble)
+ * 1      | 1    | Node id
+ * 2      | 1    | Sequence number (wraps at 255)
+ * 3      | 1    | Flags (SENSOR_FLAG_*)
+ * 4      | 1    | Samples taken in the window
+ * 5      | 6    | Temperature min, mean, max, int16 centi-degrees Celsius
+ * 11     | 6    | Humidity min, mean, max, uint16 centi-%RH
+ * 17     | 9    | Pressure min, mean, max, uint24 deci-Pascal
+ */
+
+/* CC1101 Beacon Frame Layout (little-endian), broadcast by the gateway once per superframe:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Version (high nibble) and frame type (low nibble)
+ * 1      | 4    | Superframe number, counts beacons since the gateway started
+ * 5      | 1    | Node slots per superframe
+ * 6      | 2    | Slot length in milliseconds
+ * 8      | 4    | Superframe length (beacon interval) in milliseconds
+ * The end of the beacon marks the start of the superframe; slot n starts
+ * (n + 1) slot lengths later, slot 0 being left to the beacon itself.
+ */
+
+/* CC1101 Command Frame Layout (little-endian), sent by the gateway as the payload of its ACK:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Version (high nibble) and frame type (low nibble)
+ * 1      | 1    | Node id
+ * 2      | 1    | Command sequence number, repeated until the node's result arrives
+ * 3      | 1    | Command code (SENSOR_COMMAND_*)
+ * 4      | 4    | Value, int32
+ */
+
+/* CC1101 Command Result Frame Layout, sent by the node once per command received:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 1    | Version (high nibble) and frame type (low nibble)
+ * 1      | 1    | Node id
+ * 2      | 1    | Command sequence number
+ * 3      | 1    | Command code
+ * 4      | 1    | Result (SENSOR_RESULT_*)
+ */
+
+#define SENSOR_PACKET_VERSION 1
+#define SENSOR_FRAME_READING 0x1
+#define SENSOR_FRAME_SUMMARY 0x2
+#define SENSOR_FRAME_BEACON 0x3
+#define SENSOR_FRAME_COMMAND 0x4
+#define SENSOR_FRAME_RESULT 0x5
+
+#define SENSOR_READING_FRAME_LEN 11
+#define SENSOR_SUMMARY_FRAME_LEN 26
+#define SENSOR_BEACON_FRAME_LEN 12
+#define SENSOR_COMMAND_FRAME_LEN 8
+#define SENSOR_RESULT_FRAME_LEN 5
+
+/* Command Codes:
+ * Code | Name      | Value
+ * -----|-----------|----------------------------------------------
+ * 1    | INTERVAL  | Reading interval in milliseconds
+ * 2    | HEARTBEAT | Longest silence between transmissions in milliseconds
+ * 3    | TDEADBAND | Temperature deadband, centi-degrees Celsius
+ * 4    | HDEADBAND | Humidity deadband, centi-%RH
+ * 5    | PDEADBAND | Pressure deadband, deci-Pascal
+ * 6    | THRESHOLD | Soil moisture below which irrigation starts, centi-%
+ * 7    | VALVE     | Open the valve for this many seconds, 0 closes it
+ * A node answers SENSOR_RESULT_UNSUPPORTED for codes it has no use for.
+ */
+#define SENSOR_COMMAND_INTERVAL 1
+#define SENSOR_COMMAND_HEARTBEAT 2
+#define SENSOR_COMMAND_TEMPERATURE_DEADBAND 3
+#define SENSOR_COMMAND_HUMIDITY_DEADBAND 4
+#define SENSOR_COMMAND_PRESSURE_DEADBAND 5
+#define SENSOR_COMMAND_MOISTURE_THRESHOLD 6
+#define SENSOR_COMMAND_VALVE 7
+
+#define SENSOR_RESULT_OK 0
+#define SENSOR_RESULT_UNSUPPORTED 1  // The node has no such setting or actuator
+#define SENSOR_RESULT_OUT_OF_RANGE 2 // Value rejected, the setting is unchanged
+
+// Flag bits carried in the last byte of a reading frame
+#define SENSOR_FLAG_TH_INVALID 0x01       // AHT20 read failed, temperature and humidity are not valid
+#define SENSOR_FLAG_PRESSURE_INVALID 0x02 // BMP280 read failed, pressure is not valid
+#define SENSOR_FLAG_RESTARTED 0x04        // Node started since its last acknowledged frame; its sequence began again at 0
+
+#define SENSOR_PRESSURE_MAX 0xFFFFFFUL // Largest deci-Pascal value that fits in 24 bits
+
+// RadioHead address of the gateway; a node uses its node id as its address
+#define SENSOR_GATEWAY_ADDRESS 0x00
+
+// One decoded sensor reading in fixed-point units
+struct SensorReading {
+  uint8_t nodeId;
+  uint8_t sequence;
+  int16_t temperature; // centi-degrees Celsius
+  uint16_t humidity;   // centi-%RH
+  uint32_t pressure;   // deci-Pascal
+  uint8_t flags;
+};
+
+// One window of filtered samples; reading holds the means
+struct SensorSummary {
+  SensorReading reading;
+  uint8_t samples;
+  int16_t temperatureMin, temperatureMax;
+  uint16_t humidityMin, humidityMax;
+  uint32_t pressureMin, pressureMax;
+};
+
+// Gateway time base for slotted transmission
+struct SensorBeacon {
+  uint32_t superframe;
+  uint8_t slotCount;
+  uint16_t slotLength; // milliseconds
+  uint32_t interval;   // milliseconds
+};
+
+// Downlink command for one node
+struct SensorCommand {
+  uint8_t nodeId;
+  uint8_t sequence;
+  uint8_t code;  // SENSOR_COMMAND_*
+  int32_t value;
+};
+
+// A node's answer to a command
+struct SensorCommandResult {
+  uint8_t nodeId;
+  uint8_t sequence;
+  uint8_t code;
+  uint8_t result; // SENSOR_RESULT_*
+};
+
+// Encode a reading into buf; returns the frame length, or 0 if buf is too small
+size_t encodeSensorReading(const SensorReading& reading, uint8_t* buf, size_t len);
+
+// Decode a reading or summary frame into reading (the window means for a summary);
+// returns false on a short frame or unknown version/type
+bool decodeSensorReading(const uint8_t* buf, size_t len, SensorReading& reading);
+
+// Encode a summary into buf; returns the frame length, or 0 if buf is too small
+size_t encodeSensorSummary(const SensorSummary& summary, uint8_t* buf, size_t len);
+
+// Decode a summary frame; returns false on a short frame or any other version/type
+bool decodeSensorSummary(const uint8_t* buf, size_t len, SensorSummary& summary);
+
+// Write value / 10^decimals as text (e.g. -50, 2 -> "-0.50"); returns chars written excluding NUL
+size_t formatFixedPoint(char* buf, size_t len, int32_t value, uint8_t decimals);
+
+// Encode a beacon into buf; returns the frame length, or 0 if buf is too small
+size_t encodeSensorBeacon(const SensorBeacon& beacon, uint8_t* buf, size_t len);
+
+// Decode a beacon frame; returns false on a short frame or any other version/type
+bool decodeSensorBeacon(const uint8_t* buf, size_t len, SensorBeacon& beacon);
+
+// Encode a command into buf; returns the frame length, or 0 if buf is too small
+size_t encodeSensorCommand(const SensorCommand& command, uint8_t* buf, size_t len);
+
+// Decode a command frame; returns false on a short frame or any other version/type
+bool decodeSensorCommand(const uint8_t* buf, size_t len, SensorCommand& command);
+
+// Encode a command result into buf; returns the frame length, or 0 if buf is too small
+size_t encodeSensorCommandResult(const SensorCommandResult& result, uint8_t* buf, size_t len);
+
+// Decode a command result frame; returns false on a short frame or any other version/type
+bool decodeSensorCommandResult(const uint8_t* buf, size_t len, SensorCommandResult& result);
+
+#endif
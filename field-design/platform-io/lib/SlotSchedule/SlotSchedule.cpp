@@ -0,0 +1,74 @@
+#include "SlotSchedule.h"
+
+// Times are compared as signed differences so the node clock may wrap
+static bool before(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) < 0;
+}
+
+SlotSchedule::SlotSchedule(uint8_t nodeId)
+    : nodeId(nodeId), heard(false), lastBeacon(0), interval(0), slotLength(0), slotCount(0) {}
+
+void SlotSchedule::beaconHeard(const SensorBeacon& beacon, uint32_t at) {
+  // A beacon that leaves no room for this node's slot is useless for scheduling
+  if (beacon.slotCount == 0 || beacon.interval < (uint32_t)(beacon.slotCount + 1) * beacon.slotLength) {
+    return;
+  }
+  heard = true;
+  lastBeacon = at;
+  interval = beacon.interval;
+  slotLength = beacon.slotLength;
+  slotCount = beacon.slotCount;
+}
+
+bool SlotSchedule::synced(uint32_t now) const {
+  return heard && now - lastBeacon <= TDMA_SYNC_TIMEOUT;
+}
+
+uint32_t SlotSchedule::window(uint32_t at) const {
+  return TDMA_GUARD + (at - lastBeacon) / 1000 * TDMA_DRIFT_PPM / 1000;
+}
+
+uint32_t SlotSchedule::listenLength(uint32_t at) const {
+  return 2 * window(at) + airtime(SENSOR_BEACON_FRAME_LEN);
+}
+
+uint32_t SlotSchedule::listenAt(uint32_t now) const {
+  if (!heard) {
+    return now;
+  }
+
+  // Beacons are expected at lastBeacon + k * interval, k >= 1; listening starts one window plus the beacon's airtime early
+  uint32_t k = (now - lastBeacon) / interval + 1;
+  for (;; k++) {
+    uint32_t expected = lastBeacon + k * interval;
+    uint32_t start = expected - window(expected) - airtime(SENSOR_BEACON_FRAME_LEN);
+    if (!before(start, now)) {
+      return start;
+    }
+  }
+}
+
+uint32_t SlotSchedule::slotAt(uint32_t now) const {
+  if (!heard) {
+    return now;
+  }
+
+  uint32_t offset = (uint32_t)(slot() + 1) * slotLength;
+  uint32_t k = before(lastBeacon + offset, now) ? (now - lastBeacon - offset) / interval : 0;
+  for (;; k++) {
+    uint32_t start = lastBeacon + k * interval + offset;
+    uint32_t transmit = start + window(start);
+    if (!before(transmit, now)) {
+      return transmit;
+    }
+  }
+}
+
+bool SlotSchedule::fits(uint32_t duration, uint32_t at) const {
+  return duration + 2 * window(at) <= slotLength;
+}
+
+uint32_t SlotSchedule::airtime(uint8_t payloadLen, uint32_t bitrate) {
+  // Rounded up, so a fast rate never reports a frame as taking no time
+  return (((uint32_t)payloadLen + RADIO_FRAME_OVERHEAD) * 8 * 1000 + bitrate - 1) / bitrate;
+}
@@ -0,0 +1,76 @@
+#ifndef SLOT_SCHEDULE_H
+#define SLOT_SCHEDULE_H
+
+#include <stdint.h>
+#include <SensorPacket.h>
+
+// Timing slack in milliseconds kept on both sides of the beacon and at the start of the slot
+#ifndef TDMA_GUARD
+#define TDMA_GUARD 20
+#endif
+
+// Worst-case combined clock error of node and gateway, widens the slack the longer a node goes without a beacon
+#ifndef TDMA_DRIFT_PPM
+#define TDMA_DRIFT_PPM 100
+#endif
+
+// A schedule not refreshed by a beacon for this long is dropped and the node falls back to listen-before-talk
+#ifndef TDMA_SYNC_TIMEOUT
+#define TDMA_SYNC_TIMEOUT 900000UL // 15 minutes in milliseconds
+#endif
+
+// On-air rate of the RadioHead default modem configuration (GFSK_Rb1_2Fd5_2)
+#ifndef RADIO_BITRATE
+#define RADIO_BITRATE 1200
+#endif
+
+// Bytes sent around every payload: preamble, sync word, length, RadioHead header and CRC
+#define RADIO_FRAME_OVERHEAD 15
+
+/* Node side of the slotted (TDMA) schedule set by the gateway beacon.
+ * Times are node-local milliseconds from a clock that keeps running while
+ * the node sleeps. The beacon arrival marks the start of a superframe; the
+ * node owns slot nodeId % slotCount and transmits one guard window into
+ * it. The window grows with the drift since the last beacon, so the node
+ * only has to listen for a beacon before it has something to send.
+ */
+class SlotSchedule {
+public:
+  explicit SlotSchedule(uint8_t nodeId);
+
+  // Adopt the time base of a beacon received at local time at
+  void beaconHeard(const SensorBeacon& beacon, uint32_t at);
+
+  // True while the last beacon is recent enough to trust
+  bool synced(uint32_t now) const;
+
+  // Timing uncertainty at time at: guard plus the worst-case drift since the last beacon
+  uint32_t window(uint32_t at) const;
+
+  // When to turn the receiver on for the next beacon it can still catch after now, and for how long
+  uint32_t listenAt(uint32_t now) const;
+  uint32_t listenLength(uint32_t at) const;
+
+  // Start of the next transmission inside the node's slot, at or after now
+  uint32_t slotAt(uint32_t now) const;
+
+  // True when duration ms of radio traffic (a frame and its ACK) still fit in the slot, with the drift accumulated by at
+  bool fits(uint32_t duration, uint32_t at) const;
+
+  uint8_t slot() const { return slotCount ? nodeId % slotCount : 0; }
+  uint32_t lastBeaconAt() const { return lastBeacon; }
+
+  // Milliseconds on air for a frame with payloadLen bytes, at the default rate or at bitrate
+  static uint32_t airtime(uint8_t payloadLen) { return airtime(payloadLen, RADIO_BITRATE); }
+  static uint32_t airtime(uint8_t payloadLen, uint32_t bitrate);
+
+private:
+  uint8_t nodeId;
+  bool heard;
+  uint32_t lastBeacon;
+  uint32_t interval;
+  uint16_t slotLength;
+  uint8_t slotCount;
+};
+
+#endif
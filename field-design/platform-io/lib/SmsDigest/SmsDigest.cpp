@@ -0,0 +1,197 @@
+#include "SmsDigest.h"
+
+#include <string.h>
+
+// Two-letter codes of the SMS_ALARM_* bits, lowest bit first
+static const char* const ALARM_CODES[] = {"TH", "TL", "HH", "HL", "SF"};
+#define ALARM_CODE_COUNT (sizeof(ALARM_CODES) / sizeof(ALARM_CODES[0]))
+
+// value / divisor rounded half away from zero
+static int32_t roundDiv(int64_t value, int64_t divisor) {
+  return (int32_t)(value >= 0 ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor);
+}
+
+// Set bit when raise holds, clear it when clear holds, otherwise keep it as it was
+static uint8_t latch(uint8_t active, uint8_t bit, bool raise, bool clear) {
+  if (raise) {
+    return active | bit;
+  }
+  if (clear) {
+    return active & ~bit;
+  }
+  return active;
+}
+
+// Append ",<label>:<min>/<mean>/<max>" already scaled for text, or ",<label>:<value>" when all three are equal
+static void appendChannel(StringBuilder& text, const char* label, int32_t min, int32_t mean, int32_t max,
+                          uint8_t decimals) {
+  text.append(',').append(label).append(':').appendFixed(min, decimals);
+  if (min == max && mean == min) {
+    return;
+  }
+  text.append('/').appendFixed(mean, decimals).append('/').appendFixed(max, decimals);
+}
+
+SmsDigest::SmsDigest(const SmsAlarmLimits& limits) : limits(limits) {
+  clear();
+}
+
+void SmsDigest::clear() {
+  memset(entries, 0, sizeof(entries));
+  count = 0;
+}
+
+uint8_t SmsDigest::add(uint8_t slot, const SensorReading& reading) {
+  if (slot >= NODE_TABLE_CAPACITY) {
+    return 0;
+  }
+  if (slot >= count) {
+    count = slot + 1;
+  }
+
+  DigestEntry& entry = entries[slot];
+  if (entry.nodeId != reading.nodeId) {
+    memset(&entry, 0, sizeof(entry));
+    entry.nodeId = reading.nodeId;
+  }
+  addSample(entry, reading);
+  return checkAlarms(entry, reading);
+}
+
+void SmsDigest::markReported(uint8_t slot, uint16_t samples, const SensorReading& latest) {
+  DigestEntry& entry = entries[slot];
+  bool newer = entry.samples != samples;
+  resetWindow(entry);
+  if (newer) {
+    addSample(entry, latest);
+  }
+}
+
+uint8_t SmsDigest::order(uint8_t* slots) const {
+  uint8_t filled = 0;
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    for (uint8_t i = 0; i < count; i++) {
+      bool alarmed = entries[i].windowAlarms != 0;
+      if (entries[i].samples > 0 && alarmed == (pass == 0)) {
+        slots[filled++] = i;
+      }
+    }
+  }
+  return filled;
+}
+
+void SmsDigest::formatWindow(uint8_t slot, StringBuilder& text) const {
+  const DigestEntry& entry = entries[slot];
+  text.append("N:").appendUnsigned(entry.nodeId);
+  if (entry.windowAlarms != 0) {
+    text.append('!');
+    formatAlarmCodes(entry.windowAlarms, text);
+  }
+
+  if (entry.climateSamples > 0) {
+    appendChannel(text, "T", roundDiv(entry.temperatureMin, 10),
+                  roundDiv(entry.temperatureSum, (int64_t)entry.climateSamples * 10),
+                  roundDiv(entry.temperatureMax, 10), 1);
+    appendChannel(text, "H", roundDiv(entry.humidityMin, 100),
+                  roundDiv(entry.humiditySum, (int64_t)entry.climateSamples * 100),
+                  roundDiv(entry.humidityMax, 100), 0);
+  }
+  if (entry.pressureSamples > 0) {
+    appendChannel(text, "P", roundDiv(entry.pressureMin, 1000),
+                  roundDiv((int64_t)entry.pressureSum, (int64_t)entry.pressureSamples * 1000),
+                  roundDiv(entry.pressureMax, 1000), 0);
+  }
+}
+
+void SmsDigest::formatAlarm(uint8_t slot, const SensorReading& reading, StringBuilder& text) const {
+  text.append("N:").appendUnsigned(entries[slot].nodeId).append('!');
+  formatAlarmCodes(entries[slot].pendingAlarms, text);
+
+  if ((reading.flags & SENSOR_FLAG_TH_INVALID) == 0) {
+    text.append(",T:").appendFixed(roundDiv(reading.temperature, 10), 1);
+    text.append(",H:").appendSigned(roundDiv(reading.humidity, 100));
+  }
+  if ((reading.flags & SENSOR_FLAG_PRESSURE_INVALID) == 0) {
+    text.append(",P:").appendSigned(roundDiv(reading.pressure, 1000));
+  }
+}
+
+void SmsDigest::formatAlarmCodes(uint8_t alarms, StringBuilder& text) {
+  for (uint8_t i = 0; i < ALARM_CODE_COUNT; i++) {
+    if (alarms & (1 << i)) {
+      text.append(ALARM_CODES[i]);
+    }
+  }
+}
+
+uint8_t SmsDigest::checkAlarms(DigestEntry& entry, const SensorReading& reading) const {
+  uint8_t active = entry.activeAlarms;
+  bool faulty = (reading.flags & (SENSOR_FLAG_TH_INVALID | SENSOR_FLAG_PRESSURE_INVALID)) != 0;
+  active = latch(active, SMS_ALARM_SENSOR_FAULT, faulty, !faulty);
+
+  // Without a valid temperature and humidity the climate alarms stay as they were
+  if ((reading.flags & SENSOR_FLAG_TH_INVALID) == 0) {
+    int32_t temperature = reading.temperature;
+    int32_t humidity = reading.humidity;
+    active = latch(active, SMS_ALARM_TEMPERATURE_HIGH, temperature > limits.temperatureHigh,
+                   temperature <= (int32_t)limits.temperatureHigh - limits.temperatureHysteresis);
+    active = latch(active, SMS_ALARM_TEMPERATURE_LOW, temperature < limits.temperatureLow,
+                   temperature >= (int32_t)limits.temperatureLow + limits.temperatureHysteresis);
+    active = latch(active, SMS_ALARM_HUMIDITY_HIGH, humidity > limits.humidityHigh,
+                   humidity <= (int32_t)limits.humidityHigh - limits.humidityHysteresis);
+    active = latch(active, SMS_ALARM_HUMIDITY_LOW, humidity < limits.humidityLow,
+                   humidity >= (int32_t)limits.humidityLow + limits.humidityHysteresis);
+  }
+
+  uint8_t raised = active & ~entry.activeAlarms;
+  entry.activeAlarms = active;
+  entry.windowAlarms |= active;
+  entry.pendingAlarms |= raised;
+  return raised;
+}
+
+void SmsDigest::resetWindow(DigestEntry& entry) {
+  entry.samples = 0;
+  entry.climateSamples = 0;
+  entry.pressureSamples = 0;
+  entry.temperatureSum = 0;
+  entry.humiditySum = 0;
+  entry.pressureSum = 0;
+  entry.windowAlarms = entry.activeAlarms;  // A condition still holding shows in the next window too
+}
+
+void SmsDigest::addSample(DigestEntry& entry, const SensorReading& reading) {
+  if (entry.samples == UINT16_MAX) {
+    return;  // Far beyond any SMS window; the sums stop growing rather than wrap
+  }
+  entry.samples++;
+
+  if ((reading.flags & SENSOR_FLAG_TH_INVALID) == 0) {
+    if (entry.climateSamples == 0 || reading.temperature < entry.temperatureMin) {
+      entry.temperatureMin = reading.temperature;
+    }
+    if (entry.climateSamples == 0 || reading.temperature > entry.temperatureMax) {
+      entry.temperatureMax = reading.temperature;
+    }
+    if (entry.climateSamples == 0 || reading.humidity < entry.humidityMin) {
+      entry.humidityMin = reading.humidity;
+    }
+    if (entry.climateSamples == 0 || reading.humidity > entry.humidityMax) {
+      entry.humidityMax = reading.humidity;
+    }
+    entry.temperatureSum += reading.temperature;
+    entry.humiditySum += reading.humidity;
+    entry.climateSamples++;
+  }
+
+  if ((reading.flags & SENSOR_FLAG_PRESSURE_INVALID) == 0) {
+    if (entry.pressureSamples == 0 || reading.pressure < entry.pressureMin) {
+      entry.pressureMin = reading.pressure;
+    }
+    if (entry.pressureSamples == 0 || reading.pressure > entry.pressureMax) {
+      entry.pressureMax = reading.pressure;
+    }
+    entry.pressureSum += reading.pressure;
+    entry.pressureSamples++;
+  }
+}
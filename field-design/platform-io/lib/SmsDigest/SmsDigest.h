@@ -0,0 +1,101 @@
+#ifndef SMS_DIGEST_H
+#define SMS_DIGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SensorPacket.h>
+#include <StringBuilder.h>
+#include <NodeTable.h>
+
+// Alarm conditions of one node, as bits; the text codes are listed next to each
+#define SMS_ALARM_TEMPERATURE_HIGH 0x01 // "TH"
+#define SMS_ALARM_TEMPERATURE_LOW 0x02  // "TL"
+#define SMS_ALARM_HUMIDITY_HIGH 0x04    // "HH"
+#define SMS_ALARM_HUMIDITY_LOW 0x08     // "HL"
+#define SMS_ALARM_SENSOR_FAULT 0x10     // "SF", a sensor read failed
+
+// Limits a reading is checked against, in frame units; an alarm clears once the value is back
+// inside its limit by the hysteresis, so a value hovering at a limit raises it only once
+struct SmsAlarmLimits {
+  int16_t temperatureHigh;       // centi-degrees Celsius
+  int16_t temperatureLow;
+  int16_t temperatureHysteresis;
+  uint16_t humidityHigh;         // centi-%RH
+  uint16_t humidityLow;
+  uint16_t humidityHysteresis;
+};
+
+// Readings of one node over the current window; slots match NodeTable slots
+struct DigestEntry {
+  uint8_t nodeId;
+  uint16_t samples;          // Readings added this window
+  uint16_t climateSamples;   // Of those, with a valid temperature and humidity
+  uint16_t pressureSamples;  // Of those, with a valid pressure
+  int16_t temperatureMin, temperatureMax;
+  int32_t temperatureSum;
+  uint16_t humidityMin, humidityMax;
+  uint32_t humiditySum;
+  uint32_t pressureMin, pressureMax;
+  uint64_t pressureSum;
+  uint8_t activeAlarms;      // Conditions holding at the latest reading
+  uint8_t windowAlarms;      // Conditions seen at any time this window
+  uint8_t pendingAlarms;     // Conditions raised but not yet sent on the alarm path
+};
+
+/* Per-node min/mean/max of every reading in an SMS window, with threshold
+ * alarms, formatted into compact summaries for the SMS sink.
+ * add() folds each accepted reading into its node's window and returns the
+ * alarms it raised, so the gateway can send those at once; the periodic
+ * digest lists alarmed nodes first and restarts each node's window as it is
+ * sent. Storage is static: one entry per NodeTable slot.
+ */
+class SmsDigest {
+public:
+  explicit SmsDigest(const SmsAlarmLimits& limits);
+
+  // Fold a reading of the node in NodeTable slot into the window; returns the SMS_ALARM_* bits it raised
+  uint8_t add(uint8_t slot, const SensorReading& reading);
+
+  const DigestEntry& entry(uint8_t slot) const { return entries[slot]; }
+
+  // True when slot has readings in this window
+  bool hasWindow(uint8_t slot) const { return slot < count && entries[slot].samples > 0; }
+
+  // Restart the window of slot after it was sent; samples is entry().samples when it was formatted, and
+  // readings added since are kept as the start of the next window, as far as latest still holds them
+  void markReported(uint8_t slot, uint16_t samples, const SensorReading& latest);
+
+  // Clear the pending alarms of slot that were sent, leaving any raised since
+  void markAlarmSent(uint8_t slot, uint8_t alarms) { entries[slot].pendingAlarms &= ~alarms; }
+
+  // Number of slots holding entries, at most NODE_TABLE_CAPACITY
+  uint8_t size() const { return count; }
+
+  // Fill slots (NODE_TABLE_CAPACITY entries) with every slot holding a window in digest order, those with
+  // alarms this window first, then the rest, each in slot order; returns the number filled
+  uint8_t order(uint8_t* slots) const;
+
+  // Append "N:<id>[!<codes>],T:<min>/<mean>/<max>,H:<min>/<mean>/<max>,P:<min>/<mean>/<max>" for the window of
+  // slot, in degrees with one decimal, whole %RH and whole hPa; a channel without valid readings is left out
+  // and a channel whose readings were all equal shows one value
+  void formatWindow(uint8_t slot, StringBuilder& text) const;
+
+  // Append "N:<id>!<codes>,T:<temp>,H:<hum>,P:<hPa>" for the pending alarms of slot and its latest reading
+  void formatAlarm(uint8_t slot, const SensorReading& reading, StringBuilder& text) const;
+
+  // Append the two-letter code of every SMS_ALARM_* bit in alarms
+  static void formatAlarmCodes(uint8_t alarms, StringBuilder& text);
+
+  void clear();
+
+private:
+  uint8_t checkAlarms(DigestEntry& entry, const SensorReading& reading) const;
+  static void resetWindow(DigestEntry& entry);
+  static void addSample(DigestEntry& entry, const SensorReading& reading);
+
+  SmsAlarmLimits limits;
+  DigestEntry entries[NODE_TABLE_CAPACITY];
+  uint8_t count;
+};
+
+#endif
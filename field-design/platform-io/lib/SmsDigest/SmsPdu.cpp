@@ -0,0 +1,115 @@
+#include "SmsPdu.h"
+
+#include <string.h>
+
+#define SMS_FIRST_OCTET_SUBMIT 0x01
+#define SMS_FIRST_OCTET_UDHI 0x40      // User data starts with a header
+#define SMS_ADDRESS_INTERNATIONAL 0x91
+#define SMS_ADDRESS_NATIONAL 0x81
+#define SMS_CONCAT_HEADER_SEPTETS 7    // 6 header octets and one fill bit
+
+static void appendHex(StringBuilder& pdu, uint8_t value) {
+  static const char DIGITS[] = "0123456789ABCDEF";
+  pdu.append(DIGITS[value >> 4]).append(DIGITS[value & 0x0F]);
+}
+
+uint8_t smsPartCount(size_t len) {
+  if (len <= SMS_SINGLE_SEPTETS) {
+    return 1;
+  }
+  return (uint8_t)((len + SMS_PART_SEPTETS - 1) / SMS_PART_SEPTETS);
+}
+
+uint8_t gsmSeptet(char c) {
+  switch (c) {
+    case '@':
+      return 0x00;
+    case '$':
+      return 0x02;
+    case '_':
+      return 0x11;
+    case '\n':
+    case '\r':
+      return (uint8_t)c;
+    default:
+      break;
+  }
+
+  // The rest of printable ASCII sits at the same codes, apart from the characters the basic set replaces
+  if (c < ' ' || c > 'z' || c == '`' || (c >= '[' && c <= '^')) {
+    return '?';
+  }
+  return (uint8_t)c;
+}
+
+uint8_t encodeSmsSubmit(const char* phone, const char* text, size_t len, uint8_t reference, uint8_t part,
+                        uint8_t total, StringBuilder& pdu) {
+  if (total == 0 || part == 0 || part > total) {
+    return 0;
+  }
+  if (len > (total == 1 ? SMS_SINGLE_SEPTETS : SMS_PART_SEPTETS)) {
+    return 0;
+  }
+
+  bool international = phone[0] == '+';
+  const char* digits = international ? phone + 1 : phone;
+  size_t digitCount = strlen(digits);
+  if (digitCount == 0 || digitCount > SMS_PHONE_DIGITS_MAX) {
+    return 0;
+  }
+  for (size_t i = 0; i < digitCount; i++) {
+    if (digits[i] < '0' || digits[i] > '9') {
+      return 0;
+    }
+  }
+
+  size_t start = pdu.length();
+  appendHex(pdu, 0x00);
+  appendHex(pdu, total > 1 ? SMS_FIRST_OCTET_SUBMIT | SMS_FIRST_OCTET_UDHI : SMS_FIRST_OCTET_SUBMIT);
+  appendHex(pdu, 0x00);
+
+  // Destination digits in swapped nibbles, padded with F
+  appendHex(pdu, (uint8_t)digitCount);
+  appendHex(pdu, international ? SMS_ADDRESS_INTERNATIONAL : SMS_ADDRESS_NATIONAL);
+  for (size_t i = 0; i < digitCount; i += 2) {
+    uint8_t low = digits[i] - '0';
+    uint8_t high = i + 1 < digitCount ? digits[i + 1] - '0' : 0x0F;
+    appendHex(pdu, (uint8_t)(high << 4 | low));
+  }
+
+  appendHex(pdu, 0x00);
+  appendHex(pdu, 0x00);
+
+  uint32_t bits = 0;
+  uint8_t bitCount = 0;
+  if (total > 1) {
+    appendHex(pdu, (uint8_t)(SMS_CONCAT_HEADER_SEPTETS + len));
+    appendHex(pdu, 0x05);  // Header length
+    appendHex(pdu, 0x00);  // Concatenated message, 8-bit reference
+    appendHex(pdu, 0x03);
+    appendHex(pdu, reference);
+    appendHex(pdu, total);
+    appendHex(pdu, part);
+    bitCount = 1;  // Fill bit, so the text starts on a septet boundary
+  } else {
+    appendHex(pdu, (uint8_t)len);
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    bits |= (uint32_t)gsmSeptet(text[i]) << bitCount;
+    bitCount += 7;
+    while (bitCount >= 8) {
+      appendHex(pdu, (uint8_t)bits);
+      bits >>= 8;
+      bitCount -= 8;
+    }
+  }
+  if (bitCount > 0) {
+    appendHex(pdu, (uint8_t)bits);
+  }
+
+  if (pdu.overflowed()) {
+    return 0;
+  }
+  return (uint8_t)((pdu.length() - start) / 2 - 1);
+}
@@ -0,0 +1,39 @@
+#ifndef SMS_PDU_H
+#define SMS_PDU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <StringBuilder.h>
+
+/* SMS-SUBMIT PDU Layout (3GPP TS 23.040), as hex text for AT+CMGF=0 and AT+CMGS=<length>:
+ * Octets | Field
+ * -------|----------------------------------------------
+ * 1      | SMSC length, 0: the modem's default service centre
+ * 1      | First octet: SMS-SUBMIT, UDHI set when the message is one part of several
+ * 1      | Message reference, 0: assigned by the modem
+ * 2-12   | Destination: digit count, type (0x91 international, 0x81 national) and swapped BCD digits
+ * 1      | Protocol identifier, 0
+ * 1      | Data coding scheme, 0: GSM 7-bit default alphabet
+ * 1      | User data length in septets, including the header
+ * 0-140  | User data: for a part, the concatenation header 05 00 03 <ref> <total> <part> and one fill
+ *        | bit, then the text packed 7 bits per character
+ */
+
+#define SMS_SINGLE_SEPTETS 160 // Characters in a message sent on its own
+#define SMS_PART_SEPTETS 153   // Characters in each part of a concatenated message, after its header
+#define SMS_PDU_MAX_OCTETS 158 // Whole PDU, SMSC length octet included, for a 20-digit number
+#define SMS_PHONE_DIGITS_MAX 20
+
+// Parts of SMS_PART_SEPTETS needed to carry len characters; 1 when they fit in a single message
+uint8_t smsPartCount(size_t len);
+
+// GSM 7-bit default alphabet code of c; characters outside the basic set without an escape become '?'
+uint8_t gsmSeptet(char c);
+
+// Append the PDU of part (1-based) of total, carrying len characters of text, as hex digits to pdu;
+// total 1 sends a single message without a header. Returns the TPDU length AT+CMGS expects (the octets after
+// the SMSC field), or 0 when phone is malformed, part is out of range or the text is too long for it
+uint8_t encodeSmsSubmit(const char* phone, const char* text, size_t len, uint8_t reference, uint8_t part,
+                        uint8_t total, StringBuilder& pdu);
+
+#endif
@@ -0,0 +1,57 @@
+#include "StatusLed.h"
+
+StatusLed::StatusLed(uint8_t pin, uint8_t onLevel)
+    : pin(pin), onLevel(onLevel), edges(0), resting(false), period(0), changedAt(0), queuedTimes(0),
+      queuedDuration(0) {}
+
+void StatusLed::begin() {
+  pinMode(pin, OUTPUT);
+  write(false);
+}
+
+void StatusLed::blink(uint8_t times, uint16_t duration) {
+  if (times == 0) {
+    return;
+  }
+  if (edges > 0 || resting) {
+    queuedTimes = times;
+    queuedDuration = duration;
+    return;
+  }
+  start(times, duration);
+}
+
+void StatusLed::poll() {
+  uint32_t now = millis();
+
+  if (edges > 0) {
+    if (now - changedAt >= period) {
+      changedAt = now;
+      edges--;
+      write(edges % 2 == 1);  // The code starts lit, so an odd count of toggles left means on
+      resting = edges == 0;
+    }
+    return;
+  }
+
+  // The last off phase, then the gap, before the queued code may start
+  if (resting && now - changedAt >= (uint32_t)period + STATUS_LED_GAP) {
+    resting = false;
+  }
+  if (!resting && queuedTimes > 0) {
+    start(queuedTimes, queuedDuration);
+    queuedTimes = 0;
+  }
+}
+
+void StatusLed::start(uint8_t times, uint16_t duration) {
+  period = duration;
+  edges = times * 2 - 1;
+  resting = false;
+  changedAt = millis();
+  write(true);
+}
+
+void StatusLed::write(bool lit) {
+  digitalWrite(pin, lit ? onLevel : !onLevel);
+}
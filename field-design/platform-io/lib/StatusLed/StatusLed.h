@@ -0,0 +1,41 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include <Arduino.h>
+
+// Dark pause after a blink code before the next one starts, so consecutive codes can be told apart
+#define STATUS_LED_GAP 600
+
+/* Non-blocking blink codes on a status LED.
+ * blink() starts a code, or queues it while another one is showing, and
+ * poll() from loop() toggles the LED as its time comes; loop() never waits
+ * on the LED. One code is queued at most: a newer one replaces it.
+ */
+class StatusLed {
+public:
+  StatusLed(uint8_t pin, uint8_t onLevel);
+
+  // Configure the pin and switch the LED off
+  void begin();
+
+  // Blink times, duration milliseconds on and duration off
+  void blink(uint8_t times, uint16_t duration);
+
+  // Advance the running code; call every loop() pass
+  void poll();
+
+private:
+  void start(uint8_t times, uint16_t duration);
+  void write(bool lit);
+
+  uint8_t pin;
+  uint8_t onLevel;
+  uint8_t edges;          // Toggles left in the running code
+  bool resting;           // Running code has finished and the gap is running
+  uint16_t period;        // Milliseconds per on or off phase of the running code
+  uint32_t changedAt;     // millis() of the last toggle
+  uint8_t queuedTimes;    // Code waiting for the running one, 0 when none
+  uint16_t queuedDuration;
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "BatchCodec.h"
+
+#include <stdio.h>
+
+#define BATCH_RECORD_MAX 15 // Largest binary record: node, 5 byte varint, 9 bytes of values
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Base64 decoded a byte at a time, so a binary batch of any length decodes without a buffer
+struct Base64Reader {
+  const char* pos;
+  const char* end;
+  uint32_t bits;
+  uint8_t bitCount;
+  bool invalid;  // A character outside the alphabet; a padding '=' just ends the data
+
+  bool next(uint8_t& byte);
+};
+
+size_t base64Encode(const uint8_t* data, size_t len, char* out, size_t outLen) {
+  size_t needed = (len + 2) / 3 * 4;
+  if (outLen < needed + 1) {
+    return 0;
+  }
+
+  size_t pos = 0;
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t chunk = (uint32_t)data[i] << 16;
+    if (i + 1 < len) {
+      chunk |= (uint32_t)data[i + 1] << 8;
+    }
+    if (i + 2 < len) {
+      chunk |= data[i + 2];
+    }
+    out[pos++] = BASE64_ALPHABET[(chunk >> 18) & 0x3F];
+    out[pos++] = BASE64_ALPHABET[(chunk >> 12) & 0x3F];
+    out[pos++] = i + 1 < len ? BASE64_ALPHABET[(chunk >> 6) & 0x3F] : '=';
+    out[pos++] = i + 2 < len ? BASE64_ALPHABET[chunk & 0x3F] : '=';
+  }
+  out[pos] = '\0';
+  return pos;
+}
+
+static size_t putU32(uint8_t* out, uint32_t value) {
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+  out[2] = (value >> 16) & 0xFF;
+  out[3] = (value >> 24) & 0xFF;
+  return 4;
+}
+
+static size_t putVarint(uint8_t* out, uint32_t value) {
+  size_t pos = 0;
+  while (value >= 0x80) {
+    out[pos++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[pos++] = value;
+  return pos;
+}
+
+static size_t putRecord(uint8_t* out, const SensorReading& reading, int32_t delta) {
+  uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+  uint16_t temperature = (uint16_t)reading.temperature;
+  uint32_t pressure = reading.pressure > SENSOR_PRESSURE_MAX ? SENSOR_PRESSURE_MAX : reading.pressure;
+  size_t pos = 0;
+
+  out[pos++] = reading.nodeId;
+  pos += putVarint(out + pos, zigzag);
+  out[pos++] = temperature & 0xFF;
+  out[pos++] = temperature >> 8;
+  out[pos++] = reading.humidity & 0xFF;
+  out[pos++] = reading.humidity >> 8;
+  out[pos++] = pressure & 0xFF;
+  out[pos++] = (pressure >> 8) & 0xFF;
+  out[pos++] = (pressure >> 16) & 0xFF;
+  out[pos++] = reading.flags;
+  return pos;
+}
+
+static uint16_t encodeText(const RecordStore& store, uint32_t now, char* buf, size_t len, size_t& written) {
+  StoredRecord record;
+  if (!store.at(0, record)) {
+    return 0;
+  }
+
+  int pos = snprintf(buf, len, "B%u,%lu,%lu", BATCH_FORMAT_VERSION, (unsigned long)now,
+                     (unsigned long)record.timestamp);
+  if (pos < 0 || (size_t)pos >= len) {
+    return 0;
+  }
+
+  uint16_t count = 0;
+  uint32_t previous = record.timestamp;
+  while (count < 0xFFFF && store.at(count, record)) {
+    const SensorReading& r = record.reading;
+    int added = snprintf(buf + pos, len - pos, ";%u,%ld,%d,%u,%lu,%u", r.nodeId,
+                         (long)(int32_t)(record.timestamp - previous), r.temperature, r.humidity,
+                         (unsigned long)r.pressure, r.flags);
+    if (added < 0 || (size_t)added >= len - pos) {
+      break;
+    }
+    pos += added;
+    previous = record.timestamp;
+    count++;
+  }
+
+  // A batch with no room for a single record is not worth sending
+  buf[count > 0 ? pos : 0] = '\0';
+  written = count > 0 ? pos : 0;
+  return count;
+}
+
+static uint16_t encodeBinary(const RecordStore& store, uint32_t now, char* buf, size_t len, size_t& written) {
+  static uint8_t raw[BATCH_BINARY_MAX];
+  const size_t prefixLen = 3;
+
+  StoredRecord record;
+  if (len < prefixLen + 1 || !store.at(0, record)) {
+    return 0;
+  }
+
+  // Raw bytes that still fit once base64 grows them by a third
+  size_t rawMax = (len - prefixLen - 1) / 4 * 3;
+  if (rawMax > sizeof(raw)) {
+    rawMax = sizeof(raw);
+  }
+  if (rawMax < 8 + BATCH_RECORD_MAX) {
+    return 0;
+  }
+
+  size_t pos = putU32(raw, now);
+  pos += putU32(raw + pos, record.timestamp);
+
+  uint16_t count = 0;
+  uint32_t previous = record.timestamp;
+  while (count < 0xFFFF && pos + BATCH_RECORD_MAX <= rawMax && store.at(count, record)) {
+    pos += putRecord(raw + pos, record.reading, (int32_t)(record.timestamp - previous));
+    previous = record.timestamp;
+    count++;
+  }
+
+  snprintf(buf, len, "b%u:", BATCH_FORMAT_VERSION);
+  written = prefixLen + base64Encode(raw, pos, buf + prefixLen, len - prefixLen);
+  return count;
+}
+
+uint16_t encodeBatch(const RecordStore& store, BatchMode mode, uint32_t now, char* buf, size_t len, size_t& written) {
+  written = 0;
+  if (len == 0) {
+    return 0;
+  }
+  buf[0] = '\0';
+  return mode == BATCH_BINARY ? encodeBinary(store, now, buf, len, written)
+                              : encodeText(store, now, buf, len, written);
+}
+
+static int8_t base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  }
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  }
+  if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  }
+  if (c == '+') {
+    return 62;
+  }
+  return c == '/' ? 63 : -1;
+}
+
+bool Base64Reader::next(uint8_t& byte) {
+  while (bitCount < 8) {
+    if (pos == end || *pos == '=') {
+      pos = end;
+      return false;
+    }
+    int8_t value = base64Value(*pos++);
+    if (value < 0) {
+      invalid = true;
+      pos = end;
+      return false;
+    }
+    bits = (bits << 6) | (uint32_t)value;
+    bitCount += 6;
+  }
+  bitCount -= 8;
+  byte = (bits >> bitCount) & 0xFF;
+  bits &= (1u << bitCount) - 1;
+  return true;
+}
+
+static bool readBytes(Base64Reader& reader, uint8_t* out, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (!reader.next(out[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static int32_t decodeBinary(const char* text, const char* end, uint32_t& now, BatchRecordCallback onRecord,
+                            void* context) {
+  Base64Reader reader = {text, end, 0, 0, false};
+  uint8_t header[8];
+  if (!readBytes(reader, header, sizeof(header))) {
+    return -1;
+  }
+  now = getU32(header);
+
+  StoredRecord record = {getU32(header + 4), {0, 0, 0, 0, 0, 0}};
+  int32_t count = 0;
+  uint8_t node;
+  while (reader.next(node)) {
+    // Zigzag varint delta, at most 5 bytes for 32 bits
+    uint32_t zigzag = 0;
+    uint8_t byte = 0x80;
+    for (uint8_t shift = 0; byte & 0x80; shift += 7) {
+      if (shift > 28 || !reader.next(byte)) {
+        return -1;
+      }
+      zigzag |= (uint32_t)(byte & 0x7F) << shift;
+    }
+
+    uint8_t values[8];
+    if (!readBytes(reader, values, sizeof(values))) {
+      return -1;
+    }
+    record.timestamp += (zigzag >> 1) ^ (0u - (zigzag & 1));
+    record.reading.nodeId = node;
+    record.reading.temperature = (int16_t)(values[0] | (values[1] << 8));
+    record.reading.humidity = (uint16_t)(values[2] | (values[3] << 8));
+    record.reading.pressure = (uint32_t)values[4] | ((uint32_t)values[5] << 8) | ((uint32_t)values[6] << 16);
+    record.reading.flags = values[7];
+    onRecord(record, context);
+    count++;
+  }
+  return reader.invalid ? -1 : count;
+}
+
+// Parse a decimal number within [min, max] at pos, stopping at end; false when there is none or it is out of range
+static bool parseField(const char*& pos, const char* end, int64_t min, int64_t max, int64_t& value) {
+  bool negative = pos < end && *pos == '-';
+  const char* digits = negative ? pos + 1 : pos;
+  const char* p = digits;
+  int64_t magnitude = 0;
+  while (p < end && *p >= '0' && *p <= '9' && magnitude <= max + 1) {
+    magnitude = magnitude * 10 + (*p++ - '0');
+  }
+  if (p == digits || (p < end && *p >= '0' && *p <= '9')) {
+    return false;
+  }
+  value = negative ? -magnitude : magnitude;
+  pos = p;
+  return value >= min && value <= max;
+}
+
+static bool expectChar(const char*& pos, const char* end, char c) {
+  if (pos == end || *pos != c) {
+    return false;
+  }
+  pos++;
+  return true;
+}
+
+static int32_t decodeText(const char* text, const char* end, uint32_t& now, BatchRecordCallback onRecord,
+                          void* context) {
+  const char* pos = text;
+  int64_t header, start;
+  if (!parseField(pos, end, 0, UINT32_MAX, header) || !expectChar(pos, end, ',') ||
+      !parseField(pos, end, 0, UINT32_MAX, start)) {
+    return -1;
+  }
+  now = (uint32_t)header;
+
+  StoredRecord record = {(uint32_t)start, {0, 0, 0, 0, 0, 0}};
+  int32_t count = 0;
+  while (pos < end) {
+    int64_t node, delta, temperature, humidity, pressure, flags;
+    if (!expectChar(pos, end, ';') || !parseField(pos, end, 0, UINT8_MAX, node) || !expectChar(pos, end, ',') ||
+        !parseField(pos, end, INT32_MIN, INT32_MAX, delta) || !expectChar(pos, end, ',') ||
+        !parseField(pos, end, INT16_MIN, INT16_MAX, temperature) || !expectChar(pos, end, ',') ||
+        !parseField(pos, end, 0, UINT16_MAX, humidity) || !expectChar(pos, end, ',') ||
+        !parseField(pos, end, 0, SENSOR_PRESSURE_MAX, pressure) || !expectChar(pos, end, ',') ||
+        !parseField(pos, end, 0, UINT8_MAX, flags)) {
+      return -1;
+    }
+    record.timestamp += (uint32_t)(int32_t)delta;
+    record.reading.nodeId = (uint8_t)node;
+    record.reading.temperature = (int16_t)temperature;
+    record.reading.humidity = (uint16_t)humidity;
+    record.reading.pressure = (uint32_t)pressure;
+    record.reading.flags = (uint8_t)flags;
+    onRecord(record, context);
+    count++;
+  }
+  return count;
+}
+
+int32_t decodeBatch(const char* payload, size_t len, uint32_t& now, BatchRecordCallback onRecord, void* context) {
+  const char* end = payload + len;
+  if (len < 3 || payload[1] != '0' + BATCH_FORMAT_VERSION) {
+    return -1;
+  }
+  if (payload[0] == 'b' && payload[2] == ':') {
+    return decodeBinary(payload + 3, end, now, onRecord, context);
+  }
+  if (payload[0] == 'B' && payload[2] == ',') {
+    return decodeText(payload + 3, end, now, onRecord, context);
+  }
+  return -1;
+}
@@ -0,0 +1,59 @@
+#ifndef BATCH_CODEC_H
+#define BATCH_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "RecordStore.h"
+
+/* Batch payloads built from the oldest records of a RecordStore.
+ * Timestamps are gateway uptime seconds; "now" lets the receiver turn them
+ * into wall-clock time (time = arrival - (now - timestamp)), and a record
+ * timestamp of 0 means "before the gateway's last reset".
+ *
+ * Text mode, values in the fixed-point units of SensorPacket.h:
+ *   B1,<now>,<t0>;<node>,<dt>,<T>,<H>,<P>,<flags>;...
+ *   dt is the signed delta in seconds from the previous record (t0 for the first)
+ *
+ * Binary mode, for AT+MQTTPUB which only takes a quoted string:
+ *   b1:<base64>
+ *   Bytes | Field
+ *   ------|----------------------------------------------
+ *   4     | now, uint32 little-endian
+ *   4     | t0, uint32 little-endian
+ *   per record:
+ *   1     | Node id
+ *   1-5   | dt, zigzag LEB128 varint
+ *   2     | Temperature, int16 centi-degrees Celsius
+ *   2     | Humidity, uint16 centi-%RH
+ *   3     | Pressure, uint24 deci-Pascal
+ *   1     | Flags
+ */
+
+#define BATCH_FORMAT_VERSION 1
+
+// Largest binary batch before base64, bounds the scratch buffer
+#ifndef BATCH_BINARY_MAX
+#define BATCH_BINARY_MAX 384
+#endif
+
+enum BatchMode {
+  BATCH_TEXT,
+  BATCH_BINARY
+};
+
+// Encode as many of the oldest records of store as fit into buf (NUL-terminated);
+// returns the number encoded and sets written to the payload length
+uint16_t encodeBatch(const RecordStore& store, BatchMode mode, uint32_t now, char* buf, size_t len, size_t& written);
+
+// Standard base64 with padding; returns chars written excluding NUL, 0 if out is too small
+size_t base64Encode(const uint8_t* data, size_t len, char* out, size_t outLen);
+
+// One record decoded from a batch; the timestamp is still gateway uptime and the sequence number is 0
+typedef void (*BatchRecordCallback)(const StoredRecord& record, void* context);
+
+// Decode a text or binary batch of len chars (no NUL needed), calling onRecord for each record oldest first,
+// and set now from its header; returns the number of records, or -1 when the payload is not a batch or is
+// malformed, in which case the records already passed to onRecord should be discarded
+int32_t decodeBatch(const char* payload, size_t len, uint32_t& now, BatchRecordCallback onRecord, void* context);
+
+#endif
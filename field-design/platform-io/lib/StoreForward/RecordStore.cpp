@@ -0,0 +1,253 @@
+#include "RecordStore.h"
+
+#include <string.h>
+
+static uint16_t readU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+RecordStore::RecordStore(SpillStorage* spill)
+    : storage(spill), ramHead(0), ramCount(0), pageTail(0), pagesUsed(0), recoveredPages(0),
+      tailConsumed(0), nextSequence(0), droppedCount(0) {}
+
+void RecordStore::pack(const StoredRecord& record, uint8_t* out) {
+  const SensorReading& reading = record.reading;
+  uint16_t temperature = (uint16_t)reading.temperature;
+  uint32_t pressure = reading.pressure > SENSOR_PRESSURE_MAX ? SENSOR_PRESSURE_MAX : reading.pressure;
+
+  writeU32(out, record.timestamp);
+  out[4] = reading.nodeId;
+  out[5] = reading.sequence;
+  out[6] = temperature & 0xFF;
+  out[7] = temperature >> 8;
+  out[8] = reading.humidity & 0xFF;
+  out[9] = reading.humidity >> 8;
+  out[10] = pressure & 0xFF;
+  out[11] = (pressure >> 8) & 0xFF;
+  out[12] = (pressure >> 16) & 0xFF;
+  out[13] = reading.flags;
+}
+
+void RecordStore::unpack(const uint8_t* in, StoredRecord& record) {
+  record.timestamp = readU32(in);
+  record.reading.nodeId = in[4];
+  record.reading.sequence = in[5];
+  record.reading.temperature = (int16_t)readU16(in + 6);
+  record.reading.humidity = readU16(in + 8);
+  record.reading.pressure = (uint32_t)in[10] | ((uint32_t)in[11] << 8) | ((uint32_t)in[12] << 16);
+  record.reading.flags = in[13];
+}
+
+uint16_t RecordStore::recordsPerPage() const {
+  return (storage->pageSize() - STORE_PAGE_HEADER_LEN) / STORE_RECORD_LEN;
+}
+
+uint16_t RecordStore::pageRecords(uint8_t index) const {
+  return readU16(storage->page(index) + 2);
+}
+
+bool RecordStore::pageBlank(uint8_t index) const {
+  const uint8_t* data = storage->page(index);
+  for (uint16_t i = 0; i < storage->pageSize(); i++) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void RecordStore::begin() {
+  if (storage != nullptr && (storage->pageCount() == 0 || recordsPerPage() == 0)) {
+    storage = nullptr;
+  }
+  if (storage == nullptr) {
+    return;
+  }
+
+  uint8_t pages = storage->pageCount();
+  bool valid[256];
+  bool found = false;
+  uint32_t oldest = 0;
+
+  for (uint8_t i = 0; i < pages; i++) {
+    const uint8_t* data = storage->page(i);
+    uint16_t count = readU16(data + 2);
+    valid[i] = readU16(data) == STORE_PAGE_MAGIC && count > 0 && count <= recordsPerPage();
+    if (valid[i]) {
+      uint32_t sequence = readU32(data + 4);
+      if (!found || (int32_t)(sequence - oldest) < 0) {
+        oldest = sequence;
+        pageTail = i;
+      }
+      found = true;
+    }
+  }
+
+  // Pages are written round-robin, so the backlog is the unbroken run of sequences starting at the oldest
+  pagesUsed = 0;
+  nextSequence = oldest;
+  if (found) {
+    while (pagesUsed < pages) {
+      uint8_t index = (pageTail + pagesUsed) % pages;
+      if (!valid[index] || readU32(storage->page(index) + 4) != nextSequence) {
+        break;
+      }
+      valid[index] = false;
+      pagesUsed++;
+      nextSequence++;
+    }
+  }
+  recoveredPages = pagesUsed;
+  tailConsumed = 0;
+
+  // Anything else is a torn write or a leftover outside the run
+  for (uint8_t i = 0; i < pages; i++) {
+    bool inRun = (uint8_t)((i + pages - pageTail) % pages) < pagesUsed;
+    if (!inRun && !pageBlank(i)) {
+      storage->erase(i);
+    }
+  }
+}
+
+void RecordStore::append(const StoredRecord& record) {
+  if (ramCount == STORE_RAM_RECORDS && !spill()) {
+    // No flash to spill into: overwrite the oldest record
+    ramHead = (ramHead + 1) % STORE_RAM_RECORDS;
+    ramCount--;
+    droppedCount++;
+  }
+
+  pack(record, ram[(ramHead + ramCount) % STORE_RAM_RECORDS]);
+  ramCount++;
+}
+
+void RecordStore::dropOldestPage() {
+  droppedCount += pageRecords(pageTail) - tailConsumed;
+  releaseOldestPage();
+}
+
+void RecordStore::releaseOldestPage() {
+  storage->erase(pageTail);
+  pageTail = (pageTail + 1) % storage->pageCount();
+  pagesUsed--;
+  tailConsumed = 0;
+  if (recoveredPages > 0) {
+    recoveredPages--;
+  }
+}
+
+// Move the oldest page worth of RAM records into the next spill page
+bool RecordStore::spill() {
+  if (storage == nullptr || ramCount == 0) {
+    return false;
+  }
+
+  if (pagesUsed == storage->pageCount()) {
+    dropOldestPage();
+  }
+
+  uint8_t target = pageAt(pagesUsed);
+  if (!pageBlank(target) && !storage->erase(target)) {
+    return false;
+  }
+
+  uint16_t count = ramCount < recordsPerPage() ? ramCount : recordsPerPage();
+  for (uint16_t i = 0; i < count; i++) {
+    uint16_t offset = STORE_PAGE_HEADER_LEN + i * STORE_RECORD_LEN;
+    if (!storage->program(target, offset, ram[(ramHead + i) % STORE_RAM_RECORDS], STORE_RECORD_LEN)) {
+      storage->erase(target);
+      return false;
+    }
+  }
+
+  uint8_t header[STORE_PAGE_HEADER_LEN];
+  header[0] = STORE_PAGE_MAGIC & 0xFF;
+  header[1] = STORE_PAGE_MAGIC >> 8;
+  header[2] = count & 0xFF;
+  header[3] = count >> 8;
+  writeU32(header + 4, nextSequence);
+  if (!storage->program(target, 0, header, STORE_PAGE_HEADER_LEN)) {
+    storage->erase(target);
+    return false;
+  }
+
+  nextSequence++;
+  pagesUsed++;
+  ramHead = (ramHead + count) % STORE_RAM_RECORDS;
+  ramCount -= count;
+  return true;
+}
+
+void RecordStore::persist() {
+  while (ramCount > 0 && spill()) {
+  }
+}
+
+uint32_t RecordStore::size() const {
+  uint32_t total = ramCount;
+  for (uint8_t i = 0; i < pagesUsed; i++) {
+    total += pageRecords(pageAt(i));
+  }
+  return total - tailConsumed;
+}
+
+const uint8_t* RecordStore::recordAt(uint32_t index, bool& recovered) const {
+  uint32_t skip = tailConsumed;
+  for (uint8_t i = 0; i < pagesUsed; i++) {
+    uint8_t page = pageAt(i);
+    uint16_t count = pageRecords(page);
+    if (index + skip < count) {
+      recovered = i < recoveredPages;
+      return storage->page(page) + STORE_PAGE_HEADER_LEN + (index + skip) * STORE_RECORD_LEN;
+    }
+    index -= count - skip;
+    skip = 0;
+  }
+
+  recovered = false;
+  return index < ramCount ? ram[(ramHead + index) % STORE_RAM_RECORDS] : nullptr;
+}
+
+bool RecordStore::at(uint32_t index, StoredRecord& record) const {
+  bool recovered;
+  const uint8_t* data = recordAt(index, recovered);
+  if (data == nullptr) {
+    return false;
+  }
+  unpack(data, record);
+
+  // Uptime from before a reset cannot be related to the current clock
+  if (recovered) {
+    record.timestamp = 0;
+  }
+  return true;
+}
+
+void RecordStore::consume(uint32_t count) {
+  while (count > 0 && pagesUsed > 0) {
+    uint16_t available = pageRecords(pageTail) - tailConsumed;
+    if (count < available) {
+      tailConsumed += count;
+      return;
+    }
+    count -= available;
+    releaseOldestPage();
+  }
+
+  if (count > ramCount) {
+    count = ramCount;
+  }
+  ramHead = (ramHead + count) % STORE_RAM_RECORDS;
+  ramCount -= count;
+}
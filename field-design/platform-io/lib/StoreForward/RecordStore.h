@@ -0,0 +1,113 @@
+#ifndef RECORD_STORE_H
+#define RECORD_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SensorPacket.h>
+
+/* Stored Record Layout (little-endian, 14 bytes, same in RAM and flash):
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 4    | Timestamp, gateway uptime in seconds (0 = before the last reset)
+ * 4      | 1    | Node id
+ * 5      | 1    | Sequence number
+ * 6      | 2    | Temperature, int16 centi-degrees Celsius
+ * 8      | 2    | Humidity, uint16 centi-%RH
+ * 10     | 3    | Pressure, uint24 deci-Pascal
+ * 13     | 1    | Flags (SENSOR_FLAG_*)
+ */
+
+#define STORE_RECORD_LEN 14
+
+/* Spill Page Layout:
+ * Offset | Size | Field
+ * -------|------|----------------------------------------------
+ * 0      | 2    | Magic STORE_PAGE_MAGIC, written last so a torn write leaves the page invalid
+ * 2      | 2    | Record count
+ * 4      | 4    | Page sequence number, orders the pages after a reset
+ * 8      | 14*n | Records, oldest first
+ */
+
+#define STORE_PAGE_MAGIC 0x5346
+#define STORE_PAGE_HEADER_LEN 8
+
+// Records buffered in RAM before the oldest are spilled to a flash page
+#ifndef STORE_RAM_RECORDS
+#define STORE_RAM_RECORDS 80
+#endif
+
+// One reading waiting for the uplink, with the time the gateway received it
+struct StoredRecord {
+  uint32_t timestamp;
+  SensorReading reading;
+};
+
+/* Page-granular persistent storage the RecordStore spills into.
+ * Pages are memory mapped for reading; program() takes an even offset and
+ * length (flash is written in half-words) and only programs erased bytes.
+ */
+class SpillStorage {
+public:
+  virtual uint8_t pageCount() const = 0;
+  virtual uint16_t pageSize() const = 0;
+  virtual const uint8_t* page(uint8_t index) const = 0;
+  virtual bool erase(uint8_t index) = 0;
+  virtual bool program(uint8_t index, uint16_t offset, const uint8_t* data, uint16_t len) = 0;
+};
+
+/* Store-and-forward queue of readings for the uplink.
+ * Records are appended to a RAM ring; when it fills, the oldest page worth
+ * is written to the next spill page, so an outage fills flash instead of
+ * dropping data. Reads and consume() go oldest first, through the spilled
+ * pages and then RAM. A page is erased once all its records are consumed.
+ * When flash is full as well, the oldest page is dropped and counted.
+ */
+class RecordStore {
+public:
+  // spill may be nullptr for a RAM-only store that drops its oldest record when full
+  explicit RecordStore(SpillStorage* spill = nullptr);
+
+  // Recover pages spilled before a reset and erase torn ones; call once from setup()
+  void begin();
+
+  void append(const StoredRecord& record);
+
+  // Record index (0 = oldest); false past the end
+  bool at(uint32_t index, StoredRecord& record) const;
+
+  // Remove the count oldest records once the uplink has accepted them
+  void consume(uint32_t count);
+
+  // Spill every record still in RAM, e.g. before a deliberate reset
+  void persist();
+
+  uint32_t size() const;
+  uint8_t spilledPages() const { return pagesUsed; }
+  uint32_t dropped() const { return droppedCount; }
+
+  static void pack(const StoredRecord& record, uint8_t* out);
+  static void unpack(const uint8_t* in, StoredRecord& record);
+
+private:
+  uint16_t recordsPerPage() const;
+  uint16_t pageRecords(uint8_t index) const;
+  uint8_t pageAt(uint8_t position) const { return (pageTail + position) % storage->pageCount(); }
+  const uint8_t* recordAt(uint32_t index, bool& recovered) const;
+  bool spill();
+  void dropOldestPage();
+  void releaseOldestPage();
+  bool pageBlank(uint8_t index) const;
+
+  SpillStorage* storage;
+  uint8_t ram[STORE_RAM_RECORDS][STORE_RECORD_LEN];
+  uint16_t ramHead;
+  uint16_t ramCount;
+  uint8_t pageTail;         // Oldest spilled page
+  uint8_t pagesUsed;
+  uint8_t recoveredPages;   // Pages at the tail written before the last reset
+  uint16_t tailConsumed;    // Records of the oldest page already consumed
+  uint32_t nextSequence;
+  uint32_t droppedCount;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "Stm32FlashStorage.h"
+
+#if defined(ARDUINO_ARCH_STM32)
+#include <Arduino.h>
+
+uint8_t Stm32FlashStorage::pageCount() const {
+  return pages;
+}
+
+bool Stm32FlashStorage::erase(uint8_t index) {
+  if (index >= pages) {
+    return false;
+  }
+
+  FLASH_EraseInitTypeDef eraseInit = {};
+  eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+  eraseInit.Banks = FLASH_BANK_1;
+  eraseInit.PageAddress = baseAddress + (uint32_t)index * STM32_FLASH_PAGE_SIZE;
+  eraseInit.NbPages = 1;
+  uint32_t pageError = 0;
+
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&eraseInit, &pageError);
+  HAL_FLASH_Lock();
+  return status == HAL_OK;
+}
+
+bool Stm32FlashStorage::program(uint8_t index, uint16_t offset, const uint8_t* data, uint16_t len) {
+  if (index >= pages || (offset & 1) || (len & 1) || offset + len > STM32_FLASH_PAGE_SIZE) {
+    return false;
+  }
+
+  uint32_t address = baseAddress + (uint32_t)index * STM32_FLASH_PAGE_SIZE + offset;
+  HAL_StatusTypeDef status = HAL_OK;
+
+  HAL_FLASH_Unlock();
+  for (uint16_t i = 0; i < len && status == HAL_OK; i += 2) {
+    uint16_t halfWord = data[i] | (data[i + 1] << 8);
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + i, halfWord);
+  }
+  HAL_FLASH_Lock();
+  return status == HAL_OK;
+}
+
+#else
+
+// Not an STM32 build: there is no flash to map, so the store behaves as RAM-only
+uint8_t Stm32FlashStorage::pageCount() const {
+  return 0;
+}
+
+bool Stm32FlashStorage::erase(uint8_t index) {
+  return false;
+}
+
+bool Stm32FlashStorage::program(uint8_t index, uint16_t offset, const uint8_t* data, uint16_t len) {
+  return false;
+}
+
+#endif
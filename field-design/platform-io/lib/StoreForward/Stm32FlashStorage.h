@@ -0,0 +1,30 @@
+#ifndef STM32_FLASH_STORAGE_H
+#define STM32_FLASH_STORAGE_H
+
+#include "RecordStore.h"
+
+#define STM32_FLASH_PAGE_SIZE 1024 // STM32F103x8/xB page size in bytes
+
+/* SpillStorage on a range of internal STM32F1 flash pages, through the HAL.
+ * The pages must lie above the firmware image: reserve them by lowering
+ * board_upload.maximum_size in platformio.ini. Erasing a page stalls the
+ * CPU for about 20 ms, so erase() runs only when a page is consumed or reused.
+ */
+class Stm32FlashStorage : public SpillStorage {
+public:
+  Stm32FlashStorage(uint32_t baseAddress, uint8_t pages) : baseAddress(baseAddress), pages(pages) {}
+
+  uint8_t pageCount() const override;
+  uint16_t pageSize() const override { return STM32_FLASH_PAGE_SIZE; }
+  const uint8_t* page(uint8_t index) const override {
+    return reinterpret_cast<const uint8_t*>(baseAddress + (uint32_t)index * STM32_FLASH_PAGE_SIZE);
+  }
+  bool erase(uint8_t index) override;
+  bool program(uint8_t index, uint16_t offset, const uint8_t* data, uint16_t len) override;
+
+private:
+  uint32_t baseAddress;
+  uint8_t pages;
+};
+
+#endif
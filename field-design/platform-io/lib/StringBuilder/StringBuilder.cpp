@@ -0,0 +1,66 @@
+#include "StringBuilder.h"
+
+#include <string.h>
+#include <SensorPacket.h>
+
+static char emptyText[1];
+
+StringBuilder::StringBuilder(char* buf, size_t capacity) : buf(buf), capacity(capacity), len(0), overflow(false) {
+  if (this->buf == nullptr || this->capacity == 0) {
+    this->buf = emptyText;
+    this->capacity = 1;
+  }
+  this->buf[0] = '\0';
+}
+
+StringBuilder& StringBuilder::append(const char* text, size_t count) {
+  if (count > remaining()) {
+    count = remaining();
+    overflow = true;
+  }
+  memcpy(buf + len, text, count);
+  len += count;
+  buf[len] = '\0';
+  return *this;
+}
+
+StringBuilder& StringBuilder::append(const char* text) {
+  return append(text, strlen(text));
+}
+
+StringBuilder& StringBuilder::append(char c) {
+  return append(&c, 1);
+}
+
+StringBuilder& StringBuilder::appendUnsigned(uint32_t value) {
+  char digits[10];
+  size_t pos = sizeof(digits);
+  do {
+    digits[--pos] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  return append(digits + pos, sizeof(digits) - pos);
+}
+
+StringBuilder& StringBuilder::appendSigned(int32_t value) {
+  if (value < 0) {
+    append('-');
+    return appendUnsigned(0u - (uint32_t)value);
+  }
+  return appendUnsigned((uint32_t)value);
+}
+
+StringBuilder& StringBuilder::appendFixed(int32_t value, uint8_t decimals) {
+  // Format into scratch space first so a value that does not fit still sets overflowed()
+  char text[24];
+  size_t count = formatFixedPoint(text, sizeof(text), value, decimals);
+  return append(text, count);
+}
+
+void StringBuilder::truncate(size_t length) {
+  if (length < len) {
+    len = length;
+    buf[len] = '\0';
+  }
+  overflow = false;
+}
@@ -0,0 +1,54 @@
+#ifndef STRING_BUILDER_H
+#define STRING_BUILDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Bounded text builder over a caller-owned buffer, in place of String concatenation.
+ * Appends never allocate and never write past the buffer: text that does not
+ * fit is cut off, the result stays NUL-terminated and overflowed() turns true.
+ * Numbers are formatted without printf, so no float or locale code is pulled in.
+ */
+class StringBuilder {
+public:
+  // capacity includes the terminating NUL
+  StringBuilder(char* buf, size_t capacity);
+
+  StringBuilder& append(const char* text);
+  StringBuilder& append(const char* text, size_t len);
+  StringBuilder& append(char c);
+  StringBuilder& appendUnsigned(uint32_t value);
+  StringBuilder& appendSigned(int32_t value);
+
+  // value / 10^decimals, e.g. appendFixed(-50, 2) appends "-0.50"
+  StringBuilder& appendFixed(int32_t value, uint8_t decimals);
+
+  // Drop everything after the first len characters, clearing the overflow flag
+  void truncate(size_t len);
+  void clear() { truncate(0); }
+
+  const char* c_str() const { return buf; }
+  size_t length() const { return len; }
+  size_t remaining() const { return capacity - 1 - len; }
+  bool overflowed() const { return overflow; }
+
+private:
+  char* buf;
+  size_t capacity;
+  size_t len;
+  bool overflow;
+};
+
+// StringBuilder that carries its own storage, for locals and globals of a fixed size
+template <size_t Capacity>
+class FixedString : public StringBuilder {
+  static_assert(Capacity > 0, "FixedString needs room for the NUL");
+
+public:
+  FixedString() : StringBuilder(storage, Capacity) {}
+
+private:
+  char storage[Capacity];
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "TaskScheduler.h"
+
+TaskScheduler::TaskScheduler(const SchedulerTask* tasks, uint8_t count)
+    : tasks(tasks), count(count < SCHEDULER_MAX_TASKS ? count : SCHEDULER_MAX_TASKS) {
+  begin(0);
+}
+
+void TaskScheduler::begin(uint32_t now) {
+  for (uint8_t i = 0; i < count; i++) {
+    TaskState& state = states[i];
+    state.interval = tasks[i].interval;
+    state.dueAt = state.interval == TASK_ON_DEMAND ? now : now + state.interval;
+    state.missed = 0;
+    state.pending = false;
+    state.late = false;
+  }
+}
+
+void TaskScheduler::poll(uint32_t now) {
+  // Promote periodic tasks whose time has come, and count the runs that waited too long
+  for (uint8_t i = 0; i < count; i++) {
+    TaskState& state = states[i];
+    const SchedulerTask& task = tasks[i];
+    if (!state.pending && state.interval != TASK_ON_DEMAND && (int32_t)(now - state.dueAt) >= 0) {
+      state.pending = true;
+    }
+    if (state.pending && !state.late && task.deadline != TASK_NO_DEADLINE && now - state.dueAt > task.deadline) {
+      state.late = true;
+      state.missed++;
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (tasks[i].taskClass == TASK_FOREGROUND && states[i].pending) {
+      run(i, now);
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    if (tasks[i].taskClass == TASK_BACKGROUND && states[i].pending && run(i, now)) {
+      return;
+    }
+  }
+}
+
+void TaskScheduler::trigger(uint8_t task, uint32_t now) {
+  TaskState& state = states[task];
+  if (!state.pending) {
+    state.pending = true;
+    state.dueAt = now;
+  }
+}
+
+bool TaskScheduler::due(uint8_t task, uint32_t now) const {
+  const TaskState& state = states[task];
+  return state.pending || (state.interval != TASK_ON_DEMAND && (int32_t)(now - state.dueAt) >= 0);
+}
+
+void TaskScheduler::setInterval(uint8_t task, uint32_t interval, uint32_t now) {
+  TaskState& state = states[task];
+  if (state.interval == TASK_ON_DEMAND || state.interval == TASK_EVERY_PASS || interval == TASK_ON_DEMAND ||
+      interval == TASK_EVERY_PASS) {
+    return;
+  }
+  state.interval = interval;
+  if (!state.pending) {
+    state.dueAt = now + interval;
+  }
+}
+
+uint32_t TaskScheduler::missedTotal() const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    total += states[i].missed;
+  }
+  return total;
+}
+
+bool TaskScheduler::run(uint8_t index, uint32_t now) {
+  const SchedulerTask& task = tasks[index];
+  if (!task.run(now, task.context)) {
+    return false;
+  }
+
+  // The next run is timed from this one, so a run that waited does not bunch up with the next
+  TaskState& state = states[index];
+  state.pending = false;
+  state.late = false;
+  if (state.interval != TASK_ON_DEMAND) {
+    state.dueAt = now + state.interval;
+  }
+  return true;
+}
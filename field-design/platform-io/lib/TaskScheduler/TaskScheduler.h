@@ -0,0 +1,83 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <stdint.h>
+
+// Tasks one scheduler can hold; override with -D SCHEDULER_MAX_TASKS=<n>
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 12
+#endif
+
+#define TASK_EVERY_PASS 0              // Interval of a task that runs on every poll()
+#define TASK_ON_DEMAND 0xFFFFFFFFUL    // Interval of a task that only runs after trigger()
+#define TASK_NO_DEADLINE 0xFFFFFFFFUL  // Deadline of a task that may wait for ever
+
+enum TaskClass {
+  TASK_FOREGROUND, // Short work: every due foreground task runs on each pass
+  TASK_BACKGROUND  // Slow work such as starting a modem job: one per pass, after the foreground tasks
+};
+
+// Run the task; false when it cannot run yet (e.g. the modem is busy), leaving it due for the next pass
+typedef bool (*TaskCallback)(uint32_t now, void* context);
+
+// One row of the static task table; rows are in priority order, most urgent first
+struct SchedulerTask {
+  const char* name;
+  TaskClass taskClass;
+  uint32_t interval;   // Milliseconds from one run to the next becoming due, or TASK_EVERY_PASS / TASK_ON_DEMAND
+  uint32_t deadline;   // Milliseconds a due run may wait before it counts as missed
+  TaskCallback run;
+  void* context;
+};
+
+/* Cooperative scheduler over a static task table, driven from loop().
+ * Each poll() runs the due foreground tasks in table order, then at most
+ * one due background task, so a slow job never delays the next pass
+ * through the tasks above it. A run that waits past its deadline, whether
+ * behind other work or because it kept returning false, is counted as a
+ * miss. Nothing is allocated; the table itself can live in flash.
+ */
+class TaskScheduler {
+public:
+  TaskScheduler(const SchedulerTask* tasks, uint8_t count);
+
+  // Start the clock: periodic tasks first become due one interval after now
+  void begin(uint32_t now);
+
+  // Run what is due; call on every loop() pass
+  void poll(uint32_t now);
+
+  // Make task due on the next pass, whatever its interval
+  void trigger(uint8_t task, uint32_t now);
+
+  bool due(uint8_t task, uint32_t now) const;
+
+  // Change a periodic task's interval from its table row, e.g. to a setting updated at run time; the next run
+  // becomes due one new interval after now. On-demand and every-pass tasks keep theirs
+  void setInterval(uint8_t task, uint32_t interval, uint32_t now);
+  uint32_t interval(uint8_t task) const { return states[task].interval; }
+
+  // Runs of task that started later than its deadline
+  uint32_t missed(uint8_t task) const { return states[task].missed; }
+  uint32_t missedTotal() const;
+
+  uint8_t size() const { return count; }
+  const SchedulerTask& task(uint8_t index) const { return tasks[index]; }
+
+private:
+  struct TaskState {
+    uint32_t dueAt;  // millis() the pending run became due
+    uint32_t interval;  // The table row's, or the one set by setInterval()
+    uint32_t missed;
+    bool pending;    // Triggered, or due and not yet run
+    bool late;       // The pending run has already been counted as missed
+  };
+
+  bool run(uint8_t index, uint32_t now);
+
+  const SchedulerTask* tasks;
+  uint8_t count;
+  TaskState states[SCHEDULER_MAX_TASKS];
+};
+
+#endif
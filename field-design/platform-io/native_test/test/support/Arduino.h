@@ -0,0 +1,24 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host stand-in for the Arduino core: the Stream calls AtEngine makes and a millis() the test sets
+
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int availableForWrite() = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+};
+
+inline uint32_t hostMillis = 0;
+
+inline uint32_t millis() {
+  return hostMillis;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef RH_CC110_H
+#define RH_CC110_H
+
+// Host stand-in for RadioHead's RH_CC110.h: only the modem configuration ids LinkAdvisor.cpp refers to
+class RH_CC110 {
+public:
+  typedef enum {
+    GFSK_Rb1_2Fd5_2 = 0,
+    GFSK_Rb2_4Fd5_2,
+    GFSK_Rb4_8Fd25_4,
+    GFSK_Rb10Fd19,
+    GFSK_Rb38_4Fd20,
+    GFSK_Rb76_8Fd32,
+    GFSK_Rb100Fd47,
+    GFSK_Rb250Fd127
+  } ModemConfigChoice;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef RAM_SPILL_STORAGE_H
+#define RAM_SPILL_STORAGE_H
+
+#include <string.h>
+#include <RecordStore.h>
+
+// SpillStorage over a RAM array that behaves like erased NOR flash, for host runs of RecordStore
+template <uint8_t Pages, uint16_t PageSize>
+class RamSpillStorage : public SpillStorage {
+public:
+  RamSpillStorage() { memset(pages, 0xFF, sizeof(pages)); }
+
+  uint8_t pageCount() const override { return Pages; }
+  uint16_t pageSize() const override { return PageSize; }
+  const uint8_t* page(uint8_t index) const override { return pages[index]; }
+
+  bool erase(uint8_t index) override {
+    memset(pages[index], 0xFF, PageSize);
+    return true;
+  }
+
+  bool program(uint8_t index, uint16_t offset, const uint8_t* data, uint16_t len) override {
+    if ((offset & 1) || (len & 1) || offset + len > PageSize) {
+      return false;
+    }
+    for (uint16_t i = 0; i < len; i++) {
+      pages[index][offset + i] &= data[i];  // Programming only clears bits
+    }
+    return true;
+  }
+
+private:
+  uint8_t pages[Pages][PageSize];
+};
+
+#endif
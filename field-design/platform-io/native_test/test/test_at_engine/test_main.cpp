@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <string>
+#include <string.h>
+#include <AtEngine.h>
+
+// Modem port whose TX buffer takes room bytes per poll, as the core's does while the UART drains it
+class FakePort : public Stream {
+public:
+  FakePort() : room(0), reading(0) {}
+
+  int available() override { return (int)(input.size() - reading); }
+  int read() override { return reading < input.size() ? (uint8_t)input[reading++] : -1; }
+  int availableForWrite() override { return (int)room; }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    TEST_ASSERT_TRUE(size <= room);  // A write past the free space would block the caller
+    output.append((const char*)buffer, size);
+    room -= size;
+    return size;
+  }
+
+  void reply(const char* text) { input += text; }
+
+  size_t room;
+  std::string output;
+  std::string input;
+  size_t reading;
+};
+
+struct Done {
+  bool called;
+  AtResult result;
+};
+
+static void onDone(AtResult result, void* context) {
+  Done* done = (Done*)context;
+  done->called = true;
+  done->result = result;
+}
+
+// One pass through loop() with room bytes of TX space, 10 ms after the previous one
+static void pollWith(AtEngine& engine, FakePort& port, size_t room) {
+  hostMillis += 10;
+  port.room = room;
+  engine.poll();
+}
+
+void setUp() {
+  hostMillis = 1000;
+}
+
+void tearDown() {}
+
+void test_command_trickles_out_and_times_out_from_last_byte() {
+  FakePort port;
+  AtEngine engine(port);
+  Done done = {false, AT_RESULT_OK};
+  TEST_ASSERT_TRUE(engine.send("AT+CGATT?", 100, onDone, &done));
+
+  pollWith(engine, port, 0);  // TX buffer full: nothing written, nothing waited on
+  TEST_ASSERT_EQUAL_STRING("", port.output.c_str());
+  while (port.output.size() < strlen("AT+CGATT?\r\n")) {
+    size_t before = port.output.size();
+    pollWith(engine, port, 4);
+    TEST_ASSERT_EQUAL(before + 4 < 11 ? before + 4 : 11, port.output.size());
+  }
+  TEST_ASSERT_EQUAL_STRING("AT+CGATT?\r\n", port.output.c_str());
+  uint32_t lastByteAt = hostMillis;
+
+  // More than the timeout since the command started, less since its last byte
+  while (hostMillis - lastByteAt < 90) {
+    pollWith(engine, port, 64);
+  }
+  TEST_ASSERT_FALSE(done.called);
+  pollWith(engine, port, 64);
+  TEST_ASSERT_TRUE(done.called);
+  TEST_ASSERT_EQUAL(AT_RESULT_TIMEOUT, done.result);
+}
+
+void test_prompted_payload_trickles_out() {
+  FakePort port;
+  AtEngine engine(port);
+  Done done = {false, AT_RESULT_ERROR};
+
+  std::string payload(512, 'A');  // An MQTT batch or an SMS PDU part in hex
+  TEST_ASSERT_TRUE(engine.sendWithExternalPayload("AT+MQTTPUB=\"t\"", payload.c_str(), 200, onDone, &done));
+  for (int i = 0; i < 4; i++) {
+    pollWith(engine, port, 8);
+  }
+  TEST_ASSERT_EQUAL_STRING("AT+MQTTPUB=\"t\"\r\n", port.output.c_str());
+
+  port.output.clear();
+  port.reply("\r\n> ");
+  int polls = 0;
+  while (port.output.size() < payload.size() + 1) {
+    pollWith(engine, port, 16);
+    polls++;
+  }
+  TEST_ASSERT_EQUAL(33, polls);  // 513 bytes at 16 per pass: loop() kept running throughout
+  TEST_ASSERT_EQUAL(AT_CTRL_Z, port.output[payload.size()]);
+  TEST_ASSERT_TRUE(port.output.compare(0, payload.size(), payload) == 0);
+
+  // 330 ms went by writing, beyond the 200 ms timeout, which only starts now
+  TEST_ASSERT_FALSE(done.called);
+  port.reply("\r\nOK\r\n");
+  pollWith(engine, port, 16);
+  TEST_ASSERT_TRUE(done.called);
+  TEST_ASSERT_EQUAL(AT_RESULT_OK, done.result);
+}
+
+void test_error_cuts_payload_short() {
+  FakePort port;
+  AtEngine engine(port);
+  Done done = {false, AT_RESULT_OK};
+  TEST_ASSERT_TRUE(engine.sendWithPayload("AT+CMGS=20", "0011000C915247", 1000, onDone, &done));
+  pollWith(engine, port, 64);
+  port.reply("> ");
+  pollWith(engine, port, 4);
+  port.reply("\r\n+CMS ERROR: 304\r\n");
+  pollWith(engine, port, 4);
+  TEST_ASSERT_TRUE(done.called);
+  TEST_ASSERT_EQUAL(AT_RESULT_CME_ERROR, done.result);
+
+  // The rest of the payload and the Ctrl+Z are dropped, and the next command goes out whole
+  engine.send("AT", 1000);
+  pollWith(engine, port, 64);
+  TEST_ASSERT_EQUAL_STRING("AT+CMGS=20\r\n0011AT\r\n", port.output.c_str());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_command_trickles_out_and_times_out_from_last_byte);
+  RUN_TEST(test_prompted_payload_trickles_out);
+  RUN_TEST(test_error_cuts_payload_short);
+  return UNITY_END();
+}
@@ -0,0 +1,71 @@
+#include <unity.h>
+#include <string.h>
+#include <AtParser.h>
+
+void setUp() {}
+void tearDown() {}
+
+// Feed text and return the kind of the last line it completed
+static AtLineType feedAll(AtParser& parser, const char* text) {
+  AtLineType last = AT_LINE_NONE;
+  for (; *text; text++) {
+    AtLineType type = parser.feed(*text);
+    if (type != AT_LINE_NONE) {
+      last = type;
+    }
+  }
+  return last;
+}
+
+void test_final_result_codes() {
+  AtParser parser;
+  TEST_ASSERT_EQUAL(AT_LINE_OK, feedAll(parser, "\r\nOK\r\n"));
+  TEST_ASSERT_EQUAL(AT_LINE_ERROR, feedAll(parser, "\r\nERROR\r\n"));
+  TEST_ASSERT_EQUAL(AT_LINE_TEXT, feedAll(parser, "OKAY\r\n"));
+}
+
+void test_cme_error_code() {
+  AtParser parser;
+  TEST_ASSERT_EQUAL(AT_LINE_CME_ERROR, feedAll(parser, "+CME ERROR: 58\r\n"));
+  TEST_ASSERT_EQUAL_INT(58, parser.errorCode());
+  TEST_ASSERT_EQUAL(AT_LINE_CME_ERROR, feedAll(parser, "+CMS ERROR:unknown\r\n"));
+  TEST_ASSERT_EQUAL_INT(-1, parser.errorCode());
+}
+
+void test_text_line_and_urc() {
+  // The line stays readable until the next byte is fed
+  AtParser parser;
+  TEST_ASSERT_EQUAL(AT_LINE_TEXT, feedAll(parser, "\r\n+CSQ: 21,99\r"));
+  TEST_ASSERT_EQUAL_STRING("+CSQ: 21,99", parser.line());
+  TEST_ASSERT_TRUE(AtParser::startsWith(parser.line(), "+CSQ:"));
+  TEST_ASSERT_FALSE(AtParser::startsWith(parser.line(), "+CREG:"));
+}
+
+void test_prompt_without_terminator() {
+  AtParser parser;
+  feedAll(parser, "AT+CMGS=\"+254700000000\"\r\n");
+  TEST_ASSERT_EQUAL(AT_LINE_PROMPT, parser.feed('>'));
+  TEST_ASSERT_EQUAL(AT_LINE_NONE, parser.feed(' '));
+}
+
+void test_long_line_truncated() {
+  AtParser parser;
+  for (int i = 0; i < AT_LINE_MAX + 20; i++) {
+    parser.feed('x');
+  }
+  TEST_ASSERT_EQUAL(AT_LINE_TEXT, parser.feed('\r'));
+  TEST_ASSERT_TRUE(parser.truncated());
+  TEST_ASSERT_EQUAL(AT_LINE_MAX - 1, parser.lineLength());
+  TEST_ASSERT_EQUAL(AT_LINE_OK, feedAll(parser, "\nOK\r\n"));
+  TEST_ASSERT_FALSE(parser.truncated());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_final_result_codes);
+  RUN_TEST(test_cme_error_code);
+  RUN_TEST(test_text_line_and_urc);
+  RUN_TEST(test_prompt_without_terminator);
+  RUN_TEST(test_long_line_truncated);
+  return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <string.h>
+#include <RecordStore.h>
+#include <BatchCodec.h>
+
+#define DECODED_MAX 64
+
+struct Decoded {
+  StoredRecord records[DECODED_MAX];
+  uint16_t count;
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void collect(const StoredRecord& record, void* context) {
+  Decoded* decoded = (Decoded*)context;
+  if (decoded->count < DECODED_MAX) {
+    decoded->records[decoded->count++] = record;
+  }
+}
+
+// Records with negative temperatures, invalid flags, out-of-order timestamps and several nodes
+static void fill(RecordStore& store, uint16_t count) {
+  for (uint16_t i = 0; i < count; i++) {
+    StoredRecord record;
+    record.timestamp = i == 3 ? 5 : 1000 + i * 37;
+    record.reading.nodeId = (uint8_t)(1 + i % 3);
+    record.reading.sequence = (uint8_t)i;
+    record.reading.temperature = (int16_t)(i % 2 ? -1250 + i : 2124 + i);
+    record.reading.humidity = (uint16_t)(6937 + i);
+    record.reading.pressure = 814870 + i;
+    record.reading.flags = i == 5 ? SENSOR_FLAG_TH_INVALID : 0;
+    store.append(record);
+  }
+}
+
+static void checkRoundTrip(BatchMode mode) {
+  RecordStore store;
+  fill(store, 12);
+
+  char batch[512];
+  size_t written = 0;
+  uint16_t encoded = encodeBatch(store, mode, 4321, batch, sizeof(batch), written);
+  TEST_ASSERT_EQUAL_UINT16(12, encoded);
+
+  static Decoded decoded;
+  decoded.count = 0;
+  uint32_t now = 0;
+  TEST_ASSERT_EQUAL_INT32(12, decodeBatch(batch, written, now, collect, &decoded));
+  TEST_ASSERT_EQUAL_UINT32(4321, now);
+
+  for (uint16_t i = 0; i < encoded; i++) {
+    StoredRecord expected;
+    TEST_ASSERT_TRUE(store.at(i, expected));
+    const StoredRecord& actual = decoded.records[i];
+    TEST_ASSERT_EQUAL_UINT32(expected.timestamp, actual.timestamp);
+    TEST_ASSERT_EQUAL_UINT8(expected.reading.nodeId, actual.reading.nodeId);
+    TEST_ASSERT_EQUAL_INT16(expected.reading.temperature, actual.reading.temperature);
+    TEST_ASSERT_EQUAL_UINT16(expected.reading.humidity, actual.reading.humidity);
+    TEST_ASSERT_EQUAL_UINT32(expected.reading.pressure, actual.reading.pressure);
+    TEST_ASSERT_EQUAL_UINT8(expected.reading.flags, actual.reading.flags);
+  }
+}
+
+void test_text_round_trip() {
+  checkRoundTrip(BATCH_TEXT);
+}
+
+void test_binary_round_trip() {
+  checkRoundTrip(BATCH_BINARY);
+}
+
+void test_decode_needs_no_terminator() {
+  const char text[] = "B1,100,90;7,0,2000,5000,1012000,0;7,5,2100,5100,1013000,0XXX";
+  static Decoded decoded;
+  decoded.count = 0;
+  uint32_t now = 0;
+  TEST_ASSERT_EQUAL_INT32(2, decodeBatch(text, strlen(text) - 3, now, collect, &decoded));
+  TEST_ASSERT_EQUAL_UINT32(95, decoded.records[1].timestamp);
+  TEST_ASSERT_EQUAL_UINT32(1013000, decoded.records[1].reading.pressure);
+}
+
+void test_decode_rejects_malformed() {
+  const char* const BAD[] = {
+    "",
+    "N:1,T:21.24,H:69.37,P:814.87",
+    "B2,100,90;7,0,2000,5000,1012000,0",
+    "B1,100",
+    "B1,100,90;7,0,2000,5000,1012000",
+    "B1,100,90;7,0,2000,70000,1012000,0",
+    "B1,100,90;256,0,2000,5000,1012000,0",
+    "B1,100,90;7,0,2000,5000,1012000,0;",
+    "b1:AAAA",
+    "b1:ZAAAAAAAAAAB*A==",
+  };
+  for (size_t i = 0; i < sizeof(BAD) / sizeof(BAD[0]); i++) {
+    static Decoded decoded;
+    decoded.count = 0;
+    uint32_t now = 0;
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(-1, decodeBatch(BAD[i], strlen(BAD[i]), now, collect, &decoded), BAD[i]);
+  }
+}
+
+void test_binary_truncated_record() {
+  RecordStore store;
+  fill(store, 2);
+  char batch[128];
+  size_t written = 0;
+  TEST_ASSERT_EQUAL_UINT16(2, encodeBatch(store, BATCH_BINARY, 10, batch, sizeof(batch), written));
+
+  // Base64 of whole bytes only, cut inside the second record
+  static Decoded decoded;
+  decoded.count = 0;
+  uint32_t now = 0;
+  TEST_ASSERT_EQUAL_INT32(-1, decodeBatch(batch, written - 8, now, collect, &decoded));
+  TEST_ASSERT_EQUAL_UINT16(1, decoded.count);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_text_round_trip);
+  RUN_TEST(test_binary_round_trip);
+  RUN_TEST(test_decode_needs_no_terminator);
+  RUN_TEST(test_decode_rejects_malformed);
+  RUN_TEST(test_binary_truncated_record);
+  return UNITY_END();
+}
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <SensorPacket.h>
+#include <GatewayText.h>
+#include <AtParser.h>
+#include <RecordStore.h>
+#include <BatchCodec.h>
+#include <HeapMonitor.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+/* Hot-path benchmarks on the build host.
+ * Each reports time and (on x86) TSC cycles per operation and fails when an
+ * operation allocates or runs past its budget. The budgets leave a wide margin
+ * over a desktop host so only real regressions trip them; tighten or loosen
+ * them with -D BENCH_*_NS in build_flags.
+ */
+
+#define BENCH_ITERATIONS 100000
+
+#ifndef BENCH_FRAME_NS
+#define BENCH_FRAME_NS 500    // Summary encode + decode
+#endif
+#ifndef BENCH_FORMAT_NS
+#define BENCH_FORMAT_NS 1000  // Reading frame parse + text formatting
+#endif
+#ifndef BENCH_AT_BYTE_NS
+#define BENCH_AT_BYTE_NS 20   // Per byte through AtParser
+#endif
+#ifndef BENCH_BATCH_NS
+#define BENCH_BATCH_NS 100000 // One full text or binary batch
+#endif
+
+// Keeps results alive so the optimiser cannot drop the measured work
+static volatile uint32_t sink;
+
+struct BenchTimer {
+  std::chrono::steady_clock::time_point start;
+  unsigned long long startCycles;
+  BenchTimer() : start(std::chrono::steady_clock::now()), startCycles(BENCH_CYCLES()) {}
+
+  // Report per-operation cost and return nanoseconds per operation
+  double report(const char* name, uint32_t operations, const char* unit) {
+    unsigned long long cycles = BENCH_CYCLES() - startCycles;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("%-28s %10.1f ns/%s %10.1f cycles/%s\n", name, ns / operations, unit, (double)cycles / operations, unit);
+    return ns / operations;
+  }
+};
+
+void setUp() {
+  heapMonitorMark();
+}
+
+void tearDown() {
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, heapOperationsSinceMark(), "hot path allocated");
+}
+
+void test_summary_frame_encode_decode() {
+  SensorSummary summary = {{3, 0, 2121, 6900, 814170, 0}, 4, 2100, 2140, 6880, 6920, 814150, 814190};
+  uint8_t frame[SENSOR_SUMMARY_FRAME_LEN];
+  SensorSummary decoded;
+
+  BenchTimer timer;
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    summary.reading.sequence = (uint8_t)i;
+    size_t len = encodeSensorSummary(summary, frame, sizeof(frame));
+    decodeSensorSummary(frame, len, decoded);
+    sink = sink + decoded.reading.sequence;
+  }
+  double ns = timer.report("summary encode+decode", BENCH_ITERATIONS, "frame");
+
+  printf("%-28s %10u bytes/frame (%u bytes/reading frame)\n", "summary frame size", SENSOR_SUMMARY_FRAME_LEN,
+         SENSOR_READING_FRAME_LEN);
+  TEST_ASSERT_EQUAL(SENSOR_SUMMARY_FRAME_LEN, encodeSensorSummary(summary, frame, sizeof(frame)));
+  TEST_ASSERT_LESS_OR_EQUAL(BENCH_FRAME_NS, (uint32_t)ns);
+}
+
+void test_reading_parse_and_format() {
+  SensorReading reading = {12, 0, 2123, 6893, 814180, 0};
+  uint8_t frame[SENSOR_READING_FRAME_LEN];
+  encodeSensorReading(reading, frame, sizeof(frame));
+
+  size_t textBytes = 0;
+  BenchTimer timer;
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    frame[2] = (uint8_t)i;
+    SensorReading parsed;
+    parseSensorData(frame, sizeof(frame), parsed);
+    FixedString<48> text;
+    formatSensorData(parsed, text);
+    textBytes += text.length();
+  }
+  double ns = timer.report("reading parse+format", BENCH_ITERATIONS, "frame");
+  printf("%-28s %10.1f bytes/frame\n", "formatted text", (double)textBytes / BENCH_ITERATIONS);
+  sink = sink + textBytes;
+  TEST_ASSERT_LESS_OR_EQUAL(BENCH_FORMAT_NS, (uint32_t)ns);
+}
+
+void test_at_response_throughput() {
+  // One MQTT publish exchange, a signal query, an SMS prompt and a GPS answer, as the A9G sends them
+  static const char transcript[] =
+      "AT+MQTTPUB=\"/test/stm32/data\",\"N:1,T:21.23,H:68.93,P:814.18\",0,0,0\r\r\nOK\r\n"
+      "AT+CSQ\r\r\n+CSQ: 21,99\r\n\r\nOK\r\n"
+      "AT+CMGS=\"+254700000000\"\r\r\n> "
+      "\r\n+CMGS: 12\r\n\r\nOK\r\n"
+      "AT+CGPSINFO\r\r\n+CGPSINFO: -1.0921,36.9506,1650.2,20241001\r\n\r\nOK\r\n"
+      "\r\n+CME ERROR: 58\r\n";
+  const uint32_t rounds = BENCH_ITERATIONS / 10;
+  const size_t length = sizeof(transcript) - 1;
+
+  AtParser parser;
+  uint32_t finals = 0;
+  BenchTimer timer;
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < length; i++) {
+      AtLineType type = parser.feed(transcript[i]);
+      finals += type == AT_LINE_OK || type == AT_LINE_CME_ERROR;
+    }
+  }
+  double ns = timer.report("AT response parse", rounds * length, "byte");
+  printf("%-28s %10.1f MB/s\n", "AT parser throughput", 1000.0 / ns);
+  TEST_ASSERT_EQUAL_UINT32(rounds * 5, finals);
+  TEST_ASSERT_LESS_OR_EQUAL(BENCH_AT_BYTE_NS, (uint32_t)ns + 1);
+}
+
+void test_batch_encode() {
+  static RecordStore store;
+  for (uint32_t i = 0; i < STORE_RAM_RECORDS; i++) {
+    StoredRecord record = {1000 + i * 60, {(uint8_t)(1 + i % 8), (uint8_t)i, (int16_t)(2100 + i), 6900, 814170, 0}};
+    store.append(record);
+  }
+
+  static const BatchMode modes[] = {BATCH_TEXT, BATCH_BINARY};
+  static const char* names[] = {"text batch encode", "binary batch encode"};
+  for (uint8_t m = 0; m < 2; m++) {
+    char batch[1024];
+    size_t written = 0;
+    uint16_t records = 0;
+    const uint32_t rounds = 1000;
+
+    BenchTimer timer;
+    for (uint32_t i = 0; i < rounds; i++) {
+      records = encodeBatch(store, modes[m], 1000 + STORE_RAM_RECORDS * 60, batch, sizeof(batch), written);
+    }
+    double ns = timer.report(names[m], rounds, "batch");
+    printf("%-28s %10.1f bytes/record (%u records)\n", names[m], (double)written / records, records);
+    TEST_ASSERT_GREATER_THAN(0, records);
+    TEST_ASSERT_LESS_OR_EQUAL(BENCH_BATCH_NS, (uint32_t)ns);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_summary_frame_encode_decode);
+  RUN_TEST(test_reading_parse_and_format);
+  RUN_TEST(test_at_response_throughput);
+  RUN_TEST(test_batch_encode);
+  return UNITY_END();
+}
@@ -0,0 +1,199 @@
+#include <unity.h>
+#include <string.h>
+#include <ConfigStore.h>
+#include <RamSpillStorage.h>
+
+// Small pages so a few dozen updates already compact; erases are counted per page, and can be made to fail
+class CountingStorage : public RamSpillStorage<2, 128> {
+public:
+  CountingStorage() : failErase(false) { erases[0] = erases[1] = 0; }
+
+  bool erase(uint8_t index) override {
+    if (failErase) {
+      return false;
+    }
+    erases[index]++;
+    return RamSpillStorage<2, 128>::erase(index);
+  }
+
+  uint32_t erases[2];
+  bool failErase;
+};
+
+enum Key {
+  KEY_INTERVAL,
+  KEY_PHONE,
+  KEY_FREQUENCY
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_defaults_until_set_and_kept_across_reset() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  TEST_ASSERT_FALSE(config.has(KEY_INTERVAL));
+  TEST_ASSERT_EQUAL_INT32(60000, config.number(KEY_INTERVAL, 60000));
+  TEST_ASSERT_EQUAL_STRING("+254700000000", config.text(KEY_PHONE, "+254700000000"));
+
+  TEST_ASSERT_TRUE(config.setNumber(KEY_INTERVAL, 300000));
+  TEST_ASSERT_TRUE(config.setText(KEY_PHONE, "+254711111111"));
+  TEST_ASSERT_EQUAL_INT32(300000, config.number(KEY_INTERVAL, 60000));
+  TEST_ASSERT_EQUAL_STRING("+254711111111", config.text(KEY_PHONE, ""));
+
+  // Text is no number, and bytes without a NUL are no text
+  TEST_ASSERT_EQUAL_INT32(-1, config.number(KEY_PHONE, -1));
+  TEST_ASSERT_TRUE(config.set(KEY_FREQUENCY, "433", 3));
+  TEST_ASSERT_EQUAL_STRING("none", config.text(KEY_FREQUENCY, "none"));
+  TEST_ASSERT_TRUE(config.remove(KEY_FREQUENCY));
+
+  ConfigStore rebooted(flash);
+  rebooted.begin();
+  TEST_ASSERT_EQUAL_INT32(300000, rebooted.number(KEY_INTERVAL, 60000));
+  TEST_ASSERT_EQUAL_STRING("+254711111111", rebooted.text(KEY_PHONE, ""));
+  TEST_ASSERT_FALSE(rebooted.has(KEY_FREQUENCY));
+  TEST_ASSERT_EQUAL_UINT32(0, flash.erases[0] + flash.erases[1]);
+}
+
+void test_text_reads_from_flash_without_copy() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setText(KEY_PHONE, "+254711111111");
+  const char* text = config.text(KEY_PHONE, "");
+  TEST_ASSERT_TRUE((const uint8_t*)text >= flash.page(0) && (const uint8_t*)text < flash.page(0) + 128);
+}
+
+void test_unchanged_value_writes_nothing() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setNumber(KEY_INTERVAL, 300000);
+  uint16_t left = config.freeBytes();
+  TEST_ASSERT_TRUE(config.setNumber(KEY_INTERVAL, 300000));
+  TEST_ASSERT_EQUAL_UINT16(left, config.freeBytes());
+  TEST_ASSERT_TRUE(config.remove(KEY_FREQUENCY));  // Not set: nothing to write
+  TEST_ASSERT_EQUAL_UINT16(left, config.freeBytes());
+}
+
+void test_updates_compact_into_alternate_pages() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setText(KEY_PHONE, "+254711111111");
+
+  for (int32_t i = 0; i < 200; i++) {
+    TEST_ASSERT_TRUE(config.setNumber(KEY_INTERVAL, 10000 + i));
+  }
+  TEST_ASSERT_EQUAL_INT32(10199, config.number(KEY_INTERVAL, 0));
+  TEST_ASSERT_EQUAL_STRING("+254711111111", config.text(KEY_PHONE, ""));
+
+  // 120 bytes of records per page leave room for about a dozen eight-byte updates next to the phone number
+  // between erases, and the two pages share the erases
+  TEST_ASSERT_TRUE(config.generation() >= 15);
+  TEST_ASSERT_UINT32_WITHIN(1, flash.erases[0], flash.erases[1]);
+  TEST_ASSERT_TRUE(config.generation() <= 200 / 10);
+
+  ConfigStore rebooted(flash);
+  rebooted.begin();
+  TEST_ASSERT_EQUAL_INT32(10199, rebooted.number(KEY_INTERVAL, 0));
+  TEST_ASSERT_EQUAL_UINT32(config.generation(), rebooted.generation());
+}
+
+void test_removed_key_reads_default_after_compaction() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setNumber(KEY_FREQUENCY, 433920);
+  TEST_ASSERT_TRUE(config.remove(KEY_FREQUENCY));
+  TEST_ASSERT_EQUAL_INT32(433000, config.number(KEY_FREQUENCY, 433000));
+
+  uint32_t generation = config.generation();
+  while (config.generation() == generation) {
+    config.setNumber(KEY_INTERVAL, (int32_t)config.freeBytes());
+  }
+  TEST_ASSERT_FALSE(config.has(KEY_FREQUENCY));
+
+  ConfigStore rebooted(flash);
+  rebooted.begin();
+  TEST_ASSERT_FALSE(rebooted.has(KEY_FREQUENCY));
+}
+
+void test_torn_record_is_skipped() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setNumber(KEY_INTERVAL, 300000);
+
+  // A reset halfway through the next update: header written, value cut off
+  uint16_t end = 128 - config.freeBytes();
+  const uint8_t torn[] = {KEY_INTERVAL, 4, 0x12, 0x34, 0x20, 0xA1};
+  flash.program(0, end, torn, sizeof(torn));
+
+  ConfigStore rebooted(flash);
+  rebooted.begin();
+  TEST_ASSERT_EQUAL_INT32(300000, rebooted.number(KEY_INTERVAL, 0));
+  TEST_ASSERT_TRUE(rebooted.setNumber(KEY_INTERVAL, 600000));
+  TEST_ASSERT_EQUAL_UINT16(config.freeBytes() - 16, rebooted.freeBytes());  // Past the torn record, not over it
+
+  ConfigStore again(flash);
+  again.begin();
+  TEST_ASSERT_EQUAL_INT32(600000, again.number(KEY_INTERVAL, 0));
+}
+
+void test_newer_page_wins_after_interrupted_compaction() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  config.setText(KEY_PHONE, "+254711111111");
+
+  // The reset hits between the new header and the erase of the old page, leaving both valid
+  flash.failErase = true;
+  uint32_t generation = config.generation();
+  int32_t last = 0;
+  while (config.generation() == generation) {
+    TEST_ASSERT_TRUE(config.setNumber(KEY_INTERVAL, ++last));
+  }
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_PAGE_MAGIC, flash.page(0)[0] | (flash.page(0)[1] << 8));
+  TEST_ASSERT_EQUAL_UINT16(CONFIG_PAGE_MAGIC, flash.page(1)[0] | (flash.page(1)[1] << 8));
+
+  flash.failErase = false;
+  ConfigStore rebooted(flash);
+  rebooted.begin();
+  TEST_ASSERT_EQUAL_INT32(last, rebooted.number(KEY_INTERVAL, 0));
+  TEST_ASSERT_EQUAL_STRING("+254711111111", rebooted.text(KEY_PHONE, ""));
+  TEST_ASSERT_EQUAL_UINT8(0xFF, flash.page(0)[0]);  // The older page was erased
+}
+
+void test_out_of_range_and_no_flash() {
+  CountingStorage flash;
+  ConfigStore config(flash);
+  config.begin();
+  TEST_ASSERT_FALSE(config.setNumber(CONFIG_KEYS, 1));
+  char tooLong[CONFIG_VALUE_MAX + 1];
+  memset(tooLong, 'a', sizeof(tooLong) - 1);
+  tooLong[sizeof(tooLong) - 1] = '\0';
+  TEST_ASSERT_FALSE(config.setText(KEY_PHONE, tooLong));
+  TEST_ASSERT_FALSE(config.has(KEY_PHONE));
+
+  RamSpillStorage<1, 128> onePage;
+  ConfigStore none(onePage);
+  none.begin();
+  TEST_ASSERT_FALSE(none.setNumber(KEY_INTERVAL, 1));
+  TEST_ASSERT_EQUAL_INT32(60000, none.number(KEY_INTERVAL, 60000));
+  TEST_ASSERT_EQUAL_UINT16(0, none.freeBytes());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults_until_set_and_kept_across_reset);
+  RUN_TEST(test_text_reads_from_flash_without_copy);
+  RUN_TEST(test_unchanged_value_writes_nothing);
+  RUN_TEST(test_updates_compact_into_alternate_pages);
+  RUN_TEST(test_removed_key_reads_default_after_compaction);
+  RUN_TEST(test_torn_record_is_skipped);
+  RUN_TEST(test_newer_page_wins_after_interrupted_compaction);
+  RUN_TEST(test_out_of_range_and_no_flash);
+  return UNITY_END();
+}
@@ -0,0 +1,80 @@
+#include <unity.h>
+#include <string.h>
+#include <GatewayText.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_format_valid_reading() {
+  SensorReading reading = {12, 0, 2123, 6893, 814180, 0};
+  FixedString<64> text;
+  formatSensorData(reading, text);
+  TEST_ASSERT_EQUAL_STRING("N:12,T:21.23,H:68.93,P:814.18", text.c_str());
+}
+
+void test_format_negative_and_rounded_pressure() {
+  // 81417.5 Pa rounds to the whole Pascal
+  SensorReading reading = {1, 0, -5, 0, 814175, 0};
+  FixedString<64> text;
+  formatSensorData(reading, text);
+  TEST_ASSERT_EQUAL_STRING("N:1,T:-0.05,H:0.00,P:814.18", text.c_str());
+}
+
+void test_format_invalid_channels() {
+  SensorReading reading = {2, 0, 2123, 6893, 814180, SENSOR_FLAG_TH_INVALID};
+  FixedString<64> text;
+  formatSensorData(reading, text);
+  TEST_ASSERT_EQUAL_STRING("N:2,T:9999.00,H:9999.00,P:814.18", text.c_str());
+
+  reading.flags = SENSOR_FLAG_PRESSURE_INVALID;
+  text.clear();
+  formatSensorData(reading, text);
+  TEST_ASSERT_EQUAL_STRING("N:2,T:21.23,H:68.93,P:9999.00", text.c_str());
+}
+
+void test_format_truncates_without_overrun() {
+  SensorReading reading = {12, 0, 2123, 6893, 814180, 0};
+  FixedString<12> text;
+  formatSensorData(reading, text);
+  TEST_ASSERT_TRUE(text.overflowed());
+  TEST_ASSERT_EQUAL(11, text.length());
+}
+
+void test_parse_sensor_data_frame() {
+  SensorReading reading = {4, 8, 1500, 5000, 1013250, 0};
+  uint8_t frame[SENSOR_READING_FRAME_LEN];
+  encodeSensorReading(reading, frame, sizeof(frame));
+
+  SensorReading decoded;
+  TEST_ASSERT_TRUE(parseSensorData(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT8(4, decoded.nodeId);
+  TEST_ASSERT_FALSE(parseSensorData(frame, 3, decoded));
+}
+
+void test_gps_info_with_fix() {
+  size_t len = 0;
+  const char* data = parseGpsInfo("+CGPSINFO:  -1.0921,36.9506,1650.2,20241001  ", len);
+  TEST_ASSERT_NOT_NULL(data);
+  const char* expected = "-1.0921,36.9506,1650.2,20241001";
+  TEST_ASSERT_EQUAL(strlen(expected), len);
+  TEST_ASSERT_EQUAL_INT(0, strncmp(data, expected, len));
+}
+
+void test_gps_info_without_fix() {
+  size_t len = 0;
+  TEST_ASSERT_NULL(parseGpsInfo("+CGPSINFO: ,,,,,,,,", len));
+  TEST_ASSERT_NULL(parseGpsInfo("+CGPSINFO:   ", len));
+  TEST_ASSERT_NULL(parseGpsInfo("+CSQ: 20,99", len));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_format_valid_reading);
+  RUN_TEST(test_format_negative_and_rounded_pressure);
+  RUN_TEST(test_format_invalid_channels);
+  RUN_TEST(test_format_truncates_without_overrun);
+  RUN_TEST(test_parse_sensor_data_frame);
+  RUN_TEST(test_gps_info_with_fix);
+  RUN_TEST(test_gps_info_without_fix);
+  return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <unity.h>
+#include <IrrigationEngine.h>
+
+// Zone 0 waters on heat only, zone 1 on dryness only, both driven by node 1 and watered by node 5 and 6
+static const IrrigationZone ZONES[] = {
+  {"Beans", 1, 5, 2600, IRRIGATION_NO_HUMIDITY_LIMIT, 100, 300, 600, 300000},
+  {"Maize", 1, 6, IRRIGATION_NO_TEMPERATURE_LIMIT, 5500, 100, 300, 600, 300000}
+};
+
+void setUp() {}
+void tearDown() {}
+
+static SensorReading makeReading(uint8_t node, int16_t temperature, uint16_t humidity) {
+  SensorReading reading = {node, 0, temperature, humidity, 1013000, 0};
+  return reading;
+}
+
+static void feed(IrrigationEngine& engine, int16_t temperature, uint16_t humidity, uint8_t count, uint32_t now) {
+  for (uint8_t i = 0; i < count; i++) {
+    engine.update(makeReading(1, temperature, humidity), now);
+  }
+}
+
+void test_rolling_mean_follows_readings() {
+  IrrigationEngine engine(ZONES, 2);
+  engine.update(makeReading(1, 2000, 6000), 0);
+  TEST_ASSERT_EQUAL_INT16(2000, engine.temperature(0));
+  engine.update(makeReading(1, 2400, 6000), 0);
+  TEST_ASSERT_EQUAL_INT16(2100, engine.temperature(0));  // A quarter of the way to the new reading
+
+  SensorReading failed = makeReading(1, 9000, 0);
+  failed.flags = SENSOR_FLAG_TH_INVALID;
+  engine.update(failed, 0);
+  TEST_ASSERT_EQUAL_INT16(2100, engine.temperature(0));
+  TEST_ASSERT_EQUAL_UINT8(2, engine.samples(0));
+
+  engine.update(makeReading(2, 9000, 0), 0);  // Another node's reading drives neither zone
+  TEST_ASSERT_EQUAL_INT16(2100, engine.temperature(0));
+}
+
+void test_waits_for_min_samples() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision;
+  feed(engine, 3000, 6000, IRRIGATION_MIN_SAMPLES - 1, 0);
+  TEST_ASSERT_FALSE(engine.poll(0, decision));
+
+  feed(engine, 3000, 6000, 1, 0);
+  TEST_ASSERT_TRUE(engine.poll(0, decision));
+  TEST_ASSERT_EQUAL_UINT8(0, decision.zone);
+  TEST_ASSERT_EQUAL_UINT8(5, decision.valveNode);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_OPEN, decision.action);
+  TEST_ASSERT_EQUAL_UINT16(600, decision.seconds);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_REASON_HOT, decision.reasons);
+  TEST_ASSERT_EQUAL(IRRIGATION_WATERING, engine.mode(0));
+  TEST_ASSERT_FALSE(engine.poll(0, decision));  // Zone 1 is humid enough, and zone 0 is already open
+}
+
+void test_hysteresis_holds_valve_open() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision;
+  feed(engine, 2700, 6000, 3, 0);
+  TEST_ASSERT_TRUE(engine.poll(0, decision));
+
+  feed(engine, 2550, 6000, 8, 1000);  // Below the limit, but not by the hysteresis
+  TEST_ASSERT_FALSE(engine.poll(1000, decision));
+
+  feed(engine, 2400, 6000, 8, 2000);
+  TEST_ASSERT_TRUE(engine.poll(2000, decision));
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_CLOSE, decision.action);
+  TEST_ASSERT_EQUAL_UINT16(0, decision.seconds);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_REASON_RECOVERED, decision.reasons);
+  TEST_ASSERT_EQUAL(IRRIGATION_IDLE, engine.mode(0));
+}
+
+void test_watering_time_then_soak() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision;
+  feed(engine, 2000, 5000, 3, 0);
+  TEST_ASSERT_TRUE(engine.poll(0, decision));
+  TEST_ASSERT_EQUAL_UINT8(1, decision.zone);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_REASON_DRY, decision.reasons);
+
+  feed(engine, 2000, 5000, 1, 599000);
+  TEST_ASSERT_FALSE(engine.poll(599000, decision));
+  feed(engine, 2000, 5000, 1, 600000);
+  TEST_ASSERT_TRUE(engine.poll(600000, decision));
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_CLOSE, decision.action);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_REASON_TIMEOUT | IRRIGATION_REASON_DRY, decision.reasons);
+  TEST_ASSERT_EQUAL(IRRIGATION_SOAKING, engine.mode(1));
+
+  feed(engine, 2000, 5000, 1, 800000);
+  TEST_ASSERT_FALSE(engine.poll(800000, decision));  // Still soaking
+  TEST_ASSERT_TRUE(engine.poll(900000, decision));   // Soak over and still dry, so it opens again
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_OPEN, decision.action);
+}
+
+void test_stale_sensor_closes_valve() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision;
+  feed(engine, 3000, 6000, 3, 1000);
+  TEST_ASSERT_TRUE(engine.poll(1000, decision));
+  TEST_ASSERT_FALSE(engine.poll(500, decision));  // A reading stamped after the poll's millis() is not stale
+
+  TEST_ASSERT_TRUE(engine.poll(1000 + IRRIGATION_STALE_TIME, decision));
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_CLOSE, decision.action);
+  TEST_ASSERT_EQUAL_UINT8(IRRIGATION_REASON_STALE, decision.reasons);
+  TEST_ASSERT_FALSE(engine.poll(2000 + IRRIGATION_STALE_TIME, decision));  // Not reopened on old readings
+}
+
+void test_command_results() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision;
+  feed(engine, 3000, 5000, 3, 0);
+  TEST_ASSERT_TRUE(engine.poll(0, decision));
+  TEST_ASSERT_TRUE(engine.poll(0, decision));
+
+  SensorCommandResult ok = {5, 1, SENSOR_COMMAND_VALVE, SENSOR_RESULT_OK};
+  engine.commandResult(ok, 10);
+  TEST_ASSERT_EQUAL(IRRIGATION_WATERING, engine.mode(0));
+
+  SensorCommandResult other = {5, 2, SENSOR_COMMAND_INTERVAL, SENSOR_RESULT_UNSUPPORTED};
+  engine.commandResult(other, 10);
+  TEST_ASSERT_EQUAL(IRRIGATION_WATERING, engine.mode(0));
+
+  SensorCommandResult expired = {5, 1, SENSOR_COMMAND_VALVE, 0x80};
+  engine.commandResult(expired, 10);
+  TEST_ASSERT_EQUAL(IRRIGATION_SOAKING, engine.mode(0));
+
+  SensorCommandResult missing = {6, 3, SENSOR_COMMAND_VALVE, SENSOR_RESULT_UNSUPPORTED};
+  engine.commandResult(missing, 10);
+  TEST_ASSERT_EQUAL(IRRIGATION_DISABLED, engine.mode(1));
+  feed(engine, 3000, 5000, 1, 400000);
+  TEST_ASSERT_TRUE(engine.poll(400000, decision));  // Zone 0 soaked and opens again, zone 1 stays off
+  TEST_ASSERT_EQUAL_UINT8(0, decision.zone);
+  TEST_ASSERT_FALSE(engine.poll(400000, decision));
+}
+
+void test_format_decision() {
+  IrrigationEngine engine(ZONES, 2);
+  IrrigationDecision decision = {0, 5, IRRIGATION_CLOSE, 0, IRRIGATION_REASON_TIMEOUT | IRRIGATION_REASON_HOT, 2712, 4850};
+  FixedString<96> text;
+  engine.formatDecision(decision, text);
+  TEST_ASSERT_EQUAL_STRING("Z:Beans,N:5,A:CLOSE,S:0,R:HOT+TIME,T:27.12,H:48.50", text.c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_rolling_mean_follows_readings);
+  RUN_TEST(test_waits_for_min_samples);
+  RUN_TEST(test_hysteresis_holds_valve_open);
+  RUN_TEST(test_watering_time_then_soak);
+  RUN_TEST(test_stale_sensor_closes_valve);
+  RUN_TEST(test_command_results);
+  RUN_TEST(test_format_decision);
+  return UNITY_END();
+}
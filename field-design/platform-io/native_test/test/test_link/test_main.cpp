@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <SlotSchedule.h>
+#include <LinkAdvisor.h>
+#include <DownlinkQueue.h>
+#include <NodeTable.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_airtime_rounds_up() {
+  // 26-byte summary plus 15 bytes of framing at 1.2 kbps is 273.3 ms
+  TEST_ASSERT_EQUAL_UINT32(274, SlotSchedule::airtime(SENSOR_SUMMARY_FRAME_LEN));
+  TEST_ASSERT_EQUAL_UINT32(2, SlotSchedule::airtime(SENSOR_SUMMARY_FRAME_LEN, 250000));
+}
+
+void test_slot_follows_beacon() {
+  SlotSchedule schedule(5);
+  SensorBeacon beacon = {1, 100, 450, 60000};
+  TEST_ASSERT_FALSE(schedule.synced(0));
+  schedule.beaconHeard(beacon, 1000);
+  TEST_ASSERT_TRUE(schedule.synced(1000));
+  TEST_ASSERT_EQUAL_UINT8(5, schedule.slot());
+
+  // Slot 5 starts six slot lengths after the beacon, entered one guard window late
+  TEST_ASSERT_EQUAL_UINT32(1000 + 6 * 450 + TDMA_GUARD, schedule.slotAt(1000));
+  TEST_ASSERT_EQUAL_UINT32(61000 + 6 * 450 + TDMA_GUARD + 6, schedule.slotAt(5000));
+  TEST_ASSERT_TRUE(schedule.fits(300, 1000));
+  TEST_ASSERT_FALSE(schedule.fits(450, 1000));
+  TEST_ASSERT_FALSE(schedule.synced(1000 + TDMA_SYNC_TIMEOUT + 1));
+}
+
+void test_slot_ignores_impossible_beacon() {
+  SlotSchedule schedule(5);
+  SensorBeacon beacon = {1, 100, 1000, 60000};  // 101 slots of 1 s do not fit in a minute
+  schedule.beaconHeard(beacon, 1000);
+  TEST_ASSERT_FALSE(schedule.synced(1000));
+}
+
+void test_link_flags_round_trip() {
+  LinkAdvice advice = {2, 1};
+  LinkAdvice decoded = decodeLinkFlags(encodeLinkFlags(advice));
+  TEST_ASSERT_EQUAL_UINT8(2, decoded.profile);
+  TEST_ASSERT_EQUAL_UINT8(1, decoded.powerStep);
+
+  // Profile 3 does not exist and falls back to the robust one
+  TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_ROBUST, decodeLinkFlags(0x0F).profile);
+}
+
+void test_near_node_speeds_up_only_in_slot() {
+  LinkAdvisor links;
+  LinkAdvice sentAt = {LINK_PROFILE_ROBUST, LINK_POWER_STEPS - 1};
+
+  // 50 dB path loss: the fastest profile at the lowest power still has the margin
+  LinkAdvice advice = links.update(1, -40, encodeLinkFlags(sentAt), true);
+  TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_COUNT - 1, advice.profile);
+  TEST_ASSERT_EQUAL_UINT8(0, advice.powerStep);
+  TEST_ASSERT_EQUAL_UINT8(50, links.pathLoss(1));
+
+  advice = links.update(2, -40, encodeLinkFlags(sentAt), false);
+  TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_ROBUST, advice.profile);
+
+  links.setProfileLimit(LINK_PROFILE_ROBUST);
+  advice = links.update(3, -40, encodeLinkFlags(sentAt), true);
+  TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_ROBUST, advice.profile);
+}
+
+void test_far_node_stays_robust_at_full_power() {
+  LinkAdvisor links;
+  LinkAdvice sentAt = {LINK_PROFILE_ROBUST, LINK_POWER_STEPS - 1};
+  LinkAdvice advice = links.update(9, -105, encodeLinkFlags(sentAt), true);
+  TEST_ASSERT_EQUAL_UINT8(LINK_PROFILE_ROBUST, advice.profile);
+  TEST_ASSERT_EQUAL_UINT8(LINK_POWER_STEPS - 1, advice.powerStep);
+}
+
+void test_downlink_queue_replaces_and_completes() {
+  DownlinkQueue queue;
+  SensorCommand first = {3, 0, SENSOR_COMMAND_INTERVAL, 120000};
+  SensorCommand second = {3, 0, SENSOR_COMMAND_INTERVAL, 300000};
+  TEST_ASSERT_TRUE(queue.push(first, 0));
+  TEST_ASSERT_TRUE(queue.push(second, 10));
+  TEST_ASSERT_EQUAL_UINT8(1, queue.size());
+
+  SensorCommand carried;
+  TEST_ASSERT_FALSE(queue.next(4, carried));
+  TEST_ASSERT_TRUE(queue.next(3, carried));
+  TEST_ASSERT_EQUAL_INT32(300000, carried.value);
+
+  SensorCommandResult result = {3, carried.sequence, carried.code, SENSOR_RESULT_OK};
+  TEST_ASSERT_TRUE(queue.complete(result));
+  TEST_ASSERT_FALSE(queue.complete(result));
+  TEST_ASSERT_EQUAL_UINT8(0, queue.size());
+}
+
+void test_downlink_queue_expires() {
+  DownlinkQueue queue;
+  SensorCommand command = {3, 0, SENSOR_COMMAND_HEARTBEAT, 240000};
+  queue.push(command, 1000);
+
+  SensorCommand expired;
+  TEST_ASSERT_FALSE(queue.expire(1000 + DOWNLINK_EXPIRY - 1, expired));
+  TEST_ASSERT_TRUE(queue.expire(1000 + DOWNLINK_EXPIRY, expired));
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_COMMAND_HEARTBEAT, expired.code);
+}
+
+void test_node_table_drops_duplicates_and_counts_loss() {
+  NodeTable nodes;
+  SensorReading reading = {7, 10, 2000, 5000, 1000000, 0};
+  TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(reading, -60, 0));
+  TEST_ASSERT_EQUAL(NODE_UPDATE_DUPLICATE, nodes.update(reading, -60, 100));
+
+  reading.sequence = 13;  // 11 and 12 never arrive
+  TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(reading, -60, 200));
+  NodeEntry* node = nodes.find(7);
+  TEST_ASSERT_NOT_NULL(node);
+  TEST_ASSERT_EQUAL_UINT16(2, node->lost);
+  TEST_ASSERT_EQUAL_UINT16(1, node->duplicates);
+
+  reading.sequence = 12;  // A late arrival is taken back out of the loss count
+  TEST_ASSERT_EQUAL(NODE_UPDATE_LATE, nodes.update(reading, -60, 300));
+  TEST_ASSERT_EQUAL_UINT16(1, node->lost);
+}
+
+void test_node_table_restart_within_timeout_starts_new_window() {
+  NodeTable nodes;
+  SensorReading reading = {7, 0, 2000, 5000, 1000000, 0};
+  uint32_t now = 0;
+  for (uint8_t sequence = 0; sequence < 10; sequence++, now += 30000) {
+    reading.sequence = sequence;
+    TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(reading, -60, now));
+  }
+
+  // A watchdog reset a minute later, well inside NODE_RESTART_TIMEOUT: the counter starts again at 0
+  now += 60000;
+  reading.sequence = 0;
+  reading.temperature = 2100;
+  reading.flags = SENSOR_FLAG_RESTARTED;
+  TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(reading, -60, now));
+  TEST_ASSERT_EQUAL(NODE_UPDATE_DUPLICATE, nodes.update(reading, -60, now + 200));  // Its ACK was lost
+
+  // Acknowledged, so the flag is gone; none of the old window's sequence numbers are dropped
+  reading.flags = 0;
+  for (uint8_t sequence = 1; sequence < 10; sequence++) {
+    now += 30000;
+    reading.sequence = sequence;
+    TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(reading, -60, now));
+  }
+  NodeEntry* node = nodes.find(7);
+  TEST_ASSERT_EQUAL_UINT16(20, node->received);
+  TEST_ASSERT_EQUAL_UINT16(1, node->duplicates);
+  TEST_ASSERT_EQUAL_UINT16(0, node->lost);
+  TEST_ASSERT_EQUAL_UINT8(9, node->reading.sequence);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_airtime_rounds_up);
+  RUN_TEST(test_slot_follows_beacon);
+  RUN_TEST(test_slot_ignores_impossible_beacon);
+  RUN_TEST(test_link_flags_round_trip);
+  RUN_TEST(test_near_node_speeds_up_only_in_slot);
+  RUN_TEST(test_far_node_stays_robust_at_full_power);
+  RUN_TEST(test_downlink_queue_replaces_and_completes);
+  RUN_TEST(test_downlink_queue_expires);
+  RUN_TEST(test_node_table_drops_duplicates_and_counts_loss);
+  RUN_TEST(test_node_table_restart_within_timeout_starts_new_window);
+  return UNITY_END();
+}
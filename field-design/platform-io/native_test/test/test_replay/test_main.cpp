@@ -0,0 +1,187 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <SensorPacket.h>
+#include <GatewayText.h>
+#include <NodeTable.h>
+#include <RecordStore.h>
+#include <BatchCodec.h>
+#include <HeapMonitor.h>
+#include <RamSpillStorage.h>
+
+/* Replays the gateway log recorded by scripts/stm32_a9g_mqtt_ubuntu_terminal.py
+ * (Timestamp,Temperature,Humidity,Pressure,Location) through the gateway
+ * pipeline: frame encode on the node, parse, node table, formatting and the
+ * store-and-forward batch, and checks the text matches what was logged.
+ */
+
+#ifndef SENSOR_LOG_PATH
+#define SENSOR_LOG_PATH "../stm32_cc1101_receiver_a9g/scripts/sensor_data_log.csv"
+#endif
+
+#define REPLAY_NODE 1
+#define REPLAY_MAX_ROWS 4096
+
+struct LogRow {
+  char temperature[16];
+  char humidity[16];
+  char pressure[16];
+};
+
+static LogRow rows[REPLAY_MAX_ROWS];
+static size_t rowCount = 0;
+
+void setUp() {}
+void tearDown() {}
+
+// Copy the next comma-separated field of line into out; returns the rest of the line
+static const char* nextField(const char* line, char* out, size_t len) {
+  size_t n = 0;
+  while (*line && *line != ',' && *line != '\r' && *line != '\n') {
+    if (n < len - 1) {
+      out[n++] = *line;
+    }
+    line++;
+  }
+  out[n] = '\0';
+  return *line == ',' ? line + 1 : line;
+}
+
+// "21.2" -> 2120; decimals past the second are dropped
+static int32_t parseCenti(const char* text) {
+  bool negative = *text == '-';
+  if (negative) {
+    text++;
+  }
+  int32_t whole = 0;
+  while (*text >= '0' && *text <= '9') {
+    whole = whole * 10 + (*text++ - '0');
+  }
+  int32_t fraction = 0;
+  uint8_t digits = 0;
+  if (*text == '.') {
+    text++;
+    while (*text >= '0' && *text <= '9' && digits < 2) {
+      fraction = fraction * 10 + (*text++ - '0');
+      digits++;
+    }
+  }
+  while (digits++ < 2) {
+    fraction *= 10;
+  }
+  int32_t value = whole * 100 + fraction;
+  return negative ? -value : value;
+}
+
+// The logged value as the gateway prints it, always with two decimals
+static void twoDecimals(const char* in, char* out, size_t len) {
+  const char* dot = strchr(in, '.');
+  size_t decimals = dot ? strlen(dot + 1) : 0;
+  snprintf(out, len, "%s%s%s", in, dot ? "" : ".", decimals >= 2 ? "" : (decimals == 1 ? "0" : "00"));
+}
+
+static SensorReading readingOf(const LogRow& row, uint8_t sequence) {
+  SensorReading reading;
+  reading.nodeId = REPLAY_NODE;
+  reading.sequence = sequence;
+  reading.temperature = (int16_t)parseCenti(row.temperature);
+  reading.humidity = (uint16_t)parseCenti(row.humidity);
+  reading.pressure = (uint32_t)parseCenti(row.pressure) * 10;  // centi-hPa (Pa) to deci-Pa
+  reading.flags = 0;
+  return reading;
+}
+
+void test_log_loads() {
+  FILE* log = fopen(SENSOR_LOG_PATH, "r");
+  TEST_ASSERT_NOT_NULL_MESSAGE(log, SENSOR_LOG_PATH);
+
+  char line[128];
+  fgets(line, sizeof(line), log);  // Header
+  while (rowCount < REPLAY_MAX_ROWS && fgets(line, sizeof(line), log)) {
+    char timestamp[32];
+    LogRow& row = rows[rowCount];
+    const char* rest = nextField(line, timestamp, sizeof(timestamp));
+    rest = nextField(rest, row.temperature, sizeof(row.temperature));
+    rest = nextField(rest, row.humidity, sizeof(row.humidity));
+    nextField(rest, row.pressure, sizeof(row.pressure));
+    if (row.pressure[0]) {
+      rowCount++;
+    }
+  }
+  fclose(log);
+  TEST_ASSERT_GREATER_THAN(0, rowCount);
+}
+
+void test_log_reproduces_gateway_text() {
+  NodeTable nodes;
+  heapMonitorMark();
+
+  for (size_t i = 0; i < rowCount; i++) {
+    SensorReading sent = readingOf(rows[i], (uint8_t)i);
+    uint8_t frame[SENSOR_READING_FRAME_LEN];
+    size_t frameLen = encodeSensorReading(sent, frame, sizeof(frame));
+
+    SensorReading received;
+    TEST_ASSERT_TRUE(parseSensorData(frame, (uint8_t)frameLen, received));
+    TEST_ASSERT_EQUAL(NODE_UPDATE_ACCEPTED, nodes.update(received, -70, i * 32000));
+    TEST_ASSERT_EQUAL(NODE_UPDATE_DUPLICATE, nodes.update(received, -70, i * 32000 + 10));  // Lost-ACK retransmit
+
+    FixedString<64> text;
+    formatSensorData(nodes.find(REPLAY_NODE)->reading, text);
+
+    char temperature[20], humidity[20], pressure[20], expected[80];
+    twoDecimals(rows[i].temperature, temperature, sizeof(temperature));
+    twoDecimals(rows[i].humidity, humidity, sizeof(humidity));
+    twoDecimals(rows[i].pressure, pressure, sizeof(pressure));
+    snprintf(expected, sizeof(expected), "N:%d,T:%s,H:%s,P:%s", REPLAY_NODE, temperature, humidity, pressure);
+    TEST_ASSERT_EQUAL_STRING(expected, text.c_str());
+  }
+
+  NodeEntry* node = nodes.find(REPLAY_NODE);
+  TEST_ASSERT_EQUAL_UINT16(rowCount, node->received);
+  TEST_ASSERT_EQUAL_UINT16(0, node->lost);
+  TEST_ASSERT_EQUAL_UINT32(0, heapOperationsSinceMark());
+}
+
+void test_log_survives_store_and_forward() {
+  static RamSpillStorage<4, 1024> flash;
+  static RecordStore store(&flash);
+  store.begin();
+  heapMonitorMark();
+
+  for (size_t i = 0; i < rowCount; i++) {
+    StoredRecord record = {(uint32_t)(i * 32 + 1), readingOf(rows[i], (uint8_t)i)};
+    store.append(record);
+  }
+  TEST_ASSERT_EQUAL_UINT32(rowCount, store.size());
+
+  // Every record comes back out of the batches, oldest first, with its values intact
+  uint32_t consumed = 0;
+  while (store.size() > 0) {
+    char batch[512];
+    size_t written = 0;
+    uint16_t count = encodeBatch(store, BATCH_TEXT, rowCount * 32, batch, sizeof(batch), written);
+    TEST_ASSERT_GREATER_THAN(0, count);
+    TEST_ASSERT_EQUAL(0, strncmp(batch, "B1,", 3));
+
+    StoredRecord oldest;
+    TEST_ASSERT_TRUE(store.at(0, oldest));
+    SensorReading expected = readingOf(rows[consumed], (uint8_t)consumed);
+    TEST_ASSERT_EQUAL_INT16(expected.temperature, oldest.reading.temperature);
+    TEST_ASSERT_EQUAL_UINT32(expected.pressure, oldest.reading.pressure);
+
+    store.consume(count);
+    consumed += count;
+  }
+  TEST_ASSERT_EQUAL_UINT32(rowCount, consumed);
+  TEST_ASSERT_EQUAL_UINT32(0, store.dropped());
+  TEST_ASSERT_EQUAL_UINT32(0, heapOperationsSinceMark());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_log_loads);
+  RUN_TEST(test_log_reproduces_gateway_text);
+  RUN_TEST(test_log_survives_store_and_forward);
+  return UNITY_END();
+}
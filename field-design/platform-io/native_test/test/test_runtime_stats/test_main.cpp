@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <string.h>
+#include <RuntimeStats.h>
+#include <StringBuilder.h>
+
+#define CYCLES(us) ((uint32_t)(us) * RUNTIME_STATS_CYCLES_PER_US)
+
+void setUp() {}
+void tearDown() {}
+
+void test_span_mean_and_max() {
+  RuntimeStats stats;
+  stats.record(SPAN_PARSE, CYCLES(10));
+  stats.record(SPAN_PARSE, CYCLES(30));
+  const SpanStats& parse = stats.span(SPAN_PARSE);
+  TEST_ASSERT_EQUAL_UINT32(2, parse.count);
+  TEST_ASSERT_EQUAL_UINT32(CYCLES(40), (uint32_t)parse.total);
+  TEST_ASSERT_EQUAL_UINT32(CYCLES(30), parse.max);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.span(SPAN_AT).count);
+}
+
+void test_loop_latency_buckets() {
+  RuntimeStats stats;
+  uint32_t now = 1000;
+  stats.loopPass(now);  // The first pass only starts the clock
+  uint32_t gaps[] = {5, 15, 16, 63, 64, 300, 70000, 2000000};
+  for (size_t i = 0; i < sizeof(gaps) / sizeof(gaps[0]); i++) {
+    now += CYCLES(gaps[i]);
+    stats.loopPass(now);
+  }
+  // < 16 us: 5, 15; < 64 us: 16, 63; < 256 us: 64; < 1024 us: 300; the rest in the last bucket
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bucket(0));
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bucket(1));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(2));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(3));
+  TEST_ASSERT_EQUAL_UINT32(0, stats.bucket(6));
+  TEST_ASSERT_EQUAL_UINT32(2, stats.bucket(RUNTIME_STATS_BUCKETS - 1));
+}
+
+void test_counters_survive_window_reset() {
+  RuntimeStats stats;
+  stats.count(STAT_RECEIVED);
+  stats.count(STAT_RECEIVED);
+  stats.count(STAT_DUPLICATE);
+  stats.set(STAT_CRC_FAILED, 7);
+  stats.sampleHeap(4000);
+  stats.sampleHeap(3500);
+  stats.sampleHeap(3900);
+  stats.record(SPAN_RADIO_RX, CYCLES(50));
+  stats.resetWindow();
+
+  TEST_ASSERT_EQUAL_UINT32(2, stats.counter(STAT_RECEIVED));
+  TEST_ASSERT_EQUAL_UINT32(7, stats.counter(STAT_CRC_FAILED));
+  TEST_ASSERT_EQUAL_UINT32(3500, stats.heapLowWater());
+  TEST_ASSERT_EQUAL_UINT32(0, stats.span(SPAN_RADIO_RX).count);
+}
+
+void test_format() {
+  RuntimeStats stats;
+  stats.count(STAT_RECEIVED);
+  stats.count(STAT_DROPPED);
+  stats.sampleHeap(2048);
+  stats.set(STAT_HEAP_OPERATIONS, 3);
+  stats.record(SPAN_RADIO_RX, CYCLES(20));
+  stats.record(SPAN_RADIO_RX, CYCLES(40));
+  stats.record(SPAN_PUBLISH, CYCLES(900));
+  stats.loopPass(0);
+  stats.loopPass(CYCLES(100));
+
+  FixedString<192> text;
+  stats.format(text);
+  TEST_ASSERT_FALSE(text.overflowed());
+  TEST_ASSERT_EQUAL_STRING("RX:1,DR:1,CRC:0,DU:0,HL:2048,HO:3,RA:2/30/40,PA:0/0/0,AT:0/0/0,PU:1/900/900,LH:0/0/1/0/0/0/0/0",
+                           text.c_str());
+}
+
+void test_cycle_count_advances() {
+  uint32_t start = cycleCount();
+  volatile uint32_t spin = 0;
+  for (uint32_t i = 0; i < 1000000; i++) {
+    spin = spin + i;
+  }
+  TEST_ASSERT_TRUE(cycleCount() - start > 0);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_span_mean_and_max);
+  RUN_TEST(test_loop_latency_buckets);
+  RUN_TEST(test_counters_survive_window_reset);
+  RUN_TEST(test_format);
+  RUN_TEST(test_cycle_count_advances);
+  return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <unity.h>
+#include <TaskScheduler.h>
+
+// Calls per task, and whether each one is ready to run
+static uint8_t runs[4];
+static bool ready[4];
+static uint8_t order[16];
+static uint8_t orderLen;
+
+static bool record(uint32_t now, void* context) {
+  uint8_t id = (uint8_t)(uintptr_t)context;
+  if (!ready[id]) {
+    return false;
+  }
+  runs[id]++;
+  order[orderLen++] = id;
+  return true;
+}
+
+static const SchedulerTask TASKS[] = {
+  {"FAST", TASK_FOREGROUND, TASK_EVERY_PASS, TASK_NO_DEADLINE, record, (void*)0},
+  {"TICK", TASK_FOREGROUND, 100, 10, record, (void*)1},
+  {"JOB_A", TASK_BACKGROUND, 1000, 500, record, (void*)2},
+  {"JOB_B", TASK_BACKGROUND, TASK_ON_DEMAND, 200, record, (void*)3},
+};
+
+void setUp() {
+  for (uint8_t i = 0; i < 4; i++) {
+    runs[i] = 0;
+    ready[i] = true;
+  }
+  orderLen = 0;
+}
+
+void tearDown() {}
+
+void test_periodic_and_every_pass() {
+  TaskScheduler scheduler(TASKS, 4);
+  scheduler.begin(0);
+  scheduler.poll(50);
+  TEST_ASSERT_EQUAL_UINT8(1, runs[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, runs[1]);
+  scheduler.poll(100);
+  scheduler.poll(150);
+  TEST_ASSERT_EQUAL_UINT8(1, runs[1]);
+  TEST_ASSERT_TRUE(scheduler.due(1, 200));
+  TEST_ASSERT_EQUAL_UINT8(0, runs[3]);  // On demand only
+}
+
+void test_one_background_task_per_pass_after_foreground() {
+  TaskScheduler scheduler(TASKS, 4);
+  scheduler.begin(0);
+  scheduler.trigger(3, 900);
+  scheduler.poll(1000);  // TICK (late, first due at 100), JOB_A and JOB_B are all due
+  TEST_ASSERT_EQUAL_UINT8(3, orderLen);
+  TEST_ASSERT_EQUAL_UINT8(0, order[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, order[1]);
+  TEST_ASSERT_EQUAL_UINT8(2, order[2]);
+  TEST_ASSERT_EQUAL_UINT8(0, runs[3]);
+
+  scheduler.poll(1001);
+  TEST_ASSERT_EQUAL_UINT8(1, runs[3]);
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.missed(1));
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.missed(2));
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.missed(3));
+}
+
+void test_not_ready_stays_due_and_misses_deadline_once() {
+  TaskScheduler scheduler(TASKS, 4);
+  scheduler.begin(0);
+  ready[2] = false;
+  scheduler.poll(1000);
+  scheduler.poll(1400);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.missed(2));
+  scheduler.poll(1600);
+  scheduler.poll(1700);
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.missed(2));
+  TEST_ASSERT_EQUAL_UINT8(0, runs[2]);
+
+  // Once it runs, the next run is an interval later
+  ready[2] = true;
+  scheduler.poll(1800);
+  TEST_ASSERT_EQUAL_UINT8(1, runs[2]);
+  TEST_ASSERT_FALSE(scheduler.due(2, 2700));
+  TEST_ASSERT_TRUE(scheduler.due(2, 2800));
+}
+
+void test_blocked_pass_counts_foreground_miss() {
+  TaskScheduler scheduler(TASKS, 4);
+  scheduler.begin(0);
+  scheduler.poll(150);  // TICK was due at 100 with 10 ms slack
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.missed(1));
+}
+
+void test_set_interval_reschedules_periodic_task() {
+  TaskScheduler scheduler(TASKS, 4);
+  scheduler.begin(0);
+  scheduler.setInterval(1, 300, 50);
+  TEST_ASSERT_EQUAL_UINT32(300, scheduler.interval(1));
+  TEST_ASSERT_FALSE(scheduler.due(1, 100));
+  TEST_ASSERT_TRUE(scheduler.due(1, 350));
+  scheduler.poll(350);
+  TEST_ASSERT_EQUAL_UINT8(1, runs[1]);
+  TEST_ASSERT_FALSE(scheduler.due(1, 649));
+  TEST_ASSERT_TRUE(scheduler.due(1, 650));
+
+  // Every-pass and on-demand tasks keep their kind
+  scheduler.setInterval(0, 100, 350);
+  scheduler.setInterval(3, 100, 350);
+  scheduler.setInterval(2, TASK_ON_DEMAND, 350);
+  TEST_ASSERT_EQUAL_UINT32(TASK_EVERY_PASS, scheduler.interval(0));
+  TEST_ASSERT_EQUAL_UINT32(TASK_ON_DEMAND, scheduler.interval(3));
+  TEST_ASSERT_EQUAL_UINT32(1000, scheduler.interval(2));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_periodic_and_every_pass);
+  RUN_TEST(test_one_background_task_per_pass_after_foreground);
+  RUN_TEST(test_not_ready_stays_due_and_misses_deadline_once);
+  RUN_TEST(test_blocked_pass_counts_foreground_miss);
+  RUN_TEST(test_set_interval_reschedules_periodic_task);
+  return UNITY_END();
+}
@@ -0,0 +1,112 @@
+#include <unity.h>
+#include <SensorPacket.h>
+
+void setUp() {}
+void tearDown() {}
+
+void test_reading_round_trip() {
+  SensorReading reading = {7, 200, -1234, 6893, 814180, SENSOR_FLAG_PRESSURE_INVALID};
+  uint8_t frame[SENSOR_READING_FRAME_LEN];
+  TEST_ASSERT_EQUAL(SENSOR_READING_FRAME_LEN, encodeSensorReading(reading, frame, sizeof(frame)));
+
+  SensorReading decoded;
+  TEST_ASSERT_TRUE(decodeSensorReading(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT8(7, decoded.nodeId);
+  TEST_ASSERT_EQUAL_UINT8(200, decoded.sequence);
+  TEST_ASSERT_EQUAL_INT16(-1234, decoded.temperature);
+  TEST_ASSERT_EQUAL_UINT16(6893, decoded.humidity);
+  TEST_ASSERT_EQUAL_UINT32(814180, decoded.pressure);
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_FLAG_PRESSURE_INVALID, decoded.flags);
+}
+
+void test_reading_rejects_short_buffers() {
+  SensorReading reading = {1, 0, 0, 0, 0, 0};
+  uint8_t frame[SENSOR_READING_FRAME_LEN];
+  TEST_ASSERT_EQUAL(0, encodeSensorReading(reading, frame, sizeof(frame) - 1));
+
+  encodeSensorReading(reading, frame, sizeof(frame));
+  SensorReading decoded;
+  TEST_ASSERT_FALSE(decodeSensorReading(frame, sizeof(frame) - 1, decoded));
+  frame[0] = 0xF1;  // Unknown version
+  TEST_ASSERT_FALSE(decodeSensorReading(frame, sizeof(frame), decoded));
+}
+
+void test_summary_round_trip_and_means() {
+  SensorSummary summary = {{3, 9, 2121, 6900, 814170, 0}, 4, 2100, 2140, 6880, 6920, 814150, 814190};
+  uint8_t frame[SENSOR_SUMMARY_FRAME_LEN];
+  TEST_ASSERT_EQUAL(SENSOR_SUMMARY_FRAME_LEN, encodeSensorSummary(summary, frame, sizeof(frame)));
+
+  SensorSummary decoded;
+  TEST_ASSERT_TRUE(decodeSensorSummary(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT8(4, decoded.samples);
+  TEST_ASSERT_EQUAL_INT16(2100, decoded.temperatureMin);
+  TEST_ASSERT_EQUAL_INT16(2140, decoded.temperatureMax);
+  TEST_ASSERT_EQUAL_UINT32(814190, decoded.pressureMax);
+
+  // The gateway's reading path takes a summary as its means
+  SensorReading means;
+  TEST_ASSERT_TRUE(decodeSensorReading(frame, sizeof(frame), means));
+  TEST_ASSERT_EQUAL_INT16(2121, means.temperature);
+  TEST_ASSERT_EQUAL_UINT32(814170, means.pressure);
+}
+
+void test_beacon_round_trip() {
+  SensorBeacon beacon = {123456, 100, 450, 60000};
+  uint8_t frame[SENSOR_BEACON_FRAME_LEN];
+  TEST_ASSERT_EQUAL(SENSOR_BEACON_FRAME_LEN, encodeSensorBeacon(beacon, frame, sizeof(frame)));
+
+  SensorBeacon decoded;
+  TEST_ASSERT_TRUE(decodeSensorBeacon(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT32(123456, decoded.superframe);
+  TEST_ASSERT_EQUAL_UINT8(100, decoded.slotCount);
+  TEST_ASSERT_EQUAL_UINT16(450, decoded.slotLength);
+  TEST_ASSERT_EQUAL_UINT32(60000, decoded.interval);
+
+  SensorReading reading;
+  TEST_ASSERT_FALSE(decodeSensorReading(frame, sizeof(frame), reading));
+}
+
+void test_command_and_result_round_trip() {
+  SensorCommand command = {5, 17, SENSOR_COMMAND_INTERVAL, -300000};
+  uint8_t frame[SENSOR_COMMAND_FRAME_LEN];
+  TEST_ASSERT_EQUAL(SENSOR_COMMAND_FRAME_LEN, encodeSensorCommand(command, frame, sizeof(frame)));
+
+  SensorCommand decoded;
+  TEST_ASSERT_TRUE(decodeSensorCommand(frame, sizeof(frame), decoded));
+  TEST_ASSERT_EQUAL_UINT8(5, decoded.nodeId);
+  TEST_ASSERT_EQUAL_UINT8(17, decoded.sequence);
+  TEST_ASSERT_EQUAL_INT32(-300000, decoded.value);
+
+  SensorCommandResult result = {5, 17, SENSOR_COMMAND_INTERVAL, SENSOR_RESULT_OUT_OF_RANGE};
+  uint8_t resultFrame[SENSOR_RESULT_FRAME_LEN];
+  TEST_ASSERT_EQUAL(SENSOR_RESULT_FRAME_LEN, encodeSensorCommandResult(result, resultFrame, sizeof(resultFrame)));
+
+  SensorCommandResult decodedResult;
+  TEST_ASSERT_TRUE(decodeSensorCommandResult(resultFrame, sizeof(resultFrame), decodedResult));
+  TEST_ASSERT_EQUAL_UINT8(SENSOR_RESULT_OUT_OF_RANGE, decodedResult.result);
+
+  // The plain "!" ACK payload is not a command
+  const uint8_t ack[] = {'!'};
+  TEST_ASSERT_FALSE(decodeSensorCommand(ack, sizeof(ack), decoded));
+}
+
+void test_format_fixed_point() {
+  char text[16];
+  TEST_ASSERT_EQUAL(5, formatFixedPoint(text, sizeof(text), -50, 2));
+  TEST_ASSERT_EQUAL_STRING("-0.50", text);
+  formatFixedPoint(text, sizeof(text), 81418, 2);
+  TEST_ASSERT_EQUAL_STRING("814.18", text);
+  formatFixedPoint(text, sizeof(text), 7, 0);
+  TEST_ASSERT_EQUAL_STRING("7", text);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reading_round_trip);
+  RUN_TEST(test_reading_rejects_short_buffers);
+  RUN_TEST(test_summary_round_trip_and_means);
+  RUN_TEST(test_beacon_round_trip);
+  RUN_TEST(test_command_and_result_round_trip);
+  RUN_TEST(test_format_fixed_point);
+  return UNITY_END();
+}
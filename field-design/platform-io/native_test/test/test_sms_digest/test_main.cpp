@@ -0,0 +1,180 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SmsDigest.h>
+#include <SmsPdu.h>
+
+static const SmsAlarmLimits LIMITS = {3500, 200, 100, 10000, 2000, 300};
+
+void setUp() {}
+void tearDown() {}
+
+static SensorReading makeReading(uint8_t node, int16_t temperature, uint16_t humidity, uint32_t pressure) {
+  SensorReading reading = {node, 0, temperature, humidity, pressure, 0};
+  return reading;
+}
+
+// Unpack count septets from hex user data that starts skip bits into its first octet
+static void unpackSeptets(const char* hex, uint8_t skip, size_t count, char* out) {
+  uint32_t bits = 0;
+  uint8_t bitCount = 0;
+  size_t produced = 0;
+  bool skipped = false;
+  for (const char* p = hex; produced < count && p[0] && p[1]; p += 2) {
+    char octet[3] = {p[0], p[1], '\0'};
+    bits |= (uint32_t)strtoul(octet, nullptr, 16) << bitCount;
+    bitCount += 8;
+    if (!skipped) {
+      bits >>= skip;
+      bitCount -= skip;
+      skipped = true;
+    }
+    while (bitCount >= 7 && produced < count) {
+      out[produced++] = (char)(bits & 0x7F);
+      bits >>= 7;
+      bitCount -= 7;
+    }
+  }
+  out[produced] = '\0';
+}
+
+void test_window_min_mean_max() {
+  SmsDigest digest(LIMITS);
+  digest.add(0, makeReading(7, 2000, 5000, 1012000));
+  digest.add(0, makeReading(7, 2200, 6000, 1013000));
+  digest.add(0, makeReading(7, 2500, 5500, 1015000));
+
+  FixedString<96> text;
+  digest.formatWindow(0, text);
+  TEST_ASSERT_EQUAL_STRING("N:7,T:20.0/22.3/25.0,H:50/55/60,P:1012/1013/1015", text.c_str());
+  TEST_ASSERT_EQUAL_UINT16(3, digest.entry(0).samples);
+}
+
+void test_window_collapses_equal_values_and_skips_invalid_channels() {
+  SmsDigest digest(LIMITS);
+  SensorReading reading = makeReading(3, 2100, 4000, 1013000);
+  reading.flags = SENSOR_FLAG_PRESSURE_INVALID;
+  digest.add(0, reading);
+
+  FixedString<96> text;
+  digest.formatWindow(0, text);
+  TEST_ASSERT_EQUAL_STRING("N:3!SF,T:21.0,H:40", text.c_str());
+}
+
+void test_alarm_raised_once_with_hysteresis() {
+  SmsDigest digest(LIMITS);
+  TEST_ASSERT_EQUAL_UINT8(0, digest.add(0, makeReading(1, 3000, 5000, 1013000)));
+  TEST_ASSERT_EQUAL_UINT8(SMS_ALARM_TEMPERATURE_HIGH, digest.add(0, makeReading(1, 3600, 5000, 1013000)));
+
+  // Dipping back under the limit but not past the hysteresis keeps the alarm, so it is not raised again
+  TEST_ASSERT_EQUAL_UINT8(0, digest.add(0, makeReading(1, 3450, 5000, 1013000)));
+  TEST_ASSERT_EQUAL_UINT8(0, digest.add(0, makeReading(1, 3550, 5000, 1013000)));
+
+  TEST_ASSERT_EQUAL_UINT8(0, digest.add(0, makeReading(1, 3300, 5000, 1013000)));
+  TEST_ASSERT_EQUAL_UINT8(SMS_ALARM_TEMPERATURE_HIGH, digest.add(0, makeReading(1, 3600, 5000, 1013000)));
+
+  TEST_ASSERT_EQUAL_UINT8(SMS_ALARM_HUMIDITY_LOW | SMS_ALARM_TEMPERATURE_LOW,
+                          digest.add(1, makeReading(2, 100, 1500, 1013000)));
+  FixedString<64> text;
+  digest.formatAlarm(1, makeReading(2, 100, 1500, 1013000), text);
+  TEST_ASSERT_EQUAL_STRING("N:2!TLHL,T:1.0,H:15,P:1013", text.c_str());
+
+  digest.markAlarmSent(1, SMS_ALARM_TEMPERATURE_LOW);
+  TEST_ASSERT_EQUAL_UINT8(SMS_ALARM_HUMIDITY_LOW, digest.entry(1).pendingAlarms);
+}
+
+void test_order_puts_alarmed_nodes_first() {
+  SmsDigest digest(LIMITS);
+  digest.add(0, makeReading(1, 2000, 5000, 1013000));
+  digest.add(1, makeReading(2, 2000, 5000, 1013000));
+  digest.add(2, makeReading(3, 3900, 5000, 1013000));
+  digest.add(3, makeReading(4, 2000, 5000, 1013000));
+  digest.markReported(3, 1, makeReading(4, 2000, 5000, 1013000));
+
+  uint8_t slots[NODE_TABLE_CAPACITY];
+  TEST_ASSERT_EQUAL_UINT8(3, digest.order(slots));
+  TEST_ASSERT_EQUAL_UINT8(2, slots[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, slots[1]);
+  TEST_ASSERT_EQUAL_UINT8(1, slots[2]);
+}
+
+void test_mark_reported_keeps_newer_reading() {
+  SmsDigest digest(LIMITS);
+  digest.add(0, makeReading(1, 2000, 5000, 1013000));
+  uint16_t sent = digest.entry(0).samples;
+  SensorReading late = makeReading(1, 2400, 5000, 1013000);
+  digest.add(0, late);
+
+  digest.markReported(0, sent, late);
+  TEST_ASSERT_EQUAL_UINT16(1, digest.entry(0).samples);
+  FixedString<64> text;
+  digest.formatWindow(0, text);
+  TEST_ASSERT_EQUAL_STRING("N:1,T:24.0,H:50,P:1013", text.c_str());
+
+  digest.markReported(0, 1, late);
+  TEST_ASSERT_FALSE(digest.hasWindow(0));
+}
+
+void test_pdu_single_message() {
+  // Reference SMS-SUBMIT from the GSM 03.40 examples, without a validity period
+  FixedString<SMS_PDU_MAX_OCTETS * 2 + 1> pdu;
+  const char* text = "How are you?";
+  uint8_t length = encodeSmsSubmit("+31641600986", text, strlen(text), 0, 1, 1, pdu);
+  TEST_ASSERT_EQUAL_STRING("0001000B911346610089F600000CC8F71D14969741F977FD07", pdu.c_str());
+  TEST_ASSERT_EQUAL_UINT8(24, length);
+}
+
+void test_pdu_concatenated_part() {
+  char text[SMS_PART_SEPTETS + 1];
+  for (size_t i = 0; i < SMS_PART_SEPTETS; i++) {
+    text[i] = "N:1,T:20.0/22.3/25.0;"[i % 21];
+  }
+  text[SMS_PART_SEPTETS] = '\0';
+
+  FixedString<SMS_PDU_MAX_OCTETS * 2 + 1> pdu;
+  uint8_t length = encodeSmsSubmit("+254726240861", text, SMS_PART_SEPTETS, 0x2A, 2, 3, pdu);
+  TEST_ASSERT_EQUAL_UINT8(153, length);  // 13 header octets and 140 of user data, the most one SMS carries
+
+  // UDHI set, UDL 160 septets, then the concatenation header for part 2 of 3 with reference 0x2A
+  TEST_ASSERT_EQUAL_INT(0, strncmp(pdu.c_str(), "0041000C91527462428016", 22));
+  TEST_ASSERT_EQUAL_INT(0, strncmp(pdu.c_str() + 22, "0000A0050003" "2A0302", 18));
+
+  char decoded[SMS_PART_SEPTETS + 1];
+  unpackSeptets(pdu.c_str() + 40, 1, SMS_PART_SEPTETS, decoded);
+  TEST_ASSERT_EQUAL_STRING(text, decoded);
+}
+
+void test_pdu_rejects_bad_input() {
+  FixedString<SMS_PDU_MAX_OCTETS * 2 + 1> pdu;
+  TEST_ASSERT_EQUAL_UINT8(0, encodeSmsSubmit("+2547x6", "hi", 2, 0, 1, 1, pdu));
+  TEST_ASSERT_EQUAL_UINT8(0, encodeSmsSubmit("+254726240861", "hi", 2, 0, 3, 2, pdu));
+
+  char longText[SMS_SINGLE_SEPTETS + 2];
+  memset(longText, 'a', sizeof(longText) - 1);
+  longText[sizeof(longText) - 1] = '\0';
+  TEST_ASSERT_EQUAL_UINT8(0, encodeSmsSubmit("+254726240861", longText, SMS_SINGLE_SEPTETS + 1, 0, 1, 1, pdu));
+}
+
+void test_part_count_and_alphabet() {
+  TEST_ASSERT_EQUAL_UINT8(1, smsPartCount(160));
+  TEST_ASSERT_EQUAL_UINT8(2, smsPartCount(161));
+  TEST_ASSERT_EQUAL_UINT8(3, smsPartCount(459));
+  TEST_ASSERT_EQUAL_UINT8(0x00, gsmSeptet('@'));
+  TEST_ASSERT_EQUAL_UINT8(0x11, gsmSeptet('_'));
+  TEST_ASSERT_EQUAL_UINT8('?', gsmSeptet('['));
+  TEST_ASSERT_EQUAL_UINT8(':', gsmSeptet(':'));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_window_min_mean_max);
+  RUN_TEST(test_window_collapses_equal_values_and_skips_invalid_channels);
+  RUN_TEST(test_alarm_raised_once_with_hysteresis);
+  RUN_TEST(test_order_puts_alarmed_nodes_first);
+  RUN_TEST(test_mark_reported_keeps_newer_reading);
+  RUN_TEST(test_pdu_single_message);
+  RUN_TEST(test_pdu_concatenated_part);
+  RUN_TEST(test_pdu_rejects_bad_input);
+  RUN_TEST(test_part_count_and_alphabet);
+  return UNITY_END();
+}
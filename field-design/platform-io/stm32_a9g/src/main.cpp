@@ -1,5 +1,7 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <AtEngine.h>
+#include <GatewayText.h>
 
 /* A9G to STM32 BluePill Connection Guide:
  * A9G Pin    | BluePill Pin | Function
@@ -16,17 +18,26 @@
 
 HardwareSerial A9GSerial(PA10, PA9);
 
+// Non-blocking AT command engine driving the A9G, serviced from loop()
+AtEngine modem(A9GSerial);
+
 const char* phone_number = "+254726240861";
 
 unsigned long previousMillis = 0;
 const unsigned long interval = 180000; // 3 minutes in milliseconds
 
+bool modemBusy = true;              // True while bring-up or an SMS cycle is running
+char gpsLocation[64] = "L:No Fix0"; // Location attached to the next SMS
+char smsBody[96];
+
 void initA9G();
-void initGPS();
-bool testA9G();
-String getGPSLocation();
-bool sendSMS(float temp, float humidity, String location);
-String sendATCommand(const String& command, int timeout);
+void onModemReady(AtResult result, void* context);
+void onModemTested(AtResult result, void* context);
+void onGPSStarted(AtResult result, void* context);
+void onGPSInfoLine(const char* line, void* context);
+void onLocation(AtResult result, void* context);
+void onTextMode(AtResult result, void* context);
+void onSMSSent(AtResult result, void* context);
 void blinkLED(int times, int duration);
 void resetA9G();
 
@@ -42,103 +53,89 @@ void setup() {
 }
 
 void loop() {
+  // Advance the AT command in flight, if any
+  modem.poll();
+  
   unsigned long currentMillis = millis();
   
-  if (currentMillis - previousMillis >= interval) {
+  if (!modemBusy && currentMillis - previousMillis >= interval) {
     previousMillis = currentMillis;
-    
-    if (testA9G()) {
-      initGPS();
-      String location = getGPSLocation();
-      float temp = random(200, 350) / 10.0f;
-      float humidity = random(300, 800) / 10.0f;
-      if (sendSMS(temp, humidity, location)) {
-        blinkLED(2, 500);  // Slow blink twice to indicate success
-      } else {
-        blinkLED(5, 50);  // Fast blink 5 times to indicate trouble
-      }
-    } else {
-      resetA9G();
-      blinkLED(10, 50);  // Indicate reset attempt with 10 very fast blinks
-    }
+    modemBusy = true;
+    modem.send("AT", 2000, onModemTested);
   }
 }
 
 void initA9G() {
-  sendATCommand("ATE0", 1000); // Disable command echo
-  sendATCommand("AT+CGPSPWR=1", 2000); // Power on the GPS
-  delay(2000);
-  sendATCommand("AT+CGPSRST=1", 2000); // Reset GPS in hot mode
-  delay(2000);
-  sendATCommand("AT+CGPSIPR=9600", 2000); // Set GPS baud rate
-  delay(2000);
-  sendATCommand("AT+CGPSOUT=0", 2000); // Disable GPS NMEA output
+  modemBusy = true;
+  modem.send("ATE0", 1000); // Disable command echo
+  modem.send("AT+CGPSPWR=1", 2000); // Power on the GPS
+  modem.holdOff(2000);
+  modem.send("AT+CGPSRST=1", 2000); // Reset GPS in hot mode
+  modem.holdOff(2000);
+  modem.send("AT+CGPSIPR=9600", 2000); // Set GPS baud rate
+  modem.holdOff(2000);
+  modem.send("AT+CGPSOUT=0", 2000, onModemReady); // Disable GPS NMEA output
 }
 
-void initGPS() {
-  sendATCommand("AT+CGPS=1,1", 5000); // Turn on GPS with full power
-  delay(5000); // Reduced wait time for GPS to initialize
+void onModemReady(AtResult result, void* context) {
+  modemBusy = false;
 }
 
-bool testA9G() {
-  String response = sendATCommand("AT", 2000);
-  return response.indexOf("OK") != -1;
+void onModemTested(AtResult result, void* context) {
+  if (result != AT_RESULT_OK) {
+    resetA9G();
+    blinkLED(10, 50);  // Indicate reset attempt with 10 very fast blinks
+    return;
+  }
+  modem.send("AT+CGPS=1,1", 5000, onGPSStarted); // Turn on GPS with full power
 }
 
-String getGPSLocation() {
-  String response = sendATCommand("AT+CGPSINFO", 10000);
-  if (response.indexOf("+CGPSINFO:") != -1) {
-    int start = response.indexOf("+CGPSINFO:");
-    int end = response.indexOf("\r", start);
-    String gpsData = response.substring(start + 10, end);
-    gpsData.trim();
-    if (gpsData != ",,,,,,,," && gpsData.length() > 0) {
-      return "L:" + gpsData;
-    }
+void onGPSStarted(AtResult result, void* context) {
+  strcpy(gpsLocation, "L:No Fix0");
+  modem.holdOff(5000); // Reduced wait time for GPS to initialize
+  modem.send("AT+CGPSINFO", 10000, onLocation, nullptr, onGPSInfoLine);
+}
+
+// Capture the +CGPSINFO: line as "L:<data>", keeping the placeholder when there is no fix
+void onGPSInfoLine(const char* line, void* context) {
+  size_t len;
+  const char* gpsData = parseGpsInfo(line, len);
+  if (gpsData != nullptr) {
+    snprintf(gpsLocation, sizeof(gpsLocation), "L:%.*s", (int)len, gpsData);
   }
-  return "L:No Fix0";
 }
 
-bool sendSMS(float temp, float humidity, String location) {
-  String message = "T:" + String(temp, 1) + "C,H:" + String(humidity, 1) + "%," + location;
+void onLocation(AtResult result, void* context) {
+  long temp = random(200, 350);      // Tenths of a degree
+  long humidity = random(300, 800);  // Tenths of a percent
+  snprintf(smsBody, sizeof(smsBody), "T:%ld.%ldC,H:%ld.%ld%%,%s",
+           temp / 10, temp % 10, humidity / 10, humidity % 10, gpsLocation);
   
   // Set SMS text mode
-  if (sendATCommand("AT+CMGF=1", 2000).indexOf("OK") == -1) {
-    return false;
+  modem.send("AT+CMGF=1", 2000, onTextMode);
+}
+
+void onTextMode(AtResult result, void* context) {
+  if (result != AT_RESULT_OK) {
+    onSMSSent(result, context);
+    return;
   }
   
-  // Set recipient number
-  String setNumberCmd = "AT+CMGS=\"" + String(phone_number) + "\"";
-  if (sendATCommand(setNumberCmd, 5000).indexOf(">") == -1) {
-    return false;
+  // Set recipient number, the message and Ctrl+Z follow at the prompt
+  char command[32];
+  snprintf(command, sizeof(command), "AT+CMGS=\"%s\"", phone_number);
+  if (!modem.sendWithPayload(command, smsBody, 10000, onSMSSent)) {
+    onSMSSent(AT_RESULT_ERROR, context);
   }
-  
-  // Send the message
-  A9GSerial.print(message);
-  A9GSerial.write(26);  // Ctrl+Z to end message
-  
-  // Wait for response
-  String response = sendATCommand("", 10000);
-  return response.indexOf("+CMGS:") != -1;
 }
 
-String sendATCommand(const String& command, int timeout) {
-  A9GSerial.println(command);
-  
-  unsigned long startTime = millis();
-  String response = "";
-  
-  while (millis() - startTime < static_cast<unsigned long>(timeout)) {
-    if (A9GSerial.available()) {
-      char c = A9GSerial.read();
-      response += c;
-      if (response.indexOf("OK") != -1 || response.indexOf("ERROR") != -1 || response.indexOf(">") != -1) {
-        break;
-      }
-    }
+void onSMSSent(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    blinkLED(2, 500);  // Slow blink twice to indicate success
+  } else {
+    blinkLED(5, 50);  // Fast blink 5 times to indicate trouble
   }
-  
-  return response;
+  modemBusy = false;
 }
 
 void blinkLED(int times, int duration) {
@@ -151,7 +148,8 @@ void blinkLED(int times, int duration) {
 }
 
 void resetA9G() {
-  sendATCommand("AT+CRESET", 5000); // Send reset command
-  delay(10000); // Wait for A9G to restart
+  modem.clearQueue();
+  modem.send("AT+CRESET", 5000); // Send reset command
+  modem.holdOff(10000); // Wait for A9G to restart
   initA9G(); // Re-initialize A9G after reset
-}
\ No newline at end of file
+}
@@ -0,0 +1,216 @@
+import paho.mqtt.client as mqtt
+import base64
+import csv
+import os
+import sys
+from datetime import datetime, timedelta
+import logging
+
+# Set up logging
+logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+
+# CSV file to log the received data
+CSV_FILE = "sensor_data_log.csv"
+CSV_HEADER = ["Timestamp", "Temperature (°C)", "Humidity (%)", "Pressure (hPa)", "Location"]
+
+# MQTT configuration
+MQTT_BROKER = "test.mosquitto.org"
+MQTT_PORT = 1883
+MQTT_TOPIC = "/test/stm32/sensors"
+MQTT_LOCATION_TOPIC = "/test/stm32/location"
+MQTT_LINKS_TOPIC = "/test/stm32/links"
+MQTT_COMMAND_TOPIC = "/test/stm32/STM32Client/commands"
+MQTT_RESULT_TOPIC = "/test/stm32/STM32Client/results"
+
+# Last location retained by the gateway, attached to batched readings
+last_location = "Unknown"
+
+def setup_csv_file():
+    """Set up the CSV file with headers if it doesn't exist."""
+    if not os.path.isfile(CSV_FILE):
+        with open(CSV_FILE, mode='w', newline='') as file:
+            writer = csv.writer(file)
+            writer.writerow(CSV_HEADER)
+
+def on_connect(client, userdata, flags, rc, properties=None):
+    """Callback when the client connects to the broker."""
+    if rc == 0:
+        logging.info(f"Connected to MQTT broker: {MQTT_BROKER}")
+        client.subscribe(MQTT_TOPIC)
+        client.subscribe(MQTT_LOCATION_TOPIC)
+        client.subscribe(MQTT_LINKS_TOPIC)
+        client.subscribe(MQTT_RESULT_TOPIC)
+        logging.info(f"Subscribed to topics: {MQTT_TOPIC}, {MQTT_LOCATION_TOPIC}, {MQTT_LINKS_TOPIC}, "
+                     f"{MQTT_RESULT_TOPIC}")
+
+        # Commands given on the command line, e.g. "N:3,C:INTERVAL,V:120000", go to the gateway once connected
+        for command in (userdata or []):
+            client.publish(MQTT_COMMAND_TOPIC, command)
+            logging.info(f"Sent command: {command}")
+    else:
+        logging.error(f"Failed to connect to MQTT broker. Error code: {rc}")
+
+def parse_sensor_data(message):
+    """Parse sensor data from the message in the format T:21.24,H:69.37,P:814.87,L:9999.0."""
+    try:
+        # Split the message by commas and then by colons to get key-value pairs
+        data_parts = message.split(',')
+        data = {}
+        for part in data_parts:
+            key, value = part.split(':')
+            data[key.strip()] = float(value.strip())
+
+        return {
+            'temperature': data.get('T', 9999.0),
+            'humidity': data.get('H', 9999.0),
+            'pressure': data.get('P', 9999.0),
+            'location': data.get('L', 'Unknown') 
+        }
+    except Exception as e:
+        logging.error(f"Failed to parse sensor data: {message}. Error: {e}")
+        return None
+
+def read_varint(data, pos):
+    """Read an unsigned LEB128 varint, returning (value, next position)."""
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+def parse_batch(message):
+    """Parse a B1 text or b1 base64 batch into (now, [(timestamp, node, T, H, P, flags)]), values in
+    the gateway's fixed-point units (centi-degC, centi-%RH, deci-Pa) and timestamps in uptime seconds."""
+    records = []
+    if message.startswith("b1:"):
+        data = base64.b64decode(message[3:])
+        now = int.from_bytes(data[0:4], "little")
+        timestamp = int.from_bytes(data[4:8], "little")
+        pos = 8
+        while pos < len(data):
+            node = data[pos]
+            zigzag, pos = read_varint(data, pos + 1)
+            timestamp += (zigzag >> 1) ^ -(zigzag & 1)
+            temperature = int.from_bytes(data[pos:pos + 2], "little", signed=True)
+            humidity = int.from_bytes(data[pos + 2:pos + 4], "little")
+            pressure = int.from_bytes(data[pos + 4:pos + 7], "little")
+            flags = data[pos + 7]
+            pos += 8
+            records.append((timestamp, node, temperature, humidity, pressure, flags))
+        return now, records
+
+    header, *entries = message.split(';')
+    _, now, timestamp = header.split(',')
+    now = int(now)
+    timestamp = int(timestamp)
+    for entry in entries:
+        node, delta, temperature, humidity, pressure, flags = (int(v) for v in entry.split(','))
+        timestamp += delta
+        records.append((timestamp, node, temperature, humidity, pressure, flags))
+    return now, records
+
+def log_batch(message):
+    """Expand a batch into one CSV row per reading, converting uptime to wall-clock time."""
+    arrival = datetime.now()
+    now, records = parse_batch(message)
+    with open(CSV_FILE, mode='a', newline='') as file:
+        writer = csv.writer(file)
+        for timestamp, node, temperature, humidity, pressure, flags in records:
+            # Timestamp 0 marks readings stored before the gateway's last reset
+            received = arrival - timedelta(seconds=now - timestamp)
+            temperature = 9999.0 if flags & 0x01 else temperature / 100
+            humidity = 9999.0 if flags & 0x01 else humidity / 100
+            pressure = 9999.0 if flags & 0x02 else pressure / 1000
+            logging.info(f"Batched Data -> Node {node} at {received:%Y-%m-%d %H:%M:%S}: "
+                         f"Temp: {temperature:.2f} °C, Humid: {humidity:.2f} %, Press: {pressure:.2f} hPa")
+            writer.writerow([received.strftime("%Y-%m-%d %H:%M:%S"), temperature, humidity, pressure, last_location])
+    logging.info(f"Logged {len(records)} batched readings")
+
+def log_link_stats(message):
+    """Log per-node link statistics in the format N:1,R:120,L:3,D:1,S:-78,P:1,T:5;N:2,..."""
+    for node in message.split(';'):
+        try:
+            fields = dict(part.split(':') for part in node.split(','))
+            received, lost = int(fields['R']), int(fields['L'])
+            loss = 100.0 * lost / (received + lost) if received + lost else 0.0
+            logging.info(f"Link -> Node {fields['N']}: received {received}, lost {lost} ({loss:.1f} %), "
+                         f"duplicates {fields['D']}, RSSI {fields['S']} dBm, "
+                         f"profile {fields.get('P', '0')} at {fields.get('T', '?')} dBm")
+        except (KeyError, ValueError) as e:
+            logging.error(f"Failed to parse link statistics: {node}. Error: {e}")
+
+def on_message(client, userdata, msg):
+    """Callback when a message is received from the broker."""
+    global last_location
+    try:
+        message = msg.payload.decode()
+        logging.info(f"Received message on topic {msg.topic}: {message}")
+
+        if msg.topic == MQTT_LOCATION_TOPIC:
+            last_location = message[2:] if message.startswith("L:") else message
+            return
+
+        if msg.topic == MQTT_LINKS_TOPIC:
+            log_link_stats(message)
+            return
+
+        if msg.topic == MQTT_RESULT_TOPIC:
+            logging.info(f"Command result -> {message}")
+            return
+
+        if message.startswith(("B1,", "b1:")):
+            log_batch(message)
+            return
+
+        # Parse the sensor data
+        parsed_data = parse_sensor_data(message)
+        if parsed_data is None:
+            return
+
+        # Get the current timestamp
+        timestamp = datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+
+        # Format the data for logging
+        formatted_message = (
+            f"Temp: {parsed_data['temperature']:.2f} °C, "
+            f"Humid: {parsed_data['humidity']:.2f} %, "
+            f"Press: {parsed_data['pressure']:.2f} hPa, "
+            f"Location: {parsed_data['location']}"
+        )
+        logging.info(f"Formatted Data -> {formatted_message}")
+
+        # Append the data to CSV file without the raw message column
+        with open(CSV_FILE, mode='a', newline='') as file:
+            writer = csv.writer(file)
+            writer.writerow([
+                timestamp,
+                parsed_data['temperature'],
+                parsed_data['humidity'],
+                parsed_data['pressure'],
+                parsed_data['location']
+            ])
+
+    except Exception as e:
+        logging.error(f"Error processing message: {e}")
+
+def main():
+    """Main function to set up and run the MQTT client."""
+    setup_csv_file()
+
+    client = mqtt.Client(userdata=sys.argv[1:])
+    client.on_connect = on_connect
+    client.on_message = on_message
+
+    try:
+        client.connect(MQTT_BROKER, MQTT_PORT, 60)
+        client.loop_forever()
+    except Exception as e:
+        logging.error(f"Error connecting to MQTT broker: {e}")
+
+if __name__ == "__main__":
+    main()
+
@@ -0,0 +1,1855 @@
+#include <Arduino.h>
+#include <RH_CC110.h>
+#include <SPI.h>
+#include <HardwareSerial.h>
+#include <SensorPacket.h>
+#include <LinkAdvisor.h>
+#include <NodeTable.h>
+#include <FrameRing.h>
+#include <AtEngine.h>
+#include <ModemBoot.h>
+#include <GpsCache.h>
+#include <StringBuilder.h>
+#include <GatewayText.h>
+#include <HeapMonitor.h>
+#include <HealthSupervisor.h>
+#include <RuntimeStats.h>
+#include <StatusLed.h>
+#include <TaskScheduler.h>
+
+/* Output Sinks, chosen per PlatformIO env with -D GATEWAY_SINKS=<bits> (see platformio.ini); a sink left
+ * out is not compiled at all, so it costs neither flash nor RAM:
+ * Bit               | Sink
+ * ------------------|------------------------------------------------------------------------------
+ * GATEWAY_SINK_SMS  | Min/mean/max digest of every node by SMS to GATEWAY_PHONE every SMS_INTERVAL, alarms at once
+ * GATEWAY_SINK_MQTT | Store-and-forward MQTT uplink, downlink commands, link statistics and metrics
+ */
+#define GATEWAY_SINK_SMS 0x01
+#define GATEWAY_SINK_MQTT 0x02
+#ifndef GATEWAY_SINKS
+#define GATEWAY_SINKS (GATEWAY_SINK_SMS | GATEWAY_SINK_MQTT)
+#endif
+#define GATEWAY_SMS (((GATEWAY_SINKS) & GATEWAY_SINK_SMS) != 0)
+#define GATEWAY_MQTT (((GATEWAY_SINKS) & GATEWAY_SINK_MQTT) != 0)
+
+static_assert((GATEWAY_SINKS) != 0 && ((GATEWAY_SINKS) & ~(GATEWAY_SINK_SMS | GATEWAY_SINK_MQTT)) == 0,
+              "GATEWAY_SINKS must select GATEWAY_SINK_SMS, GATEWAY_SINK_MQTT or both");
+
+// Zone valves driven from the nodes' readings by the gateway itself (see IrrigationEngine.h); off unless an env
+// turns it on, since IRRIGATION_ZONES has to be filled in with the deployment's valve nodes first
+#ifndef GATEWAY_IRRIGATION
+#define GATEWAY_IRRIGATION 0
+#endif
+
+// Commands ride on ACKs to the nodes for the MQTT sink's remote configuration and for the irrigation valves
+#define GATEWAY_DOWNLINK (GATEWAY_MQTT || GATEWAY_IRRIGATION)
+
+#if GATEWAY_MQTT
+#include <MqttSession.h>
+#include <RecordStore.h>
+#include <Stm32FlashStorage.h>
+#include <BatchCodec.h>
+#include <ConfigStore.h>
+#endif
+#if GATEWAY_DOWNLINK
+#include <DownlinkQueue.h>
+#endif
+#if GATEWAY_IRRIGATION
+#include <IrrigationEngine.h>
+#endif
+#if GATEWAY_SMS
+#include <SmsDigest.h>
+#include <SmsPdu.h>
+#endif
+
+// Pin Definitions for CC1101 connection to STM32 BluePill
+#define CC1101_CS_PIN PA4   // Chip Select (CSN) pin
+
+// General Digital Output 0 pin; boards wired as in the README use PA3 (env:sms sets it)
+#ifndef CC1101_GDO0_PIN
+#define CC1101_GDO0_PIN PB0
+#endif
+
+/* Complete CC1101 to STM32 BluePill Connection Guide:
+ * CC1101 Pin | BluePill Pin | Function
+ * -----------|--------------|----------
+ * 1 (GND)    | GND          | Ground
+ * 2 (VCC)    | 3.3V         | Power (3.3V only!)
+ * 3 (GDO0)   | PB0 / PA3    | General Digital Output 0 (CC1101_GDO0_PIN)
+ * 4 (CSN)    | PA4          | SPI Chip Select
+ * 5 (SCK)    | PA5          | SPI Clock
+ * 6 (MOSI)   | PA7          | SPI Master Out Slave In
+ * 7 (MISO)   | PA6          | SPI Master In Slave Out
+ * 8 (GDO2)   | Not Connected| General Digital Output 2 (Not used in this code)
+ */
+
+/* A9G to STM32 BluePill Connection Guide:
+ * A9G Pin    | BluePill Pin | Function
+ * -----------|--------------|----------
+ * TXD        | PA10         | UART RX (connect to BluePill's UART1 RX)
+ * RXD        | PA9          | UART TX (connect to BluePill's UART1 TX)
+ * GND        | GND          | Ground
+ * VCC        | Not Connected| Power (A9G powered separately via USB)
+ */
+
+#define LED_PIN PC13
+#define LED_ON LOW
+#define LED_OFF HIGH
+
+// Blink codes, shown without blocking loop() (see the guide at the end of this file)
+StatusLed led(LED_PIN, LED_ON);
+
+// Reporting intervals in milliseconds: SMS every 30 minutes, readings queued for the MQTT uplink every minute
+#ifndef SMS_INTERVAL
+#define SMS_INTERVAL 1800000
+#endif
+#ifndef MQTT_INTERVAL
+#define MQTT_INTERVAL 60000
+#endif
+#define LINK_STATS_INTERVAL 3600000 // Per-node link statistics are published hourly
+#define STATS_INTERVAL 300000 // Runtime metrics are snapshot every 5 minutes, to USB and the next MQTT report
+#define STATS_TEXT_MAX 192 // Runtime metrics line, see RuntimeStats::format()
+#define MQTT_KEEPALIVE 120 // Seconds, the A9G pings the broker on its own within this interval
+#define COMMAND_RESULTS_CAPACITY 8 // Command results waiting to be published
+#define COMMAND_EXPIRY_CHECK_INTERVAL 60000 // How often queued commands are checked for expiry
+#define IRRIGATION_INTERVAL 10000 // How often the irrigation zones are checked against their rolling means
+#define DECISIONS_CAPACITY 8 // Irrigation decisions waiting to be published
+#define MQTT_RESET_FAILURES 5 // Consecutive failed connects before the A9G is reset
+#define SMS_MAX_PARTS 3 // Parts of one concatenated SMS; nodes that do not fit go in the next message
+#define SMS_BODY_MAX (SMS_MAX_PARTS > 1 ? SMS_MAX_PARTS * SMS_PART_SEPTETS : SMS_SINGLE_SEPTETS)
+#define RX_RING_CAPACITY 16 // Raw frames buffered between the GDO0 interrupt and loop()
+#define RX_FRAMES_PER_LOOP 8 // Frames decoded per call to processRadioFrames()
+
+// Alarm limits checked on every reading, in frame units; a reading past one goes out by SMS at once instead
+// of waiting for the digest, and the alarm is raised again only after the value came back by the hysteresis
+#ifndef ALARM_TEMPERATURE_HIGH
+#define ALARM_TEMPERATURE_HIGH 3500 // centi-degrees Celsius, heat stress
+#endif
+#ifndef ALARM_TEMPERATURE_LOW
+#define ALARM_TEMPERATURE_LOW 200 // Frost risk
+#endif
+#ifndef ALARM_HUMIDITY_HIGH
+#define ALARM_HUMIDITY_HIGH 10000 // centi-%RH; never exceeded, so off unless set
+#endif
+#ifndef ALARM_HUMIDITY_LOW
+#define ALARM_HUMIDITY_LOW 2000
+#endif
+#define ALARM_TEMPERATURE_HYSTERESIS 100
+#define ALARM_HUMIDITY_HYSTERESIS 300
+
+// Superframe length in milliseconds, a whole number of slots; 0 stops the beacon and leaves nodes on listen-before-talk
+#ifndef TDMA_BEACON_INTERVAL
+#define TDMA_BEACON_INTERVAL 60000
+#endif
+#define TDMA_SLOT_COUNT 100 // Node slots per superframe, a node uses slot NODE_ID % TDMA_SLOT_COUNT
+#define TDMA_SLOT_LENGTH 500 // Milliseconds per slot: a 26-byte summary (~275 ms at 1.2 kbps) plus drift allowance
+
+#define TDMA_SLOT_CHANNEL 1 // Beacon timer compare channel marking the slot boundaries
+#define TDMA_NO_SLOT 0xFF // currentSlot in the beacon slot and the idle tail of the superframe
+
+static_assert(TDMA_BEACON_INTERVAL % TDMA_SLOT_LENGTH == 0, "TDMA_BEACON_INTERVAL must be a whole number of slots");
+static_assert(TDMA_BEACON_INTERVAL == 0 || (TDMA_SLOT_COUNT + 1) * TDMA_SLOT_LENGTH <= TDMA_BEACON_INTERVAL,
+              "TDMA slots do not fit in the superframe");
+#define RADIO_CHECK_INTERVAL 30000 // How often the CC1101 is checked to still be in RX
+#define GPS_CHECK_INTERVAL 1000 // How often GpsCache is asked whether a refresh is due
+#define TASK_SLACK 1000 // A periodic foreground task starting later than this was held up by a blocked pass
+#define MQTT_REPORT_DEADLINE 60000 // Readings waiting longer than one MQTT interval for the modem count as late
+#define SMS_REPORT_DEADLINE 300000 // An SMS report held up for 5 minutes by other modem jobs counts as late
+#define SMS_ALARM_DEADLINE 60000 // An alarm SMS waiting a minute for the modem counts as late
+#define RADIO_TIMEOUT 300000 // 5 minutes out of RX resets the gateway
+#define MODEM_TIMEOUT 3600000 // An hour without a line from the A9G, even after resetA9G(), resets the gateway
+#define CC1101_MARCSTATE_RX 0x0D // MARCSTATE main radio control state while receiving
+#define STORE_FLASH_BASE 0x0800E000 // Uplink spill pages 56-61, above the firmware (see board_upload.maximum_size)
+#define STORE_FLASH_PAGES 6 // 1 KB pages of readings kept through an MQTT outage
+#define CONFIG_FLASH_BASE 0x0800F800 // Settings pages 62-63, the last two, used in turn (see ConfigStore.h)
+#define CONFIG_RESULTS_CAPACITY 4 // Setting changes waiting to be answered
+#define RADIO_FREQUENCY 433000 // CC1101 centre frequency in kHz, the one the nodes are built for
+#define BATCH_COMMAND_MAX 512 // AT+MQTTPUB carrying one batch of stored readings
+
+// BATCH_BINARY packs about twice as many readings per publish as the readable BATCH_TEXT
+#ifndef BATCH_MODE
+#define BATCH_MODE BATCH_BINARY
+#endif
+
+// RH_CC110 with its interrupt handler exposed so onRadioInterrupt() can drain the FIFO itself
+class RH_CC110_Ring : public RH_CC110 {
+public:
+  RH_CC110_Ring(uint8_t slaveSelectPin, uint8_t interruptPin) : RH_CC110(slaveSelectPin, interruptPin) {}
+  void serviceInterrupt() { handleInterrupt(); }
+  
+  // True when the radio state machine is in RX; interrupts are held off so the read does not cut into the ISR's SPI traffic
+  bool receiving() {
+    noInterrupts();
+    uint8_t state = spiBurstReadRegister(RH_CC110_REG_35_MARCSTATE) & 0x1F;
+    interrupts();
+    return state == CC1101_MARCSTATE_RX;
+  }
+};
+
+// Initialize CC1101 radio module
+RH_CC110_Ring cc110(CC1101_CS_PIN, CC1101_GDO0_PIN);
+
+// Raw frame captured in the GDO0 interrupt
+struct RadioFrame {
+  uint8_t len;
+  int16_t rssi;
+  uint32_t receivedAt;
+  uint8_t data[RH_CC110_MAX_MESSAGE_LEN];
+};
+
+// Beacon timer, ticking once a slot; its compare channel fires a beacon airtime later, on the slot boundaries
+// as the nodes see them, since they time their slots from the end of the beacon
+HardwareTimer beaconTimer(TIM4);
+volatile uint16_t beaconTicks = 0; // Slot ticks since the last beacon
+volatile uint32_t superframe = 0;
+volatile uint8_t currentSlot = TDMA_NO_SLOT;
+
+// Link adaptation: advice per node, and the profile each slot is received at (see LinkAdvisor.h)
+LinkAdvisor links;
+uint8_t slotProfile[TDMA_SLOT_COUNT]; // LINK_PROFILE_ROBUST (0) until a node is advised otherwise
+volatile uint8_t radioProfile = LINK_PROFILE_ROBUST;
+
+// Frames queued by onRadioInterrupt() and decoded by processRadioFrames()
+FrameRing<RadioFrame, RX_RING_CAPACITY> rxRing;
+
+// Initialize UART for A9G module
+HardwareSerial A9GSerial(PA10, PA9);
+
+// Non-blocking AT command engine driving the A9G, serviced from loop()
+AtEngine modem(A9GSerial);
+
+// A9G configuration, each step sent as soon as the previous one answers
+const ModemStep A9G_INIT_STEPS[] = {
+  {"ATE0", 1000},
+  {"AT+CGPSPWR=1", 2000},
+  {"AT+CGPSRST=1", 2000},
+  {"AT+CGPSIPR=9600", 2000},
+  {"AT+CGPSOUT=0", 2000}
+};
+
+// Bring-up driven by the modem answering and registering instead of fixed delays
+ModemBoot modemBoot(modem);
+
+// Location refreshed in the background and read by every report
+GpsCache gps(modem);
+
+// Deployment settings; override per env, e.g. '-D GATEWAY_APN="internet"' or '-D MQTT_TOPIC_ROOT="/farm/3"'
+#ifndef GATEWAY_PHONE
+#define GATEWAY_PHONE "+254726240861" // SMS recipient
+#endif
+#ifndef GATEWAY_APN
+#define GATEWAY_APN "safaricom"
+#endif
+#ifndef MQTT_BROKER
+#define MQTT_BROKER "test.mosquitto.org"
+#endif
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+#ifndef MQTT_CLIENT_ID
+#define MQTT_CLIENT_ID "STM32Client"
+#endif
+#ifndef MQTT_TOPIC_ROOT
+#define MQTT_TOPIC_ROOT "/test/stm32"
+#endif
+
+#if GATEWAY_MQTT
+const char* MQTT_TOPIC = MQTT_TOPIC_ROOT "/sensors";
+const char* MQTT_LOCATION_TOPIC = MQTT_TOPIC_ROOT "/location";
+const char* MQTT_STATUS_TOPIC = MQTT_TOPIC_ROOT "/status";
+const char* MQTT_LINKS_TOPIC = MQTT_TOPIC_ROOT "/links";
+const char* MQTT_STATS_TOPIC = MQTT_TOPIC_ROOT "/stats";
+
+// Downlink commands for this gateway's nodes, and their results; per gateway, named after MQTT_CLIENT_ID
+const char* MQTT_COMMAND_TOPIC = MQTT_TOPIC_ROOT "/" MQTT_CLIENT_ID "/commands";
+const char* MQTT_RESULT_TOPIC = MQTT_TOPIC_ROOT "/" MQTT_CLIENT_ID "/results";
+
+// Valve changes decided by the irrigation engine, "Z:<zone>,N:<node>,A:<OPEN|CLOSE>,S:<s>,R:<reasons>,T:,H:"
+const char* MQTT_DECISION_TOPIC = MQTT_TOPIC_ROOT "/" MQTT_CLIENT_ID "/decisions";
+
+/* Downlink Commands, published to MQTT_COMMAND_TOPIC as "N:<node>,C:<name>,V:<value>":
+ * Name      | Value
+ * ----------|----------------------------------------------------------
+ * INTERVAL  | Reading interval in milliseconds (10 s to 1 h)
+ * HEARTBEAT | Longest silence between transmissions in milliseconds
+ * TDEADBAND | Temperature deadband, centi-degrees Celsius
+ * HDEADBAND | Humidity deadband, centi-%RH
+ * PDEADBAND | Pressure deadband, deci-Pascal
+ * THRESHOLD | Soil moisture irrigation threshold, centi-%
+ * VALVE     | Valve open time in seconds, 0 closes it
+ * PROFILE   | Fastest link profile advised to any node (see LinkAdvisor.h); handled by the gateway, N is ignored
+ * Each command is answered on MQTT_RESULT_TOPIC with
+ * "N:<node>,Q:<sequence>,C:<name>,S:<OK|UNSUPPORTED|RANGE|EXPIRED|FULL|INVALID>".
+ */
+struct CommandName {
+  const char* name;
+  uint8_t code;
+};
+
+#define COMMAND_PROFILE 0x80 // Gateway-local command code, never sent to a node
+
+const CommandName COMMAND_NAMES[] = {
+  {"INTERVAL", SENSOR_COMMAND_INTERVAL},
+  {"HEARTBEAT", SENSOR_COMMAND_HEARTBEAT},
+  {"TDEADBAND", SENSOR_COMMAND_TEMPERATURE_DEADBAND},
+  {"HDEADBAND", SENSOR_COMMAND_HUMIDITY_DEADBAND},
+  {"PDEADBAND", SENSOR_COMMAND_PRESSURE_DEADBAND},
+  {"THRESHOLD", SENSOR_COMMAND_MOISTURE_THRESHOLD},
+  {"VALVE", SENSOR_COMMAND_VALVE},
+  {"PROFILE", COMMAND_PROFILE}
+};
+
+// Gateway settings, changed at run time; "K:<name>,V:<value>" sets one, "K:<name>" restores its default
+const char* MQTT_CONFIG_TOPIC = MQTT_TOPIC_ROOT "/" MQTT_CLIENT_ID "/config";
+
+/* Gateway Settings, kept in flash across resets and applied without one:
+ * Name    | Value                                     | Default         | Takes effect
+ * --------|-------------------------------------------|-----------------|---------------------------------------
+ * PHONE   | SMS recipient (SMS sink)                  | GATEWAY_PHONE   | Next SMS
+ * APN     | GPRS access point name                    | GATEWAY_APN     | The A9G is restarted once it is idle
+ * BROKER  | MQTT broker host                          | MQTT_BROKER     | The session moves once nothing is in flight
+ * PORT    | MQTT broker port                          | MQTT_PORT       | Likewise
+ * MQTTINT | MQTT_INTERVAL in milliseconds (10 s-1 h)  | MQTT_INTERVAL   | At once
+ * SMSINT  | SMS_INTERVAL in milliseconds (5 min-24 h) | SMS_INTERVAL    | At once (SMS sink)
+ * FREQ    | CC1101 frequency in kHz (387-464 MHz)     | RADIO_FREQUENCY | At once; only for nodes built for it
+ * Each change is answered on MQTT_RESULT_TOPIC with "K:<name>,S:<OK|RANGE|INVALID|FLASH>".
+ * MQTT_CLIENT_ID and MQTT_TOPIC_ROOT stay build-time settings, since they name the topics themselves.
+ */
+enum ConfigKey {
+  // Stored under these numbers: add new keys at the end and never reuse one
+  CONFIG_PHONE,
+  CONFIG_APN,
+  CONFIG_BROKER,
+  CONFIG_PORT,
+  CONFIG_MQTT_INTERVAL,
+  CONFIG_SMS_INTERVAL,
+  CONFIG_FREQUENCY
+};
+
+struct ConfigSetting {
+  const char* name;
+  uint8_t key;
+  bool text;
+  int32_t minimum;  // Smallest value, or shortest text
+  int32_t maximum;
+};
+
+const ConfigSetting CONFIG_SETTINGS[] = {
+#if GATEWAY_SMS
+  {"PHONE", CONFIG_PHONE, true, 4, 16},
+#endif
+  {"APN", CONFIG_APN, true, 1, 40},
+  {"BROKER", CONFIG_BROKER, true, 1, CONFIG_VALUE_MAX - 1},
+  {"PORT", CONFIG_PORT, false, 1, 65535},
+  {"MQTTINT", CONFIG_MQTT_INTERVAL, false, 10000, 3600000},
+#if GATEWAY_SMS
+  {"SMSINT", CONFIG_SMS_INTERVAL, false, 300000, 86400000},
+#endif
+  {"FREQ", CONFIG_FREQUENCY, false, 387000, 464000}
+};
+
+// A setting change and its answer, one of the COMMAND_RESULT_* / SENSOR_RESULT_* codes
+struct ConfigResult {
+  uint8_t key;
+  uint8_t result;
+};
+
+Stm32FlashStorage settingsFlash(CONFIG_FLASH_BASE, 2);
+ConfigStore config(settingsFlash);
+
+// Setting changes waiting for the uplink
+FrameRing<ConfigResult, CONFIG_RESULTS_CAPACITY> configResults;
+
+// Broker host the session connects to; a copy, since a compaction moves the value in flash
+char brokerHost[CONFIG_VALUE_MAX];
+bool brokerDue = false;             // BROKER or PORT changed; the session moves once the modem is idle
+bool modemRestartDue = false;       // APN changed; the A9G is restarted once idle and comes up with it
+
+// Persistent MQTT session, reopened with backoff whenever the link drops
+MqttSession mqtt(modem, MQTT_BROKER, MQTT_PORT, MQTT_CLIENT_ID, MQTT_KEEPALIVE);
+
+// Command results waiting for the uplink
+FrameRing<SensorCommandResult, COMMAND_RESULTS_CAPACITY> commandResults;
+
+// Readings waiting for the MQTT uplink, spilled to flash while the link is down
+Stm32FlashStorage spillFlash(STORE_FLASH_BASE, STORE_FLASH_PAGES);
+RecordStore uplinkStore(&spillFlash);
+
+bool mqttWasConnected = false;
+bool linkStatsDue = false;          // Link statistics go out with the next report
+uint8_t linkCursor = 0;             // Next node table slot the link statistics publish starts at
+bool statsDue = false;              // statsText goes out with the next report
+
+// Batch publish in flight, kept global because the AT engine sends it from this buffer
+char batchCommand[BATCH_COMMAND_MAX];
+uint16_t batchRecords = 0;
+char publishedLocation[GPS_LOCATION_MAX] = "";    // Last location retained on MQTT_LOCATION_TOPIC
+#endif
+
+#if GATEWAY_DOWNLINK
+// Results the gateway reports itself, next to the SENSOR_RESULT_* codes from the nodes
+#define COMMAND_RESULT_EXPIRED 0x80 // No result from the node within DOWNLINK_EXPIRY
+#define COMMAND_RESULT_FULL 0x81    // DownlinkQueue full, the command was not queued
+#define COMMAND_RESULT_INVALID 0x82 // Command text could not be parsed
+#define COMMAND_RESULT_FLASH 0x83   // A setting could not be written to flash
+
+// Commands waiting to ride on an ACK to their node
+DownlinkQueue downlinks;
+#endif
+
+#if GATEWAY_IRRIGATION
+/* Example Irrigation Zones, not a deployment: replace them with the field's sensor and valve nodes and its limits
+ * before building with GATEWAY_IRRIGATION. They take the limits of the lab controller's blocks
+ * (lab-experiment/arduino-code) in frame units, and the stock weather nodes 1-3 have no valve, so as they
+ * stand every zone disables itself on the first UNSUPPORTED answer. The field nodes carry no soil moisture,
+ * so the zones water on their sensor node's air temperature and humidity:
+ * Zone  | Sensor node | Valve node | Temperature max | Humidity min | Watering | Soak
+ * ------|-------------|------------|-----------------|--------------|----------|-------
+ * Beans | 1           | 1          | 26.00 C         | 65.00 %RH    | 10 min   | 5 min
+ * Maize | 2           | 2          | 30.00 C         | 55.00 %RH    | 10 min   | 5 min
+ * Onion | 3           | 3          | 25.00 C         | 70.00 %RH    | 10 min   | 5 min
+ * A node answering UNSUPPORTED to the valve command has no valve, and its zone is disabled until reboot.
+ */
+const IrrigationZone IRRIGATION_ZONES[] = {
+  {"Beans", 1, 1, 2600, 6500, 100, 300, 600, 300000},
+  {"Maize", 2, 2, 3000, 5500, 100, 300, 600, 300000},
+  {"Onion", 3, 3, 2500, 7000, 100, 300, 600, 300000}
+};
+
+IrrigationEngine irrigation(IRRIGATION_ZONES, sizeof(IRRIGATION_ZONES) / sizeof(IRRIGATION_ZONES[0]));
+
+#if GATEWAY_MQTT
+// Decisions waiting for the uplink
+FrameRing<IrrigationDecision, DECISIONS_CAPACITY> decisions;
+#endif
+#endif
+
+// Cycle-counter spans, radio counters, heap low-water mark and loop latency, snapshot into statsText
+RuntimeStats stats;
+FixedString<STATS_TEXT_MAX> statsText;
+
+// Set when FREQ changed while the radio was transmitting; the retune is tried again on the next pass
+bool frequencyDue = false;
+
+// Watchdog-fed supervision of the radio, the modem and the heap
+HealthSupervisor health;
+int8_t radioHealth = -1;
+int8_t modemHealth = -1;
+int8_t heapHealth = -1;
+bool resetReported = false;  // The reason for the last reset has been sent
+unsigned long lastDataReceivedTime = 0;
+
+// Latest reading, RSSI and sequence window of every transmitter node heard
+NodeTable nodeTable;
+
+// Modem job currently running as a chain of AT commands; a new report only starts when idle
+enum ModemJob {
+  JOB_IDLE,
+  JOB_INIT, // A9G bring-up after boot or reset
+  JOB_GPS,  // Background GPS refresh, the receiver is powered down again afterwards
+  JOB_MQTT, // Publish the cached location if it changed, then the stored readings in as few batches as possible
+  JOB_SMS   // Switch to PDU mode, send the alarms or the digest and the cached location in as few SMS as possible
+};
+
+ModemJob modemJob = JOB_INIT;
+bool reportSuccess = true;          // False once any publish or SMS of the running report failed
+
+#if GATEWAY_SMS
+const SmsAlarmLimits ALARM_LIMITS = {
+  ALARM_TEMPERATURE_HIGH, ALARM_TEMPERATURE_LOW, ALARM_TEMPERATURE_HYSTERESIS,
+  ALARM_HUMIDITY_HIGH, ALARM_HUMIDITY_LOW, ALARM_HUMIDITY_HYSTERESIS
+};
+
+// Readings of every node since its last digest, and the alarms they raised
+SmsDigest smsDigest(ALARM_LIMITS);
+uint32_t digestStartedAt = 0;       // millis() of the last digest report, shown as the window length
+
+// Running SMS report: the digest, or the alarm fast path
+bool smsAlarmReport = false;
+uint8_t smsOrder[NODE_TABLE_CAPACITY];   // Digest slots in the order they are sent, taken when the report starts
+uint8_t smsOrderSize = 0;
+uint8_t reportCursor = 0;                // Next smsOrder position (digest) or digest slot (alarms) to look at
+
+// Nodes carried by the SMS currently being sent, with their window samples (digest) or alarm bits (alarms)
+uint8_t smsBatch[NODE_TABLE_CAPACITY];
+uint16_t smsBatchMark[NODE_TABLE_CAPACITY];
+uint8_t smsBatchSize = 0;
+
+// Message being sent, kept global because the AT engine sends each part's PDU from smsPdu
+FixedString<SMS_BODY_MAX + 1> smsBody;
+FixedString<SMS_PDU_MAX_OCTETS * 2 + 1> smsPdu;
+uint8_t smsReference = 0;           // Concatenation reference, one per multi-part message
+uint8_t smsPart = 0;
+uint8_t smsParts = 0;
+#endif
+
+// Function prototypes
+void initCC1101();
+void initBeacon();
+void sendFromInterrupt(uint8_t to, uint8_t id, uint8_t flags, const uint8_t* data, uint8_t len);
+void onBeaconTimer();
+void onSlotBoundary();
+void tuneRadio(uint8_t profile);
+bool tuneFrequency();
+uint32_t radioFrequency();
+void onRadioInterrupt();
+uint8_t processRadioFrames();
+void initA9G(uint16_t grace);
+void onModemBooted(AtResult result, void* context);
+void startModemStep(const char* command, uint32_t timeout, AtDoneCallback onDone, AtLineCallback onLine = nullptr);
+void finishModemJob();
+void onGPSRefreshed(AtResult result, void* context);
+#if GATEWAY_MQTT
+void onModemReady(AtResult result, void* context);
+void storePendingNodes();
+void startMQTTReport();
+void onStatusPublished(AtResult result, void* context);
+void publishCommandResults();
+void onCommandResultPublished(AtResult result, void* context);
+void publishDecisions();
+void onDecisionPublished(AtResult result, void* context);
+void publishLocation();
+void onLocationPublished(AtResult result, void* context);
+void publishLinkStats();
+void onLinkStatsPublished(AtResult result, void* context);
+void publishStats();
+void onStatsPublished(AtResult result, void* context);
+void publishNextBatch();
+void onBatchPublished(AtResult result, void* context);
+void finishMQTTReport();
+void onSupervisedReset(void* context);
+void formatLinkStats(const NodeEntry& node, StringBuilder& text);
+void setupGPRS();
+void onCommandMessage(const char* payload, void* context);
+void onConfigMessage(const char* payload, void* context);
+const ConfigSetting* parseConfigText(const char* text, const char*& value);
+uint8_t changeSetting(const ConfigSetting& setting, const char* value);
+void applySetting(uint8_t key);
+void applyDeferredSettings();
+const char* settingName(uint8_t key);
+void publishConfigResults();
+void onConfigResultPublished(AtResult result, void* context);
+bool parseCommandText(const char* text, SensorCommand& command);
+const char* commandName(uint8_t code);
+const char* resultName(uint8_t result);
+void reportCommandResult(const SensorCommandResult& result);
+void formatCommandResult(const SensorCommandResult& result, StringBuilder& text);
+bool taskQueueReadings(uint32_t now, void* context);
+bool taskLinkStats(uint32_t now, void* context);
+bool taskMqttReport(uint32_t now, void* context);
+#endif
+#if GATEWAY_DOWNLINK
+void handleCommandResult(const SensorCommandResult& result);
+void expireCommands();
+bool taskCommandExpiry(uint32_t now, void* context);
+#endif
+#if GATEWAY_IRRIGATION
+bool taskIrrigation(uint32_t now, void* context);
+#endif
+#if GATEWAY_SMS
+void startSMSReport(bool alarms);
+const char* smsRecipient();
+void onSMSPduMode(AtResult result, void* context);
+void sendNextSMS();
+bool buildDigestSMS();
+bool buildAlarmSMS();
+void sendSMSPart();
+void onSMSPartSent(AtResult result, void* context);
+bool taskSmsAlarm(uint32_t now, void* context);
+bool taskSmsReport(uint32_t now, void* context);
+#endif
+void resetA9G();
+void superviseHealth();
+void snapshotStats();
+void formatResetCause(StringBuilder& text);
+bool taskRadio(uint32_t now, void* context);
+bool taskModem(uint32_t now, void* context);
+bool taskLed(uint32_t now, void* context);
+bool taskStats(uint32_t now, void* context);
+bool taskRadioCheck(uint32_t now, void* context);
+bool taskHealth(uint32_t now, void* context);
+bool taskGps(uint32_t now, void* context);
+
+// Everything loop() does, most urgent first: radio ingest and the AT engine run on every pass ahead of the
+// timers, and the modem jobs come last, at most one started per pass (see TaskScheduler.h)
+enum TaskId {
+  TASK_RADIO,
+  TASK_MODEM,
+  TASK_LED,
+#if GATEWAY_MQTT
+  TASK_QUEUE_READINGS,
+  TASK_LINK_STATS,
+#endif
+#if GATEWAY_DOWNLINK
+  TASK_COMMAND_EXPIRY,
+#endif
+#if GATEWAY_IRRIGATION
+  TASK_IRRIGATION,
+#endif
+  TASK_STATS,
+  TASK_RADIO_CHECK,
+  TASK_HEALTH,
+#if GATEWAY_SMS
+  TASK_SMS_ALARM,
+#endif
+#if GATEWAY_MQTT
+  TASK_MQTT_REPORT,
+#endif
+#if GATEWAY_SMS
+  TASK_SMS_REPORT,
+#endif
+  TASK_GPS,
+  TASK_COUNT
+};
+
+const SchedulerTask TASKS[] = {
+  {"RADIO", TASK_FOREGROUND, TASK_EVERY_PASS, TASK_NO_DEADLINE, taskRadio, nullptr},
+  {"MODEM", TASK_FOREGROUND, TASK_EVERY_PASS, TASK_NO_DEADLINE, taskModem, nullptr},
+  {"LED", TASK_FOREGROUND, TASK_EVERY_PASS, TASK_NO_DEADLINE, taskLed, nullptr},
+#if GATEWAY_MQTT
+  {"QUEUE", TASK_FOREGROUND, MQTT_INTERVAL, TASK_SLACK, taskQueueReadings, nullptr},
+  {"LINKS", TASK_FOREGROUND, LINK_STATS_INTERVAL, TASK_SLACK, taskLinkStats, nullptr},
+#endif
+#if GATEWAY_DOWNLINK
+  {"EXPIRY", TASK_FOREGROUND, COMMAND_EXPIRY_CHECK_INTERVAL, TASK_SLACK, taskCommandExpiry, nullptr},
+#endif
+#if GATEWAY_IRRIGATION
+  {"IRRIGATE", TASK_FOREGROUND, IRRIGATION_INTERVAL, TASK_SLACK, taskIrrigation, nullptr},
+#endif
+  {"STATS", TASK_FOREGROUND, STATS_INTERVAL, TASK_SLACK, taskStats, nullptr},
+  {"RXCHECK", TASK_FOREGROUND, RADIO_CHECK_INTERVAL, TASK_SLACK, taskRadioCheck, nullptr},
+  {"HEALTH", TASK_FOREGROUND, TASK_EVERY_PASS, TASK_NO_DEADLINE, taskHealth, nullptr},
+#if GATEWAY_SMS
+  {"ALARM", TASK_BACKGROUND, TASK_ON_DEMAND, SMS_ALARM_DEADLINE, taskSmsAlarm, nullptr},
+#endif
+#if GATEWAY_MQTT
+  {"MQTT", TASK_BACKGROUND, TASK_ON_DEMAND, MQTT_REPORT_DEADLINE, taskMqttReport, nullptr},
+#endif
+#if GATEWAY_SMS
+  {"SMS", TASK_BACKGROUND, SMS_INTERVAL, SMS_REPORT_DEADLINE, taskSmsReport, nullptr},
+#endif
+  {"GPS", TASK_BACKGROUND, GPS_CHECK_INTERVAL, TASK_NO_DEADLINE, taskGps, nullptr}
+};
+
+static_assert(sizeof(TASKS) / sizeof(TASKS[0]) == TASK_COUNT, "TASKS must have one row per TaskId, in order");
+
+TaskScheduler scheduler(TASKS, TASK_COUNT);
+
+void setup() {
+  // Start supervision first, so the watchdog also covers a hang during bring-up
+  health.begin();
+  radioHealth = health.addSubsystem("RADIO", RADIO_TIMEOUT);
+  modemHealth = health.addSubsystem("MODEM", MODEM_TIMEOUT);
+  heapHealth = health.addSubsystem("HEAP", HEALTH_NO_TIMEOUT);
+  
+  RuntimeStats::begin();
+  led.begin();
+  Serial.begin(115200);  // USB CDC, where the runtime metrics are dumped while a host has the port open
+  
+#if GATEWAY_MQTT
+  health.onReset(onSupervisedReset);
+  uplinkStore.begin();  // Readings spilled before a reset are sent first
+  config.begin();       // Settings changed over MQTT before a reset, read by the bring-up below
+  strncpy(brokerHost, config.text(CONFIG_BROKER, MQTT_BROKER), sizeof(brokerHost) - 1);
+  mqtt.setBroker(brokerHost, (uint16_t)config.number(CONFIG_PORT, MQTT_PORT));
+#endif
+  
+  SPI.begin();
+  initCC1101();
+  
+  A9GSerial.begin(9600);
+#if GATEWAY_MQTT
+  mqtt.begin();
+  mqtt.subscribe(MQTT_COMMAND_TOPIC, onCommandMessage);
+  mqtt.subscribe(MQTT_CONFIG_TOPIC, onConfigMessage);
+#endif
+  
+  // Queue the bring-up; loop() runs it while the radio keeps receiving
+  initA9G(0);
+
+  // Anything allocated from here on is a steady-state allocation, which the firmware should never make
+  heapMonitorMark();
+  
+  scheduler.begin(millis());
+#if GATEWAY_MQTT
+  applySetting(CONFIG_MQTT_INTERVAL);
+  applySetting(CONFIG_SMS_INTERVAL);
+#endif
+  
+  // Indicate setup completion
+  led.blink(3, 200);  // 3 quick blinks
+}
+
+void loop() {
+  stats.loopPass(cycleCount());
+  scheduler.poll(millis());
+}
+
+// Decode whatever the GDO0 interrupt queued since the last pass
+bool taskRadio(uint32_t now, void* context) {
+  if (frequencyDue) {
+    frequencyDue = !tuneFrequency();
+  }
+  if (processRadioFrames() > 0) {
+    led.blink(2, 100);  // 2 quick blinks indicate successful data reception and parsing
+  }
+  return true;
+}
+
+// Advance the AT command in flight, and keep the MQTT session open once the modem is up, resetting the A9G
+// if it cannot connect at all; a session that comes back after an outage flushes straight away
+bool taskModem(uint32_t now, void* context) {
+  uint32_t start = cycleCount();
+  modem.poll();
+  stats.record(SPAN_AT, cycleCount() - start);
+  
+#if GATEWAY_MQTT
+  if (modemJob == JOB_IDLE) {
+    applyDeferredSettings();
+  }
+  if (modemJob != JOB_INIT) {
+    mqtt.poll();
+    if (modemJob == JOB_IDLE && mqtt.consecutiveFailures() >= MQTT_RESET_FAILURES) {
+      resetA9G();
+    }
+  }
+  
+  if (mqtt.connected() && !mqttWasConnected && uplinkStore.size() > 0) {
+    scheduler.trigger(TASK_MQTT_REPORT, now);
+  }
+  mqttWasConnected = mqtt.connected();
+#endif
+  return true;
+}
+
+bool taskLed(uint32_t now, void* context) {
+  led.poll();
+  return true;
+}
+
+bool taskStats(uint32_t now, void* context) {
+  snapshotStats();
+#if GATEWAY_MQTT
+  statsDue = true;
+#endif
+  return true;
+}
+
+// Nodes can stay silent for long stretches, so the radio also counts as alive while it sits in RX
+bool taskRadioCheck(uint32_t now, void* context) {
+  if (cc110.receiving()) {
+    health.alive(radioHealth);
+  }
+  return true;
+}
+
+// Report progress and feed the watchdog; a subsystem that stopped making progress resets the gateway
+bool taskHealth(uint32_t now, void* context) {
+  superviseHealth();
+  return true;
+}
+
+#if GATEWAY_MQTT
+// Queue new readings for the uplink every MQTT interval, whether or not the link is up
+bool taskQueueReadings(uint32_t now, void* context) {
+  storePendingNodes();
+  scheduler.trigger(TASK_MQTT_REPORT, now);
+  return true;
+}
+
+bool taskLinkStats(uint32_t now, void* context) {
+  linkStatsDue = true;
+  linkCursor = 0;
+  return true;
+}
+
+// Publish once the modem is free and the session is up; until then the report stays due
+bool taskMqttReport(uint32_t now, void* context) {
+  if (modemJob != JOB_IDLE || !mqtt.connected()) {
+    return false;
+  }
+  startMQTTReport();
+  return true;
+}
+#endif
+
+#if GATEWAY_DOWNLINK
+bool taskCommandExpiry(uint32_t now, void* context) {
+  expireCommands();
+  return true;
+}
+#endif
+
+#if GATEWAY_IRRIGATION
+// Step the zones; each valve change rides on the valve node's next ACK and goes out with the next MQTT report
+bool taskIrrigation(uint32_t now, void* context) {
+  IrrigationDecision decision;
+  while (irrigation.poll(now, decision)) {
+    SensorCommand command = {decision.valveNode, 0, SENSOR_COMMAND_VALVE, decision.seconds};
+    noInterrupts();
+    bool queued = downlinks.push(command, now);
+    interrupts();
+#if GATEWAY_MQTT
+    IrrigationDecision* slot = decisions.writeSlot();
+    if (slot != nullptr) {
+      *slot = decision;
+      decisions.commit();
+    }
+    scheduler.trigger(TASK_MQTT_REPORT, now);
+#endif
+    if (!queued) {
+      SensorCommandResult result = {command.nodeId, 0, command.code, COMMAND_RESULT_FULL};
+      handleCommandResult(result);
+    }
+  }
+  return true;
+}
+#endif
+
+#if GATEWAY_SMS
+// Send the alarms raised since the last alarm SMS as soon as the modem is free, ahead of every other report
+bool taskSmsAlarm(uint32_t now, void* context) {
+  if (modemJob != JOB_IDLE) {
+    return false;
+  }
+  startSMSReport(true);
+  return true;
+}
+
+bool taskSmsReport(uint32_t now, void* context) {
+  if (modemJob != JOB_IDLE) {
+    return false;
+  }
+  startSMSReport(false);
+  return true;
+}
+#endif
+
+// Refresh the cached location when nothing else needs the modem
+bool taskGps(uint32_t now, void* context) {
+  if (!gps.due()) {
+    return true;
+  }
+  if (modemJob != JOB_IDLE) {
+    return false;
+  }
+  modemJob = JOB_GPS;
+  if (!gps.refresh(onGPSRefreshed)) {
+    finishModemJob();
+  }
+  return true;
+}
+
+void initCC1101() {
+  if (!cc110.init()) {
+    led.blink(5, 100);  // 5 medium blinks indicate CC1101 init failure
+    while (1) {
+      led.poll();  // Halt if CC1101 init fails
+    }
+  }
+  cc110.setFrequency(radioFrequency() / 1000.0f);
+  
+  // Nodes address their frames to the gateway and wait for an acknowledgement
+  cc110.setThisAddress(SENSOR_GATEWAY_ADDRESS);
+  cc110.setHeaderFrom(SENSOR_GATEWAY_ADDRESS);
+  
+  // Take over GDO0 from RadioHead so every packet is queued in rxRing, even while the A9G is busy
+  attachInterrupt(digitalPinToInterrupt(CC1101_GDO0_PIN), onRadioInterrupt, RISING);
+  cc110.setModeRx();
+  
+  initBeacon();
+}
+
+void initBeacon() {
+  if (TDMA_BEACON_INTERVAL == 0) {
+    return;
+  }
+  beaconTimer.setOverflow(TDMA_SLOT_LENGTH * 1000UL, MICROSEC_FORMAT);
+  beaconTimer.attachInterrupt(onBeaconTimer);
+  beaconTimer.setMode(TDMA_SLOT_CHANNEL, TIMER_DISABLED);
+  beaconTimer.setCaptureCompare(TDMA_SLOT_CHANNEL, linkAirtime(SENSOR_BEACON_FRAME_LEN, LINK_PROFILE_ROBUST) * 1000UL,
+                                MICROSEC_COMPARE_FORMAT);
+  beaconTimer.attachInterrupt(TDMA_SLOT_CHANNEL, onSlotBoundary);
+  beaconTimer.resume();
+}
+
+// Timer interrupt: broadcast the TDMA beacon on time, whatever loop() is blocked on
+void onBeaconTimer() {
+  if (++beaconTicks < TDMA_BEACON_INTERVAL / TDMA_SLOT_LENGTH) {
+    return;
+  }
+  beaconTicks = 0;
+  tuneRadio(LINK_PROFILE_ROBUST);  // Nodes listen for the beacon at the robust profile
+  
+  SensorBeacon beacon;
+  beacon.superframe = superframe++;
+  beacon.slotCount = TDMA_SLOT_COUNT;
+  beacon.slotLength = TDMA_SLOT_LENGTH;
+  beacon.interval = TDMA_BEACON_INTERVAL;
+  
+  uint8_t frame[SENSOR_BEACON_FRAME_LEN];
+  size_t frameLen = encodeSensorBeacon(beacon, frame, sizeof(frame));
+  
+  sendFromInterrupt(RH_BROADCAST_ADDRESS, 0, RH_FLAGS_NONE, frame, frameLen);
+}
+
+// Timer compare interrupt on each slot boundary: receive the slot that starts at the profile advised to its node
+void onSlotBoundary() {
+  uint16_t tick = beaconTicks;
+  currentSlot = tick >= 1 && tick <= TDMA_SLOT_COUNT ? tick - 1 : TDMA_NO_SLOT;
+  tuneRadio(currentSlot == TDMA_NO_SLOT ? LINK_PROFILE_ROBUST : slotProfile[currentSlot]);
+}
+
+// Retune the receiver to profile; skipped while a frame is going out, which leaves that slot on the old profile
+void tuneRadio(uint8_t profile) {
+  noInterrupts();
+  if (profile != radioProfile && cc110.mode() != RHGenericDriver::RHModeTx) {
+    cc110.setModeIdle();
+    cc110.setModemConfig((RH_CC110::ModemConfigChoice)LINK_PROFILES[profile].modemConfig);
+    cc110.setModeRx();
+    radioProfile = profile;
+  }
+  interrupts();
+}
+
+// Retune to the FREQ setting; false while a beacon or ACK is on air, so the caller tries again
+bool tuneFrequency() {
+  noInterrupts();
+  bool idle = cc110.mode() != RHGenericDriver::RHModeTx;
+  if (idle) {
+    cc110.setModeIdle();
+    cc110.setFrequency(radioFrequency() / 1000.0f);
+    cc110.setModeRx();
+  }
+  interrupts();
+  return idle;
+}
+
+// Centre frequency in kHz, from the settings when the MQTT sink can change them
+uint32_t radioFrequency() {
+#if GATEWAY_MQTT
+  return (uint32_t)config.number(CONFIG_FREQUENCY, RADIO_FREQUENCY);
+#else
+  return RADIO_FREQUENCY;
+#endif
+}
+
+// GDO0 interrupt: RadioHead reads the FIFO, then the frame moves into rxRing and RX is re-armed
+void onRadioInterrupt() {
+  uint32_t start = cycleCount();
+  cc110.serviceInterrupt();
+  
+  RadioFrame* frame = rxRing.writeSlot();
+  uint8_t discard[RH_CC110_MAX_MESSAGE_LEN];
+  uint8_t len = RH_CC110_MAX_MESSAGE_LEN;
+  
+  // recv() also puts the radio straight back into RX mode; with the ring full the frame is dropped
+  bool received = cc110.recv(frame ? frame->data : discard, &len);
+  if (received) {
+    stats.count(frame ? STAT_RECEIVED : STAT_DROPPED);
+  }
+  if (received && frame) {
+    frame->len = len;
+    frame->rssi = cc110.lastRssi();
+    frame->receivedAt = millis();
+    rxRing.commit();
+    
+    // Acknowledge a frame addressed to the gateway right away, inside the node's ACK timeout; a dropped
+    // frame is not acknowledged, so the node sends it again. The ACK matches RHReliableDatagram's and
+    // carries the node's link advice; a faster profile is only advised for a frame heard in the node's slot
+    if (cc110.headerTo() == SENSOR_GATEWAY_ADDRESS && !(cc110.headerFlags() & RH_FLAGS_ACK)) {
+      uint8_t node = cc110.headerFrom();
+      uint8_t slot = node % TDMA_SLOT_COUNT;
+      LinkAdvice advice = links.update(node, frame->rssi, cc110.headerFlags(), currentSlot == slot);
+      slotProfile[slot] = advice.profile;
+      
+      // The node only listens while it waits for the ACK, so a queued command rides in its payload;
+      // not in the answer to a command result, which would only have the node answer again
+      uint8_t ack[SENSOR_COMMAND_FRAME_LEN] = {'!'};
+      uint8_t ackLen = 1;
+#if GATEWAY_DOWNLINK
+      SensorCommand command;
+      if (len > 0 && (frame->data[0] & 0x0F) != SENSOR_FRAME_RESULT && downlinks.next(node, command)) {
+        ackLen = encodeSensorCommand(command, ack, sizeof(ack));
+      }
+#endif
+      sendFromInterrupt(node, cc110.headerId(), RH_FLAGS_ACK | encodeLinkFlags(advice), ack, ackLen);
+    }
+  }
+  stats.record(SPAN_RADIO_RX, cycleCount() - start);
+}
+
+// Queue a frame for transmission from either radio interrupt; GDO0 is held off while the FIFO is loaded so
+// onRadioInterrupt() cannot interleave with it, and its interrupt at the end of the frame re-arms RX
+void sendFromInterrupt(uint8_t to, uint8_t id, uint8_t flags, const uint8_t* data, uint8_t len) {
+  noInterrupts();
+  if (cc110.mode() != RHGenericDriver::RHModeTx) {
+    cc110.setHeaderTo(to);
+    cc110.setHeaderId(id);
+    cc110.setHeaderFlags(flags, 0xFF);
+    cc110.send(data, len);
+  }
+  interrupts();
+}
+
+// Cooperative radio task: decode queued frames into the node table, returns readings accepted
+uint8_t processRadioFrames() {
+  uint8_t accepted = 0;
+  
+  for (uint8_t i = 0; i < RX_FRAMES_PER_LOOP; i++) {
+    RadioFrame* frame = rxRing.readSlot();
+    if (frame == nullptr) {
+      break;
+    }
+    uint32_t start = cycleCount();
+    
+#if GATEWAY_DOWNLINK
+    SensorCommandResult result;
+    if (decodeSensorCommandResult(frame->data, frame->len, result)) {
+      noInterrupts();
+      bool queued = downlinks.complete(result);
+      interrupts();
+      if (queued) {
+        handleCommandResult(result);  // A repeated result of a command already answered is dropped
+      }
+      health.alive(radioHealth, frame->receivedAt);
+      rxRing.release();
+      stats.record(SPAN_PARSE, cycleCount() - start);
+      continue;
+    }
+#endif
+    
+    SensorReading reading;
+    if (parseSensorData(frame->data, frame->len, reading)) {
+      NodeUpdateResult update = nodeTable.update(reading, frame->rssi, frame->receivedAt);
+      if (update == NODE_UPDATE_ACCEPTED) {
+        lastDataReceivedTime = frame->receivedAt;
+        health.alive(radioHealth, frame->receivedAt);
+        accepted++;
+#if GATEWAY_IRRIGATION
+        irrigation.update(reading, frame->receivedAt);
+#endif
+#if GATEWAY_SMS
+        uint8_t slot = (uint8_t)(nodeTable.find(reading.nodeId) - &nodeTable.entry(0));
+        if (smsDigest.add(slot, reading) != 0) {
+          scheduler.trigger(TASK_SMS_ALARM, millis());
+        }
+#endif
+      } else if (update == NODE_UPDATE_DUPLICATE) {
+        stats.count(STAT_DUPLICATE);
+      }
+    }
+    rxRing.release();
+    stats.record(SPAN_PARSE, cycleCount() - start);
+  }
+  
+  return accepted;
+}
+
+// Queue the bring-up; the modem is probed until it answers, so a cold boot costs only as long as the A9G takes
+void initA9G(uint16_t grace) {
+  modemJob = JOB_INIT;
+  if (!modemBoot.start(A9G_INIT_STEPS, sizeof(A9G_INIT_STEPS) / sizeof(A9G_INIT_STEPS[0]), grace, onModemBooted)) {
+    finishModemJob();
+  }
+}
+
+void onModemBooted(AtResult result, void* context) {
+  // A modem that never answered or never registered gets a full restart
+  if (result != AT_RESULT_OK) {
+    resetA9G();
+    return;
+  }
+#if GATEWAY_MQTT
+  setupGPRS();
+#else
+  finishModemJob();
+#endif
+}
+
+// Queue the next command of the running job; the job is abandoned if the queue is full
+void startModemStep(const char* command, uint32_t timeout, AtDoneCallback onDone, AtLineCallback onLine) {
+  if (!modem.send(command, timeout, onDone, nullptr, onLine)) {
+    finishModemJob();
+  }
+}
+
+void finishModemJob() {
+  modemJob = JOB_IDLE;
+}
+
+void onGPSRefreshed(AtResult result, void* context) {
+  finishModemJob();
+}
+
+#if GATEWAY_MQTT
+void onModemReady(AtResult result, void* context) {
+  finishModemJob();
+}
+
+// Move every reading the MQTT sink has not taken yet into the uplink store, stamped with when it arrived
+void storePendingNodes() {
+  for (uint8_t i = 0; i < nodeTable.size(); i++) {
+    NodeEntry& node = nodeTable.entry(i);
+    if (!NodeTable::isPending(node, NODE_SINK_MQTT)) {
+      continue;
+    }
+    
+    StoredRecord record;
+    record.timestamp = node.lastSeen / 1000;
+    record.reading = node.reading;
+    uplinkStore.append(record);
+    NodeTable::markFlushed(node, NODE_SINK_MQTT);
+  }
+}
+
+void startMQTTReport() {
+  modemJob = JOB_MQTT;
+  reportSuccess = true;
+  
+  // Tell the backend once per boot why the gateway restarted
+  if (!resetReported) {
+    FixedString<48> status;
+    formatResetCause(status);
+    if (mqtt.publish(MQTT_STATUS_TOPIC, status.c_str(), onStatusPublished)) {
+      return;
+    }
+  }
+  publishCommandResults();
+}
+
+void onStatusPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    resetReported = true;
+  } else {
+    reportSuccess = false;
+  }
+  publishCommandResults();
+}
+
+// Publish the command results one per message, oldest first; a failure leaves the rest for the next report
+void publishCommandResults() {
+  SensorCommandResult* result = commandResults.readSlot();
+  if (result == nullptr || !reportSuccess) {
+    publishConfigResults();
+    return;
+  }
+  
+  FixedString<64> text;
+  formatCommandResult(*result, text);
+  if (!mqtt.publish(MQTT_RESULT_TOPIC, text.c_str(), onCommandResultPublished)) {
+    reportSuccess = false;
+    publishConfigResults();
+  }
+}
+
+void onCommandResultPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    commandResults.release();
+  } else {
+    reportSuccess = false;
+  }
+  publishCommandResults();
+}
+
+// Answer the setting changes on the same topic as "K:<name>,S:<result>", one per message
+void publishConfigResults() {
+  ConfigResult* result = configResults.readSlot();
+  if (result == nullptr || !reportSuccess) {
+    publishDecisions();
+    return;
+  }
+  
+  FixedString<32> text;
+  text.append("K:").append(settingName(result->key)).append(",S:").append(resultName(result->result));
+  if (!mqtt.publish(MQTT_RESULT_TOPIC, text.c_str(), onConfigResultPublished)) {
+    reportSuccess = false;
+    publishDecisions();
+  }
+}
+
+void onConfigResultPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    configResults.release();
+  } else {
+    reportSuccess = false;
+  }
+  publishConfigResults();
+}
+
+// Publish the irrigation decisions one per message, oldest first, like the command results
+void publishDecisions() {
+#if GATEWAY_IRRIGATION
+  IrrigationDecision* decision = decisions.readSlot();
+  if (decision != nullptr && reportSuccess) {
+    FixedString<96> text;
+    irrigation.formatDecision(*decision, text);
+    if (mqtt.publish(MQTT_DECISION_TOPIC, text.c_str(), onDecisionPublished)) {
+      return;
+    }
+    reportSuccess = false;
+  }
+#endif
+  publishLocation();
+}
+
+void onDecisionPublished(AtResult result, void* context) {
+#if GATEWAY_IRRIGATION
+  if (result == AT_RESULT_OK) {
+    decisions.release();
+  } else {
+    reportSuccess = false;
+  }
+#endif
+  publishDecisions();
+}
+
+void publishLocation() {
+  // The location rarely changes, so it is retained on its own topic instead of repeated in every batch
+  if (gps.hasFix() && strcmp(gps.location(), publishedLocation) != 0 &&
+      mqtt.publish(MQTT_LOCATION_TOPIC, gps.location(), onLocationPublished, nullptr, true)) {
+    return;
+  }
+  publishLinkStats();
+}
+
+void onLocationPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    strcpy(publishedLocation, gps.location());
+  } else {
+    reportSuccess = false;
+  }
+  publishLinkStats();
+}
+
+// Publish the link statistics of as many nodes as fit in one message, then the next message
+void publishLinkStats() {
+  if (linkStatsDue && linkCursor >= nodeTable.size()) {
+    linkStatsDue = false;
+  }
+  if (!linkStatsDue || !reportSuccess) {
+    publishStats();
+    return;
+  }
+  
+  uint32_t start = cycleCount();
+  size_t pos = MqttSession::openPublish(batchCommand, sizeof(batchCommand), MQTT_LINKS_TOPIC);
+  StringBuilder text(batchCommand + pos, sizeof(batchCommand) - pos - MQTT_PUBLISH_SUFFIX_MAX);
+  uint8_t first = linkCursor;
+  
+  // Stop at the first node that does not fit completely
+  while (pos > 0 && linkCursor < nodeTable.size()) {
+    size_t mark = text.length();
+    if (linkCursor > first) {
+      text.append(';');
+    }
+    formatLinkStats(nodeTable.entry(linkCursor), text);
+    if (text.overflowed()) {
+      text.truncate(mark);
+      break;
+    }
+    linkCursor++;
+  }
+  
+  bool queued = pos > 0 && linkCursor > first &&
+                MqttSession::closePublish(batchCommand, sizeof(batchCommand), pos + text.length()) &&
+                mqtt.publishExternal(batchCommand, onLinkStatsPublished);
+  stats.record(SPAN_PUBLISH, cycleCount() - start);
+  if (!queued) {
+    reportSuccess = false;
+    finishMQTTReport();
+  }
+}
+
+void onLinkStatsPublished(AtResult result, void* context) {
+  if (result != AT_RESULT_OK) {
+    reportSuccess = false;
+  }
+  publishLinkStats();
+}
+
+// Publish the latest runtime metrics snapshot, once
+void publishStats() {
+  if (!statsDue || !reportSuccess) {
+    publishNextBatch();
+    return;
+  }
+  
+  uint32_t start = cycleCount();
+  size_t pos = MqttSession::openPublish(batchCommand, sizeof(batchCommand), MQTT_STATS_TOPIC);
+  StringBuilder text(batchCommand + pos, sizeof(batchCommand) - pos - MQTT_PUBLISH_SUFFIX_MAX);
+  text.append(statsText.c_str(), statsText.length());
+  
+  bool queued = pos > 0 && !text.overflowed() &&
+                MqttSession::closePublish(batchCommand, sizeof(batchCommand), pos + text.length()) &&
+                mqtt.publishExternal(batchCommand, onStatsPublished);
+  stats.record(SPAN_PUBLISH, cycleCount() - start);
+  if (!queued) {
+    reportSuccess = false;
+    finishMQTTReport();
+  }
+}
+
+void onStatsPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    statsDue = false;
+  } else {
+    reportSuccess = false;
+  }
+  publishNextBatch();
+}
+
+// Publish the oldest stored readings as one batch; the report ends when the store is empty or a publish fails
+void publishNextBatch() {
+  if (!reportSuccess || !mqtt.connected() || uplinkStore.size() == 0) {
+    finishMQTTReport();
+    return;
+  }
+  
+  uint32_t start = cycleCount();
+  size_t pos = MqttSession::openPublish(batchCommand, sizeof(batchCommand), MQTT_TOPIC);
+  size_t written = 0;
+  batchRecords = encodeBatch(uplinkStore, BATCH_MODE, millis() / 1000, batchCommand + pos,
+                             sizeof(batchCommand) - pos - MQTT_PUBLISH_SUFFIX_MAX, written);
+  
+  bool queued = pos > 0 && batchRecords > 0 &&
+                MqttSession::closePublish(batchCommand, sizeof(batchCommand), pos + written) &&
+                mqtt.publishExternal(batchCommand, onBatchPublished);
+  stats.record(SPAN_PUBLISH, cycleCount() - start);
+  if (!queued) {
+    reportSuccess = false;
+    finishMQTTReport();
+  }
+}
+
+void onBatchPublished(AtResult result, void* context) {
+  if (result == AT_RESULT_OK) {
+    uplinkStore.consume(batchRecords);
+  } else {
+    reportSuccess = false;
+  }
+  publishNextBatch();
+}
+
+// Keep the readings still in RAM across a supervised reset
+void onSupervisedReset(void* context) {
+  uplinkStore.persist();
+}
+
+void finishMQTTReport() {
+  if (reportSuccess) {
+    led.blink(4, 100);  // 4 quick blinks indicate successful MQTT publish
+  } else {
+    led.blink(4, 250);  // 4 medium blinks indicate MQTT publish failure
+  }
+  finishModemJob();
+}
+#endif
+
+#if GATEWAY_SMS
+// Switch to PDU mode once per report, so every message and part after it is a single AT+CMGS
+void startSMSReport(bool alarms) {
+  modemJob = JOB_SMS;
+  smsAlarmReport = alarms;
+  startModemStep("AT+CMGF=0", 2000, onSMSPduMode);
+}
+
+void onSMSPduMode(AtResult result, void* context) {
+  if (result != AT_RESULT_OK) {
+    resetA9G();
+    return;
+  }
+  reportCursor = 0;
+  reportSuccess = true;
+  smsOrderSize = smsAlarmReport ? 0 : smsDigest.order(smsOrder);
+  sendNextSMS();
+}
+
+// Build and send the next message of the report, or end the report when nothing is left for it
+void sendNextSMS() {
+  smsBody.clear();
+  smsBatchSize = 0;
+  bool built = smsAlarmReport ? buildAlarmSMS() : buildDigestSMS();
+  
+  if (!built) {
+    if (!smsAlarmReport) {
+      digestStartedAt = millis();
+    }
+    if (reportSuccess) {
+      led.blink(2, 500);  // 2 long blinks indicate successful SMS
+    } else {
+      led.blink(5, 50);  // 5 quick blinks indicate SMS sending failure
+    }
+    finishModemJob();
+    return;
+  }
+  
+  const char* location = gps.location();
+  if (location[0] != '\0') {
+    smsBody.append(';').append(location);
+  }
+  
+  smsReference++;
+  smsParts = smsPartCount(smsBody.length());
+  smsPart = 1;
+  sendSMSPart();
+}
+
+// Pack the windows of as many nodes as fit, alarmed nodes first, after "W:<minutes since the last digest>"
+bool buildDigestSMS() {
+  size_t reserve = strlen(gps.location()) + 1;
+  
+  // The first SMS after boot also says why the gateway restarted
+  if (!resetReported) {
+    formatResetCause(smsBody);
+    smsBody.append(';');
+  }
+  smsBody.append("W:").appendUnsigned((millis() - digestStartedAt) / 60000);
+  
+  for (; reportCursor < smsOrderSize; reportCursor++) {
+    uint8_t slot = smsOrder[reportCursor];
+    if (!smsDigest.hasWindow(slot)) {
+      continue;
+    }
+    
+    // Stop at the first node that would not fit next to the location
+    size_t mark = smsBody.length();
+    smsBody.append(';');
+    smsDigest.formatWindow(slot, smsBody);
+    if (smsBody.overflowed() || smsBody.length() + reserve > SMS_BODY_MAX) {
+      smsBody.truncate(mark);
+      break;
+    }
+    smsBatchMark[smsBatchSize] = smsDigest.entry(slot).samples;
+    smsBatch[smsBatchSize++] = slot;
+  }
+  return smsBatchSize > 0;
+}
+
+// Pack "ALARM" and the latest reading of every node with alarms not sent yet
+bool buildAlarmSMS() {
+  size_t reserve = strlen(gps.location()) + 1;
+  smsBody.append("ALARM");
+  
+  for (; reportCursor < smsDigest.size(); reportCursor++) {
+    uint8_t alarms = smsDigest.entry(reportCursor).pendingAlarms;
+    if (alarms == 0) {
+      continue;
+    }
+    
+    size_t mark = smsBody.length();
+    smsBody.append(';');
+    smsDigest.formatAlarm(reportCursor, nodeTable.entry(reportCursor).reading, smsBody);
+    if (smsBody.overflowed() || smsBody.length() + reserve > SMS_BODY_MAX) {
+      smsBody.truncate(mark);
+      break;
+    }
+    smsBatchMark[smsBatchSize] = alarms;
+    smsBatch[smsBatchSize++] = reportCursor;
+  }
+  return smsBatchSize > 0;
+}
+
+// GATEWAY_PHONE, or the PHONE setting when the MQTT sink can change it
+const char* smsRecipient() {
+#if GATEWAY_MQTT
+  return config.text(CONFIG_PHONE, GATEWAY_PHONE);
+#else
+  return GATEWAY_PHONE;
+#endif
+}
+
+// Encode the current part of smsBody and hand its PDU to AT+CMGS
+void sendSMSPart() {
+  size_t offset = smsParts > 1 ? (size_t)(smsPart - 1) * SMS_PART_SEPTETS : 0;
+  size_t len = smsBody.length() - offset;
+  if (smsParts > 1 && len > SMS_PART_SEPTETS) {
+    len = SMS_PART_SEPTETS;
+  }
+  
+  smsPdu.clear();
+  uint8_t length = encodeSmsSubmit(smsRecipient(), smsBody.c_str() + offset, len, smsReference, smsPart, smsParts,
+                                   smsPdu);
+  if (length == 0) {
+    led.blink(5, 50);  // 5 quick blinks indicate SMS sending failure; the recipient is not a number
+    finishModemJob();
+    return;
+  }
+  
+  FixedString<16> command;
+  command.append("AT+CMGS=").appendUnsigned(length);
+  if (!modem.sendWithExternalPayload(command.c_str(), smsPdu.c_str(), 10000, onSMSPartSent)) {
+    finishModemJob();
+  }
+}
+
+// Once the last part is out, the nodes it carried are reported; a failed part leaves them pending
+void onSMSPartSent(AtResult result, void* context) {
+  if (result != AT_RESULT_OK) {
+    reportSuccess = false;
+    sendNextSMS();
+    return;
+  }
+  if (smsPart < smsParts) {
+    smsPart++;
+    sendSMSPart();
+    return;
+  }
+  
+  for (uint8_t i = 0; i < smsBatchSize; i++) {
+    uint8_t slot = smsBatch[i];
+    if (smsAlarmReport) {
+      smsDigest.markAlarmSent(slot, (uint8_t)smsBatchMark[i]);
+    } else {
+      smsDigest.markReported(slot, smsBatchMark[i], nodeTable.entry(slot).reading);
+      resetReported = true;
+    }
+  }
+  sendNextSMS();
+}
+#endif
+
+// Drop whatever the modem was doing and queue a full restart and bring-up
+void resetA9G() {
+  led.blink(10, 50);  // 10 quick blinks indicate A9G reset attempt
+  modem.clearQueue();
+  modemBoot.cancel();
+  gps.cancel();
+#if GATEWAY_MQTT
+  mqtt.linkLost();
+#endif
+  modem.send("AT+CRESET", 5000);
+  initA9G(MODEM_RESET_GRACE);
+}
+
+void superviseHealth() {
+  health.alive(modemHealth, modem.lastResponseAt());
+  
+  // The firmware makes no allocation after setup(), so the first one found, from any library, is a fault;
+  // the supervised reset records HEAP as its cause
+  uint32_t heapOperationsNow = heapOperationsSinceMark();
+  stats.set(STAT_HEAP_OPERATIONS, heapOperationsNow);
+  if (heapOperationsNow > 0) {
+    health.fail(heapHealth);
+  }
+  stats.sampleHeap(heapFree());
+  
+  health.poll();
+}
+
+// Freeze the runtime metrics into statsText as "U:<uptime s>,DM:<deadline misses>,<RuntimeStats::format()>",
+// start a new window and dump the line over USB CDC; skipped when no host has the port open or its buffer is
+// full, so it never blocks
+void snapshotStats() {
+  stats.set(STAT_CRC_FAILED, cc110.rxBad());
+  statsText.clear();
+  statsText.append("U:").appendUnsigned(millis() / 1000);
+  statsText.append(",DM:").appendUnsigned(scheduler.missedTotal()).append(',');
+  noInterrupts();  // The radio interrupt records into the same window
+  stats.format(statsText);
+  stats.resetWindow();
+  interrupts();
+  
+  if (Serial && Serial.availableForWrite() >= (int)statsText.length() + 2) {
+    Serial.write((const uint8_t*)statsText.c_str(), statsText.length());
+    Serial.write((const uint8_t*)"\r\n", 2);
+  }
+}
+
+// Append "R:<cause>[:<subsystem>],B:<boots>" describing the last reset
+void formatResetCause(StringBuilder& text) {
+  text.append("R:").append(HealthSupervisor::causeName(health.resetCause()));
+  if (health.resetCause() == RESET_CAUSE_SUPERVISOR) {
+    text.append(':').append(health.failedSubsystem());
+  }
+  text.append(",B:").appendUnsigned(health.bootCount());
+}
+
+#if GATEWAY_MQTT
+// Append "N:<id>,R:<received>,L:<lost>,D:<duplicates>,S:<rssi>,P:<profile>,T:<dBm>" for one node
+void formatLinkStats(const NodeEntry& node, StringBuilder& text) {
+  text.append("N:").appendUnsigned(node.nodeId);
+  text.append(",R:").appendUnsigned(node.received);
+  text.append(",L:").appendUnsigned(node.lost);
+  text.append(",D:").appendUnsigned(node.duplicates);
+  text.append(",S:").appendSigned(node.rssi);
+  
+  LinkAdvice advice = links.advice(node.nodeId);
+  text.append(",P:").appendUnsigned(advice.profile);
+  text.append(",T:").appendSigned(LINK_POWER_DBM[advice.powerStep]);
+}
+
+// A message on MQTT_COMMAND_TOPIC: queue it for its node, or apply it here when it is for the gateway
+void onCommandMessage(const char* payload, void* context) {
+  SensorCommand command = {0, 0, 0, 0};
+  SensorCommandResult result;
+  bool parsed = parseCommandText(payload, command);
+  result.nodeId = command.nodeId;
+  result.sequence = 0;
+  result.code = command.code;
+  
+  if (!parsed) {
+    result.result = COMMAND_RESULT_INVALID;
+  } else if (command.code == COMMAND_PROFILE) {
+    bool valid = command.value >= LINK_PROFILE_ROBUST && command.value < LINK_PROFILE_COUNT;
+    if (valid) {
+      noInterrupts();
+      links.setProfileLimit((uint8_t)command.value);
+      interrupts();
+    }
+    result.result = valid ? SENSOR_RESULT_OK : SENSOR_RESULT_OUT_OF_RANGE;
+  } else {
+    noInterrupts();
+    bool queued = downlinks.push(command, millis());
+    interrupts();
+    if (queued) {
+      return;  // Answered once the node's result comes back
+    }
+    result.result = COMMAND_RESULT_FULL;
+  }
+  reportCommandResult(result);
+}
+
+// Parse "N:<node>,C:<name>,V:<value>"; false when a field is missing or the name is unknown
+bool parseCommandText(const char* text, SensorCommand& command) {
+  const char* node = strstr(text, "N:");
+  const char* name = strstr(text, "C:");
+  const char* value = strstr(text, "V:");
+  if (node == nullptr || name == nullptr || value == nullptr) {
+    return false;
+  }
+  
+  char* end;
+  long nodeId = strtol(node + 2, &end, 10);
+  if (end == node + 2 || nodeId < 0 || nodeId > 255) {
+    return false;
+  }
+  command.nodeId = (uint8_t)nodeId;
+  command.value = strtol(value + 2, &end, 10);
+  if (end == value + 2) {
+    return false;
+  }
+  
+  name += 2;
+  size_t nameLen = strcspn(name, ",");
+  for (size_t i = 0; i < sizeof(COMMAND_NAMES) / sizeof(COMMAND_NAMES[0]); i++) {
+    if (strlen(COMMAND_NAMES[i].name) == nameLen && strncmp(COMMAND_NAMES[i].name, name, nameLen) == 0) {
+      command.code = COMMAND_NAMES[i].code;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* commandName(uint8_t code) {
+  for (size_t i = 0; i < sizeof(COMMAND_NAMES) / sizeof(COMMAND_NAMES[0]); i++) {
+    if (COMMAND_NAMES[i].code == code) {
+      return COMMAND_NAMES[i].name;
+    }
+  }
+  return "?";
+}
+
+// A message on MQTT_CONFIG_TOPIC: store the setting, apply it and queue the answer
+void onConfigMessage(const char* payload, void* context) {
+  const char* value;
+  const ConfigSetting* setting = parseConfigText(payload, value);
+  ConfigResult* slot = configResults.writeSlot();
+  uint8_t result = setting != nullptr ? changeSetting(*setting, value) : COMMAND_RESULT_INVALID;
+  if (setting != nullptr && result == SENSOR_RESULT_OK) {
+    applySetting(setting->key);
+  }
+  if (slot != nullptr) {
+    slot->key = setting != nullptr ? setting->key : 0xFF;
+    slot->result = result;
+    configResults.commit();
+  }
+  scheduler.trigger(TASK_MQTT_REPORT, millis());
+}
+
+// Parse "K:<name>" or "K:<name>,V:<value>", the value running to the end of the payload; nullptr when the
+// name is missing or unknown, and value nullptr when there is none
+const ConfigSetting* parseConfigText(const char* text, const char*& value) {
+  const char* name = strstr(text, "K:");
+  if (name == nullptr) {
+    return nullptr;
+  }
+  name += 2;
+  size_t nameLen = strcspn(name, ",");
+  const char* field = strstr(name + nameLen, "V:");
+  value = field != nullptr ? field + 2 : nullptr;
+  
+  for (size_t i = 0; i < sizeof(CONFIG_SETTINGS) / sizeof(CONFIG_SETTINGS[0]); i++) {
+    if (strlen(CONFIG_SETTINGS[i].name) == nameLen && strncmp(CONFIG_SETTINGS[i].name, name, nameLen) == 0) {
+      return &CONFIG_SETTINGS[i];
+    }
+  }
+  return nullptr;
+}
+
+// Check value against the setting's bounds and store it, or remove the setting when value is nullptr
+uint8_t changeSetting(const ConfigSetting& setting, const char* value) {
+  if (value == nullptr) {
+    return config.remove(setting.key) ? SENSOR_RESULT_OK : COMMAND_RESULT_FLASH;
+  }
+  
+  if (setting.text) {
+    size_t len = strlen(value);
+    if (len < (size_t)setting.minimum || len > (size_t)setting.maximum) {
+      return SENSOR_RESULT_OUT_OF_RANGE;
+    }
+    for (size_t i = 0; i < len; i++) {
+      if (value[i] < ' ' || value[i] > '~' || value[i] == '"') {
+        return COMMAND_RESULT_INVALID;  // Text settings end up inside quoted AT command arguments
+      }
+    }
+    return config.setText(setting.key, value) ? SENSOR_RESULT_OK : COMMAND_RESULT_FLASH;
+  }
+  
+  char* end;
+  long number = strtol(value, &end, 10);
+  if (end == value || *end != '\0') {
+    return COMMAND_RESULT_INVALID;
+  }
+  if (number < setting.minimum || number > setting.maximum) {
+    return SENSOR_RESULT_OUT_OF_RANGE;
+  }
+  return config.setNumber(setting.key, (int32_t)number) ? SENSOR_RESULT_OK : COMMAND_RESULT_FLASH;
+}
+
+// Put a stored setting into effect; PHONE and APN are read where they are used
+void applySetting(uint8_t key) {
+  switch (key) {
+    case CONFIG_APN:
+      modemRestartDue = true;
+      break;
+    case CONFIG_BROKER:
+    case CONFIG_PORT:
+      brokerDue = true;
+      break;
+    case CONFIG_MQTT_INTERVAL:
+      scheduler.setInterval(TASK_QUEUE_READINGS, config.number(CONFIG_MQTT_INTERVAL, MQTT_INTERVAL), millis());
+      break;
+#if GATEWAY_SMS
+    case CONFIG_SMS_INTERVAL:
+      scheduler.setInterval(TASK_SMS_REPORT, config.number(CONFIG_SMS_INTERVAL, SMS_INTERVAL), millis());
+      break;
+#endif
+    case CONFIG_FREQUENCY:
+      frequencyDue = !tuneFrequency();
+      break;
+    default:
+      break;
+  }
+}
+
+// Settings that need the modem, applied between jobs: the session moves to a new broker once nothing is in
+// flight, and a new APN restarts the A9G, whose bring-up sets up GPRS with it
+void applyDeferredSettings() {
+  if (brokerDue && mqtt.state() != MQTT_CONNECTING && mqtt.inflight() == 0) {
+    strncpy(brokerHost, config.text(CONFIG_BROKER, MQTT_BROKER), sizeof(brokerHost) - 1);
+    brokerDue = !mqtt.setBroker(brokerHost, (uint16_t)config.number(CONFIG_PORT, MQTT_PORT));
+  }
+  if (modemRestartDue) {
+    modemRestartDue = false;
+    resetA9G();
+  }
+}
+
+const char* settingName(uint8_t key) {
+  for (size_t i = 0; i < sizeof(CONFIG_SETTINGS) / sizeof(CONFIG_SETTINGS[0]); i++) {
+    if (CONFIG_SETTINGS[i].key == key) {
+      return CONFIG_SETTINGS[i].name;
+    }
+  }
+  return "?";
+}
+
+// Queue result for the uplink and have the next report go out now; dropped when the results ring is full
+void reportCommandResult(const SensorCommandResult& result) {
+  SensorCommandResult* slot = commandResults.writeSlot();
+  if (slot != nullptr) {
+    *slot = result;
+    commandResults.commit();
+  }
+  scheduler.trigger(TASK_MQTT_REPORT, millis());
+}
+
+// Append "N:<node>,Q:<sequence>,C:<name>,S:<result>"
+void formatCommandResult(const SensorCommandResult& result, StringBuilder& text) {
+  text.append("N:").appendUnsigned(result.nodeId);
+  text.append(",Q:").appendUnsigned(result.sequence);
+  text.append(",C:").append(commandName(result.code));
+  text.append(",S:").append(resultName(result.result));
+}
+
+const char* resultName(uint8_t result) {
+  switch (result) {
+    case SENSOR_RESULT_OK:
+      return "OK";
+    case SENSOR_RESULT_UNSUPPORTED:
+      return "UNSUPPORTED";
+    case SENSOR_RESULT_OUT_OF_RANGE:
+      return "RANGE";
+    case COMMAND_RESULT_EXPIRED:
+      return "EXPIRED";
+    case COMMAND_RESULT_FULL:
+      return "FULL";
+    case COMMAND_RESULT_FLASH:
+      return "FLASH";
+    default:
+      return "INVALID";
+  }
+}
+
+void setupGPRS() {
+  FixedString<AT_COMMAND_MAX> command;
+
+  // Set up PDP context with APN
+  command.append("AT+CGDCONT=1,\"IP\",\"").append(config.text(CONFIG_APN, GATEWAY_APN));
+  command.append("\",\"0.0.0.0\",0,0");
+  modem.send(command.c_str(), 5000);
+
+  // Activate PDP context; bring-up is complete once it answers
+  modem.send("AT+CGACT=1,1", 10000, onModemReady);
+}
+#endif
+
+#if GATEWAY_DOWNLINK
+// A node's answer to a queued command, or one the gateway gave up on: the irrigation engine hears about its
+// valves, and the MQTT sink publishes every result
+void handleCommandResult(const SensorCommandResult& result) {
+#if GATEWAY_IRRIGATION
+  irrigation.commandResult(result, millis());
+#endif
+#if GATEWAY_MQTT
+  reportCommandResult(result);
+#endif
+}
+
+// Give up on commands whose node never answered
+void expireCommands() {
+  SensorCommand expired;
+  for (;;) {
+    noInterrupts();
+    bool found = downlinks.expire(millis(), expired);
+    interrupts();
+    if (!found) {
+      return;
+    }
+    SensorCommandResult result = {expired.nodeId, expired.sequence, expired.code, COMMAND_RESULT_EXPIRED};
+    handleCommandResult(result);
+  }
+}
+#endif
+
+/* LED Blink Status Guide:
+ * 3 quick blinks (setup): Setup completed successfully
+ * 2 quick blinks (loop): Successful data reception and parsing from CC1101
+ * 4 quick blinks (loop): Successful MQTT publish (MQTT sink)
+ * 4 medium blinks (loop): MQTT publish failure (MQTT sink)
+ * 2 long blinks (loop): Successful SMS digest or alarm sent (SMS sink)
+ * 5 quick blinks (loop): SMS sending failure (SMS sink)
+ * 10 quick blinks (loop): A9G reset attempt
+ * 5 medium blinks (initCC1101): CC1101 initialization failure
+ */
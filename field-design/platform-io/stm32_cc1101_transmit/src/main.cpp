@@ -1,10 +1,93 @@
 #include <Arduino.h>
 #include <RH_CC110.h>
+#include <RHReliableDatagram.h>
 #include <SPI.h>
 #include <Wire.h>
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BMP280.h>
 #include <Adafruit_AHTX0.h>
+#include <SensorPacket.h>
+#include <SampleFilter.h>
+#include <SlotSchedule.h>
+#include <LinkAdvisor.h>
+#include <ConfigStore.h>
+#include <Stm32FlashStorage.h>
+#include <STM32LowPower.h>
+#include <STM32RTC.h>
+
+// Node id carried in every frame; override per node with -D NODE_ID=<n> in build_flags
+#ifndef NODE_ID
+#define NODE_ID 1
+#endif
+
+// Time from one summarised reading to the next in milliseconds; override per node with -D READING_INTERVAL=<ms>
+#ifndef READING_INTERVAL
+#define READING_INTERVAL 60000
+#endif
+
+// Sensor samples per reading, spread evenly over READING_INTERVAL and filtered into one summary frame
+#ifndef SAMPLES_PER_WINDOW
+#define SAMPLES_PER_WINDOW 4
+#endif
+
+// Bounds on the settings a downlink command may change (see SensorPacket.h)
+#define COMMAND_INTERVAL_MIN 10000UL    // 10 s
+#define COMMAND_INTERVAL_MAX 3600000UL  // 1 hour
+#define COMMAND_SILENCE_MAX 3600000UL   // 1 hour
+#define COMMAND_DEADBAND_MAX 100000L
+
+// Settings changed by downlink commands survive a reset in the last two flash pages (see platformio.ini)
+#define CONFIG_FLASH_BASE 0x0800F800 // Pages 62-63
+
+// 1 = STOP mode with RTC alarm wake-up between samples, 0 = stay awake and delay() (SWD debugging on the bench)
+#ifndef LOW_POWER
+#define LOW_POWER 1
+#endif
+
+// Change from the last transmitted value that triggers a transmission, in the frame's fixed-point units
+#ifndef TEMPERATURE_DEADBAND
+#define TEMPERATURE_DEADBAND 20 // 0.20 degrees Celsius
+#endif
+#ifndef HUMIDITY_DEADBAND
+#define HUMIDITY_DEADBAND 100   // 1.00 %RH
+#endif
+#ifndef PRESSURE_DEADBAND
+#define PRESSURE_DEADBAND 500   // 50 Pa
+#endif
+
+// Longest time without a transmission, so the gateway still sees a live node in steady weather;
+// keep it below the gateways' RADIO_TIMEOUT (5 minutes)
+#ifndef MAX_SILENCE
+#define MAX_SILENCE 240000
+#endif
+
+// 1 = transmit in the slot given by the gateway beacon (TDMA), 0 = transmit as soon as the channel is clear
+#ifndef TDMA
+#define TDMA 1
+#endif
+
+// How long the node listens for a beacon while unsynchronised, and how often it tries again after a failed search
+#define TDMA_SEARCH_WINDOW 61000 // Just over the gateways' default superframe
+#define TDMA_SEARCH_INTERVAL 21600000UL // 6 hours; in between the node stays on listen-before-talk
+
+// Listen-before-talk, also used inside the slot in case a neighbour's clock has drifted into it
+#define LBT_RSSI_THRESHOLD -90 // dBm above which the channel counts as busy
+#define LBT_ATTEMPTS 5 // Channel checks before the transmission is deferred
+#define LBT_BACKOFF_MIN 10 // Random back-off between checks in milliseconds
+#define LBT_BACKOFF_MAX 60
+#define LBT_RETRY 1000 // Delay before an unsynchronised node tries a deferred transmission again
+#define CC1101_RSSI_OFFSET 74 // dB subtracted from the RSSI register at 433 MHz (CC1101 datasheet)
+
+// Acknowledged delivery: attempts per summary, each followed by an ACK_TIMEOUT to 2 * ACK_TIMEOUT wait
+#ifndef ACK_ATTEMPTS
+#define ACK_ATTEMPTS 3
+#endif
+#define ACK_TIMEOUT 200 // ms; the gateway's ACK takes ~107 ms on air at 1.2 kbps
+#define ACK_TURNAROUND 10 // ms from the end of a frame until the gateway's ACK starts
+#define ACK_PAYLOAD_MAX SENSOR_COMMAND_FRAME_LEN // A downlink command rides in the ACK payload
+
+// Power step 0 of the gateway's link advice (see LinkAdvisor.h); steps go up from here to 10 dBm
+#define POWER_LEVEL_MIN RH_CC110::TransmitPower0dBm
 
 // Pin Definitions for CC1101 connection to STM32 BluePill
 #define CC1101_CS_PIN PA4   // Chip Select (CSN) pin
@@ -32,8 +115,44 @@
  * SCL        | PB6          | I2C Clock
  */
 
+// RH_CC110 with the instantaneous RSSI exposed for listen-before-talk, and the payload of the last frame
+// kept, since RHReliableDatagram::sendtoWait() throws the ACK's payload away
+class RH_CC110_Lbt : public RH_CC110 {
+public:
+  RH_CC110_Lbt(uint8_t slaveSelectPin, uint8_t interruptPin) : RH_CC110(slaveSelectPin, interruptPin), lastLen(0) {}
+  
+  bool recv(uint8_t* buf, uint8_t* len) override {
+    lastLen = sizeof(last);
+    if (!RH_CC110::recv(last, &lastLen)) {
+      lastLen = 0;
+      return false;
+    }
+    if (buf && len) {
+      *len = *len < lastLen ? *len : lastLen;
+      memcpy(buf, last, *len);
+    }
+    return true;
+  }
+  
+  const uint8_t* lastPayload() const { return last; }
+  uint8_t lastPayloadLen() const { return lastLen; }
+  
+  // Signal level on the channel in dBm; the radio must have been in RX for about a millisecond
+  int16_t channelRssi() {
+    int8_t raw = (int8_t)spiBurstReadRegister(RH_CC110_REG_34_RSSI);
+    return raw / 2 - CC1101_RSSI_OFFSET;
+  }
+  
+private:
+  uint8_t last[RH_CC110_MAX_MESSAGE_LEN];
+  uint8_t lastLen;
+};
+
 // Create an instance of the CC110 driver
-RH_CC110 cc110(CC1101_CS_PIN, CC1101_GDO0_PIN);
+RH_CC110_Lbt cc110(CC1101_CS_PIN, CC1101_GDO0_PIN);
+
+// Addressed, acknowledged datagrams to the gateway; retransmits are scheduled by the node, so RadioHead sends once
+RHReliableDatagram manager(cc110, NODE_ID);
 
 // Define the onboard LED pin for visual feedback
 #define LED_PIN PC13 // BluePill onboard LED is on PC13 and is active LOW
@@ -42,21 +161,266 @@ RH_CC110 cc110(CC1101_CS_PIN, CC1101_GDO0_PIN);
 Adafruit_AHTX0 aht;
 Adafruit_BMP280 bmp;
 
-// Function to read sensor data
-void getSensorData(float &temperature, float &humidity, float &pressure) {
+// Settings a downlink command can change, starting from the build-time defaults or the values stored in flash
+struct NodeSettings {
+  uint32_t readingInterval;
+  uint32_t maxSilence;
+  int32_t temperatureDeadband;
+  int32_t humidityDeadband;
+  int32_t pressureDeadband;
+};
+
+NodeSettings settings = {READING_INTERVAL, MAX_SILENCE, TEMPERATURE_DEADBAND, HUMIDITY_DEADBAND, PRESSURE_DEADBAND};
+
+// Keys the settings are stored under; add new ones at the end and never reuse one
+enum ConfigKey {
+  CONFIG_READING_INTERVAL,
+  CONFIG_MAX_SILENCE,
+  CONFIG_TEMPERATURE_DEADBAND,
+  CONFIG_HUMIDITY_DEADBAND,
+  CONFIG_PRESSURE_DEADBAND
+};
+
+Stm32FlashStorage settingsFlash(CONFIG_FLASH_BASE, 2);
+ConfigStore config(settingsFlash);
+
+// Sequence number of the next frame, lets the gateway spot lost and repeated packets
+uint8_t sequenceNumber = 0;
+
+// Summaries carry SENSOR_FLAG_RESTARTED until one is acknowledged, so the gateway starts a new duplicate
+// window for the counter starting again at 0 instead of dropping it against the window of before the reset
+bool restartAcked = false;
+
+// Per-channel median + EMA filters, summarised once per window (see SampleFilter.h)
+ChannelFilter temperatureFilter;
+ChannelFilter humidityFilter;
+ChannelFilter pressureFilter;
+uint8_t windowSamples = 0;
+
+// Node clock in milliseconds that keeps running in STOP mode, where millis() stands still
+uint32_t sleptTotal = 0;
+
+// Slot timing learnt from the gateway beacon
+SlotSchedule schedule(NODE_ID);
+uint32_t searchAt = 0; // Next beacon search while unsynchronised; 0 searches straight after boot
+
+// Frame waiting for its slot, a summary or a command result, and when it goes out
+SensorSummary pendingSummary;
+SensorCommandResult pendingResult;
+bool framePending = false;
+bool pendingIsResult = false;
+bool resultDue = false; // A command arrived; its result goes out once no summary is waiting
+uint8_t lastCommandSequence = 0;
+bool commandApplied = false; // lastCommandSequence holds a command already applied
+bool beaconCheckPending = false; // Listen for the next beacon first, to refresh the slot timing
+uint32_t listenTime = 0;
+uint32_t transmitTime = 0;
+
+// Delivery state of the pending frame
+uint8_t pendingAttempts = 0;
+uint16_t undelivered = 0;    // Summaries dropped after ACK_ATTEMPTS
+bool slotTransmission = false; // The pending frame goes out in the node's slot, at the advised profile
+
+// Rate profile for the node's slot and power step, as last advised in a gateway ACK; robust at full power until then
+LinkAdvice link = {LINK_PROFILE_ROBUST, LINK_POWER_STEPS - 1};
+uint8_t radioProfile = LINK_PROFILE_ROBUST; // Profile the CC1101 is configured for
+
+// Next sample of the current window
+uint32_t nextSampleAt = 0;
+
+// Report-by-exception state: the values the gateway last received and the time since then
+SensorReading lastSent;
+bool sentOnce = false;
+uint32_t silentFor = 0;
+
+/* Estimated Charge per Reporting Cycle (READING_INTERVAL = 60 s, 4 samples, 3.3 V, power LED removed).
+ * Computed by hand from datasheet currents and the configured timings; the firmware neither measures
+ * nor enforces it, so a longer LBT back-off, retry or beacon search simply costs more.
+ * Phase                     | Time       | Current | Charge
+ * --------------------------|------------|---------|---------
+ * Wake, clocks back on HSE  | 4x ~2 ms   | ~10 mA  | 0.1 mAs
+ * AHT20 measurement         | 4x ~80 ms  | ~26 mA  | 8.3 mAs  (MCU at 72 MHz waits on the sensor)
+ * BMP280 forced, x1/x1      | 4x ~7 ms   | ~26 mA  | 0.7 mAs
+ * Beacon RX before the slot | ~230 ms    | ~43 mA  | 9.9 mAs  (17 mA radio + MCU; TDMA only)
+ * CC1101 TX, 41 B @ 1.2 kbps| ~275 ms    | ~55 mA  | 15.1 mAs (29 mA radio at 10 dBm + MCU)
+ * ACK RX after the summary  | ~130 ms    | ~43 mA  | 5.6 mAs  (turnaround + 16 B ACK; less TX current below 10 dBm)
+ * STOP, RTC on LSE          | ~60 s      | ~25 uA  | 1.5 mAs  (F103 STOP ~20 uA, CC1101 SLEEP, sensors idle)
+ * Total                     |            |         | ~41.2 mAs = ~0.69 mA average
+ * A window inside every deadband skips the beacon, TX and ACK phases, so steady weather with the
+ * default 4 minute heartbeat averages ~0.30 mA (~9 months on 2000 mAh). Sending the 4 samples
+ * as raw frames instead would cost four 175 ms transmissions (~38 mAs) per minute.
+ * While unsynchronised a 61 s beacon search (~1 As) runs at boot and every 6 hours.
+ * On an advised 38.4 kbps profile the TX and ACK phases shrink to ~10 ms each (~1 mAs together).
+ */
+
+// Take one sample of every sensor into the filters, in the frame's fixed-point units
+void sampleSensors() {
   sensors_event_t humidity_event, temp_event;
-  
+
   if (aht.getEvent(&humidity_event, &temp_event)) {
-    temperature = temp_event.temperature;
-    humidity = humidity_event.relative_humidity;
+    temperatureFilter.add(lroundf(temp_event.temperature * 100.0f));
+    humidityFilter.add(lroundf(constrain(humidity_event.relative_humidity, 0.0f, 100.0f) * 100.0f));
+  }
+
+  // Forced mode: one conversion on demand, then the BMP280 goes back to sleep
+  float pressure = bmp.takeForcedMeasurement() ? bmp.readPressure() : NAN;  // Pascal
+  if (!isnan(pressure) && pressure >= 0) {
+    pressureFilter.add(lroundf(pressure * 10.0f));  // Convert Pa to deci-Pa
+  }
+
+  windowSamples++;
+}
+
+// Close the window into summary and start the next; a channel with no valid sample is flagged invalid
+void summarizeWindow(SensorSummary& summary) {
+  SensorReading& reading = summary.reading;
+  reading.nodeId = NODE_ID;
+  reading.flags = 0;
+  summary.samples = windowSamples;
+
+  if (temperatureFilter.count() > 0) {
+    reading.temperature = (int16_t)temperatureFilter.mean();
+    summary.temperatureMin = (int16_t)temperatureFilter.minimum();
+    summary.temperatureMax = (int16_t)temperatureFilter.maximum();
+    reading.humidity = (uint16_t)humidityFilter.mean();
+    summary.humidityMin = (uint16_t)humidityFilter.minimum();
+    summary.humidityMax = (uint16_t)humidityFilter.maximum();
+  } else {
+    reading.temperature = summary.temperatureMin = summary.temperatureMax = 0;
+    reading.humidity = summary.humidityMin = summary.humidityMax = 0;
+    reading.flags |= SENSOR_FLAG_TH_INVALID;
+    temperatureFilter.reset();  // Stale history would bias the first readings after recovery
+    humidityFilter.reset();
+  }
+
+  if (pressureFilter.count() > 0) {
+    reading.pressure = (uint32_t)pressureFilter.mean();
+    summary.pressureMin = (uint32_t)pressureFilter.minimum();
+    summary.pressureMax = (uint32_t)pressureFilter.maximum();
+  } else {
+    reading.pressure = summary.pressureMin = summary.pressureMax = 0;
+    reading.flags |= SENSOR_FLAG_PRESSURE_INVALID;
+    pressureFilter.reset();
+  }
+
+  temperatureFilter.startWindow();
+  humidityFilter.startWindow();
+  pressureFilter.startWindow();
+  windowSamples = 0;
+}
+
+static uint32_t difference(int32_t a, int32_t b) {
+  return a > b ? a - b : b - a;
+}
+
+// True when the reading moved past a deadband, a sensor failed or recovered, or the heartbeat is due
+bool shouldTransmit(const SensorReading& reading) {
+  if (!sentOnce || silentFor >= settings.maxSilence || reading.flags != lastSent.flags) {
+    return true;
+  }
+  return difference(reading.temperature, lastSent.temperature) >= (uint32_t)settings.temperatureDeadband ||
+         difference(reading.humidity, lastSent.humidity) >= (uint32_t)settings.humidityDeadband ||
+         difference(reading.pressure, lastSent.pressure) >= (uint32_t)settings.pressureDeadband;
+}
+
+// Wake the CC1101 from SLEEP; PATABLE is lost while asleep, so the output power is written again
+void wakeRadio() {
+  cc110.setModeIdle();
+  cc110.setTxPower((RH_CC110::TransmitPower)(POWER_LEVEL_MIN + link.powerStep));
+}
+
+// Switch the modem configuration to profile; the radio must be awake and idle
+void useProfile(uint8_t profile) {
+  if (profile != radioProfile) {
+    cc110.setModemConfig((RH_CC110::ModemConfigChoice)LINK_PROFILES[profile].modemConfig);
+    radioProfile = profile;
+  }
+}
+
+uint32_t nodeClock() {
+  return millis() + sleptTotal;
+}
+
+// True once the node clock has reached at
+static bool reached(uint32_t now, uint32_t at) {
+  return (int32_t)(now - at) >= 0;
+}
+
+// Sleep until the node clock reaches at
+void sleepUntil(uint32_t at) {
+  uint32_t now = nodeClock();
+  if (reached(now, at)) {
+    return;
+  }
+  uint32_t remaining = at - now;
+#if LOW_POWER
+  LowPower.deepSleep(remaining);
+  sleptTotal += remaining;
+#else
+  delay(remaining);
+#endif
+}
+
+void radioOff() {
+#if LOW_POWER
+  cc110.sleep();
+#else
+  cc110.setModeIdle();
+#endif
+}
+
+// Keep the receiver on for up to length ms and adopt the first beacon heard; true when one was
+bool listenForBeacon(uint32_t length) {
+  wakeRadio();
+  cc110.setModeRx();
+  
+  bool heard = false;
+  uint32_t start = millis();
+  while (!heard && millis() - start < length) {
+    uint8_t buf[RH_CC110_MAX_MESSAGE_LEN];
+    uint8_t len = sizeof(buf);
+    SensorBeacon beacon;
+    if (cc110.waitAvailableTimeout(length - (millis() - start)) && cc110.recv(buf, &len) &&
+        decodeSensorBeacon(buf, len, beacon)) {
+      schedule.beaconHeard(beacon, nodeClock());
+      heard = schedule.synced(nodeClock());
+    }
+  }
+  
+  radioOff();
+  return heard;
+}
+
+// Decide when the pending frame goes out: after the next beacon when synchronised, otherwise now
+void planTransmission(uint32_t now) {
+  beaconCheckPending = TDMA && schedule.synced(now);
+  slotTransmission = false;
+  if (beaconCheckPending) {
+    listenTime = schedule.listenAt(now);
   } else {
-    temperature = humidity = -999.99;  // Error value
+    transmitTime = now;
   }
+}
+
+// Pick the slot after a beacon check; a slot the drift has outgrown falls back to listen-before-talk
+void planSlot(uint32_t now) {
+  uint32_t traffic = linkAirtime(SENSOR_SUMMARY_FRAME_LEN, link.profile) + ACK_TURNAROUND +
+                     linkAirtime(ACK_PAYLOAD_MAX, link.profile);
+  slotTransmission = schedule.synced(now) && schedule.fits(traffic, now);
+  transmitTime = slotTransmission ? schedule.slotAt(now) : now;
+}
 
-  pressure = bmp.readPressure() / 100.0;  // Convert Pa to hPa
-  if (isnan(pressure)) {
-    pressure = -999.99;  // Error value
+// Listen before talk with random back-off; the radio must already be awake
+bool channelClear() {
+  cc110.setModeRx();
+  for (uint8_t attempt = 0; attempt < LBT_ATTEMPTS; attempt++) {
+    delay(1);  // RSSI settles after entering RX
+    if (cc110.channelRssi() < LBT_RSSI_THRESHOLD) {
+      return true;
+    }
+    delay(random(LBT_BACKOFF_MIN, LBT_BACKOFF_MAX));
   }
+  return false;
 }
 
 void setup() {
@@ -70,8 +434,8 @@ void setup() {
   // Initialize SPI communication
   SPI.begin();
   
-  // Initialize the CC110 module
-  while (!cc110.init()) {
+  // Initialize the CC110 module, addressed as NODE_ID
+  while (!manager.init()) {
     // If initialization fails, blink LED rapidly
     for (int i = 0; i < 10; i++) {
       digitalWrite(LED_PIN, LOW);  // LED on
@@ -84,19 +448,39 @@ void setup() {
   // Set the transmitter frequency to 433 MHz
   cc110.setFrequency(433.0);
   
-  // Set transmit power to maximum
-  cc110.setTxPower(RH_CC110::TransmitPower10dBm);
+  // Start robust at maximum transmit power until the gateway's ACKs show the link has margin
+  cc110.setTxPower((RH_CC110::TransmitPower)(POWER_LEVEL_MIN + link.powerStep));
+  
+  manager.setRetries(0);
+  manager.setTimeout(ACK_TIMEOUT);
+  
+  // Settings applied by downlink commands before the last reset
+  config.begin();
+  settings.readingInterval = config.number(CONFIG_READING_INTERVAL, settings.readingInterval);
+  settings.maxSilence = config.number(CONFIG_MAX_SILENCE, settings.maxSilence);
+  settings.temperatureDeadband = config.number(CONFIG_TEMPERATURE_DEADBAND, settings.temperatureDeadband);
+  settings.humidityDeadband = config.number(CONFIG_HUMIDITY_DEADBAND, settings.humidityDeadband);
+  settings.pressureDeadband = config.number(CONFIG_PRESSURE_DEADBAND, settings.pressureDeadband);
   
   // Initialize sensors
   aht.begin();
   bmp.begin(0x77);  // BMP280 I2C address is typically 0x76 or 0x77
   
-  // Configure BMP280 settings for weather monitoring
-  bmp.setSampling(Adafruit_BMP280::MODE_NORMAL,
-                  Adafruit_BMP280::SAMPLING_X2,
-                  Adafruit_BMP280::SAMPLING_X16,
-                  Adafruit_BMP280::FILTER_X16,
-                  Adafruit_BMP280::STANDBY_MS_500);
+  // Weather monitoring settings from the BMP280 datasheet: forced mode, no oversampling or filter
+  bmp.setSampling(Adafruit_BMP280::MODE_FORCED,
+                  Adafruit_BMP280::SAMPLING_X1,
+                  Adafruit_BMP280::SAMPLING_X1,
+                  Adafruit_BMP280::FILTER_OFF,
+                  Adafruit_BMP280::STANDBY_MS_1);
+
+#if LOW_POWER
+  // The RTC runs from the Blue Pill's 32.768 kHz crystal and wakes the MCU from STOP
+  STM32RTC::getInstance().setClockSource(STM32RTC::LSE_CLOCK);
+  LowPower.begin();
+#endif
+  
+  // Nodes start their back-off sequences apart even after a common power-up
+  randomSeed(NODE_ID);
   
   // Blink LED three times to indicate successful setup
   for (int i = 0; i < 3; i++) {
@@ -107,30 +491,229 @@ void setup() {
   }
 }
 
-void loop() {
-  float temperature, humidity, pressure;
-  
-  // Get real sensor data
-  getSensorData(temperature, humidity, pressure);
-  
-  // Prepare the message to be sent
-  // Format: "T:XX.XX,H:YY.YY,P:ZZZZ.ZZ" where XX.XX is temperature, YY.YY is humidity, and ZZZZ.ZZ is pressure
-  char msg[48];
-  snprintf(msg, sizeof(msg), "T:%d.%02d,H:%d.%02d,P:%d.%02d", 
-           (int)temperature, abs((int)(temperature*100)%100), 
-           (int)humidity, abs((int)(humidity*100)%100),
-           (int)pressure, abs((int)(pressure*100)%100));
+// Apply a setting within its bounds and keep it in flash; the result code goes back to the gateway. A failed
+// flash write still leaves the setting applied until the next reset
+uint8_t applyCommand(const SensorCommand& command) {
+  int32_t value = command.value;
+  switch (command.code) {
+    case SENSOR_COMMAND_INTERVAL:
+      if (value < (int32_t)COMMAND_INTERVAL_MIN || value > (int32_t)COMMAND_INTERVAL_MAX) {
+        return SENSOR_RESULT_OUT_OF_RANGE;
+      }
+      settings.readingInterval = value;
+      config.setNumber(CONFIG_READING_INTERVAL, value);
+      return SENSOR_RESULT_OK;
+    
+    case SENSOR_COMMAND_HEARTBEAT:
+      if (value < (int32_t)settings.readingInterval || value > (int32_t)COMMAND_SILENCE_MAX) {
+        return SENSOR_RESULT_OUT_OF_RANGE;
+      }
+      settings.maxSilence = value;
+      config.setNumber(CONFIG_MAX_SILENCE, value);
+      return SENSOR_RESULT_OK;
+    
+    case SENSOR_COMMAND_TEMPERATURE_DEADBAND:
+    case SENSOR_COMMAND_HUMIDITY_DEADBAND:
+    case SENSOR_COMMAND_PRESSURE_DEADBAND:
+      if (value < 0 || value > COMMAND_DEADBAND_MAX) {
+        return SENSOR_RESULT_OUT_OF_RANGE;
+      }
+      if (command.code == SENSOR_COMMAND_TEMPERATURE_DEADBAND) {
+        settings.temperatureDeadband = value;
+        config.setNumber(CONFIG_TEMPERATURE_DEADBAND, value);
+      } else if (command.code == SENSOR_COMMAND_HUMIDITY_DEADBAND) {
+        settings.humidityDeadband = value;
+        config.setNumber(CONFIG_HUMIDITY_DEADBAND, value);
+      } else {
+        settings.pressureDeadband = value;
+        config.setNumber(CONFIG_PRESSURE_DEADBAND, value);
+      }
+      return SENSOR_RESULT_OK;
+    
+    default:
+      return SENSOR_RESULT_UNSUPPORTED;  // Moisture threshold and valve belong to field nodes, not this weather node
+  }
+}
+
+// Take a command carried in the ACK's payload; the gateway repeats it until the result arrives, so a command
+// is applied once per sequence number and answered every time
+void handleCommand() {
+  SensorCommand command;
+  if (!decodeSensorCommand(cc110.lastPayload(), cc110.lastPayloadLen(), command) || command.nodeId != NODE_ID) {
+    return;
+  }
+  if (!commandApplied || command.sequence != lastCommandSequence) {
+    pendingResult.result = applyCommand(command);
+    lastCommandSequence = command.sequence;
+    commandApplied = true;
+  }
+  pendingResult.nodeId = NODE_ID;
+  pendingResult.sequence = command.sequence;
+  pendingResult.code = command.code;
+  resultDue = true;
+}
+
+// Send the pending frame to the gateway at profile and wait for its ACK; true when it was acknowledged
+bool transmitPending(uint8_t profile) {
+  // Pack the summary or command result into the binary frame shared with the gateways (see SensorPacket.h)
+  uint8_t frame[SENSOR_SUMMARY_FRAME_LEN];
+  size_t frameLen = pendingIsResult ? encodeSensorCommandResult(pendingResult, frame, sizeof(frame))
+                                    : encodeSensorSummary(pendingSummary, frame, sizeof(frame));
   
-  // Turn on LED to indicate transmission attempt
+#if !LOW_POWER
+  // Turn on LED to indicate transmission attempt (bench builds only)
   digitalWrite(LED_PIN, LOW);
+#endif
+  
+  // Tell the gateway the power and profile the frame goes out at, so it can work out the path loss
+  LinkAdvice sentAt = {profile, link.powerStep};
+  cc110.setHeaderFlags(encodeLinkFlags(sentAt), RH_FLAGS_APPLICATION_SPECIFIC);
   
   // Send the message using the CC110 transmitter
-  cc110.send((uint8_t *)msg, strlen(msg));
-  cc110.waitPacketSent();
+  bool acked = manager.sendtoWait(frame, frameLen, SENSOR_GATEWAY_ADDRESS);
   
   // Turn off LED to indicate end of transmission
   digitalWrite(LED_PIN, HIGH);
+
+  if (acked && pendingIsResult) {
+    resultDue = false;
+  } else if (acked) {
+    lastSent = pendingSummary.reading;
+    lastSent.flags &= ~SENSOR_FLAG_RESTARTED;  // Not a sensor state change for shouldTransmit()
+    restartAcked = true;
+    sentOnce = true;
+    silentFor = 0;
+  }
+  if (acked) {
+    handleCommand();
+  }
+  return acked;
+}
+
+// Take the advice carried in the ACK's header flags; a missed ACK drops back to the robust profile one power step up
+void adaptLink(bool acked) {
+  if (acked) {
+    link = decodeLinkFlags(cc110.headerFlags());
+    return;
+  }
+  link.profile = LINK_PROFILE_ROBUST;
+  if (link.powerStep < LINK_POWER_STEPS - 1) {
+    link.powerStep++;
+  }
+}
+
+// Send the pending frame if the channel is clear; without an ACK it is retried up to ACK_ATTEMPTS times
+void sendPending(uint32_t now) {
+  uint8_t profile = slotTransmission ? link.profile : LINK_PROFILE_ROBUST;
+  wakeRadio();
+  useProfile(profile);
+  bool clear = channelClear();
+  bool acked = clear && transmitPending(profile);
+  useProfile(LINK_PROFILE_ROBUST);  // Beacons and the gateway outside fast slots stay on the robust profile
+  radioOff();
+  
+  if (clear) {
+    adaptLink(acked);
+    pendingAttempts++;
+  }
+  
+  if (acked || pendingAttempts >= ACK_ATTEMPTS) {
+    if (!acked && pendingIsResult) {
+      resultDue = false;  // The gateway carries the command again in a later ACK and the result follows that
+    } else if (!acked) {
+      undelivered++;  // The next window differs from lastSent, so it is sent regardless of the deadbands
+    }
+    framePending = false;
+    return;
+  }
   
-  // Wait for 5 seconds before sending the next message
-  delay(5000);
-}
\ No newline at end of file
+  if (clear) {
+    // A lost ACK can leave the gateway listening at a different profile in the slot; retry robust outside it,
+    // and the gateway's answer brings both sides back in step
+    slotTransmission = false;
+    beaconCheckPending = false;
+    transmitTime = now + LBT_RETRY;
+    return;
+  }
+  planTransmission(now + LBT_RETRY);
+}
+
+// Earliest node clock time at which loop() has work to do
+uint32_t nextEvent() {
+  uint32_t next = nextSampleAt;
+  
+  if (TDMA && !schedule.synced(nodeClock()) && (int32_t)(searchAt - next) < 0) {
+    next = searchAt;
+  }
+  if (framePending) {
+    uint32_t at = beaconCheckPending ? listenTime : transmitTime;
+    if ((int32_t)(at - next) < 0) {
+      next = at;
+    }
+  }
+  return next;
+}
+
+void loop() {
+  uint32_t now = nodeClock();
+  
+  if (reached(now, nextSampleAt)) {
+    uint32_t sampleInterval = settings.readingInterval / SAMPLES_PER_WINDOW;
+    nextSampleAt += sampleInterval;
+    if (reached(now, nextSampleAt)) {
+      nextSampleAt = now + sampleInterval;  // Fell behind during a beacon search; do not sample in a burst
+    }
+    sampleSensors();
+    
+    if (windowSamples >= SAMPLES_PER_WINDOW) {
+      SensorSummary summary;
+      summarizeWindow(summary);
+      
+      // Only key the radio when something changed enough for the gateway to care; a newer summary replaces
+      // one still waiting, or a command result, which the gateway asks for again in the summary's ACK
+      if (shouldTransmit(summary.reading)) {
+        pendingSummary = summary;
+        pendingSummary.reading.sequence = sequenceNumber++;  // Kept across retransmits so the gateway drops duplicates
+        if (!restartAcked) {
+          pendingSummary.reading.flags |= SENSOR_FLAG_RESTARTED;
+        }
+        pendingIsResult = false;
+        pendingAttempts = 0;
+        framePending = true;
+        planTransmission(nodeClock());
+      }
+      silentFor += settings.readingInterval;
+    }
+  }
+  
+  // Answer a command as soon as no summary is waiting
+  if (resultDue && !framePending) {
+    pendingIsResult = true;
+    pendingAttempts = 0;
+    framePending = true;
+    planTransmission(nodeClock());
+  }
+  
+  // Unsynchronised: look for a beacon right after boot or losing sync, then every TDMA_SEARCH_INTERVAL
+  if (TDMA && !schedule.synced(nodeClock()) && reached(nodeClock(), searchAt)) {
+    if (!listenForBeacon(TDMA_SEARCH_WINDOW)) {
+      searchAt = nodeClock() + TDMA_SEARCH_INTERVAL;
+    }
+    if (framePending) {
+      planTransmission(nodeClock());
+    }
+  }
+  
+  // Synchronised: refresh the timing from the beacon just before using the slot
+  if (framePending && beaconCheckPending && reached(nodeClock(), listenTime)) {
+    listenForBeacon(schedule.listenLength(listenTime));
+    beaconCheckPending = false;
+    planSlot(nodeClock());
+  }
+  
+  if (framePending && !beaconCheckPending && reached(nodeClock(), transmitTime)) {
+    sendPending(nodeClock());
+  }
+  
+  sleepUntil(nextEvent());
+}
@@ -0,0 +1,126 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+
+/* Signed Q-format fixed-point number: a Storage integer counting units of 2^-FractionBits.
+ * The Mega's AVR has no FPU, so float arithmetic is a library call of a few hundred cycles
+ * and pulls the soft-float routines into flash; this type keeps every step an integer add,
+ * compare or shift. The most negative raw value means "no reading", in place of NAN.
+ * Everything is constexpr within C++11, so constants and calibration curves fold at compile time.
+ */
+template <uint8_t FractionBits, typename Storage = int16_t>
+class Fixed {
+public:
+  static constexpr long ONE = 1L << FractionBits;
+
+  constexpr Fixed() : raw(0) {}
+
+  static constexpr Fixed fromRaw(long value) { return Fixed((Storage)value); }
+  static constexpr Fixed fromInt(long value) { return Fixed((Storage)(value * ONE)); }
+
+  // numerator / denominator rounded to the nearest unit, in long arithmetic only (denominator * ONE must fit)
+  static constexpr Fixed fromRatio(long numerator, long denominator) {
+    return Fixed((Storage)(numerator / denominator * ONE + divideRounded(numerator % denominator * ONE, denominator)));
+  }
+
+  // For libraries that only hand out float; NAN becomes none()
+  static Fixed fromFloat(float value) {
+    return isnan(value) ? none() : Fixed((Storage)lround(value * ONE));
+  }
+
+  static constexpr Fixed none() { return Fixed(NONE); }
+  constexpr bool valid() const { return raw != NONE; }
+
+  constexpr Storage rawValue() const { return raw; }
+
+  // Whole units, rounded down, or to the nearest
+  constexpr long floor() const { return raw >> FractionBits; }
+  constexpr long round() const { return ((long)raw + ONE / 2) >> FractionBits; }
+
+  constexpr Fixed operator+(Fixed other) const { return Fixed((Storage)(raw + other.raw)); }
+  constexpr Fixed operator-(Fixed other) const { return Fixed((Storage)(raw - other.raw)); }
+  constexpr Fixed operator*(long factor) const { return Fixed((Storage)(raw * factor)); }
+  constexpr Fixed operator/(long divisor) const { return Fixed((Storage)divideRounded(raw, divisor)); }
+  Fixed& operator+=(Fixed other) {
+    raw += other.raw;
+    return *this;
+  }
+
+  constexpr bool operator==(Fixed other) const { return raw == other.raw; }
+  constexpr bool operator!=(Fixed other) const { return raw != other.raw; }
+  constexpr bool operator<(Fixed other) const { return raw < other.raw; }
+  constexpr bool operator>(Fixed other) const { return raw > other.raw; }
+
+  // Against whole-unit limits such as the block thresholds; none() compares below every limit
+  constexpr bool operator<(long limit) const { return raw < limit * ONE; }
+  constexpr bool operator>(long limit) const { return raw > limit * ONE; }
+
+  // Print with decimals digits after the point (at most 4), rounded, or "nan" for none(), as Print does for floats
+  size_t printTo(Print& out, uint8_t decimals = 2) const {
+    if (!valid()) {
+      return out.print("nan");
+    }
+    unsigned long scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+      scale *= 10;
+    }
+    unsigned long magnitude = raw < 0 ? -(long)raw : raw;
+    unsigned long whole = magnitude >> FractionBits;
+    unsigned long fraction = ((magnitude & (ONE - 1)) * scale + ONE / 2) >> FractionBits;
+    if (fraction >= scale) {
+      whole++;  // The fraction rounded up to the next unit
+      fraction -= scale;
+    }
+
+    size_t written = raw < 0 ? out.print('-') : 0;
+    written += out.print(whole);
+    if (decimals > 0) {
+      written += out.print('.');
+      for (unsigned long digit = scale / 10; digit > 0; digit /= 10) {
+        written += out.print((char)('0' + fraction / digit % 10));
+      }
+    }
+    return written;
+  }
+
+private:
+  static constexpr Storage NONE = (Storage)((Storage)1 << (sizeof(Storage) * 8 - 1));
+
+  constexpr explicit Fixed(Storage value) : raw(value) {}
+
+  static constexpr long divideRounded(long numerator, long denominator) {
+    return (numerator + (numerator >= 0 ? denominator / 2 : -denominator / 2)) / denominator;
+  }
+
+  Storage raw;
+};
+
+// One point of a piecewise-linear calibration curve: a raw sensor reading and the value it stands for
+template <typename Value>
+struct CurvePoint {
+  int16_t input;
+  Value value;
+};
+
+// Value at input on a curve with ascending inputs, interpolated between its points and held at its ends;
+// recursive so that it stays a C++11 constexpr, one step per point passed
+template <typename Value>
+constexpr Value interpolate(const CurvePoint<Value>* curve, uint8_t points, int16_t input) {
+  return points < 2 || input <= curve[0].input ? curve[0].value
+         : input < curve[1].input
+           ? Value::fromRaw(curve[0].value.rawValue() +
+                            ((long)curve[1].value.rawValue() - curve[0].value.rawValue()) *
+                                (input - curve[0].input) / (curve[1].input - curve[0].input))
+         : points == 2 ? curve[1].value
+                       : interpolate(curve + 1, points - 1, input);
+}
+
+template <typename Value, size_t Points>
+constexpr Value interpolate(const CurvePoint<Value> (&curve)[Points], int16_t input) {
+  return interpolate(&curve[0], Points, input);
+}
+
+#endif
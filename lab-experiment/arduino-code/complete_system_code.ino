@@ -1,410 +1,546 @@
 #include <DHT.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
+#include "FixedPoint.h"
+
+// Control cycle period in milliseconds
+const unsigned long CONTROL_INTERVAL = 10000;
+
+// Longest a valve stays open in one go, then the block soaks before it is checked again
+const unsigned long MAX_WATERING_TIME = 600000;  // 10 minutes
+const unsigned long SOAK_TIME = 300000;          // 5 minutes
+
+// Minimum tank level in percent for any irrigation
+const int TANK_MIN_LEVEL = 20;
+
+// Flow meter pulses are counted in the pin-change interrupt and turned into litres every FLOW_TICK
+const unsigned long FLOW_TICK = 1000;
+const long PULSES_PER_LITRE = 450;  // YF-S201: frequency = 7.5 x L/min
+
+// Background sensor acquisition: DS18B20 conversions run on all buses at once, DHT11s are read one at a
+// time in rotation so each is read at most every DHT_READ_INTERVAL (the DHT11 samples at up to 1 Hz and
+// the DHT library hands back its cached result for 2 s anyway)
+const unsigned long TEMPERATURE_INTERVAL = 2000;   // From the start of one DS18B20 sweep to the next
+const unsigned long CONVERSION_TIMEOUT = 1000;     // Longer than a 12-bit conversion (750 ms)
+const unsigned long DHT_READ_INTERVAL = 2000;
+const unsigned long READING_MAX_AGE = 30000;       // Older cached readings count as missing
+
+// Background tank sounding: a ping every PING_INTERVAL, its echo timed by the pin interrupt on echoPin and
+// collected at the next ping, the tank level the median of the last TANK_SAMPLES good echoes
+const unsigned long PING_INTERVAL = 100;  // ms; the HC-SR04 wants 60 ms between pings for echoes to die down
+const unsigned long ECHO_TIMEOUT = 25000;  // us; ~4 m round trip, longer echoes (38 ms: nothing in range) are dropped
+const uint8_t TANK_SAMPLES = 5;
+
+// No FPU on the Mega, so readings, volumes and flow are fixed-point (FixedPoint.h) from the sensor on.
+// Temperatures and percentages in Q9.7, the DS18B20's own 1/128 resolution
+typedef Fixed<7> SensorValue;
+typedef Fixed<10, int32_t> Litres;  // Q21.10, about 2.3 units per flow meter pulse
+typedef Fixed<8> LitresPerMinute;   // Q7.8, up to 127 L/min
+
+// Moisture probe calibration, ADC counts in ascending order: 300 in water, 1023 in dry air;
+// held at the ends, so a reading past either one is 100 % or 0 %
+constexpr CurvePoint<SensorValue> MOISTURE_CURVE[] = {
+  {300, SensorValue::fromInt(100)},
+  {1023, SensorValue::fromInt(0)},
+};
+static_assert(interpolate(MOISTURE_CURVE, 300) == SensorValue::fromInt(100) &&
+              interpolate(MOISTURE_CURVE, 1023) == SensorValue::fromInt(0),
+              "Moisture curve must span 0-100 %");
+
+// Pin value for a sensor a block does not have
+const uint8_t NO_PIN = 0xFF;
+
+// Threshold value for a limit a block does not use
+const int NO_LIMIT = -1000;
 
-// Pin assignments
-const int moistureSensorPins[] = {A0, A1, A2, A3};  // Pins for moisture sensors in blocks 1 to 3
-const int dhtPins[] = {11, 12, 13};  // Pins for DHT11 humidity sensors in blocks 1 to 3
-const int ds18b20Pins[] = {7, 8, 9, 10};  // Pins for DS18B20 temperature sensors in blocks 1 to 3
-const int solenoidPins[] = {3, 4, 5, 6};  // Pins for solenoid valves
-int X[4];
-int Y[4];
-float TIME[4] = {0};
-float FREQUENCY[4] = {0};
-float WATER[4];
-float TOTAL[4] = {0};
-float LS[4] = {0};
-const int inputPins[] = {15, 16, 17, 18};
 const int pumpPin = 2;  // Pin for irrigation pump
 const int surroundingDHTPin = 21; // Pin for the DHT11 sensor measuring surrounding temperature and humidity
-const int water1Read = A5;
-const int water2Read = A6;
-float moistureLevel[4];
-float humidityLevel[3];
-float temperatureLevel[4];
-
-
-// Thresholds for blocks 1 to 3
-const int moistureMinThresholds[] = {40, 81, 40};  // Min Moisture thresholds for blocks 1 to 3
-const int humidityMinThresholds[] = {65, 55, 70};  // Min Humidity thresholds for blocks 1 to 3
-const int temperatureMinThresholds[] ={21, 15, 13};  // Min Temperature thresholds for blocks 1 to 3
-const int moistureMaxThresholds[] = {60, 95, 75};  // Max Moisture thresholds for blocks 1 to 3
-const int humidityMaxThresholds[] = {95, 90, 70};  // Max Humidity thresholds for blocks 1 to 3
-const int temperatureMaxThresholds[] = {26, 30, 25};  // Max Temperature thresholds for blocks 1 to 3
-
-// Thresholds for block 4
-const int moistureMinThreshold = 60;  // Minimum moisture threshold for block 4
-const int moistureMaxThreshold = 80;  // Maximum moisture threshold for block 4
-const int temperatureMinThreshold = 20;  // Minimum temperature threshold for block 4
-const int temperatureMaxThreshold = 37;  // Maximum temperature threshold for block 4
-const int waterLevelMinThreshold = 2;  // Minimum water level threshold for block 4
-const int waterLevelMaxThreshold = 4;  // Maximum water level threshold for block 4
-
-int trigPin = 19;
-int echoPin = 20;
-long duration;
-float radius = 15;
-int distance;
-int higher = 0;
-int lower = 13;
-int waterLevel;
-float currentWaterLevel;
-
-
-int surroundingTemperature;
-int surroundingHumidity;
-
-// Initialize DHT sensors
-DHT dhtBlocks[] = {DHT(dhtPins[0], DHT11), DHT(dhtPins[1], DHT11), DHT(dhtPins[2], DHT11), DHT(dhtPins[3], DHT11)};
-DHT dhtSurrounding (surroundingDHTPin, DHT11);
-
-// Initialize DS18B20 sensors
-OneWire oneWire[] = {OneWire(ds18b20Pins[0]), OneWire(ds18b20Pins[1]), OneWire(ds18b20Pins[2]), OneWire(ds18b20Pins[3])};
-DallasTemperature ds18b20[] = {DallasTemperature(&oneWire[0]), DallasTemperature(&oneWire[1]), DallasTemperature(&oneWire[2]), DallasTemperature(&oneWire[3])};
-
-// Number of sensors in each block
-const int numSensors = 3;
-
-// Sensor readings array
-//float sensorReadings[5][4];
-float sensorReadings[19];
-
-// Water level in tank
-int waterLevelTank;
+
+// Ultrasonic sensor at the top of the tank
+const int trigPin = 19;
+const int echoPin = 20;
+const int radius = 15;  // Tank radius in cm
+const int higher = 0;
+const int lower = 13;
+
+// Litres per cm of tank depth, pi r^2 / 1000 with pi as 355/113; full between the lower and higher distances
+constexpr Litres TANK_LITRES_PER_CM = Litres::fromRatio(355L * radius * radius, 113L * 1000);
+constexpr Litres TANK_CAPACITY = TANK_LITRES_PER_CM * (lower - higher);
+
+// Sensor objects used by the block table below
+DHT beansHumidity(11, DHT11);
+DHT maizeHumidity(12, DHT11);
+DHT onionHumidity(13, DHT11);
+DHT dhtSurrounding(surroundingDHTPin, DHT11);
+
+OneWire beansBus(7);
+OneWire maizeBus(8);
+OneWire onionBus(9);
+OneWire riceBus(10);
+DallasTemperature beansTemperature(&beansBus);
+DallasTemperature maizeTemperature(&maizeBus);
+DallasTemperature onionTemperature(&onionBus);
+DallasTemperature riceTemperature(&riceBus);
+
+// Irrigation limits of one block; watering starts when a reading crosses a Min (or temperatureMax)
+// and carries on until moisture and paddy water are back up to their Max
+struct BlockThresholds {
+  int moistureMin;
+  int moistureMax;
+  int humidityMin;
+  int temperatureMax;
+  int waterLevelMin;
+  int waterLevelMax;
+};
+
+// Sensors, actuators and limits of one block
+struct BlockConfig {
+  const char* name;
+  uint8_t moisturePin;
+  DHT* humiditySensor;                  // nullptr when the block has none
+  DallasTemperature* temperatureSensor;
+  uint8_t waterLevelPins[2];            // Paddy water level probes, NO_PIN when the block has none
+  uint8_t valvePin;
+  uint8_t flowPin;                      // On port K (A8 to A15), the pins sharing the PCINT2 interrupt
+  BlockThresholds limits;
+};
+
+/* Block Table:
+ * Block | Moisture | DHT11 | DS18B20 | Water level | Valve | Flow
+ * ------|----------|-------|---------|-------------|-------|-----
+ * Beans | A0       | 11    | 7       | -           | 3     | A8
+ * Maize | A1       | 12    | 8       | -           | 4     | A9
+ * Onion | A2       | 13    | 9       | -           | 5     | A10
+ * Rice  | A3       | -     | 10      | A5, A6      | 6     | A11
+ * Adding a block is one more row here and its sensor objects above.
+ */
+const BlockConfig BLOCKS[] = {
+  {"Beans", A0, &beansHumidity, &beansTemperature, {NO_PIN, NO_PIN}, 3, A8, {40, 60, 65, 26, NO_LIMIT, NO_LIMIT}},
+  {"Maize", A1, &maizeHumidity, &maizeTemperature, {NO_PIN, NO_PIN}, 4, A9, {81, 95, 55, 30, NO_LIMIT, NO_LIMIT}},
+  {"Onion", A2, &onionHumidity, &onionTemperature, {NO_PIN, NO_PIN}, 5, A10, {40, 75, 70, 25, NO_LIMIT, NO_LIMIT}},
+  {"Rice",  A3, nullptr,        &riceTemperature,  {A5, A6},         6, A11, {60, 80, NO_LIMIT, 37, 2, 4}},
+};
+
+const int BLOCK_COUNT = sizeof(BLOCKS) / sizeof(BLOCKS[0]);
+
+enum BlockMode {
+  BLOCK_IDLE,      // Valve closed, checked every cycle
+  BLOCK_WATERING,  // Valve open
+  BLOCK_SOAKING    // Valve closed after MAX_WATERING_TIME, not checked until SOAK_TIME has passed
+};
+
+// One cycle's readings of a block; none() or NO_LIMIT where the block has no such sensor
+struct BlockReading {
+  SensorValue temperature;
+  SensorValue moisture;
+  SensorValue humidity;
+  int waterLevel;
+};
+
+// Last value read from a sensor in the background, none() until the first good read
+struct CachedReading {
+  SensorValue value;
+  unsigned long at;  // millis() of the read
+};
+
+enum AcquisitionStage {
+  ACQUIRE_IDLE,       // Waiting for the next DS18B20 sweep
+  ACQUIRE_CONVERTING  // Conversions started on every bus
+};
+
+// Control state of a block
+struct BlockState {
+  BlockMode mode;
+  unsigned long since;  // millis() when the mode was entered
+  unsigned long pulses;  // Flow meter pulses since start-up; the litres delivered are worked out when printed
+  LitresPerMinute flowRate;  // Over the last FLOW_TICK
+  BlockReading reading;
+  CachedReading temperature;
+  CachedReading humidity;
+  DeviceAddress temperatureAddress;  // Of the DS18B20 on the block's bus, looked up once
+  bool temperatureFound;
+};
+
+BlockState blockStates[BLOCK_COUNT];
+
+SensorValue waterLevelTank;  // Percent, taken from tankLevel at the start of each control cycle
+CachedReading tankLevel;     // Percent, from the median echo
+CachedReading surroundingTemperature;
+CachedReading surroundingHumidity;
+
+AcquisitionStage acquisitionStage = ACQUIRE_IDLE;
+unsigned long conversionStartMillis = 0;
+unsigned long previousDhtMillis = 0;
+unsigned long dhtSpacing = DHT_READ_INTERVAL;  // Between two reads in the rotation, so each DHT11 gets DHT_READ_INTERVAL
+int nextDht = 0;  // Rotation over the blocks' DHT11s, then the surrounding one at BLOCK_COUNT
+
+// Echo timing, written in the echoPin interrupt; echoMicros is 0 until the echo of the last ping has ended
+volatile unsigned long echoStartMicros = 0;
+volatile unsigned long echoMicros = 0;
+volatile uint8_t* echoInput;  // Port input register and bit of echoPin, for the interrupt
+uint8_t echoMask;
+unsigned long previousPingMillis = 0;
+
+// Last good echo distances in mm, oldest overwritten first
+uint16_t tankDistances[TANK_SAMPLES];
+uint8_t tankDistanceCount = 0;
+uint8_t nextTankDistance = 0;
+
+unsigned long previousCycleMillis = 0;
+unsigned long previousFlowMillis = 0;
+
+// Flow pulses per block since the last tick, counted in the interrupt
+volatile uint16_t flowPulses[BLOCK_COUNT];
+
+// Block whose flow meter is on each port K bit, or 0xFF; the last port K state, to find rising edges
+uint8_t flowBlockOfBit[8];
+uint8_t flowPortState = 0;
+
+// Function prototypes
+void acquireSensors(unsigned long now);
+void readTemperatures(unsigned long now);
+void readNextDht(unsigned long now);
+void storeReading(CachedReading& cache, SensorValue value, unsigned long now);
+SensorValue freshValue(const CachedReading& cache, unsigned long now);
+void controlCycle();
+void readBlock(const BlockConfig& block, BlockState& state, unsigned long now);
+bool needsWater(const BlockThresholds& limits, const BlockReading& reading);
+bool keepWatering(const BlockThresholds& limits, const BlockReading& reading);
+void stepBlock(const BlockConfig& block, BlockState& state, unsigned long now);
+void setMode(const BlockConfig& block, BlockState& state, BlockMode mode, unsigned long now);
+void flowTick(unsigned long elapsed);
+void onEcho();
+void soundTank(unsigned long now);
+uint16_t medianTankDistance();
+void printReadings();
 
 void setup() {
   // Initialize serial communication
   Serial.begin(9600);
 
-  // Set solenoid and pump pins as outputs
-  for (int i = 0; i < 4; i++) {
-    pinMode(solenoidPins[i], OUTPUT);
-    pinMode(inputPins[i], INPUT);
-  }
   pinMode(pumpPin, OUTPUT);
-
+  digitalWrite(pumpPin, HIGH);  // Pump off
   pinMode(trigPin, OUTPUT);
   pinMode(echoPin, INPUT);
+  echoInput = portInputRegister(digitalPinToPort(echoPin));
+  echoMask = digitalPinToBitMask(echoPin);
+  attachInterrupt(digitalPinToInterrupt(echoPin), onEcho, CHANGE);
+  tankLevel.value = SensorValue::none();
+  dhtSurrounding.begin();
+  int dhtCount = 1;  // The surrounding DHT11
 
-  // Start DHT sensors for blocks 1 to 3
-  for (int i = 0; i < 3; i++) {
-    dhtBlocks[i].begin();
+  for (int i = 0; i < 8; i++) {
+    flowBlockOfBit[i] = 0xFF;
   }
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    const BlockConfig& block = BLOCKS[i];
+    pinMode(block.valvePin, OUTPUT);
+    digitalWrite(block.valvePin, HIGH);  // Valve closed
+    pinMode(block.flowPin, INPUT);
+    flowBlockOfBit[digitalPinToPCMSKbit(block.flowPin)] = i;
+    *digitalPinToPCMSK(block.flowPin) |= bit(digitalPinToPCMSKbit(block.flowPin));
+    if (block.humiditySensor) {
+      block.humiditySensor->begin();
+      dhtCount++;
+    }
+    block.temperatureSensor->begin();
+    block.temperatureSensor->setWaitForConversion(false);
+    blockStates[i].temperatureFound = block.temperatureSensor->getAddress(blockStates[i].temperatureAddress, 0);
+
+    blockStates[i].temperature.value = blockStates[i].humidity.value = SensorValue::none();
+    blockStates[i].mode = BLOCK_IDLE;
+    blockStates[i].since = 0;
+    blockStates[i].pulses = 0;
+    blockStates[i].flowRate = LitresPerMinute();
+  }
+  flowPortState = PINK;
+  PCIFR = bit(PCIF2);  // Drop edges seen while the pins were set up
+  PCICR |= bit(PCIE2);
+  surroundingTemperature.value = surroundingHumidity.value = SensorValue::none();
+  dhtSpacing = DHT_READ_INTERVAL / dhtCount;
+
+  // The first control cycle comes after CONTROL_INTERVAL, by when every sensor has been read
+  previousCycleMillis = previousFlowMillis = millis();
+}
 
-  // Start DHT sensor for surrounding temperature and humidity
-  dhtSurrounding.begin();
-
-  // Start DS18B20 sensors
-  for (int i = 0; i < 3; i++) {
-    ds18b20[i].begin();
+void loop() {
+  unsigned long now = millis();
+  if (now - previousFlowMillis >= FLOW_TICK) {
+    flowTick(now - previousFlowMillis);
+    previousFlowMillis = now;
   }
-  digitalWrite(pumpPin, HIGH);
-  for (int i = 0; i < 4; i++) {
-    digitalWrite(solenoidPins[i], HIGH);
+  acquireSensors(now);
+  if (now - previousCycleMillis >= CONTROL_INTERVAL) {
+    previousCycleMillis += CONTROL_INTERVAL;
+    controlCycle();
   }
-  
-  // Check sensor readings in blocks 1 to 3 during setup
-  for (int i = 0; i < 3; i++) {
-    int moistureLevel = map(analogRead(moistureSensorPins[i]), 1023, 300, 0, 100);
-    float humidityLevel = dhtBlocks[i].readHumidity();
-    ds18b20[i].requestTemperatures();
-    float temperatureLevel = ds18b20[i].getTempCByIndex(0);
-    
-    // Store the sensor readings in the array
-    sensorReadings[2] = map(analogRead(moistureSensorPins[0]), 1023, 300, 0, 100);
-    sensorReadings[6] = map(analogRead(moistureSensorPins[1]), 1023, 300, 0, 100);
-    sensorReadings[10] = map(analogRead(moistureSensorPins[2]), 1023, 300, 0, 100);
-    sensorReadings[3] = dhtBlocks[0].readHumidity();
-    sensorReadings[7] = dhtBlocks[1].readHumidity();
-    sensorReadings[11] = dhtBlocks[2].readHumidity();
-    ds18b20[0].requestTemperatures();
-    sensorReadings[1] = ds18b20[0].getTempCByIndex(0);
-    ds18b20[1].requestTemperatures();
-    sensorReadings[5] = ds18b20[1].getTempCByIndex(0);
-    ds18b20[2].requestTemperatures();
-    sensorReadings[9] = ds18b20[2].getTempCByIndex(0);
-    
-
-    // Check if any sensor reading is below the thresholds
-    if(waterLevelTank > 20){
-      if (moistureLevel < moistureMinThresholds[i] || humidityLevel < humidityMinThresholds[i] || temperatureLevel > temperatureMaxThresholds[i]){
-        for (int i = 0; i < 3; i++) {
-          openValveAndStartPump(i);// Open solenoid valve and start pump for the block
-          X[i] = pulseIn(inputPins[i], HIGH);
-          Y[i] = pulseIn(inputPins[i], LOW);
-          TIME[i] = X[i] + Y[i];
-          FREQUENCY[i] = 1000000 / TIME[i];
-          WATER[i] = FREQUENCY[i] / 7.5;
-          LS[i] = WATER[i] / 60;
-
-          if (FREQUENCY[i] >= 0) {
-             if(isinf(FREQUENCY[i])){
-               calculateTotal(i);
-               sensorReadings[4] = TOTAL[0];
-               sensorReadings[8] = TOTAL[1];
-               sensorReadings[12] = TOTAL[2];
-              } else {
-              TOTAL[i] += LS[i];
-              calculateTotal(i);
-              sensorReadings[4] = TOTAL[0];
-              sensorReadings[8] = TOTAL[1];
-              sensorReadings[12] = TOTAL[2];
-            }
-          }
-        }
-      
-      } 
-      else {
-      closeValveAndStopPump(i);  // Close solenoid valve and stop pump for the block
-      }
-    } 
-    else {
-      closeValveAndStopPump(i);
+}
+
+// Count a pulse for every flow meter pin that went high; all flow meters share port K
+ISR(PCINT2_vect) {
+  uint8_t state = PINK;
+  uint8_t rising = state & ~flowPortState;
+  flowPortState = state;
+  for (uint8_t i = 0; rising; i++, rising >>= 1) {
+    if ((rising & 1) && flowBlockOfBit[i] != 0xFF) {
+      flowPulses[flowBlockOfBit[i]]++;
     }
-    
   }
-  //delay(200);
-
-  // Check sensor readings in block 4 during setup
-  int moistureLevelRice = map(analogRead(moistureSensorPins[3]), 1023, 300, 0, 100);
-  float surroundingHumidity = dhtBlocks[3].readHumidity();
-  float surroundingTemperature = dhtBlocks[3].readTemperature();
-  ds18b20[3].requestTemperatures();
-  float temperatureLevelRice = ds18b20[3].getTempCByIndex(0);
-  // TODO: Read water level sensor for block 4
-  int water1 = analogRead(water1Read);
-  int water2 = analogRead(water2Read);
-  int waterLevel = (water1 + water2)/20;
-
-  // Store the sensor readings in the array
- 
-  sensorReadings[14] = moistureLevelRice;
-  sensorReadings[13] = temperatureLevelRice;
-  sensorReadings[15] = waterLevel;
-  sensorReadings[17] = surroundingTemperature;
-  sensorReadings[18] = surroundingHumidity;
-
-  
-
-  // Check if any sensor reading is below the thresholds
-  if(waterLevelTank >20){
-    if(moistureLevelRice < moistureMinThreshold || temperatureLevelRice > temperatureMaxThreshold || waterLevel < waterLevelMinThreshold){
-      openValveAndStartPump(3);  // Open solenoid valve and start pump for block 4
-      
-      X[3] = pulseIn(inputPins[3], HIGH);
-      Y[3] = pulseIn(inputPins[3], LOW);
-      TIME[3] = X[3] + Y[3];
-      FREQUENCY[3] = 1000000 / TIME[3];
-      WATER[3] = FREQUENCY[3] / 7.5;
-      LS[3] = WATER[3] / 60;
-
-      if (FREQUENCY[3] >= 0) {
-        if (isinf(FREQUENCY[3])) {
-          calculateTotal(3);
-          sensorReadings[16] = TOTAL[3];
-        } else {
-          TOTAL[3] = LS[3];
-          calculateTotal(3);
-          sensorReadings[16] = TOTAL[3];
+}
+
+// Take the pulses counted since the last tick into each block's total and flow rate
+// (elapsed stays near FLOW_TICK; the rate's remainder term overflows beyond ~18 s)
+void flowTick(unsigned long elapsed) {
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    noInterrupts();
+    uint16_t pulses = flowPulses[i];
+    flowPulses[i] = 0;
+    interrupts();
+
+    blockStates[i].pulses += pulses;
+    blockStates[i].flowRate = LitresPerMinute::fromRatio(pulses * 60000L, PULSES_PER_LITRE * elapsed);
+  }
+}
+
+// Background acquisition step, called on every pass of loop(); never waits for a conversion
+void acquireSensors(unsigned long now) {
+  switch (acquisitionStage) {
+    case ACQUIRE_IDLE:
+      if (now - conversionStartMillis >= TEMPERATURE_INTERVAL) {
+        for (int i = 0; i < BLOCK_COUNT; i++) {
+          BLOCKS[i].temperatureSensor->requestTemperatures();  // Returns at once; all buses convert together
         }
+        conversionStartMillis = now;
+        acquisitionStage = ACQUIRE_CONVERTING;
       }
-      
-    } else {
-    closeValveAndStopPump(3);  // Close solenoid valve and stop pump for block 4
+      break;
+
+    case ACQUIRE_CONVERTING: {
+      bool complete = true;
+      for (int i = 0; i < BLOCK_COUNT && complete; i++) {
+        complete = BLOCKS[i].temperatureSensor->isConversionComplete();
+      }
+      if (complete || now - conversionStartMillis >= CONVERSION_TIMEOUT) {
+        readTemperatures(now);
+        acquisitionStage = ACQUIRE_IDLE;
+      }
+      break;
     }
   }
-  else {
-      closeValveAndStopPump(3);
-    }
-  
 
-  // Initialize water level in tank
-  digitalWrite(trigPin, LOW);  
-  delayMicroseconds(10);
-  digitalWrite(trigPin, HIGH);
-  delayMicroseconds(10);
-  digitalWrite(trigPin, LOW);
-  duration = pulseIn(echoPin, HIGH);
-  distance = duration*0.034/2;
-  currentWaterLevel = map(distance,lower,higher,13,0);
-  waterLevelTank = (3.14*radius*radius*currentWaterLevel)/1000;
-  waterLevelTank = map(waterLevelTank,20,0,0,100);
-  sensorReadings[0] = waterLevelTank;
-  
-
-  // Update water level in tank
-  waterLevelTank = currentWaterLevel;
-  for (int i =0; i<19; i++) {
-  Serial.print(sensorReadings[i]);
-  if (i<18) {
-    Serial.print(", ");
+  if (now - previousDhtMillis >= dhtSpacing) {
+    previousDhtMillis = now;
+    readNextDht(now);
+  }
+
+  if (now - previousPingMillis >= PING_INTERVAL) {
+    previousPingMillis = now;
+    soundTank(now);
   }
 }
-Serial.println("");
-  
-  
 
+// Timestamp both edges of the echo pulse; pin 20 has no input capture unit, the micros() clock
+// resolves 4 us (0.7 mm)
+void onEcho() {
+  unsigned long edge = micros();
+  if (*echoInput & echoMask) {
+    echoStartMicros = edge;
+  } else {
+    echoMicros = edge - echoStartMicros;
+  }
 }
 
-void loop() {
-  //Read surrounding temperature and humidity
-  float surroundingTemperature = dhtSurrounding.readTemperature();
-  float surroundingHumidity = dhtSurrounding.readHumidity();
+// Collect the echo of the previous ping, then send the next; a ping without an echo in range adds no sample
+void soundTank(unsigned long now) {
+  noInterrupts();
+  unsigned long width = echoMicros;
+  echoMicros = 0;
+  echoStartMicros = micros();  // A stray falling edge then times a near-zero echo, which the median drops
+  interrupts();
+
+  if (width > 0 && width <= ECHO_TIMEOUT) {
+    tankDistances[nextTankDistance] = width * 343 / 2000;  // mm; sound covers 0.343 mm/us, there and back
+    nextTankDistance = (nextTankDistance + 1) % TANK_SAMPLES;
+    if (tankDistanceCount < TANK_SAMPLES) {
+      tankDistanceCount++;
+    }
 
-  sensorReadings[17] = surroundingTemperature;
-  sensorReadings[18] = surroundingHumidity;
+    // Water depth below the full mark, as a share of the tank's volume
+    long depth = constrain(lower * 10L - medianTankDistance(), 0, (lower - higher) * 10L);  // mm
+    Litres volume = TANK_LITRES_PER_CM * depth / 10;
+    storeReading(tankLevel, SensorValue::fromRatio(volume.rawValue() * 100L, TANK_CAPACITY.rawValue()), now);
+  }
 
-  digitalWrite(trigPin, LOW);  
-  delayMicroseconds(10);
+  digitalWrite(trigPin, LOW);
+  delayMicroseconds(2);
   digitalWrite(trigPin, HIGH);
   delayMicroseconds(10);
   digitalWrite(trigPin, LOW);
-  duration = pulseIn(echoPin, HIGH);
-  distance = duration*0.034/2;
-  currentWaterLevel = map(distance,lower,higher,13,0);
-  waterLevelTank = (3.14*radius*radius*currentWaterLevel)/1000;
-  waterLevelTank = map(waterLevelTank,20,0,0,100);
-  sensorReadings[0] = waterLevelTank;
-
-  // Check sensor readings in blocks 1 to 3
-  for (int i = 0; i < 3; i++) {
-    int moistureLevel = map(analogRead(moistureSensorPins[i]), 1023, 300, 0, 100);
-    float humidityLevel = dhtBlocks[i].readHumidity();
-    ds18b20[i].requestTemperatures();
-    float temperatureLevel = ds18b20[i].getTempCByIndex(0);
-
-   
-    sensorReadings[2] = map(analogRead(moistureSensorPins[0]), 1023, 300, 0, 100);
-    sensorReadings[6] = map(analogRead(moistureSensorPins[1]), 1023, 300, 0, 100);
-    sensorReadings[10] = map(analogRead(moistureSensorPins[2]), 1023, 300, 0, 100);
-    sensorReadings[3] = dhtBlocks[0].readHumidity();
-    sensorReadings[7] = dhtBlocks[1].readHumidity();
-    sensorReadings[11] = dhtBlocks[2].readHumidity();
-    ds18b20[0].requestTemperatures();
-    sensorReadings[1] = ds18b20[0].getTempCByIndex(0);
-    ds18b20[1].requestTemperatures();
-    sensorReadings[5] = ds18b20[1].getTempCByIndex(0);
-    ds18b20[2].requestTemperatures();
-    sensorReadings[9] = ds18b20[2].getTempCByIndex(0);
-
-
-    // Check if any sensor reading is below the thresholds
-    if(waterLevelTank > 20){
-      if (moistureLevel < moistureMinThresholds[i] || humidityLevel < humidityMinThresholds[i] || temperatureLevel > temperatureMaxThresholds[i]){
-      for (int i = 0; i < 3; i++) {
-          openValveAndStartPump(i);// Open solenoid valve and start pump for the block
-          X[i] = pulseIn(inputPins[i], HIGH);
-          Y[i] = pulseIn(inputPins[i], LOW);
-          TIME[i] = X[i] + Y[i];
-          FREQUENCY[i] = 1000000 / TIME[i];
-          WATER[i] = FREQUENCY[i] / 7.5;
-          LS[i] = WATER[i] / 60;
-
-          if (FREQUENCY[i] >= 0) {
-            if (isinf(FREQUENCY[i])) {
-              calculateTotal(i);
-              sensorReadings[4] = TOTAL[0];
-              sensorReadings[8] = TOTAL[1];
-              sensorReadings[12] = TOTAL[2];
-            } else {
-              TOTAL[i] += LS[i];
-              calculateTotal(i);
-              sensorReadings[4] = TOTAL[0];
-              sensorReadings[8] = TOTAL[1];
-              sensorReadings[12] = TOTAL[2];
-            }
-          }
-        }
-      } else {
-        closeValveAndStopPump(i);  // Close solenoid valve and stop pump for the block
-       
-      }
-    }  
-    else {
-      closeValveAndStopPump(i);
-    }  
-  }
-  //delay(200);
-
-  // Check sensor readings in block 4
-  int moistureLevel = map(analogRead(moistureSensorPins[3]), 1023, 300, 0, 100);
-  float humidityLevel = dhtBlocks[3].readHumidity();
-  ds18b20[2].requestTemperatures();
-  float temperatureLevel = ds18b20[2].getTempCByIndex(0);
-  // TODO: Read water level sensor for block 4
-  int water1 = analogRead(water1Read);
-  int water2 = analogRead(water2Read);
-  int waterLevel = (water1 + water2)/20;
-
-  sensorReadings[14] = moistureLevel;
-  sensorReadings[13] = temperatureLevel;
-  sensorReadings[15] = waterLevel;
-  
-
-  // Check if any sensor reading is below the thresholds
-  if(waterLevelTank > 20){
-    if(moistureLevel < moistureMinThreshold || temperatureLevel > temperatureMaxThreshold || waterLevel < waterLevelMinThreshold){
-      openValveAndStartPump(3);  // Open solenoid valve and start pump for block 4
-      
-      X[3] = pulseIn(inputPins[3], HIGH);
-      Y[3] = pulseIn(inputPins[3], LOW);
-      TIME[3] = X[3] + Y[3];
-      FREQUENCY[3] = 1000000 / TIME[3];
-      WATER[3] = FREQUENCY[3] / 7.5;
-      LS[3] = WATER[3] / 60;
-
-      if (FREQUENCY[3] >= 0) {
-        if (isinf(FREQUENCY[3])) {
-          calculateTotal(3);
-          sensorReadings[16] = TOTAL[3];
-        } else {
-          TOTAL[3] = LS[3];
-          calculateTotal(3);
-          sensorReadings[16] = TOTAL[3];
-        }
-      }
-      
-    } else {
-      closeValveAndStopPump(3);  // Close solenoid valve and stop pump for block 4
+}
+
+// Median of the distances collected so far, so a single spurious or multipath echo does not move the level
+uint16_t medianTankDistance() {
+  uint16_t sorted[TANK_SAMPLES];
+  for (uint8_t i = 0; i < tankDistanceCount; i++) {
+    uint16_t distance = tankDistances[i];
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > distance; j--) {
+      sorted[j] = sorted[j - 1];
     }
+    sorted[j] = distance;
   }
-  else {
-      closeValveAndStopPump(3);
+  return sorted[tankDistanceCount / 2];
+}
+
+// Collect the finished conversions; a sensor that was missing at start-up is looked for again
+void readTemperatures(unsigned long now) {
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    DallasTemperature* sensor = BLOCKS[i].temperatureSensor;
+    BlockState& state = blockStates[i];
+    if (!state.temperatureFound) {
+      state.temperatureFound = sensor->getAddress(state.temperatureAddress, 0);
+      continue;
     }
+    int32_t raw = sensor->getTemp(state.temperatureAddress);  // 1/128 degrees C, already Q9.7
+    storeReading(state.temperature, raw == DEVICE_DISCONNECTED_RAW ? SensorValue::none() : SensorValue::fromRaw(raw), now);
+  }
+}
 
-  // Print all sensor readings
+// Read the next DHT11 in the rotation, skipping blocks without one (one DHT11 read takes ~25 ms);
+// the DHT library only returns float, converted once here
+void readNextDht(unsigned long now) {
+  while (nextDht < BLOCK_COUNT && !BLOCKS[nextDht].humiditySensor) {
+    nextDht++;
+  }
+  if (nextDht < BLOCK_COUNT) {
+    storeReading(blockStates[nextDht].humidity, SensorValue::fromFloat(BLOCKS[nextDht].humiditySensor->readHumidity()), now);
+    nextDht++;
+    return;
+  }
+  storeReading(surroundingHumidity, SensorValue::fromFloat(dhtSurrounding.readHumidity()), now);
+  storeReading(surroundingTemperature, SensorValue::fromFloat(dhtSurrounding.readTemperature()), now);  // Same DHT11 read, cached by the library
+  nextDht = 0;
+}
 
-  for (int i =0; i<19; i++) {
-  Serial.print(sensorReadings[i]);
-  if (i<18) {
-    Serial.print(", ");
+// Keep a good value with its time; a failed read leaves the previous value to age out
+void storeReading(CachedReading& cache, SensorValue value, unsigned long now) {
+  if (value.valid()) {
+    cache.value = value;
+    cache.at = now;
   }
 }
-Serial.println("");
 
+// Cached value, or none() when it was never read or is older than READING_MAX_AGE
+SensorValue freshValue(const CachedReading& cache, unsigned long now) {
+  return now - cache.at <= READING_MAX_AGE ? cache.value : SensorValue::none();
+}
+
+/* Control Cycle Worst Case (temperatures, humidities and the tank level come from the background cache):
+ * Step                      | Per cycle
+ * --------------------------|-----------------------------------------------
+ * Moisture and paddy level  | ~0.1 ms per analogRead
+ * Under 1 ms whichever valves are open; flow is counted and the tank sounded in the background and
+ * do not add to it. Outside the cycle, loop() spends at most one DHT11 read (~25 ms) per pass.
+ */
+void controlCycle() {
+  unsigned long now = millis();
+  waterLevelTank = freshValue(tankLevel, now);
+
+  bool pumpNeeded = false;
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    readBlock(BLOCKS[i], blockStates[i], now);
+    stepBlock(BLOCKS[i], blockStates[i], now);
+    pumpNeeded = pumpNeeded || blockStates[i].mode == BLOCK_WATERING;
+  }
+  digitalWrite(pumpPin, pumpNeeded ? LOW : HIGH);
 
-  delay(10000);  // Adjust the delay as needed
+  printReadings();
 }
 
-void openValveAndStartPump(int block) {
-  digitalWrite(solenoidPins[block], LOW);  // Open solenoid valve for the block
-  digitalWrite(pumpPin, LOW);  // Start pump
-  
+void readBlock(const BlockConfig& block, BlockState& state, unsigned long now) {
+  BlockReading& reading = state.reading;
+  reading.moisture = interpolate(MOISTURE_CURVE, analogRead(block.moisturePin));
+  reading.humidity = freshValue(state.humidity, now);
+  reading.temperature = freshValue(state.temperature, now);
+  if (block.waterLevelPins[0] != NO_PIN) {
+    reading.waterLevel = (analogRead(block.waterLevelPins[0]) + analogRead(block.waterLevelPins[1])) / 20;
+  } else {
+    reading.waterLevel = NO_LIMIT;
+  }
 }
 
-void closeValveAndStopPump(int block) {
-  digitalWrite(pumpPin, HIGH);  // Stop pump
-  digitalWrite(solenoidPins[block], HIGH);  // Close solenoid valve for the block  
-  
+// True when a reading crosses a start limit; a missing sensor (none(), NO_LIMIT) never starts watering
+bool needsWater(const BlockThresholds& limits, const BlockReading& reading) {
+  return reading.moisture < limits.moistureMin ||
+         (reading.humidity.valid() && reading.humidity < limits.humidityMin) ||
+         (limits.temperatureMax != NO_LIMIT && reading.temperature.valid() && reading.temperature > limits.temperatureMax) ||
+         reading.waterLevel < limits.waterLevelMin;
 }
 
-void calculateTotal(int block)
-{
-  
-  TOTAL[block];
+// True while moisture or paddy water are still short of their Max, or the start condition still holds
+bool keepWatering(const BlockThresholds& limits, const BlockReading& reading) {
+  return needsWater(limits, reading) ||
+         reading.moisture < limits.moistureMax ||
+         reading.waterLevel < limits.waterLevelMax;
+}
 
+void stepBlock(const BlockConfig& block, BlockState& state, unsigned long now) {
+  bool tankOk = waterLevelTank.valid() && waterLevelTank > TANK_MIN_LEVEL;  // No recent echo: the pump stays off
 
-}
+  switch (state.mode) {
+    case BLOCK_IDLE:
+      if (tankOk && needsWater(block.limits, state.reading)) {
+        setMode(block, state, BLOCK_WATERING, now);
+      }
+      break;
 
+    case BLOCK_WATERING:
+      if (!tankOk || !keepWatering(block.limits, state.reading)) {
+        setMode(block, state, BLOCK_IDLE, now);
+      } else if (now - state.since >= MAX_WATERING_TIME) {
+        setMode(block, state, BLOCK_SOAKING, now);
+      }
+      break;
+
+    case BLOCK_SOAKING:
+      if (now - state.since >= SOAK_TIME) {
+        setMode(block, state, BLOCK_IDLE, now);
+      }
+      break;
+  }
+}
 
+void setMode(const BlockConfig& block, BlockState& state, BlockMode mode, unsigned long now) {
+  state.mode = mode;
+  state.since = now;
+  digitalWrite(block.valvePin, mode == BLOCK_WATERING ? LOW : HIGH);  // Solenoid valves open on LOW
+}
 
+/* Serial Output, one comma-separated line per cycle:
+ * tank % (nan without an echo in READING_MAX_AGE), then per block in table order: temperature, moisture, humidity (water level for
+ * blocks with level probes), total litres; then surrounding temperature and humidity
+ */
+void printReadings() {
+  waterLevelTank.printTo(Serial, 0);
+  for (int i = 0; i < BLOCK_COUNT; i++) {
+    const BlockReading& reading = blockStates[i].reading;
+    Serial.print(", ");
+    reading.temperature.printTo(Serial);
+    Serial.print(", ");
+    Serial.print(reading.moisture.round());
+    Serial.print(", ");
+    if (BLOCKS[i].waterLevelPins[0] != NO_PIN) {
+      Serial.print(reading.waterLevel);
+    } else {
+      reading.humidity.printTo(Serial);
+    }
+    Serial.print(", ");
+    Litres::fromRatio(blockStates[i].pulses, PULSES_PER_LITRE).printTo(Serial);
+  }
+  Serial.print(", ");
+  unsigned long now = millis();
+  freshValue(surroundingTemperature, now).printTo(Serial);
+  Serial.print(", ");
+  freshValue(surroundingHumidity, now).printTo(Serial);
+  Serial.println();
+}